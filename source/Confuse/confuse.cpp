@@ -30,6 +30,7 @@
 #include "../d_io.h"
 #include "../d_dwfile.h"
 #include "../i_system.h"
+#include "../m_qstr.h"
 #include "../w_wad.h"
 
 #include "confuse.h"
@@ -1796,5 +1797,415 @@ void cfg_setlistptr(cfg_t *cfg, const char *name, unsigned int nvalues,
    }
 }
 
+//=============================================================================
+//
+// Serialization
+//
+// A parsed tree can be written out and read back into a cfg_t created with
+// the same options, which is used to cache EDF between runs. Values are
+// stored in native byte order. Option names and types are written along with
+// the values so that a tree written by a build with different options is
+// rejected instead of being misread.
+//
+
+#define CFG_NULLSTRING 0xffffffffu
+
+static void cfg_write_u32(cfg_writefunc_t write, void *ctx, uint32_t u)
+{
+   write(ctx, &u, sizeof(u));
+}
+
+static void cfg_write_string(cfg_writefunc_t write, void *ctx, const char *s)
+{
+   if(!s)
+   {
+      cfg_write_u32(write, ctx, CFG_NULLSTRING);
+      return;
+   }
+
+   uint32_t len = static_cast<uint32_t>(strlen(s));
+   cfg_write_u32(write, ctx, len);
+   write(ctx, s, len);
+}
+
+static void cfg_serialize_body(cfg_t *cfg, cfg_writefunc_t write, void *ctx);
+
+static void cfg_serialize_section(cfg_t *sec, cfg_writefunc_t write, void *ctx)
+{
+   int32_t hdr[2] = { sec->flags, sec->line };
+
+   cfg_write_string(write, ctx, sec->title);
+   write(ctx, hdr, sizeof(hdr));
+   cfg_serialize_body(sec, write, ctx);
+
+   // haleyjd 01/02/12: displaced sections remain reachable
+   cfg_write_u32(write, ctx, sec->displaced != NULL);
+   if(sec->displaced)
+      cfg_serialize_section(sec->displaced, write, ctx);
+}
+
+static void cfg_serialize_body(cfg_t *cfg, cfg_writefunc_t write, void *ctx)
+{
+   uint32_t numopts = 0;
+
+   while(cfg->opts[numopts].name)
+      ++numopts;
+   cfg_write_u32(write, ctx, numopts);
+
+   for(uint32_t i = 0; i < numopts; i++)
+   {
+      cfg_opt_t *opt = &cfg->opts[i];
+
+      cfg_write_string(write, ctx, opt->name);
+      cfg_write_u32(write, ctx, opt->type);
+      cfg_write_u32(write, ctx, opt->nvalues);
+
+      for(unsigned int j = 0; j < opt->nvalues; j++)
+      {
+         cfg_value_t *val = opt->values[j];
+         int32_t number;
+         uint8_t boolean;
+
+         switch(opt->type)
+         {
+         case CFGT_INT:
+         case CFGT_FLAG:
+            number = val->number;
+            write(ctx, &number, sizeof(number));
+            break;
+         case CFGT_FLOAT:
+            write(ctx, &val->fpnumber, sizeof(val->fpnumber));
+            break;
+         case CFGT_BOOL:
+            boolean = val->boolean;
+            write(ctx, &boolean, sizeof(boolean));
+            break;
+         case CFGT_STR:
+         case CFGT_STRFUNC:
+            cfg_write_string(write, ctx, val->string);
+            break;
+         case CFGT_SEC:
+         case CFGT_MVPROP:
+            cfg_serialize_section(val->section, write, ctx);
+            break;
+         default:
+            break;
+         }
+      }
+   }
+}
+
+//
+// cfg_serialize
+//
+// Writes out every value in the tree, through the given write function.
+//
+void cfg_serialize(cfg_t *cfg, cfg_writefunc_t write, void *ctx)
+{
+   cfg_assert(cfg && write);
+   cfg_serialize_body(cfg, write, ctx);
+}
+
+//
+// cfg_reader_t
+//
+// Bounds-checked cursor over serialized data.
+//
+struct cfg_reader_t
+{
+   const unsigned char *data;
+   size_t size;
+   size_t pos;
+
+   bool read(void *dest, size_t len)
+   {
+      if(len > size - pos)
+         return false;
+      memcpy(dest, data + pos, len);
+      pos += len;
+      return true;
+   }
+
+   // Reads a string into allocated memory, or NULL. Returns false on error.
+   bool readString(char *&s)
+   {
+      uint32_t len;
+
+      s = NULL;
+      if(!read(&len, sizeof(len)))
+         return false;
+      if(len == CFG_NULLSTRING)
+         return true;
+      if(len > size - pos)
+         return false;
+
+      s = emalloc(char *, len + 1);
+      memcpy(s, data + pos, len);
+      s[len] = '\0';
+      pos += len;
+      return true;
+   }
+};
+
+static bool cfg_deserialize_body(cfg_t *cfg, cfg_reader_t &rd, int depth);
+
+//
+// cfg_deserialize_section
+//
+// Rebuilds a section value in the same way that cfg_setopt creates one.
+//
+static bool cfg_deserialize_section(cfg_t *cfg, cfg_opt_t *opt, cfg_t *&sec,
+                                    cfg_reader_t &rd, int depth)
+{
+   char    *title;
+   int32_t  hdr[2];
+   uint32_t hasdisplaced;
+
+   if(!opt->subopts || !rd.readString(title))
+      return false;
+
+   sec = estructalloc(cfg_t, 1);
+   sec->namealloc = estrdup(opt->name);
+   sec->name      = sec->namealloc;
+   sec->opts      = cfg_dupopts(opt->subopts);
+   sec->errfunc   = cfg->errfunc;
+   sec->title     = title;
+
+   if(!rd.read(hdr, sizeof(hdr)))
+      return false;
+   sec->flags = hdr[0] | CFGF_ALLOCATED;
+   sec->line  = hdr[1];
+
+   if(!cfg_deserialize_body(sec, rd, depth + 1) ||
+      !rd.read(&hasdisplaced, sizeof(hasdisplaced)))
+      return false;
+
+   if(hasdisplaced)
+      return cfg_deserialize_section(cfg, opt, sec->displaced, rd, depth + 1);
+
+   return true;
+}
+
+static bool cfg_deserialize_body(cfg_t *cfg, cfg_reader_t &rd, int depth)
+{
+   uint32_t numopts;
+
+   // corrupt data could otherwise recurse without bound
+   if(depth > 256 || !rd.read(&numopts, sizeof(numopts)))
+      return false;
+
+   for(uint32_t i = 0; i < numopts; i++)
+   {
+      cfg_opt_t *opt = &cfg->opts[i];
+      char      *name;
+      uint32_t   type, nvalues;
+
+      if(!opt->name || !rd.readString(name))
+         return false;
+
+      bool match = name && !strcmp(name, opt->name);
+      efree(name);
+
+      if(!match || !rd.read(&type, sizeof(type)) || type != uint32_t(opt->type) ||
+         !rd.read(&nvalues, sizeof(nvalues)))
+         return false;
+
+      for(uint32_t j = 0; j < nvalues; j++)
+      {
+         cfg_value_t *val;
+         int32_t number;
+         uint8_t boolean;
+
+         if(opt->simple_value)
+            return false;
+         val = cfg_addval(opt);
+
+         switch(opt->type)
+         {
+         case CFGT_INT:
+         case CFGT_FLAG:
+            if(!rd.read(&number, sizeof(number)))
+               return false;
+            val->number = number;
+            break;
+         case CFGT_FLOAT:
+            if(!rd.read(&val->fpnumber, sizeof(val->fpnumber)))
+               return false;
+            break;
+         case CFGT_BOOL:
+            if(!rd.read(&boolean, sizeof(boolean)))
+               return false;
+            val->boolean = !!boolean;
+            break;
+         case CFGT_STR:
+         case CFGT_STRFUNC:
+            if(!rd.readString(val->string))
+               return false;
+            break;
+         case CFGT_SEC:
+         case CFGT_MVPROP:
+            if(!cfg_deserialize_section(cfg, opt, val->section, rd, depth))
+               return false;
+            break;
+         default:
+            return false;
+         }
+      }
+   }
+
+   // the option list must have been consumed exactly
+   return !cfg->opts[numopts].name;
+}
+
+//
+// cfg_deserialize
+//
+// Reads a tree written by cfg_serialize into cfg, which must not hold any
+// values yet. Returns false if the data is corrupt or was written with
+// different options; cfg may then hold a partial tree and should be freed.
+//
+bool cfg_deserialize(cfg_t *cfg, const unsigned char *data, size_t size)
+{
+   cfg_reader_t rd = { data, size, 0 };
+
+   cfg_assert(cfg);
+   return cfg_deserialize_body(cfg, rd, 0) && rd.pos == size;
+}
+
+//
+// cfg_init_copy
+//
+// Creates an empty root cfg_t with the same options as an existing one, but
+// with its own copy of the option array, so that both can hold values at the
+// same time.
+//
+cfg_t *cfg_init_copy(cfg_t *cfg)
+{
+   cfg_t *copy = cfg_init(cfg_dupopts(cfg->opts), cfg->flags | CFGF_ALLOCATED);
+
+   copy->namealloc = estrdup(cfg->name);
+   copy->name      = copy->namealloc;
+   copy->errfunc   = cfg->errfunc;
+   copy->lexfunc   = cfg->lexfunc;
+
+   // the copied option array must not share the original's values
+   for(int i = 0; copy->opts[i].name; i++)
+   {
+      copy->opts[i].nvalues = 0;
+      copy->opts[i].values  = NULL;
+   }
+
+   return copy;
+}
+
+static bool cfg_compare_section(cfg_t *a, cfg_t *b, qstring &path);
+
+//
+// cfg_compare_body
+//
+static bool cfg_compare_body(cfg_t *a, cfg_t *b, qstring &path)
+{
+   for(int i = 0; a->opts[i].name; i++)
+   {
+      cfg_opt_t *oa = &a->opts[i];
+      cfg_opt_t *ob = &b->opts[i];
+      size_t     pathlen = path.length();
+
+      if(!ob->name || strcmp(oa->name, ob->name) || oa->type != ob->type)
+         return false;
+
+      path << '/' << oa->name;
+
+      if(oa->nvalues != ob->nvalues)
+         return false;
+
+      for(unsigned int j = 0; j < oa->nvalues; j++)
+      {
+         cfg_value_t *va = oa->values[j];
+         cfg_value_t *vb = ob->values[j];
+         bool same = true;
+
+         switch(oa->type)
+         {
+         case CFGT_INT:
+         case CFGT_FLAG:
+            same = (va->number == vb->number);
+            break;
+         case CFGT_FLOAT:
+            same = !memcmp(&va->fpnumber, &vb->fpnumber, sizeof(double));
+            break;
+         case CFGT_BOOL:
+            same = (va->boolean == vb->boolean);
+            break;
+         case CFGT_STR:
+         case CFGT_STRFUNC:
+            same = (!va->string == !vb->string) &&
+                   (!va->string || !strcmp(va->string, vb->string));
+            break;
+         case CFGT_SEC:
+         case CFGT_MVPROP:
+            path << '[' << static_cast<int>(j) << ']';
+            if(!cfg_compare_section(va->section, vb->section, path))
+               return false;
+            path.truncate(pathlen);
+            path << '/' << oa->name;
+            break;
+         default:
+            break;
+         }
+
+         if(!same)
+         {
+            path << '[' << static_cast<int>(j) << ']';
+            return false;
+         }
+      }
+
+      path.truncate(pathlen);
+   }
+
+   return true;
+}
+
+//
+// cfg_compare_section
+//
+static bool cfg_compare_section(cfg_t *a, cfg_t *b, qstring &path)
+{
+   if((!a->title != !b->title) || (a->title && strcmp(a->title, b->title)) ||
+      a->flags != b->flags || a->line != b->line)
+      return false;
+
+   if(!cfg_compare_body(a, b, path))
+      return false;
+
+   if(!a->displaced != !b->displaced)
+      return false;
+   if(a->displaced)
+   {
+      size_t pathlen = path.length();
+
+      path << "/<displaced>";
+      if(!cfg_compare_section(a->displaced, b->displaced, path))
+         return false;
+      path.truncate(pathlen);
+   }
+
+   return true;
+}
+
+//
+// cfg_compare
+//
+// Compares the values held by two trees with the same options. Returns true
+// if they are identical; otherwise, path receives the location of the first
+// difference.
+//
+bool cfg_compare(cfg_t *a, cfg_t *b, qstring &path)
+{
+   path = a->name;
+   return cfg_compare_body(a, b, path);
+}
+
 // EOF
 
@@ -814,6 +814,39 @@ void cfg_addlist(cfg_t *cfg, const char *name, unsigned int nvalues, ...);
  */
 void cfg_setlistptr(cfg_t *cfg, const char *name, unsigned int nvalues, 
                     const void *valarray);
+
+/** Output callback used by cfg_serialize. */
+typedef void (*cfg_writefunc_t)(void *ctx, const void *data, size_t len);
+
+/** Write out all values held by a parsed tree. The data can only be read
+ * back into a tree created with the same options, by the same build.
+ *
+ * @param cfg The configuration file context.
+ * @param write Function that receives the serialized data.
+ * @param ctx User pointer passed through to write.
+ */
+void cfg_serialize(cfg_t *cfg, cfg_writefunc_t write, void *ctx);
+
+/** Read values written by cfg_serialize into a tree that holds none yet.
+ *
+ * @return false if the data is corrupt or does not match the options of
+ * the tree. The tree may then hold partial values and should be freed.
+ */
+bool cfg_deserialize(cfg_t *cfg, const unsigned char *data, size_t size);
+
+/** Create an empty root context with a private copy of the options used
+ * by another, so that both can hold values at once. Free with cfg_free().
+ */
+cfg_t *cfg_init_copy(cfg_t *cfg);
+
+/** Compare the values held by two trees created with the same options.
+ *
+ * @param path Receives the location of the first difference, if any.
+ * @return true if the trees are identical.
+ */
+class qstring;
+bool cfg_compare(cfg_t *a, cfg_t *b, qstring &path);
+
 #endif
 
 /** @example cfgtest.c
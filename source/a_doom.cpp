@@ -825,6 +825,7 @@ void A_VileAttack(actionargs_t *actionargs)
 
    S_StartSound(actor, sfx_barexp);
    P_DamageMobj(actor->target, actor, actor, 20, actor->info->mod);
+   actor->target->wake(); // in case the damage did not reach it
    actor->target->momz = 1000*FRACUNIT/actor->target->info->mass;
 
    an = actor->angle >> ANGLETOFINESHIFT;
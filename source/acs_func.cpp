@@ -1931,6 +1931,8 @@ bool ACS_CF_SetThingMom(ACS_CF_ARGS)
 
    while((mo = P_FindMobjFromTID(tid, mo, info->mo)))
    {
+      mo->wake();
+
       if(add)
       {
          mo->momx += momx;
@@ -1992,6 +1994,7 @@ bool ACS_CF_SetThingPos(ACS_CF_ARGS)
       fixed_t oldy = mo->y;
       fixed_t oldz = mo->z;
 
+      mo->wake();
       mo->z = z;
 
       if(P_CheckPositionExt(mo, x, y, z))
@@ -2048,6 +2051,8 @@ void ACS_SetThingProp(Mobj *thing, uint32_t var, uint32_t val)
 {
    if(!thing) return;
 
+   thing->wake();
+
    switch(var)
    {
    case ACS_TP_Health:       thing->health = val; break;
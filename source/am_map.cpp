@@ -43,10 +43,14 @@
 #include "e_inventory.h"
 #include "ev_specials.h"
 #include "g_bind.h"
+#include "m_bbox.h"
+#include "m_collection.h"
+#include "m_compare.h"
 #include "p_maputl.h"
 #include "p_portal.h"
 #include "p_setup.h"
 #include "p_spec.h"
+#include "polyobj.h"
 #include "st_stuff.h"
 #include "r_draw.h"
 #include "r_dynseg.h"
@@ -1324,19 +1328,37 @@ static void AM_drawFline(fline_t *fl, int color )
    }
 }
 
+// Foreground RGB values of the current Wu line colour at every weight, so
+// that a run of lines in the same colour looks them up once.
+static int          am_wucolor = -1;
+static unsigned int am_wufg[65];
+
+//
+// AM_setWuColor
+//
+static void AM_setWuColor(int color)
+{
+   if(color == am_wucolor)
+      return;
+
+   for(int weight = 0; weight <= 64; weight++)
+      am_wufg[weight] = Col2RGB8[weight][color];
+   am_wucolor = color;
+}
+
 //
 // AM_putWuDot
 //
 // haleyjd 06/13/09: Pixel plotter for Wu line drawing.
+// Uses the colour set by AM_setWuColor.
 //
-static void AM_putWuDot(int x, int y, int color, int weight)
+static void AM_putWuDot(int x, int y, int weight)
 {
    byte *dest = VBADDRESS(&vbscreen, x, y);
-   unsigned int *fg2rgb = Col2RGB8[weight];
    unsigned int *bg2rgb = Col2RGB8[64 - weight];
    unsigned int fg, bg;
 
-   fg = fg2rgb[color];
+   fg = am_wufg[weight];
    bg = bg2rgb[*dest];
    fg = (fg + bg) | 0x1f07c1f;
    *dest = RGB32k[0][0][fg & (fg >> 15)];
@@ -1390,6 +1412,8 @@ static void AM_drawFlineWu(fline_t *fl, int color)
       return;
    }
 
+   AM_setWuColor(color);
+
    // draw first pixel
    PUTDOT(fl->a.x, fl->a.y, color);
 
@@ -1415,10 +1439,8 @@ static void AM_drawFlineWu(fline_t *fl, int color)
          y += 1; // advance y
 
          // the trick is in the trig!
-         AM_putWuDot(x, y, color, 
-                     finecosine[erroracc >> wu_fineshift] >> wu_fixedshift);
-         AM_putWuDot(x + xdir, y, color, 
-                     finesine[erroracc >> wu_fineshift] >> wu_fixedshift);
+         AM_putWuDot(x, y, finecosine[erroracc >> wu_fineshift] >> wu_fixedshift);
+         AM_putWuDot(x + xdir, y, finesine[erroracc >> wu_fineshift] >> wu_fixedshift);
       }
    }
    else
@@ -1440,10 +1462,8 @@ static void AM_drawFlineWu(fline_t *fl, int color)
          x += xdir; // advance x
 
          // the trick is in the trig!
-         AM_putWuDot(x, y, color, 
-                     finecosine[erroracc >> wu_fineshift] >> wu_fixedshift);
-         AM_putWuDot(x, y + 1, color, 
-                     finesine[erroracc >> wu_fineshift] >> wu_fixedshift);
+         AM_putWuDot(x, y, finecosine[erroracc >> wu_fineshift] >> wu_fixedshift);
+         AM_putWuDot(x, y + 1, finesine[erroracc >> wu_fineshift] >> wu_fixedshift);
       }
    }
 
@@ -1477,6 +1497,75 @@ static void AM_drawMline(mline_t *ml, int color)
       am_svgWriter.addLine(ml->a.x, ml->a.y, ml->b.x, ml->b.y, color);
 }
 
+//
+// Batched line drawing
+//
+// Map lines are clipped as they are found and queued, then drawn grouped by
+// colour, so that each colour's Wu weight table is built once.
+//
+
+struct amqueuedline_t
+{
+   fline_t fl;
+   int     color;
+};
+
+static PODCollection<amqueuedline_t> am_linequeue, am_linesorted;
+
+//
+// AM_queueMline
+//
+// Like AM_drawMline, but the line is drawn by the next AM_flushMlines.
+//
+static void AM_queueMline(mline_t *ml, int color)
+{
+   fline_t fl;
+
+   if(color == -1)  // jff 4/3/98 allow not drawing any sort of line
+      return;       // by setting its color to -1
+   if(color == 247) // jff 4/3/98 if color is 247 (xparent), use black
+      color=0;
+
+   if(AM_clipMline(ml, &fl))
+   {
+      amqueuedline_t &ql = am_linequeue.addNew();
+      ql.fl    = fl;
+      ql.color = color;
+   }
+   if(am_takeSvgSnapshot)
+      am_svgWriter.addLine(ml->a.x, ml->a.y, ml->b.x, ml->b.y, color);
+}
+
+//
+// AM_flushMlines
+//
+// Draws the queued lines, sorted by colour. Lines of the same colour keep
+// the order in which they were queued.
+//
+static void AM_flushMlines()
+{
+   size_t count = am_linequeue.getLength();
+   int    start[257];
+
+   if(!count)
+      return;
+
+   memset(start, 0, sizeof(start));
+   for(size_t i = 0; i < count; i++)
+      ++start[(am_linequeue[i].color & 0xff) + 1];
+   for(int c = 1; c <= 256; c++)
+      start[c] += start[c - 1];
+
+   am_linesorted.resize(count);
+   for(size_t i = 0; i < count; i++)
+      am_linesorted[start[am_linequeue[i].color & 0xff]++] = am_linequeue[i];
+
+   for(size_t i = 0; i < count; i++)
+      AM_drawFlineWu(&am_linesorted[i].fl, am_linesorted[i].color);
+
+   am_linequeue.makeEmpty<true>();
+}
+
 //
 // AM_drawGrid()
 //
@@ -1682,9 +1771,300 @@ inline static bool AM_dontDraw(const line_t &line)
    line.frontsector->intflags & SIF_PORTALBOX;
 }
 
+//=============================================================================
 //
-// Determines visible lines, draws them.
-// This is LineDef based, not LineSeg based.
+// Visible Line Query
+//
+// Lines are entered at level start into a grid covering the map, in every
+// cell their bounding box touches, so that only the lines near the window
+// need to be looked at each frame. Lines which may move (polyobjects) or
+// which cover too many cells are kept in a list that is always checked.
+//
+
+#define AMGRIDSHIFT    (FRACBITS + 7) // 128 unit cells, like the blockmap
+#define AMGRIDMAXCELLS 64             // lines touching more are always checked
+
+struct amgrid_t
+{
+   fixed_t  orgx, orgy;  // lower left corner
+   int      width, height;
+   int     *cellstart;   // width*height+1 offsets into lines
+   int     *lines;       // line numbers by cell
+   int     *always;      // lines checked in every query
+   int      numalways;
+};
+
+static amgrid_t *am_grid;
+
+//
+// AM_lineCells
+//
+// Gets the range of cells a line's bounding box touches. The offsets are
+// taken in 64 bits, as maps may span more than 32768 units.
+//
+static void AM_lineCells(const amgrid_t *grid, const line_t *line,
+                         int &x1, int &y1, int &x2, int &y2)
+{
+   x1 = int((int64_t(line->bbox[BOXLEFT])   - grid->orgx) >> AMGRIDSHIFT);
+   x2 = int((int64_t(line->bbox[BOXRIGHT])  - grid->orgx) >> AMGRIDSHIFT);
+   y1 = int((int64_t(line->bbox[BOXBOTTOM]) - grid->orgy) >> AMGRIDSHIFT);
+   y2 = int((int64_t(line->bbox[BOXTOP])    - grid->orgy) >> AMGRIDSHIFT);
+}
+
+//
+// AM_buildGrid
+//
+// Builds the line grid for the current level. It is allocated at PU_LEVEL,
+// so that it goes away together with the level.
+//
+static void AM_buildGrid()
+{
+   fixed_t bbox[4];
+   int i, x, y, x1, y1, x2, y2;
+
+   M_ClearBox(bbox);
+   for(i = 0; i < numlines; i++)
+   {
+      M_AddToBox(bbox, lines[i].bbox[BOXLEFT],  lines[i].bbox[BOXBOTTOM]);
+      M_AddToBox(bbox, lines[i].bbox[BOXRIGHT], lines[i].bbox[BOXTOP]);
+   }
+
+   // the user pointer is cleared when the level is freed
+   amgrid_t *grid = ecalloctag(amgrid_t *, 1, sizeof(amgrid_t), PU_LEVEL, 
+                               (void **)&am_grid);
+   grid->orgx   = numlines ? bbox[BOXLEFT] : 0;
+   grid->orgy   = numlines ? bbox[BOXBOTTOM] : 0;
+   grid->width  = numlines ? 
+      int((int64_t(bbox[BOXRIGHT]) - grid->orgx) >> AMGRIDSHIFT) + 1 : 1;
+   grid->height = numlines ? 
+      int((int64_t(bbox[BOXTOP]) - grid->orgy) >> AMGRIDSHIFT) + 1 : 1;
+
+   int   numcells = grid->width * grid->height;
+   byte *isalways = ecalloc(byte *, numlines + 1, 1);
+
+   // polyobject lines move, so their bounding boxes are not to be trusted
+   for(i = 0; i < numPolyObjects; i++)
+   {
+      for(int j = 0; j < PolyObjects[i].numLines; j++)
+         isalways[PolyObjects[i].lines[j] - lines] = 1;
+   }
+
+   grid->cellstart = ecalloctag(int *, numcells + 1, sizeof(int), PU_LEVEL, NULL);
+
+   // count the lines in each cell, then lay them out
+   for(i = 0; i < numlines; i++)
+   {
+      AM_lineCells(grid, &lines[i], x1, y1, x2, y2);
+      if(!isalways[i] && (x2 - x1 + 1) * (y2 - y1 + 1) > AMGRIDMAXCELLS)
+         isalways[i] = 1;
+      if(isalways[i])
+      {
+         ++grid->numalways;
+         continue;
+      }
+      for(y = y1; y <= y2; y++)
+         for(x = x1; x <= x2; x++)
+            ++grid->cellstart[y * grid->width + x + 1];
+   }
+   for(i = 1; i <= numcells; i++)
+      grid->cellstart[i] += grid->cellstart[i - 1];
+
+   int *fill = ecalloc(int *, numcells, sizeof(int));
+   grid->lines  = emalloctag(int *, emax(grid->cellstart[numcells], 1) * sizeof(int), 
+                             PU_LEVEL, NULL);
+   grid->always = emalloctag(int *, emax(grid->numalways, 1) * sizeof(int), 
+                             PU_LEVEL, NULL);
+   grid->numalways = 0;
+
+   for(i = 0; i < numlines; i++)
+   {
+      if(isalways[i])
+      {
+         grid->always[grid->numalways++] = i;
+         continue;
+      }
+      AM_lineCells(grid, &lines[i], x1, y1, x2, y2);
+      for(y = y1; y <= y2; y++)
+      {
+         for(x = x1; x <= x2; x++)
+         {
+            int cell = y * grid->width + x;
+            grid->lines[grid->cellstart[cell] + fill[cell]++] = i;
+         }
+      }
+   }
+
+   efree(fill);
+   efree(isalways);
+}
+
+//
+// AM_queryLines
+//
+// Collects the lines whose bounding boxes may overlap the given map area.
+// Each line is reported once: from the lowest cell it shares with the area.
+//
+static void AM_queryLines(double left, double bottom, double right, double top,
+                          PODCollection<const line_t *> &out)
+{
+   out.makeEmpty<true>();
+
+   if(!am_grid)
+      AM_buildGrid();
+
+   const amgrid_t *grid = am_grid;
+
+   // work in fixed point, clamped so that far-out windows cannot overflow
+   fixed_t fl = M_DoubleToFixed(eclamp(left,   -32767.0, 32767.0));
+   fixed_t fr = M_DoubleToFixed(eclamp(right,  -32767.0, 32767.0));
+   fixed_t fb = M_DoubleToFixed(eclamp(bottom, -32767.0, 32767.0));
+   fixed_t ft = M_DoubleToFixed(eclamp(top,    -32767.0, 32767.0));
+
+   int qx1 = eclamp(int((int64_t(fl) - grid->orgx) >> AMGRIDSHIFT), 0, grid->width - 1);
+   int qx2 = eclamp(int((int64_t(fr) - grid->orgx) >> AMGRIDSHIFT), 0, grid->width - 1);
+   int qy1 = eclamp(int((int64_t(fb) - grid->orgy) >> AMGRIDSHIFT), 0, grid->height - 1);
+   int qy2 = eclamp(int((int64_t(ft) - grid->orgy) >> AMGRIDSHIFT), 0, grid->height - 1);
+
+   // when most of the map is in view, walking the cells is slower than
+   // taking every line
+   if((qx2 - qx1 + 1) * (qy2 - qy1 + 1) * 2 > grid->width * grid->height)
+   {
+      for(int i = 0; i < numlines; i++)
+         out.add(&lines[i]);
+      return;
+   }
+
+   for(int y = qy1; y <= qy2; y++)
+   {
+      for(int x = qx1; x <= qx2; x++)
+      {
+         int cell = y * grid->width + x;
+
+         for(int j = grid->cellstart[cell]; j < grid->cellstart[cell + 1]; j++)
+         {
+            const line_t *line = &lines[grid->lines[j]];
+            int lx1, ly1, lx2, ly2;
+
+            AM_lineCells(grid, line, lx1, ly1, lx2, ly2);
+            if(emax(lx1, qx1) == x && emax(ly1, qy1) == y)
+               out.add(line);
+         }
+      }
+   }
+
+   for(int i = 0; i < grid->numalways; i++)
+      out.add(&lines[grid->always[i]]);
+}
+
+//=============================================================================
+//
+// Line Colour Cache
+//
+// Choosing a line's colour means looking up its special, lock and door
+// thinker. The result is kept per line together with everything it was
+// derived from, and only worked out again when one of those has changed.
+//
+
+struct amlinekey_t
+{
+   fixed_t      frontfloor, frontceiling;
+   fixed_t      backfloor, backceiling;
+   const void  *backceildata;  // door thinker, if any
+   unsigned int generation;    // am_cachegen when stored
+   int          flags;
+   int          special;
+   int          args[NUMLINEARGS];
+   int          sectorbits;    // secret states, plane portals, portal boxes
+};
+
+struct amlinecache_t
+{
+   amlinekey_t key;
+   int         color;
+};
+
+static amlinecache_t *am_linecache;
+static unsigned int   am_cachegen;
+static unsigned int   am_cachesettings;
+
+enum
+{
+   AMSB_FRONTSECRET   = 0x01,
+   AMSB_FRONTWASSECRET = 0x02,
+   AMSB_BACKSECRET    = 0x04,
+   AMSB_BACKWASSECRET = 0x08,
+   AMSB_BACKFPORTAL   = 0x10,
+   AMSB_BACKCPORTAL   = 0x20,
+   AMSB_PORTALBOX     = 0x40,
+};
+
+//
+// AM_cacheSettings
+//
+// Folds every setting that affects line colours into one value. When it
+// changes, the whole cache is stale.
+//
+static unsigned int AM_cacheSettings()
+{
+   const int settings[] =
+   {
+      ddt_cheating, plr->powers[pw_allmap] != 0, map_secret_after,
+      mapcolor_wall, mapcolor_fchg, mapcolor_cchg, mapcolor_clsd,
+      mapcolor_rkey, mapcolor_bkey, mapcolor_ykey,
+      mapcolor_rdor, mapcolor_bdor, mapcolor_ydor,
+      mapcolor_tele, mapcolor_secr, mapcolor_exit, mapcolor_unsn, mapcolor_flat,
+   };
+   unsigned int hash = 2166136261u;
+
+   for(int value : settings)
+      hash = (hash ^ unsigned(value)) * 16777619u;
+
+   return hash;
+}
+
+//
+// AM_lineKey
+//
+static void AM_lineKey(const line_t *line, amlinekey_t &key)
+{
+   const sector_t *front = line->frontsector;
+   const sector_t *back  = line->backsector;
+
+   memset(&key, 0, sizeof(key));
+   key.frontfloor   = front->floorheight;
+   key.frontceiling = front->ceilingheight;
+   key.generation   = am_cachegen;
+   key.flags        = line->flags;
+   key.special      = line->special;
+   memcpy(key.args, line->args, sizeof(key.args));
+
+   if(P_IsSecret(front))
+      key.sectorbits |= AMSB_FRONTSECRET;
+   if(P_WasSecret(front))
+      key.sectorbits |= AMSB_FRONTWASSECRET;
+   if(front->intflags & SIF_PORTALBOX)
+      key.sectorbits |= AMSB_PORTALBOX;
+
+   if(back)
+   {
+      key.backfloor    = back->floorheight;
+      key.backceiling  = back->ceilingheight;
+      key.backceildata = back->ceilingdata;
+      if(P_IsSecret(back))
+         key.sectorbits |= AMSB_BACKSECRET;
+      if(P_WasSecret(back))
+         key.sectorbits |= AMSB_BACKWASSECRET;
+      if(back->f_pflags & PS_PASSABLE)
+         key.sectorbits |= AMSB_BACKFPORTAL;
+      if(back->c_pflags & PS_PASSABLE)
+         key.sectorbits |= AMSB_BACKCPORTAL;
+   }
+}
+
+//
+// AM_classifyLine
+//
+// Works out the colour a line is drawn in, or -1 if it is not drawn.
 //
 // jff 1/5/98 many changes in this routine
 // backward compatibility not needed, so just changes, no ifs
@@ -1693,192 +2073,241 @@ inline static bool AM_dontDraw(const line_t &line)
 //    teleports, exit lines, key things
 // ability to suppress any of added features or lines with no height changes
 //
-// support for gamma correction in automap abandoned
-//
 // jff 4/3/98 changed mapcolor_xxxx=0 as control to disable feature
 // jff 4/3/98 changed mapcolor_xxxx=-1 to disable drawing line completely
 //
+static int AM_classifyLine(const line_t *line)
+{
+   // if line has been seen or IDDT has been used
+   if(ddt_cheating || (line->flags & ML_MAPPED))
+   {
+      // check for DONTDRAW flag; those lines are only visible
+      // if using the IDDT cheat.
+      if(AM_dontDraw(*line) && !ddt_cheating)
+         return -1;
+
+      if(!line->backsector) // 1S lines
+      {            
+         if(AM_drawAsExitLine(line))
+         {
+            //jff 4/23/98 add exit lines to automap
+            return mapcolor_exit; // exit line
+         }            
+         else if(AM_drawAs1sSecret(line))
+         {
+            // jff 1/10/98 add new color for 1S secret sector boundary
+            return mapcolor_secr; // line bounding secret sector
+         }
+         else if(AM_drawAsLockedDoor(line))
+         {
+            int lockColor;
+            if((lockColor = AM_DoorColor(line)) >= 0)
+               return lockColor ? lockColor : mapcolor_cchg;
+            return -1;
+         }
+         else                     //jff 2/16/98 fixed bug
+            return mapcolor_wall; // special was cleared
+      }
+      else // 2S lines
+      {
+         // jff 1/10/98 add color change for all teleporter types
+         if(AM_drawAsTeleporter(line))
+         { 
+            // teleporters
+            return mapcolor_tele;
+         }
+         else if(AM_drawAsExitLine(line))
+         {
+            //jff 4/23/98 add exit lines to automap
+            return mapcolor_exit;
+         }
+         else if(AM_drawAsLockedDoor(line))
+         {
+            //jff 1/5/98 this clause implements showing keyed doors
+            if(AM_isDoorClosed(line))
+            {
+               int lockColor;
+               if((lockColor = AM_DoorColor(line)) >= 0)
+                  return lockColor ? lockColor : mapcolor_cchg;
+               return -1;
+            }
+            else
+               return mapcolor_cchg; // open keyed door
+         }
+         else if(line->flags & ML_SECRET)    // secret door
+         {
+            return mapcolor_wall;      // wall color
+         }
+         else if(AM_drawAsClosedDoor(line))
+         {
+            return mapcolor_clsd; // non-secret closed door
+         } 
+         else if(AM_drawAs2sSecret(line))
+         {
+            return mapcolor_secr; // line bounding secret sector
+         } 
+         else if(AM_differentFloor(*line))
+         {
+            return mapcolor_fchg; // floor level change
+         }
+         else if(AM_differentCeiling(*line))
+         {
+            return mapcolor_cchg; // ceiling level change
+         }
+         else if(mapcolor_flat && ddt_cheating)
+         { 
+            return mapcolor_flat; // 2S lines that appear only in IDDT
+         }
+      }
+   } 
+   else if(plr->powers[pw_allmap]) // computermap visible lines
+   {
+      // now draw the lines only visible because the player has computermap
+      if(!AM_dontDraw(*line)) // invisible flag lines do not show
+      {
+         if(mapcolor_flat || !line->backsector ||
+            AM_differentFloor(*line) || AM_differentCeiling(*line))
+         {
+            return mapcolor_unsn;
+         }
+      }
+   }
+
+   return -1;
+}
+
+//
+// AM_lineColor
+//
+// Returns the cached colour of a line, classifying it again if anything it
+// depends on has changed.
+//
+static int AM_lineColor(const line_t *line)
+{
+   // unseen lines without the computer map are never drawn
+   if(!ddt_cheating && !(line->flags & ML_MAPPED) && !plr->powers[pw_allmap])
+      return -1;
+
+   if(!am_linecache)
+   {
+      ecalloctag(amlinecache_t *, emax(numlines, 1), sizeof(amlinecache_t), 
+                 PU_LEVEL, (void **)&am_linecache);
+      am_cachegen = 1; // all entries hold generation 0
+   }
+
+   amlinecache_t &entry = am_linecache[line - lines];
+   amlinekey_t    key;
+
+   AM_lineKey(line, key);
+   if(memcmp(&key, &entry.key, sizeof(key)))
+   {
+      entry.key   = key;
+      entry.color = AM_classifyLine(line);
+   }
+
+   return entry.color;
+}
+
+//
+// AM_drawWalls
+//
+// Determines visible lines, draws them.
+// This is LineDef based, not LineSeg based.
+//
 static void AM_drawWalls()
 {
-   int i;
+   static PODCollection<const line_t *> visible;
    static mline_t l;
    
    int plrgroup = plr->mo->groupid;
 
+   unsigned int settings = AM_cacheSettings();
+   if(settings != am_cachesettings)
+   {
+      am_cachesettings = settings;
+      ++am_cachegen;
+   }
+
+   // the SVG snapshot wants the whole map
+   double left   = am_takeSvgSnapshot ? -D_MAXINT : m_x;
+   double bottom = am_takeSvgSnapshot ? -D_MAXINT : m_y;
+   double right  = am_takeSvgSnapshot ?  D_MAXINT : m_x2;
+   double top    = am_takeSvgSnapshot ?  D_MAXINT : m_y2;
+
    // Draw overlay lines first so they will not obscure the (more important)
    // normal map lines
    if(mapportal_overlay && useportalgroups)
    {
-      for(i = 0; i < numlines; ++i)
+      for(int group = 0; group < P_PortalGroupCount(); group++)
       {
-         const line_t *line = &lines[i];
-
-         if(line->frontsector->groupid == plrgroup)
+         if(group == plrgroup)
             continue;
 
-         l.a.x = line->v1->fx;
-         l.a.y = line->v1->fy;
-         l.b.x = line->v2->fx;
-         l.b.y = line->v2->fy;
-
-         auto link = P_GetLinkOffset(line->frontsector->groupid, plrgroup);
+         auto link = P_GetLinkOffset(group, plrgroup);
+         double dx = M_FixedToDouble(link->x);
+         double dy = M_FixedToDouble(link->y);
 
-         l.a.x += M_FixedToDouble(link->x);
-         l.a.y += M_FixedToDouble(link->y);
-         l.b.x += M_FixedToDouble(link->x);
-         l.b.y += M_FixedToDouble(link->y);
+         AM_queryLines(left - dx, bottom - dy, right - dx, top - dy, visible);
 
-         // if line has been seen or IDDT has been used
-         if(ddt_cheating || (line->flags & ML_MAPPED))
+         for(size_t i = 0; i < visible.getLength(); i++)
          {
-            // check for DONTDRAW flag; those lines are only visible
-            // if using the IDDT cheat.
-            if(AM_dontDraw(*line) && !ddt_cheating)
+            const line_t *line = visible[i];
+
+            if(line->frontsector->groupid != group)
                continue;
 
-            if(!line->backsector ||
-               AM_differentFloor(*line) || AM_differentCeiling(*line))
+            // if line has been seen or IDDT has been used
+            if(ddt_cheating || (line->flags & ML_MAPPED))
             {
-               AM_drawMline(&l, mapcolor_prtl);
+               // check for DONTDRAW flag; those lines are only visible
+               // if using the IDDT cheat.
+               if(AM_dontDraw(*line) && !ddt_cheating)
+                  continue;
             }
+            else if(!plr->powers[pw_allmap] || AM_dontDraw(*line))
+               continue; // not on the computermap either
+
+            if(line->backsector &&
+               !AM_differentFloor(*line) && !AM_differentCeiling(*line))
+               continue;
+
+            l.a.x = line->v1->fx + dx;
+            l.a.y = line->v1->fy + dy;
+            l.b.x = line->v2->fx + dx;
+            l.b.y = line->v2->fy + dy;
+
+            AM_queueMline(&l, mapcolor_prtl);
          }
-         else if(plr->powers[pw_allmap]) // computermap visible lines
-         {
-            // now draw the lines only visible because the player has computermap
-            if(!AM_dontDraw(*line)) // invisible flag lines do not show
-            {
-               if(!line->backsector ||
-                  AM_differentFloor(*line) || AM_differentCeiling(*line))
-               {
-                  AM_drawMline(&l, mapcolor_prtl);
-               }
-            }
-         } // end else if      
       }
+      AM_flushMlines();
    }
 
    // draw the unclipped visible portions of all lines
-   for(i = 0; i < numlines; i++)
+   AM_queryLines(left, bottom, right, top, visible);
+
+   for(size_t i = 0; i < visible.getLength(); i++)
    {
-      const line_t *line = &lines[i];
+      const line_t *line = visible[i];
+
+      if(mapportal_overlay && useportalgroups && 
+         line->frontsector && line->frontsector->groupid != plrgroup)
+         continue;
+
+      int color = AM_lineColor(line);
+      if(color == -1)
+         continue;
 
       l.a.x = line->v1->fx;
       l.a.y = line->v1->fy;
       l.b.x = line->v2->fx;
       l.b.y = line->v2->fy;
 
-      if(mapportal_overlay && useportalgroups)
-      {
-         if(line->frontsector && line->frontsector->groupid != plrgroup)
-            continue;
-
-         if(line->frontsector)
-         {
-            linkoffset_t *link = P_GetLinkOffset(line->frontsector->groupid, plrgroup);
-
-            l.a.x += M_FixedToDouble(link->x);
-            l.a.y += M_FixedToDouble(link->y);
-            l.b.x += M_FixedToDouble(link->x);
-            l.b.y += M_FixedToDouble(link->y);
-         }
-      }
-
-      // if line has been seen or IDDT has been used
-      if(ddt_cheating || (line->flags & ML_MAPPED))
-      {
-         // check for DONTDRAW flag; those lines are only visible
-         // if using the IDDT cheat.
-         if(AM_dontDraw(*line) && !ddt_cheating)
-            continue;
+      AM_queueMline(&l, color);
+   }
 
-         if(!line->backsector) // 1S lines
-         {            
-            if(AM_drawAsExitLine(line))
-            {
-               //jff 4/23/98 add exit lines to automap
-               AM_drawMline(&l, mapcolor_exit); // exit line
-            }            
-            else if(AM_drawAs1sSecret(line))
-            {
-               // jff 1/10/98 add new color for 1S secret sector boundary
-               AM_drawMline(&l, mapcolor_secr); // line bounding secret sector
-            }
-            else if(AM_drawAsLockedDoor(line))
-            {
-               int lockColor;
-               if((lockColor = AM_DoorColor(line)) >= 0)
-                  AM_drawMline(&l, lockColor ? lockColor : mapcolor_cchg);
-            }
-            else                                //jff 2/16/98 fixed bug
-               AM_drawMline(&l, mapcolor_wall); // special was cleared
-         }
-         else // 2S lines
-         {
-            // jff 1/10/98 add color change for all teleporter types
-            if(AM_drawAsTeleporter(line))
-            { 
-               // teleporters
-               AM_drawMline(&l, mapcolor_tele);
-            }
-            else if(AM_drawAsExitLine(line))
-            {
-               //jff 4/23/98 add exit lines to automap
-               AM_drawMline(&l, mapcolor_exit);
-            }
-            else if(AM_drawAsLockedDoor(line))
-            {
-               //jff 1/5/98 this clause implements showing keyed doors
-               if(AM_isDoorClosed(line))
-               {
-                  int lockColor;
-                  if((lockColor = AM_DoorColor(line)) >= 0)
-                     AM_drawMline(&l, lockColor ? lockColor : mapcolor_cchg);
-               }
-               else
-                  AM_drawMline(&l, mapcolor_cchg); // open keyed door
-            }
-            else if(line->flags & ML_SECRET)    // secret door
-            {
-               AM_drawMline(&l, mapcolor_wall);      // wall color
-            }
-            else if(AM_drawAsClosedDoor(line))
-            {
-               AM_drawMline(&l, mapcolor_clsd); // non-secret closed door
-            } 
-            else if(AM_drawAs2sSecret(line))
-            {
-               AM_drawMline(&l, mapcolor_secr); // line bounding secret sector
-            } 
-            else if(AM_differentFloor(*line))
-            {
-               AM_drawMline(&l, mapcolor_fchg); // floor level change
-            }
-            else if(AM_differentCeiling(*line))
-            {
-               AM_drawMline(&l, mapcolor_cchg); // ceiling level change
-            }
-            else if(mapcolor_flat && ddt_cheating)
-            { 
-               AM_drawMline(&l, mapcolor_flat); // 2S lines that appear only in IDDT
-            }
-         }
-      } 
-      else if(plr->powers[pw_allmap]) // computermap visible lines
-      {
-         // now draw the lines only visible because the player has computermap
-         if(!AM_dontDraw(*line)) // invisible flag lines do not show
-         {
-            if(mapcolor_flat || !line->backsector ||
-               AM_differentFloor(*line) || AM_differentCeiling(*line))
-            {
-               AM_drawMline(&l, mapcolor_unsn);
-            }
-         }
-      } // end else if
-   } // end for
+   AM_flushMlines();
 }
 
-
 //
 // AM_drawNodeLines
 //
@@ -1886,19 +2315,86 @@ static void AM_drawWalls()
 // aid or for the interest of the curious.
 //
 
-static void AM_drawBotMapSegs()
+//
+// AM_botBlockRange
+//
+// Gets the bot map blocks under the automap window. Returns false if the
+// whole map should be drawn instead.
+//
+static bool AM_botBlockRange(int &bx1, int &by1, int &bx2, int &by2)
+{
+   if(am_takeSvgSnapshot || botMap->bMapWidth <= 0 || botMap->bMapHeight <= 0)
+      return false;
+
+   auto toblock = [](double coord, fixed_t org, int size) -> int
+   {
+      double block = (coord - M_FixedToDouble(org)) / BOTMAPBLOCKUNITS;
+      return int(eclamp(block, 0.0, double(size - 1)));
+   };
+
+   bx1 = toblock(m_x,  botMap->bMapOrgX, botMap->bMapWidth);
+   bx2 = toblock(m_x2, botMap->bMapOrgX, botMap->bMapWidth);
+   by1 = toblock(m_y,  botMap->bMapOrgY, botMap->bMapHeight);
+   by2 = toblock(m_y2, botMap->bMapOrgY, botMap->bMapHeight);
+   return true;
+}
+
+//
+// AM_drawBotMapSeg
+//
+static void AM_drawBotMapSeg(const BotMap::Seg &sg)
 {
    mline_t l;
+   l.a.x = M_FixedToDouble(sg.v[0]->x);
+   l.a.y = M_FixedToDouble(sg.v[0]->y);
+   l.b.x = M_FixedToDouble(sg.v[1]->x);
+   l.b.y = M_FixedToDouble(sg.v[1]->y);
+   AM_queueMline(&l, mapcolor_prtl);
+}
+
+static void AM_drawBotMapSegs()
+{
+   static PODCollection<unsigned int> stamps;
+   static unsigned int stamp;
    size_t ns = botMap->segs.getLength();
-   for (size_t i = 0; i < ns; ++i)
+   int bx1, by1, bx2, by2;
+
+   if(!AM_botBlockRange(bx1, by1, bx2, by2))
    {
-      const BotMap::Seg &sg = botMap->segs[i];
-      l.a.x = M_FixedToDouble(sg.v[0]->x);
-      l.a.y = M_FixedToDouble(sg.v[0]->y);
-      l.b.x = M_FixedToDouble(sg.v[1]->x);
-      l.b.y = M_FixedToDouble(sg.v[1]->y);
-      AM_drawMline(&l, mapcolor_prtl);
+      for(size_t i = 0; i < ns; ++i)
+         AM_drawBotMapSeg(botMap->segs[i]);
+      AM_flushMlines();
+      return;
+   }
+
+   // segs spanning several blocks are listed in each; draw them once
+   if(stamps.getLength() != ns)
+   {
+      stamps.resize(ns);
+      for(size_t i = 0; i < ns; ++i)
+         stamps[i] = 0;
+      stamp = 0;
    }
+   ++stamp;
+
+   for(int by = by1; by <= by2; ++by)
+   {
+      for(int bx = bx1; bx <= bx2; ++bx)
+      {
+         size_t b = size_t(by * botMap->bMapWidth + bx);
+         if(b >= botMap->segBlocks.getLength())
+            continue;
+         for(BotMap::Seg *sg : botMap->segBlocks[b])
+         {
+            size_t index = size_t(sg - &botMap->segs[0]);
+            if(stamps[index] == stamp)
+               continue;
+            stamps[index] = stamp;
+            AM_drawBotMapSeg(*sg);
+         }
+      }
+   }
+   AM_flushMlines();
 }
 void AM_drawBotPath()   // not static (friend to Bot)
 {
@@ -1911,31 +2407,76 @@ void AM_drawBotPath()   // not static (friend to Bot)
          l.a.y = M_FixedToDouble(neigh->v.y);
          l.b.x = M_FixedToDouble(neigh->v.x + neigh->d.x);
          l.b.y = M_FixedToDouble(neigh->v.y + neigh->d.y);
-         AM_drawMline(&l, mapcolor_frnd);
+         AM_queueMline(&l, mapcolor_frnd);
       }
+      AM_flushMlines();
    }
 }
-static void AM_drawSteepLines()
+
+//
+// AM_drawSteepLine
+//
+// Draws a bot map line if it can only be crossed one way.
+//
+static void AM_drawSteepLine(const BotMap::Line *line)
 {
-   mline_t l;
-   const BotMap::Line* line;
    static const fixed_t height = 56 * FRACUNIT;
-   
-   for(int i = 0; i < botMap->numlines; ++i)
+   mline_t l;
+
+   if(!line->msec[0] || !line->msec[1])
+      return;
+   if(botMap->canPass(line->msec[0], line->msec[1], height) &&
+      !botMap->canPass(line->msec[1], line->msec[0], height))
    {
-      line = botMap->lines + i;
-      if(!line->msec[0] || !line->msec[1])
-         continue;
-      if(botMap->canPass(line->msec[0], line->msec[1], height) &&
-         !botMap->canPass(line->msec[1], line->msec[0], height))
+      l.a.x = M_FixedToDouble(line->v[0]->x);
+      l.a.y = M_FixedToDouble(line->v[0]->y);
+      l.b.x = M_FixedToDouble(line->v[1]->x);
+      l.b.y = M_FixedToDouble(line->v[1]->y);
+      AM_queueMline(&l, mapcolor_frnd);
+   }
+}
+
+static void AM_drawSteepLines()
+{
+   static PODCollection<unsigned int> stamps;
+   static unsigned int stamp;
+   int bx1, by1, bx2, by2;
+
+   if(!AM_botBlockRange(bx1, by1, bx2, by2))
+   {
+      for(int i = 0; i < botMap->numlines; ++i)
+         AM_drawSteepLine(botMap->lines + i);
+      AM_flushMlines();
+      return;
+   }
+
+   if(stamps.getLength() != size_t(botMap->numlines))
+   {
+      stamps.resize(botMap->numlines);
+      for(int i = 0; i < botMap->numlines; ++i)
+         stamps[i] = 0;
+      stamp = 0;
+   }
+   ++stamp;
+
+   for(int by = by1; by <= by2; ++by)
+   {
+      for(int bx = bx1; bx <= bx2; ++bx)
       {
-         l.a.x = M_FixedToDouble(line->v[0]->x);
-         l.a.y = M_FixedToDouble(line->v[0]->y);
-         l.b.x = M_FixedToDouble(line->v[1]->x);
-         l.b.y = M_FixedToDouble(line->v[1]->y);
-         AM_drawMline(&l, mapcolor_frnd);
+         size_t b = size_t(by * botMap->bMapWidth + bx);
+         if(b >= botMap->lineBlocks.getLength())
+            continue;
+         for(const BotMap::Line *line : botMap->lineBlocks[b])
+         {
+            size_t index = size_t(line - botMap->lines);
+            if(stamps[index] == stamp)
+               continue;
+            stamps[index] = stamp;
+            AM_drawSteepLine(line);
+         }
       }
    }
+   AM_flushMlines();
 }
 static void AM_drawNodeLines()
 {
@@ -2359,6 +2900,7 @@ void AM_Drawer()
       return;
 
    AM_clearFB(mapcolor_back);       //jff 1/5/98 background default color
+   am_wucolor = -1;                 // palette may have changed
 
    // IOANCH 20150215: svg snapshot
    if(am_takeSvgSnapshot)
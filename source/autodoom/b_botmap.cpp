@@ -170,7 +170,7 @@ void BotMap::getBoxTouchedBlocks(fixed_t top, fixed_t bottom,
 
 BotMap::Subsec &BotMap::pointInSubsector(fixed_t x, fixed_t y) const
 {
-   int nodenum = this->numnodes - 1;
+   int nodenum = nodeGrid.startNode(x, y, this->numnodes - 1);
    while(!(nodenum & NF_SUBSECTOR))
       nodenum = this->nodes[nodenum].child[pointOnSide(x, y,
                                                        this->nodes[nodenum])];
@@ -458,6 +458,22 @@ static void B_setSpecLinePositions()
    }
 }
 
+//
+// BotMap::createNodeGrid
+//
+// Creates the grid of node walk starting points over the blockmap area. Must
+// run after the nodes and the blockmap exist.
+//
+void BotMap::createNodeGrid()
+{
+   nodeGrid.build(bMapOrgX, bMapOrgY, bMapWidth, bMapHeight, BOTMAPBLOCKSHIFT,
+                  nodes, numnodes,
+                  [] (const Node &node, int side) { return node.child[side]; },
+                  [this] (fixed_t x, fixed_t y, const Node &node) {
+      return pointOnSide(x, y, node);
+   });
+}
+
 //
 // BotMap::createBlockMap
 //
@@ -537,6 +553,24 @@ void BotMap::getAllLivingMonsters()
     }
 }
 
+//
+// BotMap::refreshMobjLists
+//
+// Rebuilds the monster and projectile lists after the level's thinkers have
+// been replaced wholesale, such as by a snapshot restore.
+//
+void BotMap::refreshMobjLists()
+{
+    getAllLivingMonsters();
+    thrownProjectiles.makeEmpty();
+    for (Thinker *th = thinkercap.next; th != &thinkercap; th = th->next)
+    {
+        Mobj *mo = thinker_cast<Mobj *>(th);
+        if (mo && mo->flags & MF_MISSILE && (!mo->target || !mo->target->player))
+            thrownProjectiles.add(mo);
+    }
+}
+
 void BotMap::SpecialIsDoor(int n, SectorTrait& st, const line_t* line)
 {
     VanillaLineSpecial vls = (VanillaLineSpecial)n;
@@ -1279,6 +1313,9 @@ void BotMap::Build()
    // init validstuff
    VALID_ALLOC(botMap->validLines, botMap->numlines);
 
+   // speed up pointInSubsector
+   botMap->createNodeGrid();
+
    // Place all mobjs on it
    B_setMobjPositions();
    
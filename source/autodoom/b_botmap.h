@@ -39,6 +39,7 @@
 #include "b_msector.h"
 #include "b_util.h"
 #include "../e_rtti.h"
+#include "../m_bspgrid.h"
 #include "../m_collection.h"
 #include "../m_dllist.h"
 #include "../m_fixed.h"
@@ -166,6 +167,7 @@ public:
       int child[2];   // right, left
    } *nodes;
    int numnodes;
+   BSPGrid nodeGrid; // where pointInSubsector starts walking the nodes
    
    PODCollection<MetaSector*> metasectors;
    MetaSector *nullMSec;   // the metasector for walls (exclude from BSP)
@@ -236,6 +238,7 @@ public:
    void operator delete (void *p, int a, BotMap ** b);
 
    void createBlockMap();
+   void createNodeGrid();
    
    int pointOnSide(fixed_t x, fixed_t y, const Node &node) const;
    Subsec &pointInSubsector(fixed_t x, fixed_t y) const;
@@ -255,6 +258,7 @@ public:
    }
    void unsetThingPosition(const Mobj *thing);
    void setThingPosition(const Mobj *thing);
+   void refreshMobjLists();
    
    bool canPass(const MetaSector *s1, const MetaSector *s2, fixed_t height) const;
    bool canPass(const Subsec &s1, const Subsec &s2, fixed_t height) const;
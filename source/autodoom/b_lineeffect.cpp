@@ -661,6 +661,7 @@ static void B_pushSectorHeights(int secnum, const line_t& line,
    const ev_action_t *action = EV_ActionForSpecial(line.special);
    if(!action)
       return;
+   // keep B_LineChangesHeights in step with the actions handled below
    EVActionFunc func = action->action;
    int lockID;
 
@@ -1353,6 +1354,70 @@ bool B_LineTriggersStairs(const line_t &line)
    return !!funcs.count(action->action);
 }
 
+//
+// True if LevelStateStack::Push may change sector heights for the line. Must
+// list the same actions as B_pushSectorHeights.
+//
+bool B_LineChangesHeights(const line_t &line)
+{
+   if(!line.special)
+      return false;
+
+   const ev_action_t *action = EV_ActionForSpecial(line.special);
+   if(!action)
+      return false;
+
+   static const std::unordered_set<EVActionFunc> funcs = {
+      EV_ActionBOOMRaiseCeilingLowerFloor,
+      EV_ActionBOOMRaiseCeilingOrLowerFloor,
+      EV_ActionBuildStairsTurbo16,
+      EV_ActionBuildStairsUp8,
+      EV_ActionCeilingCrushAndRaise,
+      EV_ActionCeilingLowerAndCrush,
+      EV_ActionCeilingLowerToFloor,
+      EV_ActionCeilingLowerToLowest,
+      EV_ActionCeilingLowerToMaxFloor,
+      EV_ActionCloseDoor,
+      EV_ActionCloseDoor30,
+      EV_ActionDoDonut,
+      EV_ActionDoLockedDoor,
+      EV_ActionDoorBlazeClose,
+      EV_ActionDoorBlazeOpen,
+      EV_ActionDoorBlazeRaise,
+      EV_ActionElevatorCurrent,
+      EV_ActionElevatorDown,
+      EV_ActionElevatorUp,
+      EV_ActionFastCeilCrushRaise,
+      EV_ActionFloorLowerAndChange,
+      EV_ActionFloorLowerToLowest,
+      EV_ActionFloorLowerToNearest,
+      EV_ActionFloorRaiseCrush,
+      EV_ActionFloorRaiseToNearest,
+      EV_ActionFloorRaiseToTexture,
+      EV_ActionLowerFloor,
+      EV_ActionLowerFloorTurbo,
+      EV_ActionOpenDoor,
+      EV_ActionPlatBlazeDWUS,
+      EV_ActionPlatDownWaitUpStay,
+      EV_ActionPlatPerpetualRaise,
+      EV_ActionPlatRaise24Change,
+      EV_ActionPlatRaise32Change,
+      EV_ActionPlatRaiseNearestChange,
+      EV_ActionPlatToggleUpDown,
+      EV_ActionRaiseCeilingLowerFloor,
+      EV_ActionRaiseDoor,
+      EV_ActionRaiseFloor,
+      EV_ActionRaiseFloor24,
+      EV_ActionRaiseFloor24Change,
+      EV_ActionRaiseFloor512,
+      EV_ActionRaiseFloorTurbo,
+      EV_ActionSilentCrushAndRaise,
+      EV_ActionVerticalDoor,
+   };
+
+   return !!funcs.count(action->action);
+}
+
 bool B_SectorTypeIsHarmless(int16_t special)
 {
    auto vss = static_cast<VanillaSectorSpecial>(special);
@@ -337,6 +337,7 @@ enum VanillaSectorSpecial
 bool B_LineTriggersBackSector(const line_t &line);
 bool B_LineTriggersDonut(const line_t &line);
 bool B_LineTriggersStairs(const line_t &line);
+bool B_LineChangesHeights(const line_t &line);
 
 bool B_SectorTypeIsHarmless(int16_t special);
 
@@ -0,0 +1,686 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2018 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Headless map analyzer, reporting what the bot could reach
+//
+//      -mapreport <outdir> loads each map of the loaded wads, the way a new
+//      game would, and writes <outdir>/<MAP>.json with what the bot map can
+//      reach from the player start: items, keys, exits and secret sectors,
+//      plus the monsters by threat and the gun lines. Only the maps of the
+//      PWADs are analysed when there are any; -mapreportmaps A,B,... picks
+//      them explicitly. With -jobs N (default one per core) the maps are
+//      split among headless worker processes, each of them this program
+//      given -mapreportmaps with its share.
+//
+//      Reachability follows the bot's own model: subsectors connect when
+//      BotMap::canPass allows, switches and doors act through
+//      LevelStateStack, and keys open locked doors once a reachable one is
+//      picked up. This repeats until nothing new opens. All switch effects
+//      stay applied, so it is an upper bound of what one sequence of moves
+//      could reach.
+//
+//-----------------------------------------------------------------------------
+
+#include <cfloat>
+#include <map>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "../z_zone.h"
+#include "b_botmap.h"
+#include "b_lineeffect.h"
+#include "b_mapreport.h"
+#include "b_path.h"
+#include "b_statistics.h"
+#include "b_util.h"
+#include "../d_main.h"
+#include "../d_player.h"
+#include "../doomstat.h"
+#include "../e_inventory.h"
+#include "../ev_actions.h"
+#include "../ev_specials.h"
+#include "../g_game.h"
+#include "../hal/i_process.h"
+#include "../info.h"
+#include "../m_argv.h"
+#include "../m_qstr.h"
+#include "../metaapi.h"
+#include "../p_maputl.h"
+#include "../p_mobj.h"
+#include "../p_spec.h"
+#include "../p_tick.h"
+#include "../r_state.h"
+#include "../w_levels.h"
+#include "../w_wad.h"
+
+// Distance from a line at which its sides are probed
+#define SIDEPROBE (8 * FRACUNIT)
+
+//
+// Key found on the map
+//
+struct reportkey_t
+{
+   const Mobj         *mo;
+   const itemeffect_t *effect;
+   bool                reached;
+};
+
+//
+// Counts for one monster type
+//
+struct reportmonster_t
+{
+   int count;
+   int reached;
+};
+
+//
+// Everything that is written for a map
+//
+struct mapreport_t
+{
+   bool hasstart;
+
+   int subsectors, reachedsubsectors;
+   int switches, usedswitches;
+
+   int items, reacheditems;
+   std::vector<reportkey_t> keys;
+
+   int exits, reachedexits;
+   int secretexits, reachedsecretexits;
+
+   int secrets, reachedsecrets;
+   int gunlines;
+
+   int monsters, reachedmonsters;
+   std::map<int, reportmonster_t> monstertypes;
+};
+
+//
+// B_mapReportAll
+//
+// AvailableGoals criterion taking every subsector
+//
+static PathResult B_mapReportAll(const BSubsec &, void *)
+{
+   return PathAdd;
+}
+
+//
+// B_mapReportKey
+//
+// Returns the key effect given by a pickup, if any
+//
+static const itemeffect_t *B_mapReportKey(const Mobj *mo)
+{
+   if(mo->sprite < 0 || mo->sprite >= NUMSPRITES)
+      return nullptr;
+
+   const e_pickupfx_t *pickup = mo->info->pickupfx ?
+      mo->info->pickupfx : E_PickupFXForSprNum(mo->sprite);
+   if(!pickup)
+      return nullptr;
+
+   for(unsigned i = 0; i < pickup->numEffects; ++i)
+   {
+      const itemeffect_t *effect = pickup->effects[i];
+      if(effect && effect->getInt("class", ITEMFX_NONE) == ITEMFX_ARTIFACT &&
+         effect->getInt("artifacttype", ARTI_NORMAL) == ARTI_KEY)
+      {
+         return effect;
+      }
+   }
+   return nullptr;
+}
+
+//
+// B_mapReportSecretExit
+//
+// True if the exit leads to the secret level
+//
+static bool B_mapReportSecretExit(const ev_action_t *action)
+{
+   return action->action == EV_ActionSecretExit ||
+          action->action == EV_ActionSwitchSecretExit ||
+          action->action == EV_ActionGunSecretExit ||
+          action->action == EV_ActionParamExitSecret;
+}
+
+//
+// B_mapReportSideReached
+//
+// True if the subsector just in front of either side of the line was reached
+//
+static bool B_mapReportSideReached(const line_t &line,
+                                   const std::vector<bool> &reached)
+{
+   const BSubsec *first = &botMap->ssectors[0];
+   fixed_t midx = line.v1->x + line.dx / 2;
+   fixed_t midy = line.v1->y + line.dy / 2;
+   angle_t ang = P_PointToAngle(line.v1->x, line.v1->y,
+                                line.v2->x, line.v2->y) - ANG90;
+
+   for(int side = 0; side < (line.backsector ? 2 : 1); ++side, ang += ANG180)
+   {
+      const BSubsec &ss =
+         botMap->pointInSubsector(midx + FixedMul(SIDEPROBE, B_AngleCosine(ang)),
+                                  midy + FixedMul(SIDEPROBE, B_AngleSine(ang)));
+      if(reached[&ss - first])
+         return true;
+   }
+   return false;
+}
+
+//
+// B_mapReportFlood
+//
+// Opens up the map from the player start until nothing changes, marking the
+// reached subsectors and keys. Fills used with the switches that could be
+// used on the way. A switch that can't be used yet, such as a locked one
+// reached before its key, is tried again on the next pass.
+//
+static void B_mapReportFlood(player_t &player, std::vector<bool> &reached,
+                             std::vector<reportkey_t> &keys,
+                             std::unordered_set<const line_t *> &used)
+{
+   PathFinder finder(botMap);
+   finder.SetPlayer(&player);
+
+   const BSubsec *first = &botMap->ssectors[0];
+   std::vector<const BSubsec *> sources;
+   std::unordered_set<const BSubsec *> found;
+
+   LevelStateStack::Clear();
+   LevelStateStack::SetKeyPlayer(&player);
+
+   sources.push_back(&botMap->pointInSubsector(player.mo->x, player.mo->y));
+
+   bool changed;
+   do
+   {
+      changed = false;
+
+      // the player may have been carried off by a lift, so also look again
+      // from where the last switches were used
+      found.clear();
+      for(const BSubsec *source : sources)
+         finder.AvailableGoals(*source, &found, B_mapReportAll);
+      sources.resize(1);
+
+      for(const BSubsec *ss : found)
+      {
+         if(!reached[ss - first])
+         {
+            reached[ss - first] = true;
+            changed = true;
+         }
+      }
+
+      for(reportkey_t &key : keys)
+      {
+         if(!key.reached &&
+            reached[&botMap->pointInSubsector(key.mo->x, key.mo->y) - first])
+         {
+            key.reached = true;
+            E_GiveInventoryItem(&player, key.effect);
+            changed = true;
+         }
+      }
+
+      for(const BSubsec *ss : found)
+      {
+         for(const auto &entry : ss->linelist)
+         {
+            if(used.count(entry.first))
+               continue;
+            if(LevelStateStack::Push(*entry.first, player))
+            {
+               used.insert(entry.first);
+               sources.push_back(ss);
+               changed = true;
+            }
+         }
+      }
+   } while(changed);
+
+   LevelStateStack::Clear();
+   LevelStateStack::SetKeyPlayer(nullptr);
+}
+
+//
+// B_mapReportAnalyse
+//
+// Gathers the report of the loaded level
+//
+static void B_mapReportAnalyse(mapreport_t &report)
+{
+   player_t &player = players[consoleplayer];
+   std::vector<bool> reached(botMap->ssectors.getLength());
+   std::unordered_set<const line_t *> used;
+   const BSubsec *first = &botMap->ssectors[0];
+
+   report.subsectors = static_cast<int>(botMap->ssectors.getLength());
+   report.hasstart = player.mo != nullptr;
+
+   for(Thinker *th = thinkercap.next; th != &thinkercap; th = th->next)
+   {
+      const Mobj *mo = thinker_cast<const Mobj *>(th);
+      if(!mo || !(mo->flags & MF_SPECIAL))
+         continue;
+      if(const itemeffect_t *effect = B_mapReportKey(mo))
+         report.keys.push_back({ mo, effect, false });
+   }
+
+   if(report.hasstart)
+   {
+      E_TakeAllKeys(&player);
+      B_mapReportFlood(player, reached, report.keys, used);
+   }
+
+   for(bool r : reached)
+      report.reachedsubsectors += r;
+
+   auto isReached = [&](fixed_t x, fixed_t y) {
+      return !!reached[&botMap->pointInSubsector(x, y) - first];
+   };
+
+   for(Thinker *th = thinkercap.next; th != &thinkercap; th = th->next)
+   {
+      const Mobj *mo = thinker_cast<const Mobj *>(th);
+      if(!mo)
+         continue;
+      if(mo->flags & MF_SPECIAL)
+      {
+         ++report.items;
+         report.reacheditems += isReached(mo->x, mo->y);
+      }
+      if(mo->flags & MF_COUNTKILL)
+      {
+         bool r = isReached(mo->x, mo->y);
+         reportmonster_t &type = report.monstertypes[mo->type];
+         ++type.count;
+         type.reached += r;
+         ++report.monsters;
+         report.reachedmonsters += r;
+      }
+   }
+
+   for(int i = 0; i < numlines; ++i)
+   {
+      const line_t &line = lines[i];
+      const ev_action_t *action = EV_ActionForSpecial(line.special);
+      if(!action)
+         continue;
+
+      bool isswitch = action->type == &S1ActionType ||
+                      action->type == &SRActionType ||
+                      action->type == &DRActionType;
+      if(isswitch && B_LineChangesHeights(line))
+      {
+         ++report.switches;
+         report.usedswitches += !!used.count(&line);
+      }
+      if(action->type == &G1ActionType || action->type == &GRActionType)
+         ++report.gunlines;
+
+      if(EV_CompositeActionFlags(action) & EV_ISMAPPEDEXIT)
+      {
+         bool r = B_mapReportSideReached(line, reached);
+         if(B_mapReportSecretExit(action))
+         {
+            ++report.secretexits;
+            report.reachedsecretexits += r;
+         }
+         else
+         {
+            ++report.exits;
+            report.reachedexits += r;
+         }
+      }
+   }
+
+   std::vector<bool> secretreached(numsectors);
+   for(size_t i = 0; i < reached.size(); ++i)
+   {
+      if(reached[i])
+         secretreached[first[i].msector->getFloorSector() - sectors] = true;
+   }
+   for(int i = 0; i < numsectors; ++i)
+   {
+      if(P_IsSecret(&sectors[i]))
+      {
+         ++report.secrets;
+         report.reachedsecrets += secretreached[i];
+      }
+   }
+}
+
+//
+// B_mapReportString
+//
+// Writes a JSON string
+//
+static void B_mapReportString(FILE *f, const char *s)
+{
+   fputc('"', f);
+   for(; *s; ++s)
+   {
+      if(*s == '"' || *s == '\\')
+         fputc('\\', f);
+      if(static_cast<unsigned char>(*s) >= ' ')
+         fputc(*s, f);
+   }
+   fputc('"', f);
+}
+
+//
+// B_mapReportWrite
+//
+// Writes the report of one map
+//
+static bool B_mapReportWrite(const char *path, const char *mapname,
+                             const mapreport_t &report)
+{
+   FILE *f = fopen(path, "w");
+   if(!f)
+      return false;
+
+   fprintf(f, "{\n  \"map\": ");
+   B_mapReportString(f, mapname);
+   fprintf(f, ",\n  \"skill\": %d,\n", static_cast<int>(gameskill) + 1);
+   fprintf(f, "  \"playerstart\": %s,\n", report.hasstart ? "true" : "false");
+   fprintf(f, "  \"subsectors\": { \"total\": %d, \"reachable\": %d },\n",
+           report.subsectors, report.reachedsubsectors);
+   fprintf(f, "  \"switches\": { \"total\": %d, \"used\": %d },\n",
+           report.switches, report.usedswitches);
+   fprintf(f, "  \"items\": { \"total\": %d, \"reachable\": %d },\n",
+           report.items, report.reacheditems);
+
+   fprintf(f, "  \"keys\": [");
+   for(size_t i = 0; i < report.keys.size(); ++i)
+   {
+      const reportkey_t &key = report.keys[i];
+      fprintf(f, "%s\n    { \"item\": ", i ? "," : "");
+      B_mapReportString(f, key.effect->getKey());
+      fprintf(f, ", \"x\": %d, \"y\": %d, \"reachable\": %s }",
+              key.mo->x >> FRACBITS, key.mo->y >> FRACBITS,
+              key.reached ? "true" : "false");
+   }
+   fprintf(f, "%s],\n", report.keys.empty() ? "" : "\n  ");
+
+   fprintf(f, "  \"exits\": { \"total\": %d, \"reachable\": %d, "
+           "\"secret\": %d, \"secretreachable\": %d },\n",
+           report.exits, report.reachedexits, report.secretexits,
+           report.reachedsecretexits);
+   fprintf(f, "  \"secrets\": { \"total\": %d, \"reachable\": %d },\n",
+           report.secrets, report.reachedsecrets);
+   fprintf(f, "  \"gunlines\": %d,\n", report.gunlines);
+
+   // threat is the damage a monster type deals per death, unknown until the
+   // bot has met it (see b_statistics.cpp)
+   double totalthreat = 0;
+   int    unknown = 0;
+   fprintf(f, "  \"monsters\": {\n    \"types\": [");
+   bool firsttype = true;
+   for(const auto &entry : report.monstertypes)
+   {
+      const mobjinfo_t *info = mobjinfo[entry.first];
+      double threat = B_GetMonsterThreatLevel(info);
+
+      fprintf(f, "%s\n      { \"name\": ", firsttype ? "" : ",");
+      B_mapReportString(f, info->name);
+      fprintf(f, ", \"count\": %d, \"reachable\": %d, \"threat\": ",
+              entry.second.count, entry.second.reached);
+      if(threat == DBL_MAX)
+      {
+         fprintf(f, "null }");
+         unknown += entry.second.count;
+      }
+      else
+      {
+         fprintf(f, "%g }", threat);
+         totalthreat += threat * entry.second.count;
+      }
+      firsttype = false;
+   }
+   fprintf(f, "%s],\n", firsttype ? "" : "\n    ");
+   fprintf(f, "    \"total\": %d,\n    \"reachable\": %d,\n", report.monsters,
+           report.reachedmonsters);
+   fprintf(f, "    \"threat\": %g,\n    \"unknownthreat\": %d\n  }\n}\n",
+           totalthreat, unknown);
+
+   bool ok = !ferror(f);
+   fclose(f);
+   return ok;
+}
+
+//
+// B_mapReportMap
+//
+// Loads a map and writes its report. Returns false on failure.
+//
+static bool B_mapReportMap(const char *outdir, const char *mapname)
+{
+   G_InitNew(startskill, mapname);
+   if(gamestate != GS_LEVEL || !botMap)
+   {
+      usermsg("%s: cannot load the map", mapname);
+      return false;
+   }
+
+   mapreport_t report = mapreport_t();
+   B_mapReportAnalyse(report);
+
+   qstring path(outdir);
+   path.pathConcatenate(mapname);
+   path += ".json";
+
+   if(!B_mapReportWrite(path.constPtr(), mapname, report))
+   {
+      usermsg("%s: cannot write %s", mapname, path.constPtr());
+      return false;
+   }
+
+   usermsg("%s: %d of %d subsectors, %d of %d items, %d of %d exits reachable",
+           mapname, report.reachedsubsectors, report.subsectors,
+           report.reacheditems, report.items,
+           report.reachedexits + report.reachedsecretexits,
+           report.exits + report.secretexits);
+   return true;
+}
+
+//
+// B_mapReportList
+//
+// Lists the maps to analyse: those of -mapreportmaps, or else those of the
+// PWADs, or else all of them
+//
+static void B_mapReportList(std::vector<qstring> &maps)
+{
+   int p;
+
+   if((p = M_CheckParm("-mapreportmaps")) && p < myargc - 1)
+   {
+      qstring name;
+      for(const char *s = myargv[p + 1]; ; ++s)
+      {
+         if(*s && *s != ',')
+         {
+            name += *s;
+            continue;
+         }
+         if(!name.empty())
+            maps.push_back(name.toUpper());
+         name.clear();
+         if(!*s)
+            break;
+      }
+      return;
+   }
+
+   wadlevel_t *levels = W_FindAllMapsInLevelWad(&wGlobalDir);
+   lumpinfo_t **lumpinfo = wGlobalDir.getLumpInfo();
+   bool pwadonly = false;
+
+   for(wadlevel_t *level = levels; level->header[0]; ++level)
+   {
+      int source = lumpinfo[level->lumpnum]->source;
+      if(source != WadDirectory::IWADSource &&
+         source != WadDirectory::ResWADSource)
+      {
+         pwadonly = true;
+      }
+   }
+
+   for(wadlevel_t *level = levels; level->header[0]; ++level)
+   {
+      int source = lumpinfo[level->lumpnum]->source;
+      if(pwadonly && (source == WadDirectory::IWADSource ||
+                      source == WadDirectory::ResWADSource))
+      {
+         continue;
+      }
+      // sorted, so a map in more than one wad comes up in a row
+      if(!maps.empty() && !maps.back().strCaseCmp(level->header))
+         continue;
+      maps.push_back(qstring(level->header));
+   }
+
+   efree(levels);
+}
+
+//
+// B_mapReportSpawn
+//
+// Splits the maps among worker processes and waits for them. Returns the
+// exit status.
+//
+static int B_mapReportSpawn(const std::vector<qstring> &maps, int jobs)
+{
+   // workers get every argument except the splitting ones
+   std::vector<const char *> baseargs;
+   for(int i = 0; i < myargc; i++)
+   {
+      if(i && (!strcasecmp(myargv[i], "-jobs") ||
+               !strcasecmp(myargv[i], "-mapreportmaps")))
+      {
+         ++i;
+         continue;
+      }
+      baseargs.push_back(myargv[i]);
+   }
+
+   // deal the maps out in turn, so the usually bigger late ones are spread
+   std::vector<qstring> shares(jobs);
+   for(size_t i = 0; i < maps.size(); ++i)
+   {
+      qstring &share = shares[i % jobs];
+      if(!share.empty())
+         share += ',';
+      share += maps[i];
+   }
+
+   std::vector<processhandle_t> handles;
+   int status = 0;
+
+   for(const qstring &share : shares)
+   {
+      std::vector<const char *> args(baseargs);
+      args.push_back("-mapreportmaps");
+      args.push_back(share.constPtr());
+      args.push_back(nullptr);
+
+      processhandle_t handle = I_SpawnProcess(args.data());
+      if(handle == -1)
+      {
+         usermsg("B_MapReport: cannot start a worker for %s", share.constPtr());
+         status = 1;
+      }
+      else
+         handles.push_back(handle);
+   }
+
+   while(!handles.empty())
+   {
+      int exitcode;
+      int index = I_WaitProcesses(handles.data(),
+                                  static_cast<int>(handles.size()), exitcode);
+      if(index < 0)
+      {
+         usermsg("B_MapReport: lost track of the worker processes");
+         return 2;
+      }
+      if(exitcode)
+         status = 1;
+      handles.erase(handles.begin() + index);
+   }
+
+   return status;
+}
+
+//
+// B_MapReport
+//
+int B_MapReport(const char *outdir)
+{
+   std::vector<qstring> maps;
+   int status = 0;
+   int jobs = static_cast<int>(std::thread::hardware_concurrency());
+   int p;
+
+   B_mapReportList(maps);
+   if(maps.empty())
+   {
+      usermsg("B_MapReport: no maps to analyse");
+      return 2;
+   }
+
+   if((p = M_CheckParm("-jobs")) && p < myargc - 1)
+      jobs = atoi(myargv[p + 1]);
+   if(jobs > static_cast<int>(maps.size()))
+      jobs = static_cast<int>(maps.size());
+
+   // a worker, or asked to keep to one process
+   if(M_CheckParm("-mapreportmaps") || jobs <= 1)
+   {
+      for(const qstring &map : maps)
+      {
+         if(!B_mapReportMap(outdir, map.constPtr()))
+            status = 1;
+      }
+   }
+   else
+   {
+      usermsg("Analysing %d maps on %d workers", static_cast<int>(maps.size()),
+              jobs);
+      status = B_mapReportSpawn(maps, jobs);
+   }
+
+   fflush(stdout);
+   return status;
+}
+
+// EOF
@@ -0,0 +1,38 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2018 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Headless map analyzer, reporting what the bot could reach
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __EternityEngine__b_mapreport__
+#define __EternityEngine__b_mapreport__
+
+// Tool mode: loads every map of the loaded wads and writes a JSON report for
+// each into outdir. Returns the exit status: 0 if all maps were reported.
+int B_MapReport(const char *outdir);
+
+#endif
+
+// EOF
@@ -0,0 +1,296 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2018 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Bot movement prediction. Runs the player movement physics on a copy
+//      of the player's position against the bot map, without touching any
+//      game state.
+//
+//-----------------------------------------------------------------------------
+
+#include "../z_zone.h"
+
+#include "b_motion.h"
+#include "../d_player.h"
+#include "../d_ticcmd.h"
+#include "../doomstat.h"
+#include "../m_compare.h"
+#include "../p_info.h"
+#include "../p_mobj.h"
+#include "../p_spec.h"
+
+enum
+{
+    // Longest distance moved without checking the subsector in between, so
+    // that narrow subsectors are not jumped over
+    MOTION_SUBSTEP = 8 * FRACUNIT,
+    STEP_HEIGHT = 24 * FRACUNIT,
+};
+
+//
+// BotMotion::BotMotion
+//
+// Takes the snapshot. Nothing of the player is kept referenced.
+//
+BotMotion::BotMotion(const player_t &player)
+{
+    const Mobj &mo = *player.mo;
+
+    m_start.x = mo.x;
+    m_start.y = mo.y;
+    m_start.z = mo.z;
+    m_start.momx = mo.momx;
+    m_start.momy = mo.momy;
+    m_start.momz = mo.momz;
+    m_start.angle = mo.angle;
+    m_start.ss = &botMap->pointInSubsector(mo.x, mo.y);
+
+    m_height = mo.height;
+    m_ironfeet = player.powers[pw_ironfeet] != 0;
+    m_nogravity = (mo.flags & MF_NOGRAVITY) || (mo.flags4 & MF4_FLY);
+}
+
+//
+// BotMotion::isHazard
+//
+// Same notion of a painful floor as the pathfinder's
+//
+bool BotMotion::isHazard(const BSubsec &ss) const
+{
+    const sector_t *sector = ss.msector->getFloorSector();
+    return enable_nuke && sector && sector->damage > 0 &&
+    (!m_ironfeet || sector->damageflags & SDMG_IGNORESUIT);
+}
+
+//
+// BotMotion::stepTo
+//
+// Moves a short distance, crossing at most into a neighbouring subsector.
+// Returns the motion flags of the step; on BLOCKED, st is left alone.
+//
+unsigned BotMotion::stepTo(State &st, fixed_t x, fixed_t y) const
+{
+    const BSubsec &ss = botMap->pointInSubsector(x, y);
+    unsigned flags = 0;
+
+    if(&ss != st.ss)
+    {
+        const MetaSector *from = st.ss->msector, *to = ss.msector;
+        fixed_t floorz = to->getFloorHeight();
+        fixed_t ceilingz = to->getCeilingHeight();
+
+        if(floorz == D_MAXINT || ceilingz == D_MININT ||
+           ceilingz - floorz < m_height || floorz - st.z > STEP_HEIGHT ||
+           ceilingz - st.z < m_height)
+        {
+            return BLOCKED;
+        }
+
+        if(!botMap->canPassNow(to, from, m_height))
+            flags |= DROPPED;
+        if(isHazard(ss) && !isHazard(*st.ss))
+            flags |= HAZARD;
+
+        if(st.z < floorz)
+            st.z = floorz;   // stepped up
+        st.ss = &ss;
+    }
+
+    st.x = x;
+    st.y = y;
+    return flags;
+}
+
+//
+// BotMotion::tryMove
+//
+// Like P_TryMove, it either gets all the way to (x, y) or not at all.
+//
+unsigned BotMotion::tryMove(State &st, fixed_t x, fixed_t y) const
+{
+    State trial = st;
+    fixed_t dx = x - st.x, dy = y - st.y;
+    int steps = (D_abs(dx) > D_abs(dy) ? D_abs(dx) : D_abs(dy)) / MOTION_SUBSTEP + 1;
+    unsigned flags = 0;
+
+    for(int i = 1; i <= steps; ++i)
+    {
+        // the last step lands exactly on the destination
+        fixed_t sx = i == steps ? x : st.x + (fixed_t)((int64_t)dx * i / steps);
+        fixed_t sy = i == steps ? y : st.y + (fixed_t)((int64_t)dy * i / steps);
+
+        flags |= stepTo(trial, sx, sy);
+        if(flags & BLOCKED)
+            return BLOCKED;
+    }
+
+    st = trial;
+    return flags;
+}
+
+//
+// BotMotion::tic
+//
+// One tic of P_MovePlayer, P_XYMovement and P_ZMovement for a player.
+// Blocked moves stop the body along the blocked axis instead of sliding along
+// the wall.
+//
+unsigned BotMotion::tic(State &st, const ticcmd_t &cmd, Result &res, int ticnum) const
+{
+    unsigned flags = 0;
+
+    st.angle += cmd.angleturn << 16;
+
+    // thrust
+    const sector_t *floorsec = st.ss->msector->getFloorSector();
+    int friction = ORIG_FRICTION, movefactor = ORIG_FRICTION_FACTOR;
+    if(variable_friction && !m_nogravity && floorsec && floorsec->flags & SECF_FRICTION)
+    {
+        friction = floorsec->friction;
+        movefactor = floorsec->movefactor;
+    }
+
+    bool onground = st.z <= st.ss->msector->getFloorHeight() || m_nogravity;
+    if(!onground)
+    {
+        if(LevelInfo.airControl > 0 || LevelInfo.airControl < -1)
+            movefactor = FixedMul(movefactor, LevelInfo.airControl);
+        else
+            movefactor = 0;
+    }
+
+    if(movefactor)
+    {
+        unsigned fa = st.angle >> ANGLETOFINESHIFT;
+        unsigned sa = (st.angle - ANG90) >> ANGLETOFINESHIFT;
+        fixed_t fmove = cmd.forwardmove * movefactor;
+        fixed_t smove = cmd.sidemove * movefactor;
+
+        st.momx += FixedMul(fmove, finecosine[fa]) + FixedMul(smove, finecosine[sa]);
+        st.momy += FixedMul(fmove, finesine[fa]) + FixedMul(smove, finesine[sa]);
+    }
+
+    // horizontal movement
+    st.momx = eclamp(st.momx, -MAXMOVE, MAXMOVE);
+    st.momy = eclamp(st.momy, -MAXMOVE, MAXMOVE);
+
+    fixed_t xmove = st.momx, ymove = st.momy;
+    while(xmove | ymove)
+    {
+        fixed_t ptryx, ptryy;
+        if(D_abs(xmove) > MAXMOVE / 2 || D_abs(ymove) > MAXMOVE / 2)
+        {
+            ptryx = st.x + xmove / 2;
+            ptryy = st.y + ymove / 2;
+            xmove >>= 1;
+            ymove >>= 1;
+        }
+        else
+        {
+            ptryx = st.x + xmove;
+            ptryy = st.y + ymove;
+            xmove = ymove = 0;
+        }
+
+        unsigned moved = tryMove(st, ptryx, ptryy);
+        if(moved & BLOCKED)
+        {
+            flags |= BLOCKED;
+            if(!((moved = tryMove(st, ptryx, st.y)) & BLOCKED))
+                st.momy = ymove = 0;
+            else if(!((moved = tryMove(st, st.x, ptryy)) & BLOCKED))
+                st.momx = xmove = 0;
+            else
+            {
+                st.momx = st.momy = 0;
+                break;
+            }
+        }
+        flags |= moved & ~BLOCKED;
+    }
+
+    // friction
+    fixed_t floorz = st.ss->msector->getFloorHeight();
+    if(st.z <= floorz || m_nogravity)
+    {
+        if(D_abs(st.momx) < STOPSPEED && D_abs(st.momy) < STOPSPEED &&
+           !(cmd.forwardmove | cmd.sidemove))
+        {
+            st.momx = st.momy = 0;
+        }
+        else
+        {
+            st.momx = FixedMul(st.momx, friction);
+            st.momy = FixedMul(st.momy, friction);
+        }
+    }
+
+    // vertical movement
+    if(!m_nogravity)
+    {
+        st.z += st.momz;
+        if(st.z <= floorz)
+        {
+            st.z = floorz;
+            if(st.momz < 0)
+                st.momz = 0;
+        }
+        else
+        {
+            if(!st.momz)
+                st.momz = -LevelInfo.gravity;
+            st.momz -= LevelInfo.gravity;
+        }
+    }
+
+    if(flags & DROPPED && !(res.flags & DROPPED))
+    {
+        res.droptic = ticnum;
+        res.dropss = st.ss;
+    }
+    if(flags & HAZARD && !(res.flags & HAZARD))
+        res.hazardss = st.ss;
+    return flags;
+}
+
+//
+// BotMotion::predict
+//
+// Runs the given command for a number of tics from the snapshot.
+//
+BotMotion::Result BotMotion::predict(const ticcmd_t &cmd, int tics) const
+{
+    Result res;
+    res.flags = 0;
+    res.droptic = -1;
+    res.dropss = nullptr;
+    res.hazardss = nullptr;
+    res.end = m_start;
+
+    for(int i = 0; i < tics; ++i)
+        res.flags |= tic(res.end, cmd, res, i);
+    return res;
+}
+
+// EOF
+
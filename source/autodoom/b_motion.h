@@ -0,0 +1,104 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2018 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Bot movement prediction. Runs the player movement physics on a copy
+//      of the player's position against the bot map, without touching any
+//      game state.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __EternityEngine__b_motion__
+#define __EternityEngine__b_motion__
+
+#include "b_botmap.h"
+#include "../tables.h"
+
+struct player_t;
+struct ticcmd_t;
+
+//
+// BotMotion
+//
+// Snapshot of a player's body from which movement can be predicted. Since the
+// bot map is already shrunk by the player radius, the body is moved as a
+// point through it, which stands in for P_TryMove's bounding box checks.
+//
+class BotMotion
+{
+public:
+   //
+   // State
+   //
+   // The parts of the body that change while moving
+   //
+   struct State
+   {
+      fixed_t x, y, z;
+      fixed_t momx, momy, momz;
+      angle_t angle;
+      const BSubsec *ss;
+   };
+
+   // Flags of what happened during a prediction
+   enum
+   {
+      BLOCKED = 1,   // walked into a wall or a step too high
+      DROPPED = 2,   // went down somewhere it cannot walk back up from
+      HAZARD  = 4,   // stepped onto a damaging floor from a safe one
+   };
+
+   struct Result
+   {
+      unsigned flags;
+      int droptic;              // tic of the first drop, if any
+      const BSubsec *dropss;    // subsector landed in by the first drop
+      const BSubsec *hazardss;  // subsector reached by the first hazard step
+      State end;                // state after the last tic
+   };
+
+   explicit BotMotion(const player_t &player);
+
+   const State &getStart() const
+   {
+      return m_start;
+   }
+
+   Result predict(const ticcmd_t &cmd, int tics) const;
+
+private:
+   State m_start;
+   fixed_t m_height;
+   bool m_ironfeet;     // immune to floors that the suit protects from
+   bool m_nogravity;
+
+   unsigned tic(State &st, const ticcmd_t &cmd, Result &res, int ticnum) const;
+   unsigned tryMove(State &st, fixed_t x, fixed_t y) const;
+   unsigned stepTo(State &st, fixed_t x, fixed_t y) const;
+   bool isHazard(const BSubsec &ss) const;
+};
+
+#endif /* defined(__EternityEngine__b_motion__) */
+
+// EOF
+
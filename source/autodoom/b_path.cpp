@@ -27,12 +27,14 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
 #include <queue>
 #include <vector>
 #include "../z_zone.h"
 
 #include "b_path.h"
 #include "../d_player.h"
+#include "../doomstat.h"
 #include "../e_things.h"
 #include "../p_maputl.h"
 #include "../p_spec.h"
@@ -309,6 +311,281 @@ const PathFinder::TeleItem* PathFinder::checkTeleportation(const BNeigh& neigh)
     return nullptr;
 }
 
+//
+// PathFinder::ReachComponent
+//
+// Returns the strongly connected component holding ss, updating the index
+// first if any sector moved since it was last checked.
+//
+int PathFinder::ReachComponent(const BSubsec& ss)
+{
+    updateReachIndex();
+    return m_reach.sscomp[&ss - &m_map->ssectors[0]];
+}
+
+//
+// PathFinder::ComponentReachesAll
+//
+// Returns true if every component in comps can be reached from component
+// from. Walks the condensation DAG, which is much smaller than the subsector
+// graph, and stops as soon as all of them were seen.
+//
+bool PathFinder::ComponentReachesAll(int from, const std::vector<int>& comps)
+{
+    ReachIndex& r = m_reach;
+
+    if (comps.empty())
+        return true;
+
+    if (!++r.stamp)    // wrap around
+    {
+        std::fill(r.visit.begin(), r.visit.end(), 0);
+        std::fill(r.wanted.begin(), r.wanted.end(), 0);
+        r.stamp = 1;
+    }
+
+    size_t remaining = 0;
+    for (int comp : comps)
+    {
+        if (r.wanted[comp] != r.stamp)
+        {
+            r.wanted[comp] = r.stamp;
+            ++remaining;
+        }
+    }
+
+    std::vector<int> stack;
+    stack.push_back(from);
+    r.visit[from] = r.stamp;
+    while (!stack.empty())
+    {
+        int comp = stack.back();
+        stack.pop_back();
+        if (r.wanted[comp] == r.stamp && !--remaining)
+            return true;
+        for (unsigned e = r.dagstart[comp]; e < r.dagstart[comp + 1]; ++e)
+        {
+            int next = r.dagtarget[e];
+            if (r.visit[next] != r.stamp)
+            {
+                r.visit[next] = r.stamp;
+                stack.push_back(next);
+            }
+        }
+    }
+
+    return false;
+}
+
+//
+// PathFinder::updateReachIndex
+//
+// Checks at most once per tic whether any subsector changed heights. Only the
+// edges around those subsectors are recomputed, and the components are only
+// rebuilt if one of them changed passability.
+//
+void PathFinder::updateReachIndex()
+{
+    ReachIndex& r = m_reach;
+    int numss = (int)m_map->ssectors.getLength();
+
+    if (r.valid && r.height != m_player->mo->height)
+        r.valid = false;
+
+    if (!r.valid)
+    {
+        r.height = m_player->mo->height;
+        r.ssheights.resize(3 * numss);
+        r.edgestart.resize(numss + 1);
+        r.sscomp.resize(numss);
+
+        unsigned numedges = 0;
+        for (int i = 0; i < numss; ++i)
+        {
+            r.edgestart[i] = numedges;
+            numedges += (unsigned)m_map->ssectors[i].neighs.getLength();
+        }
+        r.edgestart[numss] = numedges;
+        r.edgetarget.resize(numedges);
+
+        for (int i = 0; i < numss; ++i)
+        {
+            const MetaSector* msec = m_map->ssectors[i].msector;
+            r.ssheights[3 * i] = msec->getFloorHeight();
+            r.ssheights[3 * i + 1] = msec->getAltFloorHeight();
+            r.ssheights[3 * i + 2] = msec->getCeilingHeight();
+            updateReachEdges(i);
+        }
+
+        buildReachComponents();
+        r.checktic = gametic;
+        r.valid = true;
+        return;
+    }
+
+    if (r.checktic == gametic)
+        return;
+    r.checktic = gametic;
+
+    const BSubsec* first = &m_map->ssectors[0];
+    bool changed = false;
+    for (int i = 0; i < numss; ++i)
+    {
+        const MetaSector* msec = m_map->ssectors[i].msector;
+        fixed_t heights[3] = { msec->getFloorHeight(),
+            msec->getAltFloorHeight(), msec->getCeilingHeight() };
+        if (!memcmp(&r.ssheights[3 * i], heights, sizeof(heights)))
+            continue;
+        memcpy(&r.ssheights[3 * i], heights, sizeof(heights));
+
+        // Passability is checked from both sides, so refresh the neighbours
+        changed |= updateReachEdges(i);
+        for (const BNeigh& neigh : m_map->ssectors[i].neighs)
+            changed |= updateReachEdges((int)(neigh.otherss - first));
+    }
+
+    if (changed)
+        buildReachComponents();
+}
+
+//
+// PathFinder::updateReachEdges
+//
+// Recomputes the outgoing edges of a subsector, following the same rules as
+// AvailableGoals. Returns true if any of them changed.
+//
+bool PathFinder::updateReachEdges(int ssindex)
+{
+    ReachIndex& r = m_reach;
+    const BSubsec& ss = m_map->ssectors[ssindex];
+    const BSubsec* first = &m_map->ssectors[0];
+    bool changed = false;
+    unsigned e = r.edgestart[ssindex];
+
+    for (const BNeigh& neigh : ss.neighs)
+    {
+        const TeleItem* bytele = checkTeleportation(neigh);
+        int target = -1;
+        if (bytele)
+            target = (int)(bytele->ss - first);
+        else if (m_map->canPass(ss, *neigh.otherss, m_player->mo->height))
+            target = (int)(neigh.otherss - first);
+
+        if (r.edgetarget[e] != target)
+        {
+            r.edgetarget[e] = target;
+            changed = true;
+        }
+        ++e;
+    }
+
+    return changed;
+}
+
+//
+// PathFinder::buildReachComponents
+//
+// Tarjan's algorithm, iterative so that large maps cannot overflow the stack,
+// followed by the condensation DAG in compressed row form.
+//
+void PathFinder::buildReachComponents()
+{
+    ReachIndex& r = m_reach;
+    int numss = (int)m_map->ssectors.getLength();
+
+    std::vector<int> index(numss, -1), lowlink(numss, 0);
+    std::vector<bool> onstack(numss, false);
+    std::vector<int> stack;
+    std::vector<std::pair<int, unsigned>> callstack; // ss, next edge
+    int counter = 0;
+
+    r.numcomps = 0;
+    for (int root = 0; root < numss; ++root)
+    {
+        if (index[root] != -1)
+            continue;
+
+        callstack.emplace_back(root, r.edgestart[root]);
+        index[root] = lowlink[root] = counter++;
+        stack.push_back(root);
+        onstack[root] = true;
+
+        while (!callstack.empty())
+        {
+            int v = callstack.back().first;
+            unsigned& e = callstack.back().second;
+
+            if (e < r.edgestart[v + 1])
+            {
+                int w = r.edgetarget[e++];
+                if (w < 0)
+                    continue;
+                if (index[w] == -1)
+                {
+                    index[w] = lowlink[w] = counter++;
+                    stack.push_back(w);
+                    onstack[w] = true;
+                    callstack.emplace_back(w, r.edgestart[w]);
+                }
+                else if (onstack[w] && index[w] < lowlink[v])
+                    lowlink[v] = index[w];
+                continue;
+            }
+
+            // all edges done: v is the root of a component if nothing
+            // below it reached higher up
+            if (lowlink[v] == index[v])
+            {
+                int w;
+                do
+                {
+                    w = stack.back();
+                    stack.pop_back();
+                    onstack[w] = false;
+                    r.sscomp[w] = r.numcomps;
+                } while (w != v);
+                ++r.numcomps;
+            }
+
+            callstack.pop_back();
+            if (!callstack.empty())
+            {
+                int u = callstack.back().first;
+                if (lowlink[v] < lowlink[u])
+                    lowlink[u] = lowlink[v];
+            }
+        }
+    }
+
+    // Condensation: edges between different components, without duplicates
+    std::vector<std::pair<int, int>> dag;
+    for (int v = 0; v < numss; ++v)
+    {
+        for (unsigned e = r.edgestart[v]; e < r.edgestart[v + 1]; ++e)
+        {
+            int w = r.edgetarget[e];
+            if (w >= 0 && r.sscomp[w] != r.sscomp[v])
+                dag.emplace_back(r.sscomp[v], r.sscomp[w]);
+        }
+    }
+    std::sort(dag.begin(), dag.end());
+    dag.erase(std::unique(dag.begin(), dag.end()), dag.end());
+
+    r.dagstart.assign(r.numcomps + 1, 0);
+    r.dagtarget.resize(dag.size());
+    for (size_t i = 0; i < dag.size(); ++i)
+    {
+        ++r.dagstart[dag[i].first + 1];
+        r.dagtarget[i] = dag[i].second;
+    }
+    for (int c = 0; c < r.numcomps; ++c)
+        r.dagstart[c + 1] += r.dagstart[c];
+
+    r.visit.assign(r.numcomps, 0);
+    r.wanted.assign(r.numcomps, 0);
+    r.stamp = 0;
+}
+
 //
 // PathFinder::DataBox::IncrementValidcount
 //
@@ -31,6 +31,7 @@
 #define __EternityEngine__b_path__
 
 #include <map>
+#include <vector>
 #include "b_botmap.h"
 #include "b_util.h"
 #include "../m_collection.h"
@@ -95,6 +96,10 @@ public:
     bool FindNextGoal(fixed_t x, fixed_t y, BotPath& path, bool(*isGoal)(const BSubsec&, BotPathEnd&, void*), void* parm = nullptr);
     bool AvailableGoals(const BSubsec& source, std::unordered_set<const BSubsec*>* dests, PathResult(*isGoal)(const BSubsec&, void*), void* parm = nullptr);
 
+    // Reachability index. Only valid while LevelStateStack is clear.
+    int ReachComponent(const BSubsec& ss);
+    bool ComponentReachesAll(int from, const std::vector<int>& comps);
+
     void SetPlayer(const player_t *player)
     {
         m_player = player;
@@ -112,6 +117,7 @@ public:
         db[1].Clear();
         m_teleCache.clear();
         m_dijkHeap.clear();
+        m_reach.Clear();
     }
 
 private:
@@ -165,6 +171,57 @@ private:
     };
 
     PODCollection<HeapEntry>    m_dijkHeap;
+
+    //
+    // ReachIndex
+    //
+    // Strongly connected components of the subsector graph walked by
+    // AvailableGoals, with the DAG between them. Two subsectors in the same
+    // component can always get back to each other. Rebuilt only when moving
+    // sectors actually change which neighbours can be passed.
+    //
+    struct ReachIndex
+    {
+        bool                    valid;
+        int                     checktic;   // gametic of last height check
+        fixed_t                 height;     // player height it was built for
+        std::vector<fixed_t>    ssheights;  // floor, alt floor, ceiling per ss
+        std::vector<unsigned>   edgestart;  // first edge per ss (CSR)
+        std::vector<int>        edgetarget; // target ss per neigh, or -1
+        std::vector<int>        sscomp;     // component per ss
+        int                     numcomps;
+        std::vector<unsigned>   dagstart;   // first DAG edge per component
+        std::vector<int>        dagtarget;  // target component per DAG edge
+        std::vector<unsigned>   visit;      // search marks per component
+        std::vector<unsigned>   wanted;     // target marks per component
+        unsigned                stamp;
+
+        ReachIndex() : valid(false), checktic(0), height(0), numcomps(0),
+        stamp(0)
+        {
+        }
+
+        void Clear()
+        {
+            valid = false;
+            ssheights.clear();
+            edgestart.clear();
+            edgetarget.clear();
+            sscomp.clear();
+            dagstart.clear();
+            dagtarget.clear();
+            visit.clear();
+            wanted.clear();
+            numcomps = 0;
+            stamp = 0;
+        }
+    };
+
+    ReachIndex      m_reach;
+
+    void            updateReachIndex();
+    bool            updateReachEdges(int ssindex);
+    void            buildReachComponents();
     
     void            pushSubsectorToHeap(const BNeigh& neigh, int index, 
                                         const BSubsec& ss, fixed_t tentative);
@@ -26,15 +26,45 @@
 //
 //-----------------------------------------------------------------------------
 
-#include <map>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "../z_zone.h"
 #include "b_statistics.h"
 #include "b_util.h"
 #include "../doomstat.h"
+#include "../hal/i_process.h"
 #include "../info.h"
+#include "../m_compare.h"
+#include "../m_hash.h"
+#include "../m_qstr.h"
 #include "../m_utils.h"
+#include "../w_wad.h"
 
-#define MONSTER_STATS_NAME "damagestats.data"
+//
+// The statistics live in one log file per mod, shared by every bot process
+// running that mod. Each process appends what it learned since its last store
+// as one self-checked batch, written with a single unbuffered append. Every
+// read, append and compaction is done holding an advisory lock on the log's
+// .lock file, so processes never interleave. Monster types are identified by their class name, which,
+// unlike the mobjinfo index, does not shift when EDF changes.
+//
+// Batch layout, all little-endian:
+//    uint32 STATS_BATCH_MAGIC
+//    uint32 payload size
+//    uint32 CRC32 of the payload
+//    payload: { uint8 namelen, char name[namelen], int32 damage, int32 deaths }*
+//
+// A torn batch, left by a crashed writer, fails its check and is skipped; the
+// read goes on from the next batch header. Once the log grows past
+// STATS_COMPACT_SIZE, the next process to load it replaces it with a single
+// batch of the summed totals.
+//
+
+#define STATS_BATCH_MAGIC  0x3142534d  // "MSB1"
+#define STATS_COMPACT_SIZE (64 * 1024)
+#define STATS_MAXBATCH     (16 * 1024 * 1024)
 
 struct DamageStat
 {
@@ -42,63 +72,303 @@ struct DamageStat
    int monsterDeaths;
 };
 
-static std::map<const mobjinfo_t*, DamageStat> g_stats;
+typedef std::unordered_map<std::string, DamageStat> StatsByName;
+
+static qstring g_statsPath;                 // log file for the loaded mod
+static StatsByName g_storedStats;           // totals read at load, by name
+static std::vector<DamageStat> g_stats;     // totals, by mobjinfo index
+static std::vector<DamageStat> g_pending;   // not yet stored, by mobjinfo index
+
+//
+// B_statsModKey
+//
+// Identifies the mod by the names and sizes of all loaded lumps, so that it
+// does not depend on where the files are or when they were touched.
+//
+static void B_statsModKey(uint32_t key[2])
+{
+   HashData hash(HashData::SHA1);
+   lumpinfo_t **lumpinfo = wGlobalDir.getLumpInfo();
+
+   for(int i = 0; i < wGlobalDir.getNumLumps(); i++)
+   {
+      uint32_t size = static_cast<uint32_t>(lumpinfo[i]->size);
+      hash.addData(reinterpret_cast<const uint8_t *>(lumpinfo[i]->name), 8);
+      hash.addData(reinterpret_cast<const uint8_t *>(&size), sizeof(size));
+   }
+   hash.wrapUp();
+   key[0] = hash.getDigestPart(0);
+   key[1] = hash.getDigestPart(1);
+}
+
+//
+// B_statFor
+//
+// Returns the entry of a monster type in a dense array. Types added after
+// loading get their stored totals on first use.
+//
+static DamageStat &B_statFor(std::vector<DamageStat> &stats, const mobjinfo_t *mi)
+{
+   if(mi->index >= (int)g_stats.size())
+   {
+      size_t oldsize = g_stats.size();
+      size_t newsize = emax(NUMMOBJTYPES, mi->index + 1);
+      g_stats.resize(newsize, DamageStat());
+      g_pending.resize(newsize, DamageStat());
+      for(size_t i = oldsize; i < newsize && i < (size_t)NUMMOBJTYPES; ++i)
+      {
+         auto it = g_storedStats.find(mobjinfo[i]->name);
+         if(it != g_storedStats.end())
+            g_stats[i] = it->second;
+      }
+   }
+   return stats[mi->index];
+}
+
+//
+// B_putStatsInt
+//
+static void B_putStatsInt(std::vector<uint8_t> &buf, uint32_t value)
+{
+   for(int i = 0; i < 4; ++i)
+      buf.push_back((uint8_t)(value >> (8 * i)));
+}
+
+//
+// B_getStatsInt
+//
+static uint32_t B_getStatsInt(const uint8_t *data)
+{
+   return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+//
+// B_readStatsLog
+//
+// Adds every intact batch of a log to the totals. A batch that fails its
+// check is skipped by looking for the next batch header after it, so one
+// torn batch loses nothing but itself.
+//
+static void B_readStatsLog(const char *path, StatsByName &totals)
+{
+   FILE *f = fopen(path, "rb");
+   if(!f)
+      return;
+
+   std::vector<uint8_t> data(M_FileLength(f));
+   size_t size = data.empty() ? 0 : fread(&data[0], 1, data.size(), f);
+   fclose(f);
+
+   size_t start = 0;
+   while(start + 12 <= size)
+   {
+      const uint8_t *header = &data[start];
+      const uint8_t *payload = header + 12;
+      uint32_t length = B_getStatsInt(header + 4);
+
+      if(B_getStatsInt(header) != STATS_BATCH_MAGIC ||
+         length > STATS_MAXBATCH || length > size - start - 12 ||
+         HashData(HashData::CRC32, payload, length).getDigestPart(0) !=
+         B_getStatsInt(header + 8))
+      {
+         ++start;
+         continue;
+      }
+
+      size_t pos = 0;
+      while(pos < length)
+      {
+         size_t namelen = payload[pos++];
+         if(pos + namelen + 8 > length)
+            break;
+         std::string name(reinterpret_cast<const char *>(&payload[pos]), namelen);
+         pos += namelen;
+         DamageStat &stat = totals[name];
+         stat.totalDamageToPlayer += (int32_t)B_getStatsInt(&payload[pos]);
+         stat.monsterDeaths += (int32_t)B_getStatsInt(&payload[pos + 4]);
+         pos += 8;
+      }
+      start += 12 + length;
+   }
+}
+
+//
+// B_appendStatsBatch
+//
+// Appends the given counts as one batch. The whole batch goes out in a single
+// unbuffered write to a file opened for appending.
+//
+static bool B_appendStatsBatch(const char *path, const StatsByName &counts)
+{
+   std::vector<uint8_t> buf(12);
+
+   for(const auto &entry : counts)
+   {
+      const std::string &name = entry.first;
+      if(name.empty() || name.length() > 255)
+         continue;
+      buf.push_back((uint8_t)name.length());
+      buf.insert(buf.end(), name.begin(), name.end());
+      B_putStatsInt(buf, (uint32_t)entry.second.totalDamageToPlayer);
+      B_putStatsInt(buf, (uint32_t)entry.second.monsterDeaths);
+   }
+
+   uint32_t length = (uint32_t)(buf.size() - 12);
+   if(!length)
+      return true;
+
+   HashData crc(HashData::CRC32, &buf[12], length);
+   std::vector<uint8_t> header;
+   B_putStatsInt(header, STATS_BATCH_MAGIC);
+   B_putStatsInt(header, length);
+   B_putStatsInt(header, crc.getDigestPart(0));
+   std::copy(header.begin(), header.end(), buf.begin());
+
+   FILE *f = fopen(path, "ab");
+   if(!f)
+      return false;
+   setvbuf(f, nullptr, _IONBF, 0);
+   bool ok = fwrite(buf.data(), buf.size(), 1, f) == 1;
+   ok &= !fclose(f);
+   return ok;
+}
+
+//
+// B_compactStatsLog
+//
+// Replaces a long log with one batch of its totals, written under a temporary
+// name and renamed into place. The caller must hold the log's lock, so that
+// nobody appends meanwhile.
+//
+static void B_compactStatsLog(const char *path)
+{
+   StatsByName totals;
+   B_readStatsLog(path, totals);
+
+   qstring tmppath;
+   tmppath.Printf(0, "%s.%d.tmp", path, I_GetProcessID());
+   remove(tmppath.constPtr());
+
+   if(!B_appendStatsBatch(tmppath.constPtr(), totals))
+   {
+      B_Log("Couldn't compact %s", path);
+      remove(tmppath.constPtr());
+      return;
+   }
+
+   remove(path);
+   if(rename(tmppath.constPtr(), path))
+      remove(tmppath.constPtr());
+}
+
+//
+// B_lockStatsLog
+//
+// Every process takes this before touching the log, and holds it only for a
+// single read, append or compaction.
+//
+static filelock_t B_lockStatsLog()
+{
+   qstring lockpath(g_statsPath);
+   lockpath << ".lock";
+
+   filelock_t lock = I_LockFile(lockpath.constPtr());
+   if(lock == -1)
+      B_Log("Couldn't lock %s", lockpath.constPtr());
+   return lock;
+}
 
 void B_AddMonsterDeath(const mobjinfo_t* mi)
 {
-   ++g_stats[mi].monsterDeaths;
+   ++B_statFor(g_stats, mi).monsterDeaths;
+   ++B_statFor(g_pending, mi).monsterDeaths;
 }
 
 void B_AddToPlayerDamage(const mobjinfo_t* mi, int amount)
 {
-   g_stats[mi].totalDamageToPlayer += amount;
+   B_statFor(g_stats, mi).totalDamageToPlayer += amount;
+   B_statFor(g_pending, mi).totalDamageToPlayer += amount;
 }
 
 double B_GetMonsterThreatLevel(const mobjinfo_t* mi)
 {
-   const DamageStat& stat = g_stats[mi];
+   const DamageStat& stat = B_statFor(g_stats, mi);
    return stat.monsterDeaths > 0 ? (double)stat.totalDamageToPlayer / stat.monsterDeaths : DBL_MAX;
 }
 
+//
+// B_LoadMonsterStats
+//
+// Must be called once the mod's resources and EDF have been loaded.
+//
 void B_LoadMonsterStats()
 {
-   const char* fpath = M_SafeFilePath(g_autoDoomPath, MONSTER_STATS_NAME);
-   
-   FILE* f = fopen(fpath, "rt");
+   uint32_t key[2];
+   B_statsModKey(key);
+
+   qstring name;
+   name.Printf(0, "monsterstats-%08x%08x.log", key[0], key[1]);
+   g_statsPath = g_autoDoomPath;
+   g_statsPath.pathConcatenate(name.constPtr());
+
+   g_storedStats.clear();
+   g_stats.clear();
+   g_pending.clear();
+
+   filelock_t lock = B_lockStatsLog();
+   FILE *f = fopen(g_statsPath.constPtr(), "rb");
    if(!f)
    {
-      B_Log(MONSTER_STATS_NAME " not written yet.");
-      return;
+      B_Log("%s not written yet.", name.constPtr());
    }
-   
-   int minum, toPlayer, monsterDeaths;
-   double toDiv;
-   
-   while(!feof(f))
+   else
    {
-      if(fscanf(f, "%d%d%d%lf", &minum, &toPlayer, &monsterDeaths, &toDiv) < 4)
-         break;
-      
-      g_stats[mobjinfo[0] + minum].totalDamageToPlayer = toPlayer;
-      g_stats[mobjinfo[0] + minum].monsterDeaths = monsterDeaths;
+      long size = M_FileLength(f);
+      fclose(f);
+      if(size > STATS_COMPACT_SIZE && lock != -1)
+         B_compactStatsLog(g_statsPath.constPtr());
+      B_readStatsLog(g_statsPath.constPtr(), g_storedStats);
+   }
+   I_UnlockFile(lock);
+
+   // lay the totals out by mobjinfo index
+   g_stats.resize(NUMMOBJTYPES, DamageStat());
+   g_pending.resize(NUMMOBJTYPES, DamageStat());
+   for(int i = 0; i < NUMMOBJTYPES; ++i)
+   {
+      auto it = g_storedStats.find(mobjinfo[i]->name);
+      if(it != g_storedStats.end())
+         g_stats[i] = it->second;
    }
-   
-   fclose(f);
 }
 
+//
+// B_StoreMonsterStats
+//
+// Appends what was learned since the last store.
+//
 void B_StoreMonsterStats()
 {
-   const char* fpath = M_SafeFilePath(g_autoDoomPath, MONSTER_STATS_NAME);
-   
-   FILE* f = fopen(fpath, "wt");
-   if(!f)
-   {
-      B_Log("Couldn't write " MONSTER_STATS_NAME);
+   if(g_statsPath.empty())
       return;
+
+   StatsByName counts;
+   for(size_t i = 0; i < g_pending.size() && i < (size_t)NUMMOBJTYPES; ++i)
+   {
+      if(g_pending[i].totalDamageToPlayer || g_pending[i].monsterDeaths)
+         counts[mobjinfo[i]->name] = g_pending[i];
    }
-   for (auto it = g_stats.begin(); it != g_stats.end(); ++it)
+
+   filelock_t lock = B_lockStatsLog();
+   if(lock == -1)
+      return;
+   bool written = B_appendStatsBatch(g_statsPath.constPtr(), counts);
+   I_UnlockFile(lock);
+
+   if(!written)
    {
-      fprintf(f, "%d\t%d\t%d\t%g\n", (int)(it->first - mobjinfo[0]), it->second.totalDamageToPlayer, it->second.monsterDeaths, B_GetMonsterThreatLevel(it->first));
+      B_Log("Couldn't write %s", g_statsPath.constPtr());
+      return;
    }
-   fclose(f);
-}
\ No newline at end of file
+   std::fill(g_pending.begin(), g_pending.end(), DamageStat());
+}
@@ -26,11 +26,13 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
 #include <queue>
 #include "../z_zone.h"
 
 #include "b_analysis.h"
 #include "b_itemlearn.h"
+#include "b_motion.h"
 #include "b_statistics.h"
 #include "b_think.h"
 #include "b_trace.h"
@@ -63,6 +65,8 @@ enum
     // obtain the distance the object will move before stopping while on ground
     DRIFT_TIME = (fixed_t)(0xffffffffll / (FRACUNIT - ORIG_FRICTION)),
     DRIFT_TIME_INV = FRACUNIT - ORIG_FRICTION,
+    // how far ahead movement commands are checked for drops and hazards
+    DROP_LOOKAHEAD_TICS = 8,
 
    URGENT_CHAT_INTERVAL_SEC = 20,
    IDLE_CHAT_INTERVAL_SEC = 300, // Five minutes
@@ -106,6 +110,7 @@ void Bot::mapInit()
    m_deepSearchMode = DeepNormal;
    m_deepAvailSsectors.clear();
    m_deepRepeat = nullptr;
+   m_deadEndValid = false;
     m_justGotLost = false;
     m_intoSwitch = false;
     m_goalTimer = 0;
@@ -191,6 +196,15 @@ PathResult Bot::reachableItem(const BSubsec& ss, void* v)
     return result ? (self.m_deepSearchMode == DeepBeyond ? PathDone : PathAdd) : PathNo;
 }
 
+//
+// Bot::checkDeadEndTrap
+//
+// Returns true if every goal available from here can still be reached after
+// going to targss. The goals available from here don't depend on the target,
+// so they're collected once per search, as the components of the reachability
+// index holding them. Each target then only needs a walk of the component DAG,
+// shared by all targets in the same component.
+//
 bool Bot::checkDeadEndTrap(const BSubsec& targss)
 {
     if(m_searchstage >= SearchStage_PitItems || m_deepSearchMode != DeepNormal
@@ -200,17 +214,36 @@ bool Bot::checkDeadEndTrap(const BSubsec& targss)
     }
 
     LevelStateStack::Clear();
-    m_deepAvailSsectors.clear();
 
-    m_deepSearchMode = DeepAvail;
-    m_finder.AvailableGoals(*ss, &m_deepAvailSsectors, reachableItem, this);
-    m_deepSearchMode = DeepCheckLosses;
-    m_finder.AvailableGoals(targss, nullptr, reachableItem, this);
-    m_deepSearchMode = DeepNormal;
+    if(!m_deadEndValid)
+    {
+       m_deepAvailSsectors.clear();
+
+       m_deepSearchMode = DeepAvail;
+       m_finder.AvailableGoals(*ss, &m_deepAvailSsectors, reachableItem, this);
+       m_deepSearchMode = DeepNormal;
+
+       m_deadEndGoals.clear();
+       for(const BSubsec *avail : m_deepAvailSsectors)
+          m_deadEndGoals.push_back(m_finder.ReachComponent(*avail));
+       std::sort(m_deadEndGoals.begin(), m_deadEndGoals.end());
+       m_deadEndGoals.erase(std::unique(m_deadEndGoals.begin(),
+                                        m_deadEndGoals.end()),
+                            m_deadEndGoals.end());
+
+       m_deepAvailSsectors.clear();
+       m_deadEndResults.clear();
+       m_deadEndValid = true;
+    }
 
-    LevelStateStack::Clear();
+    int comp = m_finder.ReachComponent(targss);
+    auto it = m_deadEndResults.find(comp);
+    if(it != m_deadEndResults.end())
+       return it->second;
 
-    return m_deepAvailSsectors.empty();
+    bool result = m_finder.ComponentReachesAll(comp, m_deadEndGoals);
+    m_deadEndResults[comp] = result;
+    return result;
 }
 
 bool Bot::shouldUseSpecial(const line_t& line, const BSubsec& liness)
@@ -1272,6 +1305,7 @@ void Bot::doNonCombatAI()
     {
         // TODO: object of interest
         LevelStateStack::SetKeyPlayer(pl);
+        m_deadEndValid = false;
         if(!m_finder.FindNextGoal(pl->mo->x, pl->mo->y, m_path, objOfInterest, this))
         {
             ++m_searchstage;
@@ -1588,6 +1622,71 @@ bool Bot::stepLedges(bool avoid, fixed_t nx, fixed_t ny)
    });
 }
 
+//
+// Bot::avoidDrops
+//
+// Predicts where the movement command leads over the next few tics. If it
+// ends up somewhere the bot can't walk back from, or steps onto a damaging
+// floor, and that place isn't on its path, the movement is turned or scaled
+// down until it no longer does.
+//
+void Bot::avoidDrops()
+{
+    if(!(cmd->forwardmove | cmd->sidemove) || pl->mo->z > pl->mo->floorz)
+        return;
+
+    BotMotion motion(*pl);
+    auto isSafe = [this, &motion](const ticcmd_t &candidate) {
+        BotMotion::Result res = motion.predict(candidate, DROP_LOOKAHEAD_TICS);
+        if(res.flags & BotMotion::DROPPED &&
+           !(m_hasPath && m_path.sss.count(res.dropss)))
+        {
+            return false;
+        }
+        return !(res.flags & BotMotion::HAZARD) ||
+        (m_hasPath && m_path.sss.count(res.hazardss));
+    };
+
+    if(isSafe(*cmd))
+        return;
+
+    // Candidates in order of preference: the same direction slower, then
+    // turned more and more away from it, then braking
+    static const struct
+    {
+        angle_t turn;
+        int scale;    // in halves
+    } candidates[] =
+    {
+        { 0, 1 },
+        { ANG45, 2 }, { ANG270 + ANG45, 2 },
+        { ANG90, 2 }, { ANG270, 2 },
+        { ANG90 + ANG45, 2 }, { ANG180 + ANG45, 2 },
+        { ANG180, 2 },
+    };
+
+    const fixed_t fmove = cmd->forwardmove, smove = cmd->sidemove;
+    const fixed_t maxmove = pl->pclass->forwardmove[1];
+    ticcmd_t candidate = *cmd;
+    for(const auto &c : candidates)
+    {
+        const unsigned fine = c.turn >> ANGLETOFINESHIFT;
+        fixed_t f = fmove * finecosine[fine] - smove * finesine[fine];
+        fixed_t s = fmove * finesine[fine] + smove * finecosine[fine];
+        candidate.forwardmove = (int8_t)eclamp((f >> FRACBITS) * c.scale / 2, -maxmove, maxmove);
+        candidate.sidemove = (int8_t)eclamp((s >> FRACBITS) * c.scale / 2, -maxmove, maxmove);
+        if(isSafe(candidate))
+        {
+            cmd->forwardmove = candidate.forwardmove;
+            cmd->sidemove = candidate.sidemove;
+            return;
+        }
+    }
+
+    // nothing works, so just stand still
+    cmd->forwardmove = cmd->sidemove = 0;
+}
+
 void Bot::cruiseControl(fixed_t nx, fixed_t ny, bool moveslow)
 {
 
@@ -1837,6 +1936,9 @@ void Bot::doCommand()
    
    // Limit commands before exiting
    capCommands();
+
+   // Last, make sure the command doesn't take us off a ledge by accident
+   avoidDrops();
 }
 
 //
@@ -94,6 +94,11 @@ class Bot : public ZoneObject
    std::unordered_set<const line_t*>  m_deepTriedLines;
    std::unordered_set<const BSubsec*> m_deepAvailSsectors;
    const BSubsec*           m_deepRepeat;
+
+   // checkDeadEndTrap state, valid for the duration of one FindNextGoal
+   bool                     m_deadEndValid;
+   std::vector<int>         m_deadEndGoals;   // components of available goals
+   std::unordered_map<int, bool> m_deadEndResults; // per target component
    bool                     m_justGotLost;
    bool                     m_intoSwitch;
    int                      m_goalTimer;
@@ -157,6 +162,7 @@ class Bot : public ZoneObject
    }
    bool stepLedges(bool avoid, fixed_t nx, fixed_t ny);
    void cruiseControl(fixed_t nx, fixed_t ny, bool moveslow);
+   void avoidDrops();
 
    void capCommands();
 
@@ -191,6 +197,7 @@ public:
    m_hasPath(false),
    m_deepSearchMode(DeepNormal),
    m_deepRepeat(nullptr),
+   m_deadEndValid(false),
    m_justGotLost(false),
    m_intoSwitch(false),
    m_goalTimer(0),
@@ -26,6 +26,8 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <chrono>
+
 // haleyjd 10/28/04: Win32-specific repair for D_DoomExeDir
 // haleyjd 08/20/07: POSIX opendir needed for autoload functionality
 #ifdef _MSC_VER
@@ -37,6 +39,7 @@
 #include "acs_intr.h"
 #include "am_map.h"
 #include "autodoom/b_ape.h"
+#include "autodoom/b_mapreport.h"
 #include "autodoom/b_statistics.h"
 #include "autodoom/b_think.h" // IOANCH
 #include "c_io.h"
@@ -50,6 +53,7 @@
 #include "d_io.h"
 #include "d_iwad.h"
 #include "d_net.h"
+#include "d_startprof.h"
 #include "doomstat.h"
 #include "dstrings.h"
 #include "e_edf.h"
@@ -59,10 +63,14 @@
 #include "f_wipe.h"
 #include "g_bind.h"
 #include "g_demolog.h"
+#include "g_demorun.h"
+#include "g_demostream.h"
+#include "g_demosum.h"
 #include "g_dmflag.h"
 #include "g_game.h"
 #include "g_gfs.h"
 #include "hal/i_timer.h"
+#include "hal/i_vtimer.h"
 #include "hu_stuff.h"
 #include "i_sound.h"
 #include "i_system.h"
@@ -70,6 +78,7 @@
 #include "in_lude.h"
 #include "m_argv.h"
 #include "m_compare.h"
+#include "m_ctype.h"
 #include "m_misc.h"
 #include "m_syscfg.h"
 #include "m_qstr.h"
@@ -115,10 +124,20 @@ bool fastparm;       // working -fast
 
 bool singletics = false; // debug flag to cancel adaptiveness
 
+// -maxspeed: run gametics back to back on a virtual clock
+bool d_maxspeed;
+static int    d_maxspeedrender;  // draw every nth tic; 0 to never draw
+static int    d_maxspeedtics;    // quit after this many tics; 0 for no limit
+static double d_maxspeedbudget;  // quit after this many seconds; 0 for no limit
+
 //jff 1/22/98 parms for disabling music and sound
 bool nosfxparm;
 bool nomusicparm;
 
+// -faststart: skip music and defer graphics until something is drawn
+bool d_faststart;
+static bool d_deferredinit;
+
 //jff 4/18/98
 extern bool inhelpscreens;
 
@@ -171,6 +190,8 @@ void usermsg(const char *s, ...)
 //sf:
 void startupmsg(const char *func, const char *desc)
 {
+   D_StartupPhase(func);
+
    // add colours in console mode
    usermsg(in_textmode ? "%s: %s" : FC_HI "%s: " FC_NORMAL "%s",
            func, desc);
@@ -568,6 +589,26 @@ void D_DrawWings()
    }
 }
 
+//
+// D_InitDeferred
+//
+// Loads the graphics that -faststart skipped, the first time anything needs
+// to be drawn.
+//
+void D_InitDeferred()
+{
+   if(!d_deferredinit)
+      return;
+   d_deferredinit = false;
+
+   ST_Init();
+   MN_InitGraphics();
+
+   // widgets of a running status bar refer to the graphics
+   if(gamestate == GS_LEVEL)
+      ST_Start();
+}
+
 //
 // D_Display
 //  draw current display, possibly wiping it from the previous
@@ -577,6 +618,8 @@ static void D_Display()
    if(nodrawers)                // for comparative timing / profiling
       return;
 
+   D_InitDeferred();
+
    i_haltimer.StartDisplay();
 
    if(setsizeneeded)            // change the view size if needed
@@ -1255,6 +1298,34 @@ void D_sanityCheck()
    }
 }
 
+//
+// D_parseMaxSpeed
+//
+// -maxspeed [n]       run as fast as possible, drawing every nth tic (0: never)
+// -maxtics <n>        quit after running n gametics
+// -maxseconds <secs>  quit after this much wall clock time
+//
+static void D_parseMaxSpeed()
+{
+   int p;
+
+   if(!(p = M_CheckParm("-maxspeed")))
+      return;
+
+   // the other nodes would have to keep up
+   if(netgame)
+      I_Error("D_parseMaxSpeed: -maxspeed cannot be used in a netgame\n");
+
+   d_maxspeed = true;
+   if(p < myargc - 1 && ectype::isDigit(myargv[p + 1][0]))
+      d_maxspeedrender = atoi(myargv[p + 1]);
+
+   if((p = M_CheckParm("-maxtics")) && p < myargc - 1)
+      d_maxspeedtics = emax(atoi(myargv[p + 1]), 0);
+   if((p = M_CheckParm("-maxseconds")) && p < myargc - 1)
+      d_maxspeedbudget = emax(atof(myargv[p + 1]), 0.0);
+}
+
 //
 // D_DoomInit
 //
@@ -1274,6 +1345,20 @@ static void D_DoomInit()
 
    startupmsg("Z_Init", "Init zone memory allocation daemon.");
    Z_Init();
+
+   // desync bisector: compare two checksum streams and quit, before I_Quit
+   // can touch the configuration
+   if((p = M_CheckParm("-demosumcmp")) && p < myargc - 2)
+      exit(G_DemoSumCompare(myargv[p + 1], myargv[p + 2]));
+
+   // streaming demo converter: turns a streaming demo into a .lmp, or back
+   if((p = M_CheckParm("-democonvert")) && p < myargc - 2)
+      exit(G_DemoStreamConvert(myargv[p + 1], myargv[p + 2]));
+
+   // demo regression runner: plays a corpus in worker processes and quits
+   if((p = M_CheckParm("-demorunner")) && p < myargc - 1)
+      exit(G_DemoRunCorpus(myargv[p + 1]));
+
    atexit(I_Quit);
 
    D_sanityCheck();  // ioanch 20160329
@@ -1281,6 +1366,7 @@ static void D_DoomInit()
    FindResponseFile(); // Append response file arguments to command-line
 
    // haleyjd 08/18/07: set base path and user path
+   D_StartupPhase("D_SetPaths");
    D_SetBasePath();
    D_SetUserPath();
    D_SetAutoDoomPath();	// IOANCH
@@ -1289,10 +1375,12 @@ static void D_DoomInit()
    D_CheckGamePathParam();
 
    // haleyjd 03/05/09: load system config as early as possible
+   D_StartupPhase("D_LoadSysConfig");
    D_LoadSysConfig();
 
    // haleyjd 03/10/03: GFS support
    // haleyjd 11/22/03: support loose GFS on the command line too
+   D_StartupPhase("G_LoadGFS");
    if((p = M_CheckParm("-gfs")) && p < myargc - 1)
    {
       qstring fn;
@@ -1448,6 +1536,10 @@ static void D_DoomInit()
    if(!p)
       loosedemo = D_LooseDemo();
 
+   // workers of the demo runner play as fast as they can
+   if(G_DemoRunWorker())
+      fastdemo = true;
+
    if((p && p < myargc - 1) || loosedemo)
    {
       const char *demosource = loosedemo ? loosedemo : myargv[p + 1];
@@ -1528,17 +1620,24 @@ static void D_DoomInit()
       }
    }
 
+   // fast start for batch runs: no music, and the status bar and menu
+   // graphics are only loaded if something is ever drawn
+   d_faststart = !!M_CheckParm("-faststart");
+
    //jff 1/22/98 add command line parms to disable sound and music
    {
-      bool nosound = !!M_CheckParm("-nosound");
-      nomusicparm  = nosound || M_CheckParm("-nomusic");
+      // the map analyzer never plays anything
+      bool nosound = M_CheckParm("-nosound") || M_CheckParm("-mapreport");
+      // music needs an audio device, which -wavout does without
+      nomusicparm  = nosound || d_faststart || M_CheckParm("-nomusic") ||
+                     M_CheckParm("-wavout");
       nosfxparm    = nosound || M_CheckParm("-nosfx");
       s_randmusic  = !!M_CheckParm("-randmusic");
    }
    //jff end of sound/music command line parms
 
    // killough 3/2/98: allow -nodraw -noblit generally
-   nodrawers = !!M_CheckParm("-nodraw");
+   nodrawers = M_CheckParm("-nodraw") || M_CheckParm("-mapreport");
    noblit    = !!M_CheckParm("-noblit");
 
    // haleyjd: need to do this before M_LoadDefaults
@@ -1554,6 +1653,7 @@ static void D_DoomInit()
 
    // 1/18/98 killough: Z_Init call moved to i_main.c
 
+   D_StartupPhase("D_ProcessWadPreincludes");
    D_ProcessWadPreincludes(); // killough 10/98: add preincluded wads at the end
 
    // haleyjd 08/20/07: also, enumerate and load wads from base/game/autoload
@@ -1573,6 +1673,7 @@ static void D_DoomInit()
       I_Error("\nYou cannot -file with the shareware version. Register!\n");
 
    // haleyjd 08/03/13: load any deferred mission metadata
+   D_StartupPhase("D_InitGMIPostWads");
    D_DoDeferredMissionMetaData();
 
    // haleyjd 11/12/09: Initialize post-W_InitMultipleFiles GameModeInfo
@@ -1580,6 +1681,7 @@ static void D_DoomInit()
    D_InitGMIPostWads();
 
    // haleyjd 10/20/03: use D_ProcessDehInWads again
+   D_StartupPhase("D_ProcessDehInWads");
    D_ProcessDehInWads();
 
    // killough 10/98: process preincluded .deh files
@@ -1591,6 +1693,7 @@ static void D_DoomInit()
 
    // jff 4/24/98 load color translation lumps
    // haleyjd 09/06/12: need to do this before EDF
+   D_StartupPhase("V_InitColorTranslation");
    V_InitColorTranslation(); 
 
    // haleyjd 08/28/13: init console command list
@@ -1606,15 +1709,19 @@ static void D_DoomInit()
    D_BuildBEXHashChains();
 
    // Identify root EDF file and process EDF
+   D_StartupPhase("D_LoadEDF");
    D_LoadEDF(gfs);
    
    // IOANCH: load statistics files
+   D_StartupPhase("B_LoadMonsterStats");
    B_LoadMonsterStats();
 
    // haleyjd 03/27/11: process Hexen scripts
+   D_StartupPhase("XL_ParseHexenScripts");
    XL_ParseHexenScripts();
 
    // Build BEX tables (some are EDF-dependent)
+   D_StartupPhase("D_ProcessDEHQueue");
    D_BuildBEXTables();
 
    // Process the DeHackEd queue, then free it
@@ -1684,10 +1791,17 @@ static void D_DoomInit()
    HU_Init();
 
    startupmsg("ST_Init", "Init status bar.");
-   ST_Init();
+   if(d_faststart)
+      ST_InitPalette();
+   else
+      ST_Init();
 
    startupmsg("MN_Init", "Init menu.");
    MN_Init();
+   if(!d_faststart)
+      MN_InitGraphics();
+
+   d_deferredinit = d_faststart;
 
    startupmsg("F_Init", "Init finale.");
    F_Init();
@@ -1747,6 +1861,7 @@ static void D_DoomInit()
    D_AutoExecScripts();
 
    // haleyjd 08/20/07: autoload dir csc's
+   D_StartupPhase("D_GameAutoloadCSC");
    D_GameAutoloadCSC();
 
    // haleyjd 03/10/03: GFS csc's
@@ -1777,9 +1892,13 @@ static void D_DoomInit()
    // check
 
    if(in_textmode)
+   {
+      D_StartupPhase("D_SetGraphicsMode");
       D_SetGraphicsMode();
+   }
 
    // Initialize ACS
+   D_StartupPhase("ACS_Init");
    ACS_Init();
 
    // haleyjd: updated for eternity
@@ -1881,6 +2000,8 @@ static void D_DoomInit()
       singletics = true;
    }
 
+   D_parseMaxSpeed();
+
    if((p = M_CheckParm("-fastdemo")) && ++p < myargc)
    {                                 // killough
       fastdemo = true;                // run at fastest speed possible
@@ -1908,11 +2029,19 @@ static void D_DoomInit()
    }
 
    // IOANCH 20130814: init static bot stuff
+   D_StartupPhase("Bot::InitBots");
    Bot::InitBots();
    PlayerObserver::initObservers();
 
+   // map analyzer: reports on the maps and quits, without saving the
+   // configuration, which the workers share
+   if((p = M_CheckParm("-mapreport")) && p < myargc - 1)
+      _Exit(B_MapReport(myargv[p + 1]));
+
    startlevel = estrdup(G_GetNameForMap(startepisode, startmap));
 
+   D_StartupPhase("G_InitNew");
+
    if(slot && ++slot < myargc)
    {
       char *file = NULL;
@@ -1954,6 +2083,147 @@ static void D_DoomInit()
 
    // a lot of alloca calls are made during startup; kill them all now.
    Z_FreeAlloca();
+
+   D_StartupProfileDone();
+}
+
+//=============================================================================
+//
+// Maximum Speed Loop
+//
+// With -maxspeed the game runs on the virtual clock from i_vtimer and the
+// loop below replaces the paced one: every pass runs exactly one gametic,
+// with no waiting and none of the per-frame work unless the frame is drawn.
+//
+
+static std::chrono::steady_clock::time_point d_maxspeedstart;
+static int  d_maxspeedrun;      // gametics run so far
+static bool d_maxspeedreported;
+
+//
+// D_maxSpeedSeconds
+//
+static double D_maxSpeedSeconds()
+{
+   return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                        d_maxspeedstart).count();
+}
+
+//
+// D_maxSpeedRate
+//
+static double D_maxSpeedRate(double seconds)
+{
+   return seconds > 0 ? d_maxspeedrun / seconds : 0.0;
+}
+
+//
+// D_maxSpeedAtExit
+//
+// atexit handler, so that the rate is reported however the game ends.
+//
+static void D_maxSpeedAtExit()
+{
+   if(d_maxspeedreported)
+      return;
+
+   double seconds = D_maxSpeedSeconds();
+   double rate    = D_maxSpeedRate(seconds);
+
+   printf("Ran %d gametics in %.3f seconds = %.1f tics per second (%.1fx)\n",
+          d_maxspeedrun, seconds, rate, rate / TICRATE);
+}
+
+//
+// D_maxSpeedFinish
+//
+// Quits once the time budget or the demo being played runs out.
+//
+static void D_maxSpeedFinish(const char *reason)
+{
+   double seconds = D_maxSpeedSeconds();
+   double rate    = D_maxSpeedRate(seconds);
+
+   d_maxspeedreported = true;
+   I_ExitWithMessage("%s: ran %d gametics in %.3f seconds = %.1f tics per "
+                     "second (%.1fx)\n", reason, d_maxspeedrun, seconds, rate,
+                     rate / TICRATE);
+}
+
+//
+// D_maxSpeedTic
+//
+// Runs one gametic. Input is only gathered when it can be seen to matter: on
+// drawn frames, or about once a game second otherwise so the window stays
+// responsive.
+//
+static void D_maxSpeedTic(bool draw)
+{
+   if(draw || !(gametic % TICRATE))
+   {
+      I_StartFrame();
+      I_StartTic();
+      D_ProcessEvents();
+   }
+
+   // the menus and fps counter only matter if anything is ever drawn
+   if(d_maxspeedrender)
+   {
+      MN_Ticker();
+      V_FPSTicker();
+   }
+   C_Ticker();
+
+   G_BuildTiccmd(&netcmds[consoleplayer][maketic%BACKUPTICS]);
+   if(advancedemo)
+      D_DoAdvanceDemo();
+   G_Ticker();
+   I_SoundTic();
+   gametic++;
+   maketic++;
+
+   I_VirtualAdvanceTics(1);
+}
+
+//
+// D_MaxSpeedLoop
+//
+static void D_MaxSpeedLoop()
+{
+   bool wasplaying = false;
+
+   d_maxspeedstart = std::chrono::steady_clock::now();
+   atexit(D_maxSpeedAtExit);
+
+   while(1)
+   {
+      bool draw = d_maxspeedrender && !(gametic % d_maxspeedrender);
+
+      D_maxSpeedTic(draw);
+      ++d_maxspeedrun;
+
+      // every tic, so that finished channels are freed for an offline mix
+      S_UpdateSounds(players[displayplayer].mo);
+
+      if(draw)
+      {
+         D_Display();
+         I_UpdateSound();
+         I_SubmitSound();
+      }
+
+      Z_FreeAlloca();
+
+      // a single demo has ended without -timedemo quitting for us
+      if(singledemo && wasplaying && !demoplayback)
+         D_maxSpeedFinish("Demo finished");
+      wasplaying = demoplayback;
+
+      if(d_maxspeedtics && d_maxspeedrun >= d_maxspeedtics)
+         D_maxSpeedFinish("Tic limit reached");
+      if(d_maxspeedbudget > 0 && D_maxSpeedSeconds() >= d_maxspeedbudget)
+         D_maxSpeedFinish("Time budget spent");
+   }
 }
 
 //=============================================================================
@@ -1974,6 +2244,9 @@ void D_DoomMain()
    if(autostart)
       oldgamestate = GS_NOSTATE;
 
+   if(d_maxspeed)
+      D_MaxSpeedLoop();
+
    // killough 12/98: inlined D_DoomLoop
    while(1)
    {
@@ -47,6 +47,8 @@ extern bool clfastparm;    // checkparm of -fast
 extern bool nodrawers;
 extern bool nosfxparm;
 extern bool nomusicparm;
+extern bool d_faststart;
+extern bool d_maxspeed;
 
 inline static bool D_noWindow()
 {
@@ -76,6 +78,7 @@ void D_DoomMain();
 // sf: display a message to the player: either in text mode or graphics
 void usermsg(E_FORMAT_STRING(const char *s), ...);
 void startupmsg(const char *func, const char *desc);
+void D_InitDeferred();
 
 #endif
 
@@ -42,6 +42,7 @@
 #include "g_dmflag.h"
 #include "g_game.h"
 #include "hal/i_timer.h"
+#include "i_sound.h"
 #include "m_random.h"
 #include "mn_engin.h"
 #include "i_net.h"
@@ -733,6 +734,7 @@ static bool RunGameTics()
       if(advancedemo)
          D_DoAdvanceDemo();
       G_Ticker();
+      I_SoundTic();
       gametic++;
       maketic++;
       return true;
@@ -776,6 +778,7 @@ static bool RunGameTics()
             D_DoAdvanceDemo();
          i_haltimer.SaveMS();
          G_Ticker();
+         I_SoundTic();
          gametic++;
          
          // modify command for duplicated tics
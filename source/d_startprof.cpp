@@ -0,0 +1,173 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: startup time profiler.
+//
+// Records the wall time spent in each phase of engine initialization. Phases
+// are delimited by calls to D_StartupPhase, most of them made through
+// startupmsg. Nothing here allocates: it runs before the zone heap exists.
+//
+
+#include <algorithm>
+#include <chrono>
+
+#include "z_zone.h"
+#include "d_main.h"
+#include "d_startprof.h"
+#include "m_argv.h"
+
+#define MAXSTARTUPPHASES 64
+
+struct startphase_t
+{
+   const char *name;
+   int64_t     start; // microseconds since profiling began, first entry
+   int64_t     time;  // total microseconds spent in this phase
+};
+
+static startphase_t startPhases[MAXSTARTUPPHASES];
+static int          numStartPhases;
+static startphase_t *curStartPhase;
+
+static std::chrono::steady_clock::time_point startupBegin;
+static int64_t      phaseBegin;
+static bool         startupDone;
+
+//
+// D_startupClock
+//
+// Microseconds since the first phase began.
+//
+static int64_t D_startupClock()
+{
+   return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - startupBegin).count();
+}
+
+//
+// D_endStartupPhase
+//
+static void D_endStartupPhase()
+{
+   int64_t now = D_startupClock();
+
+   if(curStartPhase)
+      curStartPhase->time += now - phaseBegin;
+   curStartPhase = nullptr;
+   phaseBegin    = now;
+}
+
+//
+// D_StartupPhase
+//
+void D_StartupPhase(const char *name)
+{
+   if(startupDone)
+      return;
+
+   if(!numStartPhases && !curStartPhase)
+      startupBegin = std::chrono::steady_clock::now();
+
+   D_endStartupPhase();
+
+   for(int i = 0; i < numStartPhases; i++)
+   {
+      if(!strcmp(startPhases[i].name, name))
+      {
+         curStartPhase = &startPhases[i];
+         return;
+      }
+   }
+
+   // out of slots: charge the remaining time to the last phase
+   if(numStartPhases == MAXSTARTUPPHASES)
+   {
+      curStartPhase = &startPhases[numStartPhases - 1];
+      return;
+   }
+
+   curStartPhase = &startPhases[numStartPhases++];
+   curStartPhase->name  = name;
+   curStartPhase->start = phaseBegin;
+   curStartPhase->time  = 0;
+}
+
+//
+// D_writeStartupJSON
+//
+static void D_writeStartupJSON(const char *filename, int64_t total)
+{
+   FILE *f;
+
+   if(!(f = fopen(filename, "w")))
+   {
+      usermsg("D_StartupProfileDone: could not write %s\n", filename);
+      return;
+   }
+
+   fprintf(f, "{\n  \"total_ms\": %.3f,\n  \"phases\": [\n", total / 1000.0);
+   for(int i = 0; i < numStartPhases; i++)
+   {
+      fprintf(f, "    { \"name\": \"%s\", \"start_ms\": %.3f, \"ms\": %.3f }%s\n",
+              startPhases[i].name, startPhases[i].start / 1000.0,
+              startPhases[i].time / 1000.0, i + 1 < numStartPhases ? "," : "");
+   }
+   fputs("  ]\n}\n", f);
+   fclose(f);
+}
+
+//
+// D_StartupProfileDone
+//
+void D_StartupProfileDone()
+{
+   int p;
+
+   if(startupDone)
+      return;
+
+   D_endStartupPhase();
+   startupDone = true;
+
+   int64_t total = phaseBegin;
+
+   if((p = M_CheckParm("-profilejson")) && p < myargc - 1)
+      D_writeStartupJSON(myargv[p + 1], total);
+
+   if(!M_CheckParm("-profilestartup"))
+      return;
+
+   startphase_t ranked[MAXSTARTUPPHASES];
+   std::copy(startPhases, startPhases + numStartPhases, ranked);
+   std::stable_sort(ranked, ranked + numStartPhases,
+                    [] (const startphase_t &a, const startphase_t &b) {
+      return a.time > b.time;
+   });
+
+   usermsg("Startup profile: %.1f ms total", total / 1000.0);
+   for(int i = 0; i < numStartPhases; i++)
+   {
+      usermsg("%8.1f ms %5.1f%%  %s", ranked[i].time / 1000.0,
+              total ? 100.0 * ranked[i].time / total : 0.0, ranked[i].name);
+   }
+}
+
+// EOF
+
@@ -0,0 +1,38 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: startup time profiler.
+//
+
+#ifndef D_STARTPROF_H__
+#define D_STARTPROF_H__
+
+// Ends the current startup phase and begins a new one. name must be a string
+// with static storage duration; phases with the same name are summed.
+void D_StartupPhase(const char *name);
+
+// Ends the last phase and, if requested on the command line, prints the
+// ranked breakdown (-profilestartup) and/or writes it as JSON (-profilejson).
+void D_StartupProfileDone();
+
+#endif
+
+// EOF
+
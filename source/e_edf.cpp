@@ -101,6 +101,7 @@
 
 #include "e_anim.h"
 #include "e_args.h"
+#include "e_edfcache.h"
 #include "e_fonts.h"
 #include "e_gameprops.h"
 #include "e_inventory.h"
@@ -560,6 +561,7 @@ static int bex_include(cfg_t *cfg, cfg_opt_t *opt, int argc,
 
    // queue the file for later processing
    D_QueueDEH(filename, 0);
+   E_EDFCacheAddDEH(filename);
 
    return 0;
 }
@@ -1759,7 +1761,14 @@ void E_ProcessEDF(const char *filename)
    // haleyjd 03/21/10: All parsing is now streamlined into a single process,
    // using the unified cfg_t object created above.
    //
-   E_ParseEDF(cfg, filename);
+   // The parse is skipped when the same sources were parsed by an earlier
+   // run, and the tree it produced is in the EDF cache.
+   //
+   if(!E_EDFCacheLoad(cfg, filename, edf_enables))
+   {
+      E_ParseEDF(cfg, filename);
+      E_EDFCacheParsed(cfg, edf_enables);
+   }
 
    //
    // Processing
@@ -1768,6 +1777,9 @@ void E_ProcessEDF(const char *filename)
    //
    E_DoEDFProcessing(cfg, true);
 
+   // processing errors are fatal, so only a good parse is ever cached
+   E_EDFCacheSave();
+
    //
    // Shutdown and Cleanup
    //
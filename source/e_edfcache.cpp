@@ -0,0 +1,677 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: persistent cache of the parsed EDF tree.
+//
+// Parsing root.edf and everything it includes is a large part of startup.
+// The result of the parse, the libConfuse tree after all includes and
+// conditionals, is written to a file keyed by the wad directory, the game
+// mode and the root file. Each source read by the parse is recorded with its
+// SHA-1, so a later run only has to hash the same sources again to know that
+// the tree can be read from the cache instead. Processing of the tree into
+// things, frames, weapons and the rest is unchanged.
+//
+// Value callbacks are run during the parse and only their results are
+// stored, so they must depend on nothing but their input and the resources
+// covered by the key.
+//
+
+#include <vector>
+
+#include "z_zone.h"
+#include "hal/i_directory.h"
+#include "hal/i_process.h"
+
+#include "Confuse/confuse.h"
+#include "Confuse/lexer.h"
+
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "d_dehtbl.h"
+#include "d_gi.h"
+#include "d_io.h"
+#include "d_main.h"
+#include "doomstat.h"
+#include "e_edf.h"
+#include "e_edfcache.h"
+#include "e_lib.h"
+#include "m_argv.h"
+#include "m_hash.h"
+#include "m_qstr.h"
+#include "m_utils.h"
+#include "w_wad.h"
+
+// Bump whenever the layout, or the output of any value callback, changes.
+#define EDFCACHE_MAGIC   "EEEDF001"
+#define EDFCACHE_VERSION 1
+
+#define EDFCACHE_MAXSIZE 0x7fffffffu
+
+bool e_edfcache = true;
+
+struct edfcacheheader_t
+{
+   char     magic[8]; // EDFCACHE_MAGIC
+   uint32_t key[5];   // SHA-1 of wad directory, game mode, root and version
+   uint32_t fileSize; // total size, for truncation checks
+};
+
+enum
+{
+   EDFINPUT_FILE,    // a file that was parsed or declined as a duplicate
+   EDFINPUT_LUMP,    // likewise for a lump
+   EDFINPUT_MISSING, // a userinclude() file that did not exist
+};
+
+struct edfcacheinput_t
+{
+   int      kind;
+   bool     accepted;   // if false, declined as a duplicate
+   qstring  name;
+   int      lumpnum;
+   uint32_t digest[5];
+};
+
+//
+// State of the current E_ProcessEDF call
+//
+static bool                          edfRecording;
+static uint32_t                      edfKey[5];
+static std::vector<edfcacheinput_t>  edfInputs;
+static std::vector<qstring>          edfDEHs;
+static std::vector<byte>             edfImage;   // file to be written
+static cfg_t                        *edfVerify;  // tree loaded for comparison
+
+//=============================================================================
+//
+// Keys and Paths
+//
+
+static bool E_edfCacheEnabled()
+{
+   return e_edfcache && !M_CheckParm("-noedfcache");
+}
+
+//
+// E_edfCacheKey
+//
+// Hashes everything that selects which sources the parse reads, and how.
+// The sources themselves are checked one by one when loading.
+//
+static void E_edfCacheKey(const char *filename, E_Enable_t *enables)
+{
+   HashData hash(HashData::SHA1);
+   int32_t  extra[4];
+
+   wGlobalDir.hashContents(hash);
+
+   extra[0] = GameModeInfo->type;
+   extra[1] = GameModeInfo->id;
+   extra[2] = GameModeInfo->missionInfo->id;
+   extra[3] = EDFCACHE_VERSION;
+   hash.addData(reinterpret_cast<const uint8_t *>(extra), sizeof(extra));
+
+   if(filename)
+   {
+      hash.addData(reinterpret_cast<const uint8_t *>(filename),
+                   static_cast<uint32_t>(strlen(filename) + 1));
+   }
+
+   // initial enable values select the conditional sections
+   for(E_Enable_t *enable = enables; enable->name; enable++)
+   {
+      int32_t value = enable->enabled;
+      hash.addData(reinterpret_cast<const uint8_t *>(&value), sizeof(value));
+   }
+
+   hash.wrapUp();
+
+   for(int i = 0; i < 5; i++)
+      edfKey[i] = hash.getDigestPart(i);
+}
+
+//
+// E_edfCachePath
+//
+static void E_edfCachePath(qstring &path, bool create)
+{
+   path = userpath;
+   path.pathConcatenate("cache");
+   if(create)
+      I_CreateDirectory(path);
+
+   qstring name;
+   name.Printf(0, "edf-%08x%08x%08x%08x%08x.cache",
+               edfKey[0], edfKey[1], edfKey[2], edfKey[3], edfKey[4]);
+   path.pathConcatenate(name.constPtr());
+}
+
+//
+// E_edfCacheReset
+//
+static void E_edfCacheReset()
+{
+   edfRecording = false;
+   edfInputs.clear();
+   edfDEHs.clear();
+   edfImage.clear();
+   if(edfVerify)
+   {
+      cfg_free(edfVerify);
+      edfVerify = NULL;
+   }
+}
+
+//=============================================================================
+//
+// Recording
+//
+
+//
+// E_EDFCacheAddInput
+//
+// Called for every EDF source opened by the parse, whether it was accepted
+// or declined as a duplicate.
+//
+void E_EDFCacheAddInput(const char *filename, int lumpnum, const char *data,
+                        size_t size, bool accepted)
+{
+   if(!edfRecording)
+      return;
+
+   HashData hash(HashData::SHA1, reinterpret_cast<const uint8_t *>(data),
+                 static_cast<uint32_t>(size));
+   edfcacheinput_t input;
+
+   input.kind     = lumpnum >= 0 ? EDFINPUT_LUMP : EDFINPUT_FILE;
+   input.accepted = accepted;
+   input.name     = filename ? filename : "";
+   input.lumpnum  = lumpnum;
+   for(int i = 0; i < 5; i++)
+      input.digest[i] = hash.getDigestPart(i);
+
+   edfInputs.push_back(input);
+}
+
+//
+// E_EDFCacheAddMissing
+//
+void E_EDFCacheAddMissing(const char *filename)
+{
+   if(!edfRecording)
+      return;
+
+   edfcacheinput_t input;
+
+   input.kind     = EDFINPUT_MISSING;
+   input.accepted = false;
+   input.name     = filename;
+   input.lumpnum  = -1;
+   memset(input.digest, 0, sizeof(input.digest));
+
+   edfInputs.push_back(input);
+}
+
+//
+// E_EDFCacheAddDEH
+//
+// bexinclude() queues DeHackEd files as it is parsed; a cached load must
+// queue them again.
+//
+void E_EDFCacheAddDEH(const char *filename)
+{
+   if(edfRecording)
+      edfDEHs.push_back(qstring(filename));
+}
+
+//=============================================================================
+//
+// File Image
+//
+
+//
+// EDFCacheWriter
+//
+class EDFCacheWriter
+{
+protected:
+   std::vector<byte> &buffer;
+
+public:
+   explicit EDFCacheWriter(std::vector<byte> &pBuffer) : buffer(pBuffer) {}
+
+   void write(const void *src, size_t len)
+   {
+      const byte *bsrc = static_cast<const byte *>(src);
+      buffer.insert(buffer.end(), bsrc, bsrc + len);
+   }
+   void writeU32(uint32_t u) { write(&u, sizeof(u)); }
+   void writeString(const qstring &str)
+   {
+      writeU32(static_cast<uint32_t>(str.length()));
+      write(str.constPtr(), str.length());
+   }
+
+   static void WriteFunc(void *ctx, const void *data, size_t len)
+   {
+      static_cast<EDFCacheWriter *>(ctx)->write(data, len);
+   }
+};
+
+//
+// EDFCacheReader
+//
+// Bounds-checked cursor over a loaded file.
+//
+class EDFCacheReader
+{
+protected:
+   const byte *data;
+   size_t      size;
+   size_t      pos;
+
+public:
+   EDFCacheReader(const byte *pData, size_t pSize)
+      : data(pData), size(pSize), pos(0)
+   {
+   }
+
+   bool read(void *dest, size_t len)
+   {
+      if(len > size - pos)
+         return false;
+      memcpy(dest, data + pos, len);
+      pos += len;
+      return true;
+   }
+   bool readU32(uint32_t &u) { return read(&u, sizeof(u)); }
+   bool readString(qstring &str)
+   {
+      uint32_t len;
+      if(!readU32(len) || len > size - pos)
+         return false;
+      str.copy(reinterpret_cast<const char *>(data + pos), len);
+      pos += len;
+      return true;
+   }
+   bool skip(size_t len)
+   {
+      if(len > size - pos)
+         return false;
+      pos += len;
+      return true;
+   }
+
+   const byte *current() const { return data + pos; }
+};
+
+//
+// E_edfCacheBuildImage
+//
+// Lays out the cache file for the parse just recorded.
+//
+static void E_edfCacheBuildImage(cfg_t *cfg, E_Enable_t *enables)
+{
+   EDFCacheWriter   writer(edfImage);
+   edfcacheheader_t hdr;
+   uint32_t         numenables = 0;
+
+   edfImage.clear();
+
+   memset(&hdr, 0, sizeof(hdr));
+   memcpy(hdr.magic, EDFCACHE_MAGIC, sizeof(hdr.magic));
+   memcpy(hdr.key, edfKey, sizeof(hdr.key));
+   writer.write(&hdr, sizeof(hdr));
+
+   writer.writeU32(static_cast<uint32_t>(edfInputs.size()));
+   for(const edfcacheinput_t &input : edfInputs)
+   {
+      int32_t fields[3] = { input.kind, input.accepted, input.lumpnum };
+
+      writer.write(fields, sizeof(fields));
+      writer.writeString(input.name);
+      writer.write(input.digest, sizeof(input.digest));
+   }
+
+   writer.writeU32(static_cast<uint32_t>(edfDEHs.size()));
+   for(const qstring &deh : edfDEHs)
+      writer.writeString(deh);
+
+   // final enable values, as changed by enable() and disable()
+   while(enables[numenables].name)
+      ++numenables;
+   writer.writeU32(numenables);
+   for(uint32_t i = 0; i < numenables; i++)
+   {
+      int32_t value = enables[i].enabled;
+      writer.writeString(qstring(enables[i].name));
+      writer.write(&value, sizeof(value));
+   }
+
+   size_t treeOffset = edfImage.size();
+   writer.writeU32(0);
+   cfg_serialize(cfg, EDFCacheWriter::WriteFunc, &writer);
+
+   uint32_t treeSize = static_cast<uint32_t>(edfImage.size() - treeOffset - 4);
+   memcpy(&edfImage[treeOffset], &treeSize, sizeof(treeSize));
+
+   if(edfImage.size() > EDFCACHE_MAXSIZE)
+   {
+      edfImage.clear();
+      return;
+   }
+
+   auto whdr = reinterpret_cast<edfcacheheader_t *>(edfImage.data());
+   whdr->fileSize = static_cast<uint32_t>(edfImage.size());
+}
+
+//=============================================================================
+//
+// Loading
+//
+
+//
+// E_edfCacheCheckInput
+//
+// Returns true if a recorded source still has the same contents. The hash is
+// returned for accepted sources, so that they can be marked as included.
+//
+static bool E_edfCacheCheckInput(const edfcacheinput_t &input, HashData &hash)
+{
+   char  *data;
+   size_t len;
+
+   if(input.kind == EDFINPUT_MISSING)
+      return access(input.name.constPtr(), R_OK) != 0;
+
+   if(input.kind == EDFINPUT_LUMP &&
+      (input.lumpnum < 0 || input.lumpnum >= wGlobalDir.getNumLumps()))
+      return false;
+
+   if(!(data = cfg_lexer_open(input.name.constPtr(), input.lumpnum, &len)))
+      return false;
+
+   hash.initialize(HashData::SHA1);
+   hash.addData(reinterpret_cast<const uint8_t *>(data), static_cast<uint32_t>(len));
+   hash.wrapUp();
+   efree(data);
+
+   for(int i = 0; i < 5; i++)
+   {
+      if(hash.getDigestPart(i) != input.digest[i])
+         return false;
+   }
+
+   return true;
+}
+
+//
+// E_edfCacheReadFile
+//
+// Reads the cache file for the current key, checking the header.
+//
+static bool E_edfCacheReadFile(std::vector<byte> &file)
+{
+   edfcacheheader_t hdr;
+   qstring          path;
+   FILE            *f;
+
+   E_edfCachePath(path, false);
+
+   if(!(f = fopen(path.constPtr(), "rb")))
+      return false;
+
+   bool ok = false;
+   if(fread(&hdr, sizeof(hdr), 1, f) == 1 &&
+      !memcmp(hdr.magic, EDFCACHE_MAGIC, sizeof(hdr.magic)) &&
+      !memcmp(hdr.key, edfKey, sizeof(edfKey)) &&
+      hdr.fileSize >= sizeof(hdr) && hdr.fileSize <= EDFCACHE_MAXSIZE)
+   {
+      file.resize(hdr.fileSize);
+      memcpy(file.data(), &hdr, sizeof(hdr));
+      ok = fread(file.data() + sizeof(hdr), 1, hdr.fileSize - sizeof(hdr), f) ==
+           hdr.fileSize - sizeof(hdr);
+   }
+   fclose(f);
+
+   return ok;
+}
+
+//
+// E_edfCacheLoadTree
+//
+// Checks every source recorded in a cache file and reads its tree into cfg.
+// The parse side effects are returned for the caller to apply.
+//
+static bool E_edfCacheLoadTree(const std::vector<byte> &file, cfg_t *cfg,
+                               std::vector<HashData> &includes,
+                               std::vector<qstring> &dehs,
+                               E_Enable_t *enables, std::vector<int> &enablevals)
+{
+   EDFCacheReader reader(file.data(), file.size());
+   uint32_t       count, treeSize;
+
+   if(!reader.skip(sizeof(edfcacheheader_t)) || !reader.readU32(count))
+      return false;
+
+   for(uint32_t i = 0; i < count; i++)
+   {
+      edfcacheinput_t input;
+      int32_t         fields[3];
+      HashData        hash;
+
+      if(!reader.read(fields, sizeof(fields)) || !reader.readString(input.name) ||
+         !reader.read(input.digest, sizeof(input.digest)))
+         return false;
+
+      input.kind     = fields[0];
+      input.accepted = !!fields[1];
+      input.lumpnum  = fields[2];
+
+      if(!E_edfCacheCheckInput(input, hash))
+         return false;
+      if(input.accepted)
+         includes.push_back(hash);
+   }
+
+   if(!reader.readU32(count))
+      return false;
+   for(uint32_t i = 0; i < count; i++)
+   {
+      qstring deh;
+      if(!reader.readString(deh))
+         return false;
+      dehs.push_back(deh);
+   }
+
+   if(!reader.readU32(count))
+      return false;
+   for(uint32_t i = 0; i < count; i++)
+   {
+      qstring name;
+      int32_t value;
+
+      if(!reader.readString(name) || !reader.read(&value, sizeof(value)) ||
+         !enables[i].name || name != enables[i].name)
+         return false;
+      enablevals.push_back(value);
+   }
+   if(enables[count].name)
+      return false;
+
+   if(!reader.readU32(treeSize) || treeSize != file.size() - (reader.current() - file.data()))
+      return false;
+
+   return cfg_deserialize(cfg, reader.current(), treeSize);
+}
+
+//
+// E_EDFCacheLoad
+//
+bool E_EDFCacheLoad(cfg_t *cfg, const char *filename, E_Enable_t *enables)
+{
+   std::vector<byte>     file;
+   std::vector<HashData> includes;
+   std::vector<qstring>  dehs;
+   std::vector<int>      enablevals;
+
+   E_edfCacheReset();
+
+   if(!E_edfCacheEnabled())
+      return false;
+
+   E_edfCacheKey(filename, enables);
+   edfRecording = true;
+
+   if(!E_edfCacheReadFile(file))
+      return false;
+
+   // -edfcacheverify: load into a separate tree and parse anyway
+   bool   verify = !!M_CheckParm("-edfcacheverify");
+   cfg_t *target = verify ? (edfVerify = cfg_init_copy(cfg)) : cfg;
+
+   if(!E_edfCacheLoadTree(file, target, includes, dehs, enables, enablevals))
+   {
+      // free any values read before the failure
+      if(verify)
+      {
+         cfg_free(edfVerify);
+         edfVerify = NULL;
+      }
+      else
+      {
+         for(int i = 0; cfg->opts[i].name; i++)
+            cfg_free_value(&cfg->opts[i]);
+      }
+      E_EDFLogPuts("\t* EDF cache is out of date\n");
+      return false;
+   }
+
+   if(verify)
+      return false;
+
+   // apply the side effects of the original parse
+   for(const HashData &hash : includes)
+      E_CheckIncludeHash(hash);
+   for(const qstring &deh : dehs)
+      D_QueueDEH(deh.constPtr(), 0);
+   for(size_t i = 0; i < enablevals.size(); i++)
+      enables[i].enabled = enablevals[i];
+
+   edfRecording = false;
+   E_EDFLogPuts("\t* Loaded parsed EDF from cache\n");
+   return true;
+}
+
+//=============================================================================
+//
+// Saving and Verification
+//
+
+//
+// E_edfCacheRoundTrip
+//
+// Reads the tree just written back into a separate tree and compares it
+// with the parse result, so that -edfcacheverify also checks serialization
+// when there is no older cache to compare with.
+//
+static bool E_edfCacheRoundTrip(cfg_t *cfg, qstring &diff)
+{
+   std::vector<byte> tree;
+   EDFCacheWriter    writer(tree);
+   cfg_t            *copy = cfg_init_copy(cfg);
+
+   cfg_serialize(cfg, EDFCacheWriter::WriteFunc, &writer);
+
+   bool ok = cfg_deserialize(copy, tree.data(), tree.size());
+   if(!ok)
+      diff = "deserialization failed";
+   else
+      ok = cfg_compare(cfg, copy, diff);
+
+   cfg_free(copy);
+   return ok;
+}
+
+//
+// E_EDFCacheParsed
+//
+void E_EDFCacheParsed(cfg_t *cfg, E_Enable_t *enables)
+{
+   if(!edfRecording)
+      return;
+   edfRecording = false;
+
+   E_edfCacheBuildImage(cfg, enables);
+
+   if(!M_CheckParm("-edfcacheverify"))
+      return;
+
+   qstring diff;
+
+   if(!E_edfCacheRoundTrip(cfg, diff))
+      usermsg("EDF cache: round trip failed at %s", diff.constPtr());
+   else if(!edfVerify)
+      usermsg("EDF cache: round trip ok, no current cache to compare with");
+   else if(!cfg_compare(cfg, edfVerify, diff))
+      usermsg("EDF cache: cached tree differs from parse at %s", diff.constPtr());
+   else
+      usermsg("EDF cache: cached tree matches parse");
+}
+
+//
+// E_EDFCacheSave
+//
+// The file is written under a temporary name and renamed into place, as for
+// the texture cache.
+//
+void E_EDFCacheSave()
+{
+   qstring path, tmppath;
+
+   if(edfImage.empty())
+   {
+      E_edfCacheReset();
+      return;
+   }
+
+   E_edfCachePath(path, true);
+   tmppath.Printf(0, "%s.%d.tmp", path.constPtr(), I_GetProcessID());
+
+   if(M_WriteFile(tmppath.constPtr(), edfImage.data(), edfImage.size()))
+   {
+      remove(path.constPtr());
+      if(rename(tmppath.constPtr(), path.constPtr()))
+         remove(tmppath.constPtr());
+   }
+
+   E_edfCacheReset();
+}
+
+//=============================================================================
+//
+// Console Variables
+//
+
+VARIABLE_TOGGLE(e_edfcache, NULL, onoff);
+CONSOLE_VARIABLE(e_edfcache, e_edfcache, 0) {}
+
+// EOF
+
@@ -0,0 +1,55 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: persistent cache of the parsed EDF tree.
+//
+
+#ifndef E_EDFCACHE_H__
+#define E_EDFCACHE_H__
+
+struct cfg_t;
+struct E_Enable_s;
+
+// Fills cfg from a cache matching the current resources and returns true,
+// replaying the side effects of the original parse. Otherwise returns false
+// and starts recording the inputs of the parse that must follow.
+bool E_EDFCacheLoad(cfg_t *cfg, const char *filename, E_Enable_s *enables);
+
+// Called once the parse that follows a failed E_EDFCacheLoad has finished.
+// Prepares the cache file, and checks it against the old one under
+// -edfcacheverify.
+void E_EDFCacheParsed(cfg_t *cfg, E_Enable_s *enables);
+
+// Writes out the cache prepared by E_EDFCacheParsed, if any. Called only
+// after the parsed EDF was processed without error.
+void E_EDFCacheSave();
+
+// Parse-time hooks; these do nothing unless a parse is being recorded.
+void E_EDFCacheAddInput(const char *filename, int lumpnum, const char *data,
+                        size_t size, bool accepted);
+void E_EDFCacheAddMissing(const char *filename);
+void E_EDFCacheAddDEH(const char *filename);
+
+extern bool e_edfcache;
+
+#endif
+
+// EOF
+
@@ -34,6 +34,7 @@
 
 #include "e_lib.h"
 #include "e_edf.h"
+#include "e_edfcache.h"
 
 #include "autopalette.h"
 #include "d_dehtbl.h"
@@ -89,7 +90,6 @@ static Collection<HashData> eincludes;
 //
 bool E_CheckInclude(const char *data, size_t size)
 {
-   size_t numincludes;
    char *digest;
    
    // calculate the SHA-1 hash of the data   
@@ -102,7 +102,18 @@ bool E_CheckInclude(const char *data, size_t size)
 
    efree(digest);
 
-   numincludes = eincludes.getLength();
+   return E_CheckIncludeHash(newHash);
+}
+
+//
+// E_CheckIncludeHash
+//
+// As above, for a data source that has already been hashed. The EDF cache
+// uses this to account for the sources behind a cached parse.
+//
+bool E_CheckIncludeHash(const HashData &newHash)
+{
+   size_t numincludes = eincludes.getLength();
 
    // compare against existing includes
    for(size_t i = 0; i < numincludes; i++)
@@ -147,7 +158,11 @@ static int E_OpenAndCheckInclude(cfg_t *cfg, const char *fn, int lumpnum)
    if((data = cfg_lexer_mustopen(cfg, fn, lumpnum, &len)))
    {
       // see if we already parsed this data source
-      if(E_CheckInclude(data, len))
+      bool accepted = E_CheckInclude(data, len);
+
+      E_EDFCacheAddInput(fn, lumpnum, data, len, accepted);
+
+      if(accepted)
          code = cfg_lexer_include(cfg, data, fn, lumpnum);
       else
       {
@@ -204,7 +219,11 @@ static int E_FindLumpInclude(cfg_t *src, const char *name)
 //
 int E_CheckRoot(cfg_t *cfg, const char *data, int size)
 {
-   return !E_CheckInclude(data, (size_t)size);
+   bool accepted = E_CheckInclude(data, (size_t)size);
+
+   E_EDFCacheAddInput(cfg->filename, cfg->lumpnum, data, (size_t)size, accepted);
+
+   return !accepted;
 }
 
 //=============================================================================
@@ -447,7 +466,14 @@ int E_UserInclude(cfg_t *cfg, cfg_opt_t *opt, int argc, const char **argv)
 
    filename = E_BuildDefaultFn(argv[0]);
 
-   return !access(filename, R_OK) ? E_OpenAndCheckInclude(cfg, filename, -1) : 0;
+   if(access(filename, R_OK))
+   {
+      // the cache must notice if the file appears later
+      E_EDFCacheAddMissing(filename);
+      return 0;
+   }
+
+   return E_OpenAndCheckInclude(cfg, filename, -1);
 }
 
 //=============================================================================
@@ -58,9 +58,12 @@
 #include "d_io.h"
 #include "d_dehtbl.h"
 #include "i_sound.h"
+#include "m_collection.h"
 #include "m_utils.h"
 #include "p_mobj.h"
 #include "p_skin.h"
+#include "s_formats.h"
+#include "s_mixer.h"
 #include "s_sndseq.h"
 #include "s_sound.h"
 #include "w_wad.h"
@@ -460,16 +463,24 @@ sfxinfo_t *E_NewSndInfoSound(const char *mnemonic, const char *name)
 //
 void E_PreCacheSounds()
 {
+   PODCollection<sfxinfo_t *> allsfx;
+
    // run down all the mnemonic hash chains so that we precache
    // all sounds, not just ones stored in S_sfx
    for(sfxinfo_t *cursfx : sfxchains)
    {
       while(cursfx)
       {
-         I_CacheSound(cursfx);
+         allsfx.add(cursfx);
          cursfx = cursfx->next;
       }
    }
+
+   // inflate any archived sound lumps in bulk before caching them
+   S_PrefetchDigitalSoundLumps(allsfx.begin(), allsfx.getLength());
+
+   for(sfxinfo_t *sfx : allsfx)
+      I_CacheSound(sfx);
 }
 
 //
@@ -480,8 +491,10 @@ void E_PreCacheSounds()
 //
 void E_UpdateSoundCache()
 {
-   // be sure all sounds are stopped
+   // be sure all sounds are stopped, and that the driver is done with them
    S_StopSounds(true);
+   I_WaitSoundCommands();
+   S_FlushResampledSounds();
 
    for(sfxinfo_t *cursfx : sfxchains)
    {
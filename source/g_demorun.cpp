@@ -0,0 +1,398 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: parallel demo regression runner.
+//
+// -demorunner <manifest> plays a corpus of demos on a pool of worker 
+// processes (-jobs, default one per core) and checks each against its 
+// expected end state. Each line of the manifest holds a demo path, relative
+// to the manifest, followed by the expected final tic, kills, items, 
+// secrets and state checksum (hex, see g_demosum.cpp); "-" skips a check 
+// and # starts a comment. -demorunout <file> writes the actual results in
+// the same format, to be used as the baseline for later runs.
+//
+// Workers are this program, given the runner's other arguments plus 
+// -playdemo, -nodraw -nosound and -demoresult <file>. They play the demo 
+// as fast as possible, with no window, and write its end state to file.
+//
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "z_zone.h"
+#include "d_io.h"
+#include "d_main.h"
+#include "doomstat.h"
+#include "g_demorun.h"
+#include "g_demosum.h"
+#include "g_game.h"
+#include "hal/i_process.h"
+#include "m_argv.h"
+#include "m_ctype.h"
+#include "m_qstr.h"
+#include "m_utils.h"
+
+enum
+{
+   DRF_TIC,
+   DRF_KILLS,
+   DRF_ITEMS,
+   DRF_SECRETS,
+   DRF_CHECKSUM,
+   DRF_NUMFIELDS
+};
+
+static const char *const demoRunFieldNames[DRF_NUMFIELDS] =
+{
+   "tic", "kills", "items", "secrets", "checksum"
+};
+
+struct demorunentry_t
+{
+   qstring  name;                   // as given in the manifest
+   qstring  path;                   // resolved path
+   bool     check[DRF_NUMFIELDS];   // which fields are expected
+   uint32_t expect[DRF_NUMFIELDS];
+   bool     ran;                    // worker wrote a result
+   uint32_t actual[DRF_NUMFIELDS];
+   int      exitcode;
+   double   ms;                     // wall time of the worker
+};
+
+//
+// G_demoRunPrint
+//
+// Formats a field the way the manifest holds it.
+//
+static void G_demoRunPrint(qstring &out, int field, uint32_t value)
+{
+   if(field == DRF_CHECKSUM)
+      out.Printf(0, "%08x", value);
+   else
+      out.Printf(0, "%d", static_cast<int>(value));
+}
+
+//
+// G_demoRunReadManifest
+//
+static bool G_demoRunReadManifest(const char *manifest, 
+                                  std::vector<demorunentry_t> &entries)
+{
+   char *text, *line, *rover;
+   char  dir[PATH_MAX + 1];
+
+   if(!(text = M_LoadStringFromFile(manifest)))
+      return false;
+
+   M_GetFilePath(manifest, dir, sizeof(dir));
+
+   for(line = text; line && *line; line = rover)
+   {
+      std::vector<qstring> tokens;
+
+      if((rover = strchr(line, '\n')))
+         *rover++ = '\0';
+
+      for(char *p = line; *p && *p != '#'; )
+      {
+         if(ectype::isSpace(*p))
+         {
+            ++p;
+            continue;
+         }
+         char *start = p;
+         while(*p && *p != '#' && !ectype::isSpace(*p))
+            ++p;
+         tokens.emplace_back();
+         tokens.back().copy(start, p - start);
+      }
+
+      if(tokens.empty())
+         continue;
+
+      demorunentry_t entry;
+      entry.name = tokens[0];
+      if(tokens[0][0] == '/' || tokens[0][0] == '\\' || tokens[0].findFirstOf(':') != qstring::npos)
+         entry.path = tokens[0];
+      else
+      {
+         entry.path = dir;
+         entry.path.pathConcatenate(tokens[0].constPtr());
+      }
+
+      for(int f = 0; f < DRF_NUMFIELDS; f++)
+      {
+         const char *tok = size_t(f + 1) < tokens.size() ? tokens[f + 1].constPtr() : "-";
+
+         entry.check[f]  = strcmp(tok, "-") != 0;
+         entry.expect[f] = entry.check[f] ? 
+            static_cast<uint32_t>(strtoul(tok, nullptr, f == DRF_CHECKSUM ? 16 : 10)) : 0;
+      }
+      entry.ran      = false;
+      entry.exitcode = 0;
+      entry.ms       = 0.0;
+      entries.push_back(entry);
+   }
+
+   efree(text);
+   return true;
+}
+
+//
+// G_demoRunReadResult
+//
+static bool G_demoRunReadResult(const char *path, demorunentry_t &entry)
+{
+   FILE *f;
+   bool  ok;
+
+   if(!(f = fopen(path, "r")))
+      return false;
+   ok = fscanf(f, "tic %u kills %u items %u secrets %u checksum %x",
+               &entry.actual[DRF_TIC], &entry.actual[DRF_KILLS], 
+               &entry.actual[DRF_ITEMS], &entry.actual[DRF_SECRETS],
+               &entry.actual[DRF_CHECKSUM]) == DRF_NUMFIELDS;
+   fclose(f);
+   return ok;
+}
+
+//
+// G_demoRunReport
+//
+// Prints the outcome of one demo; returns true if it passed.
+//
+static bool G_demoRunReport(const demorunentry_t &entry)
+{
+   qstring problems, expected, actual;
+
+   if(!entry.ran)
+   {
+      if(entry.exitcode)
+         problems.Printf(0, " exited with status %d", entry.exitcode);
+      else
+         problems = " left no result";
+   }
+   else
+   {
+      for(int f = 0; f < DRF_NUMFIELDS; f++)
+      {
+         if(!entry.check[f] || entry.actual[f] == entry.expect[f])
+            continue;
+         G_demoRunPrint(expected, f, entry.expect[f]);
+         G_demoRunPrint(actual, f, entry.actual[f]);
+         problems << " " << demoRunFieldNames[f] << " " << actual << " (expected "
+                  << expected << ")";
+      }
+   }
+
+   usermsg("%s %9.1f ms  %s%s", problems.empty() ? "PASS" : "FAIL", entry.ms, 
+           entry.name.constPtr(), problems.constPtr());
+
+   return problems.empty();
+}
+
+//
+// G_demoRunWriteResults
+//
+static void G_demoRunWriteResults(const char *path, 
+                                  const std::vector<demorunentry_t> &entries)
+{
+   FILE *f;
+
+   if(!(f = fopen(path, "w")))
+   {
+      usermsg("G_DemoRunCorpus: cannot write %s", path);
+      return;
+   }
+
+   fputs("# demo tic kills items secrets checksum\n", f);
+   for(const demorunentry_t &entry : entries)
+   {
+      fputs(entry.name.constPtr(), f);
+      for(int f2 = 0; f2 < DRF_NUMFIELDS; f2++)
+      {
+         qstring value;
+
+         if(entry.ran)
+            G_demoRunPrint(value, f2, entry.actual[f2]);
+         else
+            value = "-";
+         fprintf(f, " %s", value.constPtr());
+      }
+      fputc('\n', f);
+   }
+   fclose(f);
+}
+
+//
+// G_DemoRunCorpus
+//
+int G_DemoRunCorpus(const char *manifest)
+{
+   typedef std::chrono::steady_clock clock;
+
+   std::vector<demorunentry_t> entries;
+   int jobs = static_cast<int>(std::thread::hardware_concurrency());
+   int p;
+
+   if(!G_demoRunReadManifest(manifest, entries))
+   {
+      usermsg("G_DemoRunCorpus: cannot read %s", manifest);
+      return 2;
+   }
+
+   if((p = M_CheckParm("-jobs")) && p < myargc - 1)
+      jobs = atoi(myargv[p + 1]);
+   if(jobs < 1)
+      jobs = 1;
+
+   // workers get every argument except the runner's own
+   std::vector<const char *> baseargs;
+   for(int i = 0; i < myargc; i++)
+   {
+      if(i && (!strcasecmp(myargv[i], "-demorunner") || !strcasecmp(myargv[i], "-jobs") ||
+               !strcasecmp(myargv[i], "-demorunout")))
+      {
+         ++i;
+         continue;
+      }
+      baseargs.push_back(myargv[i]);
+   }
+
+   std::vector<processhandle_t>    handles;
+   std::vector<size_t>             running;
+   std::vector<clock::time_point>  starts;
+   std::vector<qstring>            resultpaths(entries.size());
+   size_t next = 0, done = 0;
+   int    passed = 0;
+   auto   begin = clock::now();
+
+   usermsg("Playing %d demos on %d workers", static_cast<int>(entries.size()), jobs);
+
+   while(done < entries.size())
+   {
+      // keep every worker busy
+      while(static_cast<int>(handles.size()) < jobs && next < entries.size())
+      {
+         demorunentry_t &entry = entries[next];
+         qstring        &result = resultpaths[next];
+
+         result.Printf(0, "%s.%d.result", manifest, static_cast<int>(next));
+         remove(result.constPtr());
+
+         std::vector<const char *> args(baseargs);
+         args.push_back("-playdemo");
+         args.push_back(entry.path.constPtr());
+         args.push_back("-nodraw");
+         args.push_back("-nosound");
+         args.push_back("-demoresult");
+         args.push_back(result.constPtr());
+         args.push_back(nullptr);
+
+         processhandle_t handle = I_SpawnProcess(args.data());
+         if(handle == -1)
+         {
+            entry.exitcode = -1;
+            passed += G_demoRunReport(entry);
+            ++done;
+         }
+         else
+         {
+            handles.push_back(handle);
+            running.push_back(next);
+            starts.push_back(clock::now());
+         }
+         ++next;
+      }
+
+      if(handles.empty())
+         continue;
+
+      int exitcode;
+      int index = I_WaitProcesses(handles.data(), static_cast<int>(handles.size()), exitcode);
+      if(index < 0)
+      {
+         usermsg("G_DemoRunCorpus: lost track of the worker processes");
+         return 2;
+      }
+
+      demorunentry_t &entry = entries[running[index]];
+      entry.ms = std::chrono::duration<double, std::milli>(clock::now() - starts[index]).count();
+      entry.exitcode = exitcode;
+      entry.ran = !exitcode && G_demoRunReadResult(resultpaths[running[index]].constPtr(), entry);
+      remove(resultpaths[running[index]].constPtr());
+      passed += G_demoRunReport(entry);
+      ++done;
+
+      handles.erase(handles.begin() + index);
+      running.erase(running.begin() + index);
+      starts.erase(starts.begin() + index);
+   }
+
+   double total = std::chrono::duration<double>(clock::now() - begin).count();
+   usermsg("%d of %d demos passed in %.1f s", passed, static_cast<int>(entries.size()), total);
+
+   if((p = M_CheckParm("-demorunout")) && p < myargc - 1)
+      G_demoRunWriteResults(myargv[p + 1], entries);
+
+   return passed == static_cast<int>(entries.size()) ? 0 : 1;
+}
+
+//=============================================================================
+//
+// Worker side
+//
+
+//
+// G_DemoRunWorker
+//
+bool G_DemoRunWorker()
+{
+   return !!M_CheckParm("-demoresult");
+}
+
+//
+// G_DemoRunFinished
+//
+void G_DemoRunFinished()
+{
+   int   p;
+   FILE *f;
+
+   if(!(p = M_CheckParm("-demoresult")) || p >= myargc - 1)
+      return;
+
+   if(!(f = fopen(myargv[p + 1], "w")))
+      exit(2);
+
+   fprintf(f, "tic %d kills %d items %d secrets %d checksum %08x\n", gametic - basetic,
+           G_TotalKilledMonsters(), G_TotalFoundItems(), G_TotalFoundSecrets(), 
+           G_DemoSumRolling());
+   fclose(f);
+
+   // Leave without saving the configuration, which all workers share, or
+   // anything else I_Quit would do.
+   G_DemoSumEnd();
+   _Exit(0);
+}
+
+// EOF
+
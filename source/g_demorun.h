@@ -0,0 +1,42 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: parallel demo regression runner.
+//
+
+#ifndef G_DEMORUN_H__
+#define G_DEMORUN_H__
+
+// Tool mode: plays every demo listed in the manifest, each in a headless 
+// worker process, and reports which end as expected. Returns the exit 
+// status: 0 if all passed.
+int G_DemoRunCorpus(const char *manifest);
+
+// True in a worker process started by the runner (-demoresult).
+bool G_DemoRunWorker();
+
+// In a worker process, writes the end state of the finished demo for the
+// runner and exits.
+void G_DemoRunFinished();
+
+#endif
+
+// EOF
+
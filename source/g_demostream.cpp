@@ -0,0 +1,586 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: streaming compressed demos with level state keyframes.
+//
+// A .lmp is written through a buffer that only reaches the disk in large
+// pieces, and is only finished when recording stops. A streaming demo holds
+// the very same bytes, but cut into small zlib-compressed chunks that are
+// each flushed as soon as they are complete, so a session that ends in a
+// crash keeps everything up to the last few seconds. Every so often, and at
+// the start of each level, a chunk with a snapshot of the level state is
+// added as well; playback can start from one of those instead of tic 0.
+//
+// For playback the stream is expanded back into the .lmp it stands for, so
+// the demo reading code does not need to know about it.
+//
+
+#include <vector>
+
+#include "z_zone.h"
+#include "i_system.h"
+#include "../zlib/zlib.h"
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "d_main.h"
+#include "doomstat.h"
+#include "g_demostream.h"
+#include "g_game.h"
+#include "m_swap.h"
+#include "m_utils.h"
+#include "p_snapshot.h"
+#include "v_misc.h"
+
+//
+// Stream layout
+//
+// An 8-byte magic number and a uint32 version, followed by chunks. Each
+// chunk has a header of three uint32s: type, uncompressed size and
+// compressed size, followed by the compressed data. All values are little
+// endian.
+//
+// DSTREAM_DATA:     the next bytes of the .lmp
+// DSTREAM_KEYFRAME: uint32 offset into the .lmp of the first tic after the
+//                   keyframe, uint32 demo tic, 8 bytes of map name, then
+//                   the level snapshot
+// DSTREAM_END:      no data; recording stopped normally
+//
+
+#define DSTREAM_MAGIC   "EEDEMOZ\x1a"
+#define DSTREAM_VERSION 1
+
+enum
+{
+   DSTREAM_DATA = 1,
+   DSTREAM_KEYFRAME,
+   DSTREAM_END
+};
+
+// Data is flushed after this many tics, so a crash loses at most this much.
+#define DSTREAM_BLOCKTICS (5 * TICRATE)
+
+// ...or once this many bytes are waiting, whichever comes first.
+#define DSTREAM_BLOCKSIZE (64 * 1024)
+
+// Sanity limit on chunk sizes.
+#define DSTREAM_MAXSIZE 0x10000000u
+
+#define DEMOMARKER 0x80
+
+bool demo_stream       = false; // record streaming demos instead of .lmp
+int  demo_keyframetime = 60;    // seconds between keyframes; 0 disables
+
+struct dstreamheader_t
+{
+   char     magic[8];
+   uint32_t version;
+};
+
+struct dstreamchunk_t
+{
+   uint32_t type;
+   uint32_t size;
+   uint32_t packedsize;
+};
+
+struct dstreamkeyhead_t
+{
+   uint32_t offset;
+   uint32_t tic;
+   char     mapname[8];
+};
+
+struct dstreamwriter_t
+{
+   FILE             *f;
+   std::vector<byte> pending;     // data not yet in a chunk
+   size_t            written;     // .lmp bytes received, pending included
+   int               tic;         // demo tics so far
+   int               pendingtics; // tics since the last flush
+   int               keytic;      // tic of the last keyframe, or -1
+   char              keymap[9];   // map of the last keyframe
+};
+
+struct dstreamkey_t
+{
+   size_t            offset;
+   int               tic;
+   char              mapname[9];
+   std::vector<byte> image;
+};
+
+static dstreamwriter_t          *streamWriter;
+static std::vector<dstreamkey_t> streamKeys;   // of the demo being played
+
+//=============================================================================
+//
+// Writing
+//
+
+//
+// G_writeStreamChunk
+//
+// Compresses and writes one chunk, then flushes the file, so that every
+// chunk written is on disk whole.
+//
+static bool G_writeStreamChunk(FILE *f, uint32_t type, const byte *data,
+                               size_t size)
+{
+   std::vector<byte> packed(compressBound(uLong(size)));
+   uLongf packedsize = uLongf(packed.size());
+
+   if(size && compress2(packed.data(), &packedsize, data, uLong(size),
+                        Z_DEFAULT_COMPRESSION) != Z_OK)
+      return false;
+   if(!size)
+      packedsize = 0;
+
+   dstreamchunk_t chunk;
+   chunk.type       = SwapULong(type);
+   chunk.size       = SwapULong(uint32_t(size));
+   chunk.packedsize = SwapULong(uint32_t(packedsize));
+
+   if(fwrite(&chunk, sizeof(chunk), 1, f) != 1 ||
+      (packedsize && fwrite(packed.data(), 1, packedsize, f) != packedsize))
+      return false;
+
+   return !fflush(f);
+}
+
+//
+// G_flushStream
+//
+static bool G_flushStream(dstreamwriter_t *w)
+{
+   if(w->pending.empty())
+      return true;
+
+   bool ok = G_writeStreamChunk(w->f, DSTREAM_DATA, w->pending.data(),
+                                w->pending.size());
+   w->pending.clear();
+   w->pendingtics = 0;
+   return ok;
+}
+
+//
+// G_writeStreamKeyframe
+//
+// Snapshots the level; the keyframe belongs before the tic about to be
+// written.
+//
+static bool G_writeStreamKeyframe(dstreamwriter_t *w)
+{
+   size_t      size;
+   const byte *image = P_SnapshotCapture(size);
+
+   dstreamkeyhead_t head;
+   head.offset = SwapULong(uint32_t(w->written));
+   head.tic    = SwapULong(uint32_t(w->tic));
+   memcpy(head.mapname, gamemapname, sizeof(head.mapname));
+
+   std::vector<byte> data(sizeof(head) + size);
+   memcpy(data.data(), &head, sizeof(head));
+   memcpy(data.data() + sizeof(head), image, size);
+
+   w->keytic = w->tic;
+   memcpy(w->keymap, gamemapname, sizeof(w->keymap));
+
+   return G_flushStream(w) &&
+          G_writeStreamChunk(w->f, DSTREAM_KEYFRAME, data.data(), data.size());
+}
+
+//
+// G_DemoStreamCreate
+//
+bool G_DemoStreamCreate(const char *filename)
+{
+   FILE *f;
+
+   if(streamWriter || !(f = fopen(filename, "wb")))
+      return false;
+
+   dstreamheader_t hdr;
+   memcpy(hdr.magic, DSTREAM_MAGIC, sizeof(hdr.magic));
+   hdr.version = SwapULong(DSTREAM_VERSION);
+
+   if(fwrite(&hdr, sizeof(hdr), 1, f) != 1)
+   {
+      fclose(f);
+      return false;
+   }
+
+   streamWriter = new dstreamwriter_t();
+   streamWriter->f      = f;
+   streamWriter->keytic = -1;
+   streamWriter->pending.reserve(DSTREAM_BLOCKSIZE);
+
+   return true;
+}
+
+//
+// G_DemoStreamActive
+//
+bool G_DemoStreamActive()
+{
+   return streamWriter != nullptr;
+}
+
+//
+// G_DemoStreamWrite
+//
+bool G_DemoStreamWrite(const void *data, size_t size)
+{
+   dstreamwriter_t *w = streamWriter;
+
+   if(!w)
+      return false;
+
+   const byte *bytes = static_cast<const byte *>(data);
+   w->pending.insert(w->pending.end(), bytes, bytes + size);
+   w->written += size;
+
+   if(w->pending.size() >= DSTREAM_BLOCKSIZE)
+      return G_flushStream(w);
+
+   return true;
+}
+
+//
+// G_DemoStreamTic
+//
+void G_DemoStreamTic()
+{
+   dstreamwriter_t *w = streamWriter;
+
+   if(!w)
+      return;
+
+   if(w->pendingtics >= DSTREAM_BLOCKTICS && !G_flushStream(w))
+      I_Error("G_DemoStreamTic: error writing demo\n");
+
+   // a keyframe at the start of every level, and then at intervals
+   if(gamestate == GS_LEVEL && demo_keyframetime > 0 &&
+      (w->keytic < 0 || strncmp(w->keymap, gamemapname, 8) ||
+       w->tic - w->keytic >= demo_keyframetime * TICRATE))
+   {
+      if(!G_writeStreamKeyframe(w))
+         I_Error("G_DemoStreamTic: error writing demo keyframe\n");
+   }
+
+   ++w->tic;
+   ++w->pendingtics;
+}
+
+//
+// G_DemoStreamClose
+//
+bool G_DemoStreamClose()
+{
+   dstreamwriter_t *w = streamWriter;
+
+   if(!w)
+      return false;
+
+   bool ok = G_flushStream(w) && G_writeStreamChunk(w->f, DSTREAM_END, nullptr, 0);
+   if(fclose(w->f))
+      ok = false;
+
+   delete w;
+   streamWriter = nullptr;
+
+   return ok;
+}
+
+//=============================================================================
+//
+// Reading
+//
+
+//
+// G_DemoStreamIsStream
+//
+bool G_DemoStreamIsStream(const byte *data, size_t size)
+{
+   return size >= sizeof(dstreamheader_t) &&
+          !memcmp(data, DSTREAM_MAGIC, sizeof(((dstreamheader_t *)0)->magic));
+}
+
+//
+// G_DemoStreamExpand
+//
+bool G_DemoStreamExpand(const byte *data, size_t size, std::vector<byte> &lmp)
+{
+   const byte *p   = data;
+   const byte *end = data + size;
+   bool        finished = false;
+
+   lmp.clear();
+   G_DemoStreamClearKeyframes();
+
+   if(!G_DemoStreamIsStream(data, size))
+      return false;
+
+   dstreamheader_t hdr;
+   memcpy(&hdr, p, sizeof(hdr));
+   p += sizeof(hdr);
+
+   if(SwapULong(hdr.version) != DSTREAM_VERSION)
+   {
+      C_Printf(FC_ERROR "G_DemoStreamExpand: unknown version %u\n",
+               SwapULong(hdr.version));
+      return false;
+   }
+
+   std::vector<byte> chunkdata;
+
+   while(!finished && p < end)
+   {
+      dstreamchunk_t chunk;
+
+      if(size_t(end - p) < sizeof(chunk))
+         break;
+      memcpy(&chunk, p, sizeof(chunk));
+      p += sizeof(chunk);
+
+      uint32_t type       = SwapULong(chunk.type);
+      uint32_t chunksize  = SwapULong(chunk.size);
+      uint32_t packedsize = SwapULong(chunk.packedsize);
+
+      if(chunksize > DSTREAM_MAXSIZE || packedsize > size_t(end - p))
+         break;
+
+      chunkdata.resize(chunksize);
+      uLongf outsize = chunksize;
+      if(chunksize &&
+         (uncompress(chunkdata.data(), &outsize, p, packedsize) != Z_OK ||
+          outsize != chunksize))
+         break;
+      p += packedsize;
+
+      switch(type)
+      {
+      case DSTREAM_DATA:
+         lmp.insert(lmp.end(), chunkdata.begin(), chunkdata.end());
+         break;
+
+      case DSTREAM_KEYFRAME:
+         if(chunksize > sizeof(dstreamkeyhead_t))
+         {
+            dstreamkeyhead_t head;
+            memcpy(&head, chunkdata.data(), sizeof(head));
+
+            streamKeys.emplace_back();
+            dstreamkey_t &key = streamKeys.back();
+            key.offset = SwapULong(head.offset);
+            key.tic    = int(SwapULong(head.tic));
+            memcpy(key.mapname, head.mapname, 8);
+            key.mapname[8] = '\0';
+            key.image.assign(chunkdata.begin() + sizeof(head), chunkdata.end());
+         }
+         break;
+
+      case DSTREAM_END:
+         finished = true;
+         break;
+
+      default: // from a later version; skip it
+         break;
+      }
+   }
+
+   if(lmp.empty())
+      return false;
+
+   // a recording cut short never got its end marker
+   if(!finished)
+   {
+      C_Printf(FC_ERROR "Streaming demo is incomplete; playing what is left\n");
+      lmp.push_back(DEMOMARKER);
+   }
+
+   // keyframes past the data that survived cannot be used
+   while(!streamKeys.empty() && streamKeys.back().offset >= lmp.size())
+      streamKeys.pop_back();
+
+   return true;
+}
+
+//
+// G_DemoStreamClearKeyframes
+//
+void G_DemoStreamClearKeyframes()
+{
+   streamKeys.clear();
+}
+
+//
+// G_DemoStreamSeek
+//
+bool G_DemoStreamSeek(int tic, size_t &offset, int &keytic)
+{
+   const dstreamkey_t *key = nullptr;
+
+   for(const dstreamkey_t &k : streamKeys)
+   {
+      if(k.tic > tic)
+         break;
+      key = &k;
+   }
+
+   if(!key)
+      return false;
+
+   // snapshots only hold the level state, so the map comes first
+   if(gamestate != GS_LEVEL || strncmp(gamemapname, key->mapname, 8))
+   {
+      G_SetGameMapName(key->mapname);
+      G_SetGameMap();
+      G_DoLoadLevel();
+      if(gamestate != GS_LEVEL)
+         return false;
+   }
+
+   P_SnapshotLoad(key->image.data(), key->image.size());
+
+   offset = key->offset;
+   keytic = key->tic;
+   return true;
+}
+
+//=============================================================================
+//
+// Conversion
+//
+
+//
+// G_DemoStreamConvert
+//
+int G_DemoStreamConvert(const char *inpath, const char *outpath)
+{
+   byte *data = nullptr;
+   int   size = M_ReadFile(inpath, &data);
+
+   if(size <= 0)
+   {
+      usermsg("G_DemoStreamConvert: cannot read %s", inpath);
+      if(data)
+         efree(data);
+      return 2;
+   }
+
+   int result = 0;
+
+   if(G_DemoStreamIsStream(data, size_t(size)))
+   {
+      std::vector<byte> lmp;
+
+      if(!G_DemoStreamExpand(data, size_t(size), lmp))
+      {
+         usermsg("G_DemoStreamConvert: %s holds no demo data", inpath);
+         result = 1;
+      }
+      else if(!M_WriteFile(outpath, lmp.data(), lmp.size()))
+      {
+         usermsg("G_DemoStreamConvert: cannot write %s", outpath);
+         result = 2;
+      }
+      else
+      {
+         usermsg("Wrote %s: %u bytes", outpath,
+                 static_cast<unsigned int>(lmp.size()));
+      }
+      G_DemoStreamClearKeyframes();
+   }
+   else
+   {
+      // keyframes need the game to run, so a converted .lmp has none
+      bool   ok = G_DemoStreamCreate(outpath);
+      size_t done;
+
+      for(done = 0; ok && done < size_t(size); done += DSTREAM_BLOCKSIZE)
+      {
+         size_t count = size_t(size) - done;
+         if(count > DSTREAM_BLOCKSIZE)
+            count = DSTREAM_BLOCKSIZE;
+         ok = G_DemoStreamWrite(data + done, count);
+      }
+      if(streamWriter && !G_DemoStreamClose())
+         ok = false;
+
+      if(ok)
+         usermsg("Wrote %s", outpath);
+      else
+      {
+         usermsg("G_DemoStreamConvert: cannot write %s", outpath);
+         result = 2;
+      }
+   }
+
+   efree(data);
+   return result;
+}
+
+//=============================================================================
+//
+// Console Commands
+//
+
+VARIABLE_TOGGLE(demo_stream, NULL, onoff);
+CONSOLE_VARIABLE(demo_stream, demo_stream, 0) {}
+
+VARIABLE_INT(demo_keyframetime, NULL, 0, 3600, NULL);
+CONSOLE_VARIABLE(demo_keyframetime, demo_keyframetime, 0) {}
+
+CONSOLE_COMMAND(demo_keyframes, 0)
+{
+   if(streamKeys.empty())
+   {
+      C_Printf("No demo keyframes\n");
+      return;
+   }
+
+   for(const dstreamkey_t &key : streamKeys)
+   {
+      C_Printf("%d:%02d %s (%u bytes)\n", key.tic / (60 * TICRATE),
+               (key.tic / TICRATE) % 60, key.mapname,
+               static_cast<unsigned int>(key.image.size()));
+   }
+}
+
+CONSOLE_COMMAND(demo_seek, cf_notnet)
+{
+   if(Console.argc < 1)
+   {
+      C_Printf("Usage: demo_seek seconds\n");
+      return;
+   }
+
+   int keytic;
+   if(!demoplayback || !G_DemoSeek(Console.argv[0]->toInt() * TICRATE, keytic))
+   {
+      C_Printf(FC_ERROR "No demo keyframe that early; see demo_keyframes\n");
+      return;
+   }
+
+   C_Printf("Demo at %d:%02d\n", keytic / (60 * TICRATE), (keytic / TICRATE) % 60);
+}
+
+// EOF
+
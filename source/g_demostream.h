@@ -0,0 +1,70 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: streaming compressed demos with level state keyframes.
+//
+
+#ifndef G_DEMOSTREAM_H__
+#define G_DEMOSTREAM_H__
+
+#include <vector>
+
+// Starts recording a streaming demo to the given file.
+bool G_DemoStreamCreate(const char *filename);
+
+// True while a streaming demo is being recorded.
+bool G_DemoStreamActive();
+
+// Adds demo data, in exactly the bytes a .lmp would hold.
+bool G_DemoStreamWrite(const void *data, size_t size);
+
+// Called each tic before the ticcmds are written; takes keyframes and
+// flushes finished blocks.
+void G_DemoStreamTic();
+
+// Writes what is left and closes the file.
+bool G_DemoStreamClose();
+
+// True if the data is a streaming demo rather than a .lmp.
+bool G_DemoStreamIsStream(const byte *data, size_t size);
+
+// Expands a streaming demo into the .lmp it was recorded as, and keeps its
+// keyframes for seeking. Returns false if nothing could be read.
+bool G_DemoStreamExpand(const byte *data, size_t size, std::vector<byte> &lmp);
+
+// Discards the keyframes of the demo last expanded.
+void G_DemoStreamClearKeyframes();
+
+// Puts the level in the state of the newest keyframe at or before the given
+// demo tic and returns the offset into the .lmp image to resume reading
+// from, and the keyframe's tic. Returns false if there is no such keyframe.
+bool G_DemoStreamSeek(int tic, size_t &offset, int &keytic);
+
+// Tool mode: converts a streaming demo to a .lmp or a .lmp to a streaming
+// demo, depending on what the input is. Returns 0 on success.
+int G_DemoStreamConvert(const char *inpath, const char *outpath);
+
+extern bool demo_stream;
+extern int  demo_keyframetime;
+
+#endif
+
+// EOF
+
@@ -0,0 +1,524 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: per-tic game state checksums for finding demo desyncs.
+//
+// Every tic a cheap hash is taken over the RNG, the sector heights and the
+// position, momentum, health and state of every object. The hashes go to a
+// small binary stream: beside the demo when recording with -demosum, or to
+// any file given with -demosumout. Playing back with -demosum checks each
+// tic against the stream recorded with the demo. -demosumcmp bisects two
+// streams, usually written by two builds playing the same demo, for the 
+// first divergent tic.
+//
+
+#include <vector>
+
+#include "z_zone.h"
+#include "c_io.h"
+#include "d_main.h"
+#include "doomstat.h"
+#include "g_demolog.h"
+#include "g_demosum.h"
+#include "info.h"
+#include "m_argv.h"
+#include "m_buffer.h"
+#include "m_qstr.h"
+#include "m_random.h"
+#include "p_mobj.h"
+#include "p_tick.h"
+#include "r_defs.h"
+#include "r_state.h"
+#include "v_misc.h"
+
+//
+// Stream layout
+//
+// An 8-byte magic number followed by records, each starting with a type 
+// byte. All values are little endian.
+//
+// DSUM_TIC:     uint32 gametic, int32 leveltime, uint32 hash, uint32 rolling
+//               hash of all tics so far, uint32 number of objects
+// DSUM_OBJECTS: uint32 count, then per object a uint8 length and the name
+//               of its thing type, followed by DSUMOBJ_NUMFIELDS int32s.
+//               Only written for the tic given with -demosumdetail, right 
+//               after that tic's DSUM_TIC record.
+//
+#define DEMOSUM_MAGIC "EEDSUM01"
+
+enum
+{
+   DSUM_TIC     = 'T',
+   DSUM_OBJECTS = 'O'
+};
+
+enum
+{
+   DSUMOBJ_X,
+   DSUMOBJ_Y,
+   DSUMOBJ_Z,
+   DSUMOBJ_MOMX,
+   DSUMOBJ_MOMY,
+   DSUMOBJ_MOMZ,
+   DSUMOBJ_ANGLE,
+   DSUMOBJ_HEALTH,
+   DSUMOBJ_STATE,
+   DSUMOBJ_TICS,
+   DSUMOBJ_NUMFIELDS
+};
+
+static const char *const demoSumFieldNames[DSUMOBJ_NUMFIELDS] =
+{
+   "x", "y", "z", "momx", "momy", "momz", "angle", "health", "state", "tics"
+};
+
+struct demosumtic_t
+{
+   uint32_t gametic;
+   int32_t  leveltime;
+   uint32_t hash;      // state at the end of this tic
+   uint32_t rolling;   // hash of all tic hashes so far
+   uint32_t numobjs;
+   size_t   detail;    // first of this tic's objects in DemoSumFile::objs
+   uint32_t numdetail; // number of them, 0 if none stored
+};
+
+struct demosumobj_t
+{
+   qstring name;
+   int32_t fields[DSUMOBJ_NUMFIELDS];
+};
+
+//
+// DemoSumFile
+//
+// A checksum stream read into memory.
+//
+class DemoSumFile
+{
+public:
+   std::vector<demosumtic_t> tics;
+   std::vector<demosumobj_t> objs;
+
+   bool load(const char *path);
+   void clear() { tics.clear(); objs.clear(); }
+};
+
+static OutBuffer   demoSumOut;         // stream being written
+static bool        demoSumWriting;
+static DemoSumFile demoSumRef;         // stream being checked against
+static bool        demoSumChecking;
+static bool        demoSumDiverged;    // already reported a desync
+static bool        demoSumHashing;     // hashing for a -demoresult worker
+static uint32_t    demoSumRolling;
+static uint32_t    demoSumTics;        // tics hashed so far in this demo
+static int         demoSumDetailTic = -1;
+
+#define DEMOSUM_HASHINIT 2166136261u
+
+//
+// G_sumWord
+//
+// FNV-1a, a 32-bit word at a time.
+//
+static inline uint32_t G_sumWord(uint32_t hash, uint32_t word)
+{
+   return (hash ^ word) * 16777619u;
+}
+
+//
+// DemoSumFile::load
+//
+bool DemoSumFile::load(const char *path)
+{
+   InBuffer in;
+   char     magic[8];
+   uint8_t  type;
+
+   clear();
+
+   if(!in.openFile(path, InBuffer::LENDIAN))
+      return false;
+   if(in.read(magic, sizeof(magic)) != sizeof(magic) ||
+      memcmp(magic, DEMOSUM_MAGIC, sizeof(magic)))
+      return false;
+
+   while(in.readUint8(type))
+   {
+      if(type == DSUM_TIC)
+      {
+         demosumtic_t tic;
+
+         if(!in.readUint32(tic.gametic) || !in.readSint32(tic.leveltime) ||
+            !in.readUint32(tic.hash) || !in.readUint32(tic.rolling) ||
+            !in.readUint32(tic.numobjs))
+            return false;
+         tic.detail    = 0;
+         tic.numdetail = 0;
+         tics.push_back(tic);
+      }
+      else if(type == DSUM_OBJECTS && !tics.empty())
+      {
+         demosumtic_t &tic = tics.back();
+
+         if(!in.readUint32(tic.numdetail))
+            return false;
+         tic.detail = objs.size();
+
+         for(uint32_t i = 0; i < tic.numdetail; i++)
+         {
+            demosumobj_t obj;
+            char         name[256];
+            uint8_t      len;
+
+            if(!in.readUint8(len) || in.read(name, len) != len)
+               return false;
+            obj.name.copy(name, len);
+            for(int32_t &field : obj.fields)
+            {
+               if(!in.readSint32(field))
+                  return false;
+            }
+            objs.push_back(obj);
+         }
+      }
+      else
+         return false;
+   }
+
+   return true;
+}
+
+//
+// G_demoSumSidePath
+//
+// The stream recorded with a demo sits beside it, with extension .dsum.
+//
+static void G_demoSumSidePath(const char *demo, qstring &path)
+{
+   path = demo;
+   path.addDefaultExtension(".lmp");
+   path.truncate(path.findLastOf('.'));
+   path << ".dsum";
+}
+
+//
+// G_demoSumAtExit
+//
+static void G_demoSumAtExit()
+{
+   if(demoSumWriting)
+      demoSumOut.close();
+   demoSumWriting = false;
+}
+
+//
+// G_DemoSumBegin
+//
+void G_DemoSumBegin(const char *demo, bool playback)
+{
+   static bool atexitset;
+   qstring     path;
+   int         p;
+
+   G_DemoSumEnd();
+
+   bool sidefile = !!M_CheckParm("-demosum");
+
+   if((p = M_CheckParm("-demosumout")) && p < myargc - 1)
+      path = myargv[p + 1];
+   else if(sidefile && !playback)
+      G_demoSumSidePath(demo, path);
+
+   if(!path.empty())
+   {
+      if(demoSumOut.createFile(path.constPtr(), 0x10000, OutBuffer::LENDIAN))
+      {
+         demoSumOut.write(DEMOSUM_MAGIC, 8);
+         demoSumWriting = true;
+      }
+      else
+         C_Printf(FC_ERROR "G_DemoSumBegin: cannot write %s\n", path.constPtr());
+   }
+
+   if(sidefile && playback)
+   {
+      G_demoSumSidePath(demo, path);
+      demoSumChecking = demoSumRef.load(path.constPtr());
+      if(!demoSumChecking)
+         demoSumRef.clear();
+   }
+
+   if((p = M_CheckParm("-demosumdetail")) && p < myargc - 1)
+      demoSumDetailTic = atoi(myargv[p + 1]);
+   else
+      demoSumDetailTic = -1;
+
+   demoSumRolling  = DEMOSUM_HASHINIT;
+   demoSumTics     = 0;
+   demoSumDiverged = false;
+   demoSumHashing  = playback && M_CheckParm("-demoresult");
+
+   if(demoSumWriting && !atexitset)
+   {
+      atexit(G_demoSumAtExit);
+      atexitset = true;
+   }
+}
+
+//
+// G_DemoSumEnd
+//
+void G_DemoSumEnd()
+{
+   if(demoSumChecking && !demoSumDiverged && demoSumRef.tics.size() != demoSumTics)
+   {
+      C_Printf(FC_ERROR "Demo ran %u tics, checksums were recorded for %u\n",
+               demoSumTics, static_cast<unsigned int>(demoSumRef.tics.size()));
+   }
+
+   G_demoSumAtExit();
+   demoSumRef.clear();
+   demoSumChecking = false;
+   demoSumHashing  = false;
+}
+
+//
+// G_DemoSumRolling
+//
+uint32_t G_DemoSumRolling()
+{
+   return demoSumRolling;
+}
+
+//
+// G_mobjSumFields
+//
+static void G_mobjSumFields(const Mobj *mo, int32_t fields[DSUMOBJ_NUMFIELDS])
+{
+   fields[DSUMOBJ_X]      = mo->x;
+   fields[DSUMOBJ_Y]      = mo->y;
+   fields[DSUMOBJ_Z]      = mo->z;
+   fields[DSUMOBJ_MOMX]   = mo->momx;
+   fields[DSUMOBJ_MOMY]   = mo->momy;
+   fields[DSUMOBJ_MOMZ]   = mo->momz;
+   fields[DSUMOBJ_ANGLE]  = static_cast<int32_t>(mo->angle);
+   fields[DSUMOBJ_HEALTH] = mo->health;
+   fields[DSUMOBJ_STATE]  = mo->state ? mo->state->index : -1;
+   fields[DSUMOBJ_TICS]   = mo->tics;
+}
+
+//
+// G_DemoSumTic
+//
+void G_DemoSumTic()
+{
+   if(!demoSumWriting && !demoSumChecking && !demoSumHashing)
+      return;
+
+   std::vector<const Mobj *> detail;
+   uint32_t hash    = DEMOSUM_HASHINIT;
+   uint32_t numobjs = 0;
+   bool     wantdetail = demoSumWriting && int(demoSumTics) == demoSumDetailTic;
+
+   // parked thinkers count their tics down lazily
+   Thinker::SettleThinkers();
+
+   for(unsigned int seed : rng.seed)
+      hash = G_sumWord(hash, seed);
+   hash = G_sumWord(hash, rng.rndindex);
+   hash = G_sumWord(hash, rng.prndindex);
+
+   for(int i = 0; i < numsectors; i++)
+   {
+      hash = G_sumWord(hash, sectors[i].floorheight);
+      hash = G_sumWord(hash, sectors[i].ceilingheight);
+   }
+
+   for(Mobj *mo = nullptr; (mo = P_NextThinker(mo)); )
+   {
+      int32_t fields[DSUMOBJ_NUMFIELDS];
+
+      G_mobjSumFields(mo, fields);
+      hash = G_sumWord(hash, mo->type);
+      for(int32_t field : fields)
+         hash = G_sumWord(hash, field);
+
+      if(wantdetail)
+         detail.push_back(mo);
+      ++numobjs;
+   }
+
+   demoSumRolling = G_sumWord(demoSumRolling, hash);
+
+   if(demoSumWriting)
+   {
+      demoSumOut.writeUint8(DSUM_TIC);
+      demoSumOut.writeUint32(gametic);
+      demoSumOut.writeSint32(leveltime);
+      demoSumOut.writeUint32(hash);
+      demoSumOut.writeUint32(demoSumRolling);
+      demoSumOut.writeUint32(numobjs);
+
+      if(wantdetail)
+      {
+         demoSumOut.writeUint8(DSUM_OBJECTS);
+         demoSumOut.writeUint32(static_cast<uint32_t>(detail.size()));
+         for(const Mobj *mo : detail)
+         {
+            const char *name = mo->info->name;
+            size_t      len  = strlen(name);
+            int32_t     fields[DSUMOBJ_NUMFIELDS];
+
+            if(len > 255)
+               len = 255;
+            demoSumOut.writeUint8(static_cast<uint8_t>(len));
+            demoSumOut.write(name, len);
+
+            G_mobjSumFields(mo, fields);
+            for(int32_t field : fields)
+               demoSumOut.writeSint32(field);
+         }
+      }
+   }
+
+   if(demoSumChecking && !demoSumDiverged && demoSumTics < demoSumRef.tics.size() &&
+      demoSumRef.tics[demoSumTics].hash != hash)
+   {
+      C_Printf(FC_ERROR "Demo desync at tic %u (gametic %d, level time %d)\n",
+               demoSumTics, gametic, leveltime);
+      G_DemoLog("%d\tDesync at tic %u\n", gametic, demoSumTics);
+      demoSumDiverged = true;
+   }
+
+   ++demoSumTics;
+}
+
+//
+// G_demoSumCompareObjects
+//
+// Reports the first object whose type or fields differ.
+//
+static void G_demoSumCompareObjects(const DemoSumFile &a, const demosumtic_t &ta, 
+                                    const DemoSumFile &b, const demosumtic_t &tb)
+{
+   uint32_t count = ta.numdetail < tb.numdetail ? ta.numdetail : tb.numdetail;
+
+   for(uint32_t i = 0; i < count; i++)
+   {
+      const demosumobj_t &oa = a.objs[ta.detail + i];
+      const demosumobj_t &ob = b.objs[tb.detail + i];
+
+      if(oa.name == ob.name && 
+         !memcmp(oa.fields, ob.fields, sizeof(oa.fields)))
+         continue;
+
+      usermsg("First differing object: #%u, %s / %s", i, oa.name.constPtr(), 
+              ob.name.constPtr());
+      for(int f = 0; f < DSUMOBJ_NUMFIELDS; f++)
+      {
+         if(oa.fields[f] != ob.fields[f])
+         {
+            usermsg("   %s: %d / %d", demoSumFieldNames[f], oa.fields[f], 
+                    ob.fields[f]);
+         }
+      }
+      return;
+   }
+
+   if(ta.numdetail != tb.numdetail)
+   {
+      const demosumtic_t  &tl = ta.numdetail > tb.numdetail ? ta : tb;
+      const demosumobj_t  &ol = (&tl == &ta ? a : b).objs[tl.detail + count];
+      usermsg("First differing object: #%u, %s, exists in only one stream", count,
+              ol.name.constPtr());
+   }
+   else
+      usermsg("All objects match; the difference is in the RNG or sectors");
+}
+
+//
+// G_DemoSumCompare
+//
+int G_DemoSumCompare(const char *path1, const char *path2)
+{
+   DemoSumFile a, b;
+
+   if(!a.load(path1))
+   {
+      usermsg("G_DemoSumCompare: cannot read %s", path1);
+      return 2;
+   }
+   if(!b.load(path2))
+   {
+      usermsg("G_DemoSumCompare: cannot read %s", path2);
+      return 2;
+   }
+
+   size_t count = a.tics.size() < b.tics.size() ? a.tics.size() : b.tics.size();
+
+   // once two streams diverge their rolling hashes stay different, so the 
+   // first divergent tic can be found by bisection
+   size_t lo = 0, hi = count;
+   while(lo < hi)
+   {
+      size_t mid = lo + (hi - lo) / 2;
+
+      if(a.tics[mid].rolling == b.tics[mid].rolling)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   if(lo == count)
+   {
+      if(a.tics.size() == b.tics.size())
+      {
+         usermsg("Checksum streams match over %u tics", static_cast<unsigned int>(count));
+         return 0;
+      }
+      usermsg("Checksum streams match over %u tics, but run for %u / %u tics",
+              static_cast<unsigned int>(count), static_cast<unsigned int>(a.tics.size()),
+              static_cast<unsigned int>(b.tics.size()));
+      return 1;
+   }
+
+   const demosumtic_t &ta = a.tics[lo];
+   const demosumtic_t &tb = b.tics[lo];
+
+   usermsg("First divergent tic: %u (gametic %u / %u, level time %d / %d)", 
+           static_cast<unsigned int>(lo), ta.gametic, tb.gametic, ta.leveltime, 
+           tb.leveltime);
+   if(ta.numobjs != tb.numobjs)
+      usermsg("Objects: %u / %u", ta.numobjs, tb.numobjs);
+
+   if(ta.numdetail && tb.numdetail)
+      G_demoSumCompareObjects(a, ta, b, tb);
+   else
+   {
+      usermsg("Play the demo again with -demosumdetail %u in both builds to find "
+              "the first differing object", static_cast<unsigned int>(lo));
+   }
+
+   return 1;
+}
+
+// EOF
+
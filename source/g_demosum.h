@@ -0,0 +1,49 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: per-tic game state checksums for finding demo desyncs.
+//
+
+#ifndef G_DEMOSUM_H__
+#define G_DEMOSUM_H__
+
+// Starts writing and/or checking checksums for a demo being recorded or
+// played back, as requested on the command line.
+void G_DemoSumBegin(const char *demo, bool playback);
+
+// Ends the current demo's checksum stream.
+void G_DemoSumEnd();
+
+// Adds the state of the current tic; called at the end of P_Ticker.
+void G_DemoSumTic();
+
+// Rolling hash of every tic of the current demo so far; kept up to date
+// only while a stream is written or checked, or for -demoresult.
+uint32_t G_DemoSumRolling();
+
+// Tool mode: compares two checksum streams and reports the first divergent
+// tic and, if both streams hold object detail for it, the first object that
+// differs. Returns 0 if the streams match.
+int G_DemoSumCompare(const char *path1, const char *path2);
+
+#endif
+
+// EOF
+
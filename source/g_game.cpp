@@ -58,6 +58,9 @@
 #include "f_wipe.h"
 #include "g_bind.h"
 #include "g_demolog.h"
+#include "g_demorun.h"
+#include "g_demostream.h"
+#include "g_demosum.h"
 #include "g_dmflag.h"
 #include "g_game.h"
 #include "in_lude.h"
@@ -77,6 +80,7 @@
 #include "p_inter.h"
 #include "p_map.h"
 #include "p_maputl.h"
+#include "p_savefile.h"
 #include "p_saveg.h"
 #include "p_setup.h"
 #include "p_tick.h"
@@ -107,6 +111,7 @@ static byte    *demobuffer;      // only for playback
 static OutBuffer demofp;         // only for recording
 static byte    *demo_p;          // used for both playing and recording
 static byte    *demo_continue_p; // only for rerecording
+static byte    *demostreamdata;  // expanded streaming demo, for playback
 static size_t   demolength;
 static int16_t  consistency[MAXPLAYERS][BACKUPTICS];
 static int      g_destmap;
@@ -1324,6 +1329,48 @@ static byte *G_ReadDemoHeader(byte *demo_p)
    return demo_p;
 }
 
+//
+// G_expandDemoStream
+//
+// Replaces the cached streaming demo lump in demobuffer with the .lmp it
+// expands to.
+//
+static bool G_expandDemoStream()
+{
+   std::vector<byte> lmp;
+   bool ok = G_DemoStreamExpand(demobuffer, demolength, lmp);
+
+   Z_ChangeTag(demobuffer, PU_CACHE);
+   if(!ok)
+      return false;
+
+   if(demostreamdata)
+      efree(demostreamdata);
+   demolength = lmp.size();
+   demobuffer = emalloctag(byte *, demolength, PU_STATIC, (void **)&demostreamdata);
+   memcpy(demobuffer, lmp.data(), demolength);
+
+   return true;
+}
+
+//
+// G_DemoSeek
+//
+// Moves playback of a streaming demo to its newest keyframe at or before
+// the given demo tic.
+//
+bool G_DemoSeek(int tic, int &keytic)
+{
+   size_t offset;
+
+   if(!demoplayback || !demostreamdata || demobuffer != demostreamdata ||
+      !G_DemoStreamSeek(tic, offset, keytic))
+      return false;
+
+   demo_p = demobuffer + offset;
+   return true;
+}
+
 void G_DoPlayDemo(void)
 {
    char basename[9];
@@ -1364,6 +1411,21 @@ void G_DoPlayDemo(void)
    }
    demobuffer = (byte *)(wGlobalDir.cacheLumpNum(lumpnum, PU_STATIC)); // killough
 
+   // streaming demos are played from the .lmp they expand to
+   G_DemoStreamClearKeyframes();
+   if(G_DemoStreamIsStream(demobuffer, demolength) && !G_expandDemoStream())
+   {
+      if(singledemo)
+         I_Error("G_DoPlayDemo: bad streaming demo %s\n", basename);
+      else
+      {
+         C_Printf(FC_ERROR "G_DoPlayDemo: bad streaming demo %s\n", basename);
+         gameaction = ga_nothing;
+         D_AdvanceDemo();
+      }
+      return;
+   }
+
    if(!(demo_p = G_ReadDemoHeader(demobuffer)))
       return;
 
@@ -1374,6 +1436,7 @@ void G_DoPlayDemo(void)
    gameaction = ga_nothing;
 
    G_DemoStartMessage(basename);
+   G_DemoSumBegin(defdemoname, true);
    
    if(timingdemo)
    {
@@ -1513,6 +1576,19 @@ static void G_ReadDemoContinueTiccmd(ticcmd_t *cmd)
    }
 }
 
+//
+// G_writeDemoData
+//
+// Sends recorded demo data to the .lmp or the streaming demo.
+//
+static bool G_writeDemoData(const void *data, size_t size)
+{
+   if(G_DemoStreamActive())
+      return G_DemoStreamWrite(data, size);
+
+   return demofp.write(data, size);
+}
+
 //
 // G_WriteDemoTiccmd
 //
@@ -1568,7 +1644,7 @@ static void G_WriteDemoTiccmd(ticcmd_t *cmd)
       *p++ =  cmd->slotIndex;
    }
 
-   if(!demofp.write(start, p - start))
+   if(!G_writeDemoData(start, p - start))
       I_Error("G_WriteDemoTiccmd: error writing demo\n");
 
    demo_p = start; // alias demo_p so it can be read back
@@ -2197,6 +2273,9 @@ void G_Ticker()
       }
    }
 
+   // report on a savegame finished writing in the background
+   P_CheckSaveFile();
+
    // do player reborns if needed
    for(i = 0; i < MAXPLAYERS; i++)
    {
@@ -2279,6 +2358,10 @@ void G_Ticker()
    {
       // get commands, check consistency, and build new consistancy check
       int buf = (gametic / ticdup) % BACKUPTICS;
+
+      // keyframes go between tics, before any of the next is written
+      if(demorecording)
+         G_DemoStreamTic();
       
       for(i=0; i<MAXPLAYERS; i++)
       {
@@ -3311,12 +3394,26 @@ void G_RecordDemo(const char *name)
 {
    efree(demoname);
    demoname = emalloc(char *, strlen(name) + 8);
-   M_AddDefaultExtension(strcpy(demoname, name), ".lmp");  // 1/18/98 killough
 
-   if(!demofp.createFile(demoname, 0x20000, OutBuffer::NENDIAN))
+   // streaming demos only on request; the .lmp format stays the default
+   if(demo_stream || M_CheckParm("-demostream"))
    {
-      I_Error("G_RecordDemo: cannot open %s\n", demoname);
-      return;
+      M_AddDefaultExtension(strcpy(demoname, name), ".edz");
+      if(!G_DemoStreamCreate(demoname))
+      {
+         I_Error("G_RecordDemo: cannot open %s\n", demoname);
+         return;
+      }
+   }
+   else
+   {
+      M_AddDefaultExtension(strcpy(demoname, name), ".lmp");  // 1/18/98 killough
+
+      if(!demofp.createFile(demoname, 0x20000, OutBuffer::NENDIAN))
+      {
+         I_Error("G_RecordDemo: cannot open %s\n", demoname);
+         return;
+      }
    }
 
    demo_insurance = (default_demo_insurance != 0); // killough 12/98
@@ -3347,6 +3444,22 @@ void G_RecordDemoContinue(const char *in, const char *name)
       return;
    }
    fp.close();
+
+   // continue from the .lmp image of a streaming demo
+   if(G_DemoStreamIsStream(demobuffer, demolength))
+   {
+      std::vector<byte> lmp;
+      if(!G_DemoStreamExpand(demobuffer, demolength, lmp))
+         I_Error("G_RecordDemoContinue: bad streaming demo\n");
+      G_DemoStreamClearKeyframes();
+
+      efree(demobuffer);
+      demolength = lmp.size();
+      demobuffer = emalloc(byte *, demolength);
+      memcpy(demobuffer, lmp.data(), demolength);
+      demo_continue_p = demobuffer;
+   }
+
    if(!(demo_continue_p = G_ReadDemoHeader(demo_continue_p)))
       return;
 
@@ -3663,7 +3776,7 @@ static void G_BeginRecordingOld()
    for(i = 0; i < MAXPLAYERS; i++)
       *demo_p++ = playeringame[i];
 
-   if(!demofp.write(start, 13))
+   if(!G_writeDemoData(start, 13))
       I_Error("G_BeginRecordingOld: error writing demo header\n");
 }
 
@@ -3690,6 +3803,8 @@ void G_BeginRecording()
 {
    int i;
 
+   G_DemoSumBegin(demoname, false);
+
    // haleyjd 02/21/10: -vanilla will record v1.9-format demos
    if(M_CheckParm("-vanilla") || demo_version < 200)
    {
@@ -3760,7 +3875,7 @@ void G_BeginRecording()
    for(; i < MIN_MAXPLAYERS; i++)
       *demo_p++ = 0;
 
-   if(!demofp.write(start, demo_p - start))
+   if(!G_writeDemoData(start, demo_p - start))
       I_Error("G_BeginRecording: error writing demo header\n");
 }
 
@@ -3817,8 +3932,18 @@ bool G_CheckDemoStatus()
    {
       demorecording = false;
 
-      demofp.writeUint8(DEMOMARKER);
-      demofp.close();
+      if(G_DemoStreamActive())
+      {
+         byte marker = DEMOMARKER;
+         if(!G_DemoStreamWrite(&marker, 1) || !G_DemoStreamClose())
+            I_Error("G_CheckDemoStatus: error writing demo %s\n", demoname);
+      }
+      else
+      {
+         demofp.writeUint8(DEMOMARKER);
+         demofp.close();
+      }
+      G_DemoSumEnd();
 
       I_ExitWithMessage("Demo %s recorded\n", demoname);
       return false;  // killough
@@ -3839,6 +3964,9 @@ bool G_CheckDemoStatus()
    {
       bool wassingledemo = singledemo; // haleyjd 01/08/12: must remember this
 
+      G_DemoRunFinished(); // quits if playing for the demo runner
+      G_DemoSumEnd();
+
       // haleyjd 01/08/11: refactored so that stopping netdemos doesn't cause
       // access violations by leaving the game in "netgame" mode.
       Z_ChangeTag(demobuffer, PU_CACHE);
@@ -77,6 +77,7 @@ void G_SetGameMap();
 void G_SpeedSetAddThing(int thingtype, int nspeed, int fspeed); // haleyjd
 uint64_t G_Signature(const WadDirectory *dir);
 void G_DoPlayDemo();
+bool G_DemoSeek(int tic, int &keytic); // streaming demos only
 
 void R_InitPortals();
 
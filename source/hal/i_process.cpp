@@ -0,0 +1,194 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: starting and waiting for child processes.
+//
+
+#include "../z_zone.h"
+
+#include "i_platform.h"
+#include "i_process.h"
+
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+#include <process.h>
+#include <vector>
+#include <windows.h>
+
+#include "../m_qstr.h"
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+//
+// I_SpawnProcess
+//
+processhandle_t I_SpawnProcess(const char *const *argv)
+{
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+   // _spawnv joins the arguments with spaces, so quote any which have them
+   std::vector<qstring>      quoted;
+   std::vector<const char *> args;
+
+   for(int i = 0; argv[i]; i++)
+   {
+      quoted.emplace_back(argv[i]);
+      if(strchr(argv[i], ' '))
+      {
+         quoted.back() = "\"";
+         quoted.back() << argv[i] << "\"";
+      }
+   }
+   for(const qstring &arg : quoted)
+      args.push_back(arg.constPtr());
+   args.push_back(nullptr);
+
+   return _spawnv(_P_NOWAIT, argv[0], args.data());
+#else
+   pid_t pid = fork();
+
+   if(pid == 0)
+   {
+      execvp(argv[0], const_cast<char *const *>(argv));
+      _exit(127); // could not run it
+   }
+   return pid > 0 ? pid : -1;
+#endif
+}
+
+//
+// I_WaitProcesses
+//
+int I_WaitProcesses(const processhandle_t *handles, int count, int &exitcode)
+{
+   if(count <= 0)
+      return -1;
+
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+   HANDLE hs[MAXIMUM_WAIT_OBJECTS];
+   DWORD  result, code;
+
+   if(count > MAXIMUM_WAIT_OBJECTS)
+      count = MAXIMUM_WAIT_OBJECTS;
+   for(int i = 0; i < count; i++)
+      hs[i] = reinterpret_cast<HANDLE>(handles[i]);
+
+   result = WaitForMultipleObjects(count, hs, FALSE, INFINITE);
+   if(result >= WAIT_OBJECT_0 + count)
+      return -1;
+
+   int index = static_cast<int>(result - WAIT_OBJECT_0);
+   exitcode = GetExitCodeProcess(hs[index], &code) ? static_cast<int>(code) : -1;
+   CloseHandle(hs[index]);
+   return index;
+#else
+   for(;;)
+   {
+      int   status;
+      pid_t pid = waitpid(-1, &status, 0);
+
+      if(pid < 0)
+         return -1;
+
+      for(int i = 0; i < count; i++)
+      {
+         if(handles[i] == pid)
+         {
+            exitcode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+            return i;
+         }
+      }
+      // not one of ours; keep waiting
+   }
+#endif
+}
+
+//
+// I_GetProcessID
+//
+int I_GetProcessID()
+{
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+   return _getpid();
+#else
+   return static_cast<int>(getpid());
+#endif
+}
+
+//
+// I_LockFile
+//
+filelock_t I_LockFile(const char *path)
+{
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+   HANDLE h = CreateFileA(path, GENERIC_READ | GENERIC_WRITE,
+                          FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                          OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+   if(h == INVALID_HANDLE_VALUE)
+      return -1;
+
+   OVERLAPPED ov = {};
+   if(!LockFileEx(h, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov))
+   {
+      CloseHandle(h);
+      return -1;
+   }
+   return reinterpret_cast<filelock_t>(h);
+#else
+   int fd = open(path, O_RDWR | O_CREAT, 0644);
+   if(fd < 0)
+      return -1;
+
+   int result;
+   while((result = flock(fd, LOCK_EX)) < 0 && errno == EINTR)
+      ;
+   if(result < 0)
+   {
+      close(fd);
+      return -1;
+   }
+   return fd;
+#endif
+}
+
+//
+// I_UnlockFile
+//
+void I_UnlockFile(filelock_t lock)
+{
+   if(lock == -1)
+      return;
+
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+   HANDLE     h  = reinterpret_cast<HANDLE>(lock);
+   OVERLAPPED ov = {};
+
+   UnlockFileEx(h, 0, 1, 0, &ov);
+   CloseHandle(h);
+#else
+   // closing the descriptor releases the lock
+   close(static_cast<int>(lock));
+#endif
+}
+
+// EOF
+
@@ -0,0 +1,57 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: starting and waiting for child processes.
+//
+
+#ifndef I_PROCESS_H__
+#define I_PROCESS_H__
+
+// Handle to a child process; -1 is never a valid one.
+typedef intptr_t processhandle_t;
+
+// Starts the program argv[0] with the NULL-terminated argument list argv.
+// Returns -1 on failure.
+processhandle_t I_SpawnProcess(const char *const *argv);
+
+// Waits until one of the count given children exits, then returns its index
+// and sets exitcode to its exit status, or -1 if it did not exit normally.
+// Returns -1 on failure.
+int I_WaitProcesses(const processhandle_t *handles, int count, int &exitcode);
+
+// Returns the id of this process, for naming files private to it.
+int I_GetProcessID();
+
+// Handle to a file lock held by this process; -1 is never a valid one.
+typedef intptr_t filelock_t;
+
+// Opens the file, creating it if needed, and waits until this process holds
+// the only lock on it. Other processes locking the same file wait in turn.
+// The lock is advisory: it does not keep anyone from opening the file.
+// Returns -1 on failure.
+filelock_t I_LockFile(const char *path);
+
+// Releases a lock taken by I_LockFile.
+void I_UnlockFile(filelock_t lock);
+
+#endif
+
+// EOF
+
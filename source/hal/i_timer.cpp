@@ -31,6 +31,7 @@
 #include "i_timer.h"
 
 // drivers
+#include "i_vtimer.h"
 #ifdef _SDL_VER
 #include "../sdl/i_sdltimer.h"
 #endif
@@ -89,6 +90,15 @@ static haltimerdriveritem_t halTimerDrivers[] =
    }
 };
 
+// Virtual clock, only used when asked for with -maxspeed
+static haltimerdriveritem_t halVirtualTimer =
+{
+   2,
+   "Virtual Timer",
+   I_VirtualInitTimer,
+   I_VirtualChangeClockRate
+};
+
 //
 // I_InitHALTimer
 //
@@ -107,12 +117,17 @@ void I_InitHALTimer()
       I_GetTime_Scale = ((int64_t)clockRate << CLOCK_BITS) / 100;
 
    // choose the first available timer driver
-   for(size_t i = 0; i < earrlen(halTimerDrivers); i++)
+   if(M_CheckParm("-maxspeed"))
+      timer = &halVirtualTimer;
+   else
    {
-      if(halTimerDrivers[i].Init)
+      for(size_t i = 0; i < earrlen(halTimerDrivers); i++)
       {
-         timer = &halTimerDrivers[i];
-         break;
+         if(halTimerDrivers[i].Init)
+         {
+            timer = &halTimerDrivers[i];
+            break;
+         }
       }
    }
 
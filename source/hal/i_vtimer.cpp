@@ -0,0 +1,142 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: virtual clock timer driver.
+//
+// Used by -maxspeed, where the main loop runs gametics back to back instead
+// of waiting for the wall clock. Game time only moves when the loop says a
+// tic has been run, or when someone sleeps, so code that polls the clock in
+// a sleep loop (wipes, for instance) still finishes. Only GetRealTime follows
+// the wall clock, so that -timedemo keeps reporting real frame rates.
+//
+
+#include <chrono>
+
+#include "../z_zone.h"
+#include "../doomdef.h"
+
+#include "i_timer.h"
+#include "i_vtimer.h"
+
+// Virtual time is kept in units of 1/(1000 * TICRATE) seconds, so that both
+// whole gametics and whole milliseconds advance it exactly.
+static uint64_t virtualtime;
+
+static std::chrono::steady_clock::time_point realbase;
+
+//
+// I_VirtualGetTime
+//
+static int I_VirtualGetTime()
+{
+   return (int)(virtualtime / 1000);
+}
+
+//
+// I_VirtualGetRealTime
+//
+// Wall clock gametics since the timer was initialized.
+//
+static int I_VirtualGetRealTime()
+{
+   auto elapsed = std::chrono::steady_clock::now() - realbase;
+   return (int)(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() *
+                TICRATE / 1000);
+}
+
+//
+// I_VirtualGetTicks
+//
+static unsigned int I_VirtualGetTicks()
+{
+   return (unsigned int)(virtualtime / TICRATE);
+}
+
+//
+// I_VirtualSleep
+//
+// Sleeping does not wait; it just lets the virtual time pass.
+//
+static void I_VirtualSleep(int ms)
+{
+   if(ms > 0)
+      virtualtime += (uint64_t)ms * TICRATE;
+}
+
+//
+// I_VirtualGetFrac
+//
+// Frames are only ever drawn on tic boundaries, so never interpolate.
+//
+static fixed_t I_VirtualGetFrac()
+{
+   return FRACUNIT;
+}
+
+//
+// I_VirtualNoOp
+//
+static void I_VirtualNoOp()
+{
+}
+
+//=============================================================================
+//
+// Global Interface
+//
+
+//
+// I_VirtualInitTimer
+//
+void I_VirtualInitTimer()
+{
+   virtualtime = 0;
+   realbase    = std::chrono::steady_clock::now();
+
+   i_haltimer.GetTime      = I_VirtualGetTime;
+   i_haltimer.GetRealTime  = I_VirtualGetRealTime;
+   i_haltimer.GetTicks     = I_VirtualGetTicks;
+   i_haltimer.Sleep        = I_VirtualSleep;
+   i_haltimer.StartDisplay = I_VirtualNoOp;
+   i_haltimer.EndDisplay   = I_VirtualNoOp;
+   i_haltimer.GetFrac      = I_VirtualGetFrac;
+   i_haltimer.SaveMS       = I_VirtualNoOp;
+}
+
+//
+// I_VirtualChangeClockRate
+//
+// The virtual clock is not paced, so there is no rate to change.
+//
+void I_VirtualChangeClockRate()
+{
+}
+
+//
+// I_VirtualAdvanceTics
+//
+void I_VirtualAdvanceTics(int tics)
+{
+   if(tics > 0)
+      virtualtime += (uint64_t)tics * 1000;
+}
+
+// EOF
+
@@ -41,6 +41,9 @@ typedef struct i_sounddriver_s
    int  (*SoundIsPlaying)(int);
    void (*UpdateSoundParams)(int, int, int, int);
    void (*UpdateEQParams)(void);
+   void (*SeekSound)(int, int, unsigned int);
+   void (*TicSound)(void);
+   void (*WaitSoundCommands)(void);
 } i_sounddriver_t;
 
 // Init at program start...
@@ -70,6 +73,16 @@ int I_SoundID(int handle);
 // Stops a sound channel.
 void I_StopSound(int handle, int id);
 
+// Moves a sound just started some milliseconds into its data.
+void I_SeekSound(int handle, int id, unsigned int ms);
+
+// Called once per game tic run, for drivers that mix in step with the game.
+void I_SoundTic();
+
+// Returns once the driver has acted on every call made so far, so that data
+// of stopped sounds may be freed.
+void I_WaitSoundCommands();
+
 // Called by S_*() functions
 //  to see if a channel is still playing.
 // Returns 0 if no longer playing, 1 if playing.
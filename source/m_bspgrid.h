@@ -0,0 +1,164 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: uniform grid giving a starting point for point-in-subsector
+//  lookups, so that they do not always begin at the root of the BSP.
+//
+
+#ifndef M_BSPGRID_H__
+#define M_BSPGRID_H__
+
+#include <vector>
+
+#include "doomdata.h"
+#include "m_fixed.h"
+
+// Cells beyond this count are merged by doubling the cell size.
+#define BSPGRID_MAXCELLS (1 << 18)
+
+//
+// BSPGrid
+//
+// Each cell holds the deepest node whose subtree contains the whole cell, or
+// the subsector number tagged with NF_SUBSECTOR if a single leaf covers it.
+// A node is only skipped when every point of the cell goes the same way
+// through it according to the side function the lookup itself uses, so a
+// lookup started from a cell always ends in the same subsector as one
+// started from the root.
+//
+class BSPGrid
+{
+protected:
+   fixed_t orgx, orgy;     // lower left corner
+   int     width, height;  // in cells
+   int     shift;          // log2 of the cell size in fixed point units
+   std::vector<int> cells;
+
+   //
+   // rectSide
+   //
+   // Returns the side of node that the whole rectangle lies on, or -1 if it
+   // straddles the partition or cannot be decided safely. Side functions of
+   // the R_PointOnSide family are monotonic along each axis within one
+   // quadrant around the partition origin, so agreement of the four corners
+   // is then enough. Quadrants are required to keep the sign shortcut fixed,
+   // and the bounds to keep the relative coordinates from overflowing.
+   //
+   template<typename N, typename S>
+   static int rectSide(const N &node, fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
+                       S pointOnSide)
+   {
+      const int64_t limit = 0x3fffffff;
+      int64_t rx1 = int64_t(x1) - node.x, rx2 = int64_t(x2) - node.x;
+      int64_t ry1 = int64_t(y1) - node.y, ry2 = int64_t(y2) - node.y;
+
+      if((rx1 < 0) != (rx2 < 0) || (ry1 < 0) != (ry2 < 0))
+         return -1;
+      if(rx1 < -limit || rx2 > limit || ry1 < -limit || ry2 > limit)
+         return -1;
+
+      int side = pointOnSide(x1, y1, node);
+      if(pointOnSide(x2, y1, node) != side || pointOnSide(x1, y2, node) != side ||
+         pointOnSide(x2, y2, node) != side)
+         return -1;
+      return side;
+   }
+
+public:
+   BSPGrid() : orgx(0), orgy(0), width(0), height(0), shift(0) {}
+
+   void clear()
+   {
+      cells.clear();
+      width = height = 0;
+   }
+
+   //
+   // build
+   //
+   // Covers the area of blockwidth by blockheight blocks of 1 << blockshift
+   // units starting at (inorgx, inorgy). child(node, side) returns the child
+   // number on the given side and pointOnSide(x, y, node) must be the side
+   // function used by the lookup.
+   //
+   template<typename N, typename C, typename S>
+   void build(fixed_t inorgx, fixed_t inorgy, int blockwidth, int blockheight,
+              int blockshift, const N *nodes, int numnodes, C child, S pointOnSide)
+   {
+      clear();
+      if(numnodes <= 0 || blockwidth <= 0 || blockheight <= 0)
+         return;
+
+      orgx   = inorgx;
+      orgy   = inorgy;
+      shift  = blockshift;
+      width  = blockwidth;
+      height = blockheight;
+      while(int64_t(width) * height > BSPGRID_MAXCELLS && shift < 30)
+      {
+         ++shift;
+         width  = (width + 1) / 2;
+         height = (height + 1) / 2;
+      }
+      cells.resize(size_t(width) * height);
+
+      const int64_t size = int64_t(1) << shift;
+      for(int cy = 0; cy < height; cy++)
+      {
+         for(int cx = 0; cx < width; cx++)
+         {
+            int64_t x1 = orgx + cx * size, y1 = orgy + cy * size;
+            int64_t x2 = x1 + size - 1,    y2 = y1 + size - 1;
+            int nodenum = numnodes - 1;
+
+            // cells not entirely inside the fixed point range start at the root
+            if(x1 >= INT32_MIN && y1 >= INT32_MIN && x2 <= INT32_MAX && y2 <= INT32_MAX)
+            {
+               int side;
+               while(!(nodenum & NF_SUBSECTOR) &&
+                     (side = rectSide(nodes[nodenum], fixed_t(x1), fixed_t(y1),
+                                      fixed_t(x2), fixed_t(y2), pointOnSide)) >= 0)
+                  nodenum = child(nodes[nodenum], side);
+            }
+            cells[size_t(cy) * width + cx] = nodenum;
+         }
+      }
+   }
+
+   //
+   // startNode
+   //
+   // Node (or tagged subsector) to begin the BSP walk for a point at.
+   //
+   int startNode(fixed_t x, fixed_t y, int root) const
+   {
+      int64_t cx = (int64_t(x) - orgx) >> shift;
+      int64_t cy = (int64_t(y) - orgy) >> shift;
+
+      if(cx < 0 || cy < 0 || cx >= width || cy >= height)
+         return root;
+      return cells[size_t(cy) * width + size_t(cx)];
+   }
+};
+
+#endif
+
+// EOF
+
@@ -247,7 +247,7 @@ bool OutBuffer::write(const void *data, size_t size)
       {
          if(!flush())
             return false;
-         lWriteAmt = len;
+         lWriteAmt = len - idx; // memory buffers grow rather than empty
       }
 
       if(lBytesToWrite < lWriteAmt)
@@ -528,5 +528,84 @@ bool InBuffer::readSint8(int8_t &num)
    return true;
 }
 
+//=============================================================================
+//
+// MemOutBuffer
+//
+// Output into a growable memory block instead of a file.
+//
+
+//
+// Starts a new output. The block from any previous output is kept and reused,
+// so a buffer that is written repeatedly stops allocating once it has grown
+// to the largest size needed.
+//
+void MemOutBuffer::openMemory(size_t initialLen, int pEndian)
+{
+   if(!buffer)
+      initBuffer(initialLen ? initialLen : 1, pEndian);
+   else
+   {
+      idx    = 0;
+      endian = pEndian;
+   }
+}
+
+//
+// Called when the block is full; doubles it in place of writing anything out.
+//
+bool MemOutBuffer::flush()
+{
+   if(idx == len)
+   {
+      len = len ? len * 2 : 1;
+      buffer = erealloc(byte *, buffer, len);
+   }
+
+   return true;
+}
+
+//
+// Ends the output but keeps the data, unlike OutBuffer::close.
+//
+void MemOutBuffer::close()
+{
+}
+
+//=============================================================================
+//
+// MemInBuffer
+//
+// Input from a memory block instead of a file.
+//
+
+//
+// Attaches the input to a block owned by the caller, which must outlive it.
+//
+void MemInBuffer::openMemory(const byte *pData, size_t pSize, int pEndian)
+{
+   data     = pData;
+   dataSize = pSize;
+   dataPos  = 0;
+   endian   = pEndian;
+}
+
+//
+// Copies out up to size bytes from the current position.
+//
+size_t MemInBuffer::read(void *dest, size_t size)
+{
+   size_t r = dataSize - dataPos;
+
+   if(r > size)
+      r = size;
+   memcpy(dest, data + dataPos, r);
+   dataPos += r;
+
+   if(throwing && r != size)
+      throw BufferedIOException("Error reading");
+   return r;
+}
+
 // EOF
 
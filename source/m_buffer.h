@@ -180,6 +180,46 @@ public:
    }
 };
 
+//
+// MemOutBuffer
+//
+// Binary output into memory. The block grows as needed and stays allocated
+// between uses.
+//
+class MemOutBuffer : public OutBuffer
+{
+public:
+   void openMemory(size_t initialLen, int pEndian);
+   virtual bool flush();
+   virtual void close();
+
+   const byte *getData() const { return buffer; }
+   size_t      getSize() const { return idx;    }
+};
+
+//
+// MemInBuffer
+//
+// Binary input from a block of memory.
+//
+class MemInBuffer : public InBuffer
+{
+protected:
+   const byte *data;
+   size_t      dataSize;
+   size_t      dataPos;
+
+public:
+   MemInBuffer() : InBuffer(), data(nullptr), dataSize(0), dataPos(0)
+   {
+   }
+
+   void openMemory(const byte *pData, size_t pSize, int pEndian);
+   virtual size_t read(void *dest, size_t size);
+
+   size_t getPos() const { return dataPos; }
+};
+
 #endif
 
 // EOF
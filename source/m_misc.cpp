@@ -61,6 +61,7 @@
 #include "p_user.h"
 #include "r_draw.h"
 #include "r_main.h"
+#include "r_portal.h"
 #include "r_sky.h"
 #include "r_things.h"
 #include "s_sound.h"
@@ -808,6 +809,12 @@ default_t defaults[] =
                0, 0, NUMSPANENGINES - 1, default_t::wad_no, 
                "0 = high precision, 1 = low precision"),
 
+   DEFAULT_INT("r_portaldepth", &r_portaldepth, NULL, 0, 0, 128, default_t::wad_no,
+               "maximum portal nesting depth (0 = unlimited)"),
+
+   DEFAULT_INT("r_portaltime", &r_portaltime, NULL, 0, 0, 1000, default_t::wad_no,
+               "maximum milliseconds spent drawing portals per frame (0 = unlimited)"),
+
    DEFAULT_INT("r_tlstyle", &r_tlstyle, NULL, 1, 0, R_TLSTYLE_NUM - 1, default_t::wad_yes,
                "Doom object translucency style (0 = none, 1 = Boom, 2 = new)"),
    
@@ -32,6 +32,8 @@
 #include "d_main.h"
 #include "d_net.h"
 #include "d_gi.h"
+#include "e_edfcache.h"
+#include "g_demostream.h"
 #include "gl/gl_vars.h"
 #include "hal/i_gamepads.h"
 #include "hal/i_picker.h"
@@ -41,10 +43,14 @@
 #include "m_misc.h"
 #include "m_shots.h"
 #include "mn_menus.h"
+#include "p_snapshot.h"
+#include "p_tick.h"
 #include "s_sound.h"
 #include "s_sndseq.h"
 #include "w_wad.h"
 #include "w_levels.h"
+#include "r_texcache.h"
+#include "w_zip.h"
 
 // External variables configured here:
 
@@ -154,6 +160,30 @@ static default_t sysdefaults[] =
    DEFAULT_STR("w_norestpath", &w_norestpath, NULL, "", default_t::wad_no,
                "Path to 'No Rest for the Living'"),
 
+   DEFAULT_INT("w_zipcachesize", &w_zipcachesize, NULL, 32, 0, 1024, default_t::wad_no,
+               "Megabytes of inflated ZIP/PK3 lumps to keep cached (0 = off)"),
+
+   DEFAULT_BOOL("r_texcache", &r_texcache, NULL, true, default_t::wad_no,
+                "Keep composed wall textures on disk to speed up startup"),
+
+   DEFAULT_BOOL("e_edfcache", &e_edfcache, NULL, true, default_t::wad_no,
+                "Keep the parsed EDF on disk to speed up startup"),
+
+   DEFAULT_BOOL("p_thinkersched", &p_thinkersched, NULL, false, default_t::wad_no,
+                "Skip thinking for idle monsters until they have work to do"),
+
+   DEFAULT_INT("p_snapshotrate", &p_snapshotrate, NULL, 0, 0, 60, default_t::wad_no,
+               "Seconds between level snapshots kept for rewinding (0 = off)"),
+
+   DEFAULT_INT("p_snapshotmax", &p_snapshotmax, NULL, 300, 1, 3600, default_t::wad_no,
+               "Number of level snapshots kept for rewinding"),
+
+   DEFAULT_BOOL("demo_stream", &demo_stream, NULL, false, default_t::wad_no,
+                "Record streaming compressed demos (.edz) instead of .lmp"),
+
+   DEFAULT_INT("demo_keyframetime", &demo_keyframetime, NULL, 60, 0, 3600, default_t::wad_no,
+               "Seconds between level keyframes in streaming demos (0 = off)"),
+
    // 11/04/09: system-level options moved here from the main config
 
    DEFAULT_INT("textmode_startup", &textmode_startup, NULL, 0, 0, 1, default_t::wad_no,
@@ -163,9 +193,12 @@ static default_t sysdefaults[] =
                "Percentage of normal speed (35 fps) realtic clock runs at"),
 
    // killough
-   DEFAULT_INT("snd_channels", &default_numChannels, NULL, 32, 1, 32, default_t::wad_no,
+   DEFAULT_INT("snd_channels", &default_numChannels, NULL, 32, 1, 128, default_t::wad_no,
                "number of sound effects handled simultaneously"),
 
+   DEFAULT_INT("snd_virtualchannels", &default_numVirtualChannels, NULL, 0, 0, 256, default_t::wad_no,
+               "number of extra sound effects tracked silently until a channel frees up"),
+
    // haleyjd 12/08/01
    DEFAULT_INT("force_flip_pan", &forceFlipPan, NULL, 0, 0, 1, default_t::wad_no,
                "Force reversal of stereo audio channels: 0 = normal, 1 = reverse"),
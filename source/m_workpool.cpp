@@ -0,0 +1,268 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: worker thread pool for background and data-parallel jobs.
+//
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "z_zone.h"
+#include "m_argv.h"
+#include "m_compare.h"
+#include "m_workpool.h"
+
+// Upper bound on worker threads; beyond this, startup jobs are I/O bound.
+#define MAXWORKERTHREADS 31
+
+//=============================================================================
+//
+// WorkerPool
+//
+
+class WorkerPoolPimpl
+{
+public:
+   std::vector<std::thread>   threads;
+   std::deque<WorkerPool::job_t> jobs;
+   std::mutex                 mutex;
+   std::condition_variable    jobReady; // signalled when jobs is non-empty
+   std::condition_variable    jobsDone; // signalled when pending drops to 0
+   size_t                     pending;  // queued plus running jobs
+   bool                       quit;
+
+   WorkerPoolPimpl() : threads(), jobs(), mutex(), jobReady(), jobsDone(),
+                       pending(0), quit(false)
+   {
+   }
+
+   void workerLoop();
+};
+
+//
+// WorkerPoolPimpl::workerLoop
+//
+// Body of each worker thread.
+//
+void WorkerPoolPimpl::workerLoop()
+{
+   for(;;)
+   {
+      WorkerPool::job_t job;
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         jobReady.wait(lock, [this] () {
+            return quit || !jobs.empty();
+         });
+         if(jobs.empty()) // quit requested and nothing left to do
+            return;
+         job = std::move(jobs.front());
+         jobs.pop_front();
+      }
+
+      job();
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if(--pending == 0)
+         jobsDone.notify_all();
+   }
+}
+
+//
+// WorkerPool::WorkerPool
+//
+WorkerPool::WorkerPool(int numThreads) : pImpl(new WorkerPoolPimpl)
+{
+   numThreads = eclamp(numThreads, 0, MAXWORKERTHREADS);
+   for(int i = 0; i < numThreads; i++)
+      pImpl->threads.emplace_back(&WorkerPoolPimpl::workerLoop, pImpl);
+}
+
+//
+// WorkerPool::~WorkerPool
+//
+// Finishes all queued jobs before joining the threads.
+//
+WorkerPool::~WorkerPool()
+{
+   {
+      std::lock_guard<std::mutex> lock(pImpl->mutex);
+      pImpl->quit = true;
+   }
+   pImpl->jobReady.notify_all();
+   for(std::thread &thread : pImpl->threads)
+      thread.join();
+
+   delete pImpl;
+}
+
+//
+// WorkerPool::getNumThreads
+//
+int WorkerPool::getNumThreads() const
+{
+   return static_cast<int>(pImpl->threads.size());
+}
+
+//
+// WorkerPool::submit
+//
+void WorkerPool::submit(job_t job)
+{
+   if(pImpl->threads.empty())
+   {
+      job();
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(pImpl->mutex);
+      pImpl->jobs.push_back(std::move(job));
+      ++pImpl->pending;
+   }
+   pImpl->jobReady.notify_one();
+}
+
+//
+// WorkerPool::wait
+//
+void WorkerPool::wait()
+{
+   std::unique_lock<std::mutex> lock(pImpl->mutex);
+   pImpl->jobsDone.wait(lock, [this] () { return pImpl->pending == 0; });
+}
+
+//
+// WorkerPool::parallelFor
+//
+// Indices are handed out dynamically so uneven job sizes balance themselves.
+// The calling thread takes part, so this never deadlocks even if the queue is
+// occupied by long-running background jobs.
+//
+void WorkerPool::parallelFor(size_t count, const indexjob_t &fn)
+{
+   if(!count)
+      return;
+
+   size_t numHelpers = emin(pImpl->threads.size(), count - 1);
+   if(!numHelpers)
+   {
+      for(size_t i = 0; i < count; i++)
+         fn(i);
+      return;
+   }
+
+   struct forstate_t
+   {
+      std::atomic<size_t>     next;
+      std::mutex              mutex;
+      std::condition_variable done;
+      size_t                  running;
+   };
+   auto state = std::make_shared<forstate_t>();
+   state->next    = 0;
+   state->running = numHelpers;
+
+   auto body = [state, count, &fn] () {
+      size_t i;
+      while((i = state->next++) < count)
+         fn(i);
+   };
+
+   for(size_t h = 0; h < numHelpers; h++)
+   {
+      submit([state, body] () {
+         body();
+         std::lock_guard<std::mutex> lock(state->mutex);
+         if(--state->running == 0)
+            state->done.notify_all();
+      });
+   }
+
+   body();
+
+   std::unique_lock<std::mutex> lock(state->mutex);
+   state->done.wait(lock, [&state] () { return state->running == 0; });
+}
+
+//=============================================================================
+//
+// Global Pool
+//
+
+static std::unique_ptr<WorkerPool> globalPool;
+static int workerThreadCount = -1;
+
+//
+// M_WorkerThreadCount
+//
+// Number of worker threads the global pool uses, in addition to the main
+// thread. "-threads N" asks for N threads in total; -threads 1 disables the
+// pool altogether.
+//
+int M_WorkerThreadCount()
+{
+   if(workerThreadCount < 0)
+   {
+      int p;
+
+      if((p = M_CheckParm("-threads")) && p < myargc - 1)
+         workerThreadCount = atoi(myargv[p + 1]) - 1;
+      else
+         workerThreadCount = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+
+      workerThreadCount = eclamp(workerThreadCount, 0, MAXWORKERTHREADS);
+   }
+
+   return workerThreadCount;
+}
+
+//
+// M_SetWorkerThreadCount
+//
+// Resize the global pool. Must be called from the main thread while no jobs
+// are outstanding.
+//
+void M_SetWorkerThreadCount(int numThreads)
+{
+   workerThreadCount = eclamp(numThreads, 0, MAXWORKERTHREADS);
+   globalPool.reset();
+}
+
+//
+// M_GetWorkerPool
+//
+// Returns the shared pool, creating it on first use.
+//
+WorkerPool &M_GetWorkerPool()
+{
+   if(!globalPool)
+      globalPool.reset(new WorkerPool(M_WorkerThreadCount()));
+
+   return *globalPool;
+}
+
+// EOF
+
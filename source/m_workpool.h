@@ -0,0 +1,78 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: worker thread pool for background and data-parallel jobs.
+//
+// NOTE: jobs run on worker threads must not touch the zone heap, call
+// I_Error, or modify any game state. Gather inputs on the main thread, do
+// pure computation on the workers into memory they own, and install the
+// results back on the main thread.
+//
+
+#ifndef M_WORKPOOL_H__
+#define M_WORKPOOL_H__
+
+#include <functional>
+
+class WorkerPoolPimpl;
+
+//
+// WorkerPool
+//
+// A fixed set of threads consuming a FIFO job queue. A pool created with zero
+// threads runs every job synchronously on the calling thread, which keeps the
+// single-threaded code path available for validation and timing.
+//
+class WorkerPool
+{
+private:
+   WorkerPoolPimpl *pImpl;
+
+public:
+   typedef std::function<void ()>       job_t;
+   typedef std::function<void (size_t)> indexjob_t;
+
+   explicit WorkerPool(int numThreads);
+   ~WorkerPool();
+
+   WorkerPool(const WorkerPool &) = delete;
+   WorkerPool &operator = (const WorkerPool &) = delete;
+
+   int  getNumThreads() const;
+
+   // Queue a job for asynchronous execution.
+   void submit(job_t job);
+
+   // Block until every job submitted so far has completed.
+   void wait();
+
+   // Run fn(0) ... fn(count - 1) spread across the workers and the calling
+   // thread; returns when all indices have been processed.
+   void parallelFor(size_t count, const indexjob_t &fn);
+};
+
+int         M_WorkerThreadCount();
+void        M_SetWorkerThreadCount(int numThreads);
+WorkerPool &M_GetWorkerPool();
+
+#endif
+
+// EOF
+
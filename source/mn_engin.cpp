@@ -684,6 +684,24 @@ static void MN_SetBackground()
 // Primary menu initialization. Called at startup.
 //
 void MN_Init()
+{
+   quickSaveSlot = -1; // haleyjd: -1 == no slot selected yet
+
+   MN_InitMenus();     // create menu commands in mn_menus.c
+   MN_InitFonts();     // create menu fonts
+   MN_SetBackground(); // set background
+
+   // haleyjd 07/03/09: sync up mn_classic_menus
+   MN_LinkClassicMenus(mn_classic_menus);
+}
+
+//
+// MN_InitGraphics
+//
+// Loads the graphics the menus draw with. Separate from MN_Init so that it
+// can be put off until the menus are first shown.
+//
+void MN_InitGraphics()
 {
    int i;
 
@@ -703,19 +721,10 @@ void MN_Init()
       smallptr_dims[0] = ptr0->width;
       smallptr_dims[1] = ptr0->height;
    }
-      
-   quickSaveSlot = -1; // haleyjd: -1 == no slot selected yet
 
    // haleyjd: init heretic stuff if appropriate
    if(GameModeInfo->type == Game_Heretic)
       MN_HInitSkull(); // initialize spinning skulls
-   
-   MN_InitMenus();     // create menu commands in mn_menus.c
-   MN_InitFonts();     // create menu fonts
-   MN_SetBackground(); // set background
-
-   // haleyjd 07/03/09: sync up mn_classic_menus
-   MN_LinkClassicMenus(mn_classic_menus);
 }
 
 //////////////////////////////////
@@ -1153,6 +1162,7 @@ void MN_ActivateMenu()
 {
    if(!menuactive)  // activate menu if not already
    {
+      D_InitDeferred();
       menuactive = true;
       S_StartInterfaceSound(GameModeInfo->menuSounds[MN_SND_ACTIVATE]);
    }
@@ -205,6 +205,7 @@ bool MN_CheckFullScreen();
 // loads the config file.
 
 void MN_Init();
+void MN_InitGraphics();
 
 // Called by intro code to force menu up upon a keypress,
 // does nothing if menu is already up.
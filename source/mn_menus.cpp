@@ -63,6 +63,7 @@
 #include "mn_menus.h"
 #include "mn_misc.h"
 #include "mn_files.h"
+#include "p_savefile.h"
 #include "p_setup.h"
 #include "p_skin.h"
 #include "r_defs.h"
@@ -1343,6 +1344,9 @@ void MN_CreateSaveCmds()
 //
 static void MN_ReadSaveStrings()
 {
+   // a save may still be being written
+   P_FinishSaveFile();
+
    for(int i = 0; i < SAVESLOTS; i++)
    {
       char *name = NULL;    // killough 3/22/98
@@ -1467,6 +1467,7 @@ void P_BossTeleport(bossteleport_t *bt)
          bt->hereThere != BOSSTELE_NONE)
          P_SpawnMobj(boss->x, boss->y, boss->z + bt->zpamt, bt->fxtype);
 
+      boss->wake();
       boss->z = boss->floorz;
       boss->angle = targ->angle;
       boss->momx = boss->momy = boss->momz = 0;
@@ -1953,6 +1954,7 @@ CONSOLE_COMMAND(vilehit, cf_notnet|cf_level)
    
    S_StartSound(plyr->mo, sfx_barexp);
    P_DamageMobj(clip.linetarget, plyr->mo, plyr->mo, 20, MOD_UNKNOWN);
+   clip.linetarget->wake();
    clip.linetarget->momz = 1000*FRACUNIT/clip.linetarget->info->mass;
 
    P_RadiusAttack(clip.linetarget, plyr->mo, 70, 70, MOD_UNKNOWN, 0);
@@ -1201,6 +1201,8 @@ static bool P_TouchWhirlwind(dmgspecdata_t *dmgspec)
 {
    Mobj *target = dmgspec->target;
    
+   target->wake();
+
    // toss the target around
    
    target->angle += P_SubRandom(pr_whirlwind) << 20;
@@ -1314,6 +1316,8 @@ void P_DamageMobj(Mobj *target, Mobj *inflictor, Mobj *source,
    
    if(target->health <= 0)
       return;
+
+   target->wake();
    
    // haleyjd: 
    // Invulnerability -- telestomp can still kill to avoid getting stuck
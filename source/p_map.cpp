@@ -1509,6 +1509,7 @@ static bool P_checkCarryUp(Mobj &thing, fixed_t floorz)
          resetcoll(other);
          return false;
       }
+      other->wake();
       orgzcoll.add(other->z);
       other->z = thing.z + thing.height; // move it on top
       P_ZMovementTest(other); // it may bob back down due to ceiling
@@ -2060,6 +2061,7 @@ static bool P_ThingHeightClip(Mobj *thing)
    bool onfloor = thing->z == thing->floorz;
    fixed_t oldfloorz = thing->floorz; // haleyjd
 
+   thing->wake();
    P_CheckPosition(thing, thing->x, thing->y);
   
    // what about stranding a monster partially off an edge?
@@ -843,6 +843,8 @@ static bool P_AdjustFloorCeil(Mobj *thing, bool midtex)
    if(midtex)
       thing->flags3 |= MF3_PASSMOBJ;
 
+   thing->wake();
+
    // don't trigger push specials when moving strictly vertically.
    isgood = P_CheckPosition3D(thing, thing->x, thing->y);
 
@@ -530,6 +530,8 @@ void P_UnsetThingPosition(Mobj *thing)
 {
    P_LogThingPosition(thing, "unset");
 
+   thing->wake(); // anything that moves it may leave it off the floor
+
    if(!(thing->flags & MF_NOSECTOR))
    {
       // invisible things don't need to be in sector list
@@ -284,6 +284,8 @@ bool P_SetMobjState(Mobj* mobj, statenum_t state)
    DLListItem<seenstate_t> *seenstates  = NULL; // list of seenstates for this instance
    bool ret = true;                           // return value
 
+   mobj->wake(); // in case it is set from outside its own Think
+
    if(firsttime)
    {
       P_InitSeenStates();
@@ -363,6 +365,8 @@ bool P_SetMobjStateNF(Mobj *mobj, statenum_t state)
 {
    state_t *st;
 
+   mobj->wake();
+
    if(state == NullStateNum)
    {
       // remove mobj
@@ -447,6 +451,7 @@ void P_ExplodeMissile(Mobj *mo, const sector_t *topedgesec)
 
 void P_ThrustMobj(Mobj *mo, angle_t angle, fixed_t move)
 {
+   mo->wake();
    angle >>= ANGLETOFINESHIFT;
    mo->momx += FixedMul(move, finecosine[angle]);
    mo->momy += FixedMul(move, finesine[angle]);
@@ -1340,6 +1345,29 @@ bool Mobj::shouldApplyTorque()
    return z > dropoffz;
 }
 
+//
+// Mobj::canPark
+//
+// True if the next Think calls until its state changes would do nothing but
+// count down tics: it is alive, resting on the floor with no momentum and
+// not in any sector which would act on it from within Think. Anything else
+// which may disturb it must wake it (see Thinker::wake).
+//
+bool Mobj::canPark() const
+{
+   const sector_t *sec = subsector->sector;
+
+   if(player || intflags & MIF_MUSICCHANGER || tics < 2)
+      return false;
+   if(momx | momy | momz || z != floorz || !sentient(this))
+      return false;
+   if(flags & (MF_SKULLFLY | MF_MISSILE | MF_BOUNCES | MF_CORPSE) ||
+      flags2 & (MF2_FLOATBOB | MF2_PUSHABLE) || flags3 & MF3_WINDTHRUST)
+      return false;
+
+   return sec->heightsec == -1 && !((sec->f_pflags | sec->c_pflags) & PS_PASSABLE);
+}
+
 // Mobj RTTI Proxy Type
 IMPLEMENT_THINKER_TYPE(Mobj)
 
@@ -1986,6 +2014,22 @@ static mapthing_t itemrespawnque[ITEMQUESIZE];
 static int itemrespawntime[ITEMQUESIZE];
 int iquehead, iquetail;
 
+//
+// P_ArchiveItemRespawnQueue
+//
+// Savegames never stored the deathmatch item queue, but level snapshots do,
+// so that restoring one respawns the same items at the same times.
+//
+void P_ArchiveItemRespawnQueue(SaveArchive &arc)
+{
+   arc << iquehead << iquetail;
+
+   iquehead &= ITEMQUESIZE - 1;
+   iquetail &= ITEMQUESIZE - 1;
+   for(int i = iquetail; i != iquehead; i = (i + 1) & (ITEMQUESIZE - 1))
+      arc << itemrespawnque[i] << itemrespawntime[i];
+}
+
 //
 // P_RemoveMobj
 //
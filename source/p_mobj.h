@@ -214,6 +214,11 @@ protected:
    // Methods
    void Think() override;
 
+   // Idle-thinker scheduling
+   bool canPark() const override;
+   int  parkTics() const override { return tics; }
+   void skipThinks(int count) override { tics -= count; }
+
    bool shouldApplyTorque();
 
 public:   
@@ -430,6 +435,8 @@ void P_StartMobjFade(Mobj *mo, int alphavelocity);
 extern int iquehead;
 extern int iquetail;
 
+void P_ArchiveItemRespawnQueue(SaveArchive &arc);
+
 enum bloodaction_e : int
 {
    BLOOD_SHOT,   // bullet
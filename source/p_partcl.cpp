@@ -56,15 +56,24 @@
 //
 //----------------------------------------------------------------------------
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define P_PARTCL_SSE2
+#endif
+
+#include <chrono>
+
 #include "z_zone.h"
 
 #include "a_small.h"
 #include "autopalette.h"
+#include "c_io.h"
 #include "c_runcmd.h"
 #include "d_main.h"
 #include "doomstat.h"
 #include "doomtype.h"
 #include "e_ttypes.h"
+#include "m_compare.h"
 #include "m_random.h"
 #include "p_chase.h"
 #include "p_info.h"
@@ -308,7 +317,7 @@ static vec3_t bytedirs[NUMVERTEXNORMALS] =
 // End Quake 2 data.
 //
 
-static particle_t *JitterParticle(int ttl);
+static int JitterParticle(int ttl);
 static void P_RunEffect(Mobj *actor, unsigned int effects);
 static void P_FlyEffect(Mobj *actor);
 static void P_BFGEffect(Mobj *actor);
@@ -346,16 +355,20 @@ void P_InitParticleEffects(void)
    P_GenVelocities();
 }
 
+// Particles moved to a different sector by the last P_ParticleThinker
+static int ptclrelinks;
+
 //
 // P_UnsetParticlePosition
 //
 // haleyjd 02/20/04: maintenance of particle sector links,
 // necessitated by portals.
 //
-static void P_UnsetParticlePosition(particle_t *ptcl)
+static void P_UnsetParticlePosition(int ptcl)
 {
-   ptcl->seclinks.remove();
-   ptcl->subsector = NULL;
+   if(Particles.links[ptcl].seclinks.dllPrev)
+      Particles.links[ptcl].seclinks.remove();
+   Particles.subsector[ptcl] = NULL;
 }
 
 //
@@ -366,138 +379,231 @@ static void P_UnsetParticlePosition(particle_t *ptcl)
 // field in the particle_t will be useful in the future,
 // I am sure.
 //
-static void P_SetParticlePosition(particle_t *ptcl)
+// The particle is only moved to another sector list if it has crossed into a
+// different sector; otherwise just its subsector is updated.
+//
+static void P_SetParticlePosition(int ptcl)
+{
+   subsector_t *ss  = R_PointInSubsector(Particles.x[ptcl], Particles.y[ptcl]);
+   subsector_t *old = Particles.subsector[ptcl];
+
+   if(!old || old->sector != ss->sector)
+   {
+      particle_t *link = &Particles.links[ptcl];
+
+      if(link->seclinks.dllPrev)
+      {
+         link->seclinks.remove();
+         ++ptclrelinks;
+      }
+      link->seclinks.insert(link, &(ss->sector->ptcllist));
+   }
+   Particles.subsector[ptcl] = ss;
+}
+
+//
+// P_moveParticle
+//
+// Moves a particle to another slot, keeping its place in its sector list.
+//
+static void P_moveParticle(int from, int to)
 {
-   subsector_t *ss = R_PointInSubsector(ptcl->x, ptcl->y);
+   DLListItem<particle_t> &dst = Particles.links[to].seclinks;
+
+   dst = Particles.links[from].seclinks;
+   if(dst.dllPrev)
+   {
+      *dst.dllPrev = &dst;
+      if(dst.dllNext)
+         dst.dllNext->dllPrev = &dst.dllNext;
+      dst.dllObject = &Particles.links[to];
+   }
 
-   ptcl->seclinks.insert(ptcl, &(ss->sector->ptcllist));
-   ptcl->subsector = ss;
+   Particles.subsector[to]  = Particles.subsector[from];
+   Particles.x[to]          = Particles.x[from];
+   Particles.y[to]          = Particles.y[from];
+   Particles.z[to]          = Particles.z[from];
+   Particles.velx[to]       = Particles.velx[from];
+   Particles.vely[to]       = Particles.vely[from];
+   Particles.velz[to]       = Particles.velz[from];
+   Particles.accx[to]       = Particles.accx[from];
+   Particles.accy[to]       = Particles.accy[from];
+   Particles.accz[to]       = Particles.accz[from];
+   Particles.trans[to]      = Particles.trans[from];
+   Particles.fade[to]       = Particles.fade[from];
+   Particles.ttl[to]        = Particles.ttl[from];
+   Particles.size[to]       = Particles.size[from];
+   Particles.color[to]      = Particles.color[from];
+   Particles.styleflags[to] = Particles.styleflags[from];
 }
 
+//
+// P_killParticle
+//
+// Frees a particle by moving the last live one into its slot.
+//
+static void P_killParticle(int ptcl)
+{
+   int last = --Particles.count;
+
+   P_UnsetParticlePosition(ptcl);
+   if(ptcl != last)
+      P_moveParticle(last, ptcl);
+}
+
+//
+// P_addVectors
+//
+// dest[i] += src[i] over count particles. This is the whole of the particle
+// motion update, run once per axis for position and once for velocity.
+//
+static void P_addVectors(fixed_t *dest, const fixed_t *src, int count)
+{
+   int i = 0;
+
+#if defined(P_PARTCL_SSE2)
+   for(; i + 4 <= count; i += 4)
+   {
+      __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dest + i));
+      __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), _mm_add_epi32(d, s));
+   }
+#endif
+
+   for(; i < count; i++)
+      dest[i] += src[i];
+}
+
+//
+// P_ParticleThinker
+//
+// Runs every live particle in passes over the particle arrays: fading and
+// expiry, then movement, then relinking and floor/ceiling handling, then
+// acceleration. Particles do not affect each other, so the result is the same
+// as handling them one at a time.
+//
 void P_ParticleThinker(void)
 {
    int i;
-   particle_t *particle, *prev;
-   const sector_t *psec;
-   fixed_t floorheight;
-   
-   i = activeParticles;
-   prev = NULL;
-   while(i != -1) 
+
+   ptclrelinks = 0;
+
+   // haleyjd: particles with fall to ground style don't start
+   // fading or counting down their TTL until they hit the floor.
+   // Go backwards so that a killed particle is replaced by one already seen.
+   for(i = Particles.count - 1; i >= 0; i--)
    {
-      particle = Particles + i;
-      i = particle->next;
+      if(Particles.styleflags[i] & PS_FALLTOGROUND)
+         continue;
 
-      // haleyjd: unlink the particle from the world
-      P_UnsetParticlePosition(particle);
+      // perform fading
+      unsigned oldtrans = Particles.trans[i];
+      Particles.trans[i] -= Particles.fade[i];
 
-      // haleyjd: particles with fall to ground style don't start
-      // fading or counting down their TTL until they hit the floor
-      if(!(particle->styleflags & PS_FALLTOGROUND))
-      {
-         // perform fading
-         unsigned oldtrans = particle->trans;
-         particle->trans -= particle->fade;
-         
-         // is it time to kill this particle?
-         if(oldtrans < particle->trans || --particle->ttl == 0)
-         {
-            memset(particle, 0, sizeof(particle_t));
-            if(prev)
-               prev->next = i;
-            else
-               activeParticles = i;
-            particle->next = inactiveParticles;
-            inactiveParticles = eindex(particle - Particles);
-            continue;
-         }
-      }
+      // is it time to kill this particle?
+      if(oldtrans < Particles.trans[i] || --Particles.ttl[i] == 0)
+         P_killParticle(i);
+   }
+
+   int count = Particles.count;
 
+   // update position
+   if(gMapHasLinePortals)
+   {
       // Check for wall portals
-      if(gMapHasLinePortals && particle->velx | particle->vely)
+      for(i = 0; i < count; i++)
       {
-         v2fixed_t destination = P_LinePortalCrossing(particle->x, particle->y, 
-            particle->velx, particle->vely);
-         particle->x = destination.x;
-         particle->y = destination.y;
-      }
-      else
-      {
-         // update and link to new position
-         particle->x += particle->velx;
-         particle->y += particle->vely;
+         if(!(Particles.velx[i] | Particles.vely[i]))
+            continue;
+
+         v2fixed_t destination = P_LinePortalCrossing(Particles.x[i], 
+            Particles.y[i], Particles.velx[i], Particles.vely[i]);
+         Particles.x[i] = destination.x;
+         Particles.y[i] = destination.y;
       }
-      particle->z += particle->velz;
-      P_SetParticlePosition(particle);
-      if(P_IsInVoid(particle->x, particle->y, *particle->subsector))
+   }
+   else
+   {
+      P_addVectors(Particles.x, Particles.velx, count);
+      P_addVectors(Particles.y, Particles.vely, count);
+   }
+   P_addVectors(Particles.z, Particles.velz, count);
+
+   for(i = 0; i < count; i++)
+   {
+      // link to new position; particles that did not move stay where they are
+      if(Particles.velx[i] | Particles.vely[i] || !Particles.subsector[i])
+         P_SetParticlePosition(i);
+
+      if(P_IsInVoid(Particles.x[i], Particles.y[i], *Particles.subsector[i]))
       {
-         particle->ttl = 1;
-         particle->trans = 0;
+         Particles.ttl[i] = 1;
+         Particles.trans[i] = 0;
       }
 
-      // apply accelerations
-      particle->velx += particle->accx;
-      particle->vely += particle->accy;
-      particle->velz += particle->accz;
-
       // handle special movement flags (post-position-set)
 
-      psec = particle->subsector->sector;
+      const sector_t *psec = Particles.subsector[i]->sector;
 
       // haleyjd 09/04/05: use deep water floor if it is higher
       // than the real floor.
-      floorheight = 
+      fixed_t floorheight = 
          (psec->heightsec != -1 && 
           sectors[psec->heightsec].floorheight > psec->floorheight) ?
           sectors[psec->heightsec].floorheight :
           psec->floorheight; 
 
       // did particle hit ground, but is now no longer on it?
-      if(particle->styleflags & PS_HITGROUND && particle->z != floorheight)
-         particle->z = floorheight;
+      if(Particles.styleflags[i] & PS_HITGROUND && Particles.z[i] != floorheight)
+         Particles.z[i] = floorheight;
 
       // floor clipping
-      if(particle->z < floorheight && psec->f_pflags & PS_PASSABLE)
+      if(Particles.z[i] < floorheight && psec->f_pflags & PS_PASSABLE)
       {
          const linkdata_t *ldata = R_FPLink(psec);
 
-         P_UnsetParticlePosition(particle);
-         particle->x += ldata->deltax;
-         particle->y += ldata->deltay;
-         particle->z += ldata->deltaz;
-         P_SetParticlePosition(particle);
+         Particles.x[i] += ldata->deltax;
+         Particles.y[i] += ldata->deltay;
+         Particles.z[i] += ldata->deltaz;
+         P_SetParticlePosition(i);
       }
-      else if(particle->z < floorheight)
+      else if(Particles.z[i] < floorheight)
       {
          // particles with fall to ground style start ticking now
-         if(particle->styleflags & PS_FALLTOGROUND)
-            particle->styleflags &= ~PS_FALLTOGROUND;
+         if(Particles.styleflags[i] & PS_FALLTOGROUND)
+            Particles.styleflags[i] &= ~PS_FALLTOGROUND;
 
-         // particles with floor clipping may need to stop
-         if(particle->styleflags & PS_FLOORCLIP)
+         // particles with floor clipping may need to stop; clearing the
+         // acceleration as well keeps them stopped after the pass below
+         if(Particles.styleflags[i] & PS_FLOORCLIP)
          {
-            particle->z = floorheight;
-            particle->accz = particle->velz = 0;
-            particle->styleflags |= PS_HITGROUND;
+            Particles.z[i] = floorheight;
+            Particles.accz[i] = Particles.velz[i] = 0;
+            Particles.styleflags[i] |= PS_HITGROUND;
             
             // some particles make splashes
-            if(particle->styleflags & PS_SPLASH)
-               E_PtclTerrainHit(particle);
+            if(Particles.styleflags[i] & PS_SPLASH)
+            {
+               E_PtclTerrainHit(Particles.subsector[i]->sector, Particles.x[i],
+                                Particles.y[i], Particles.z[i]);
+            }
          }
       }
-      else if(particle->z > psec->ceilingheight && psec->c_pflags & PS_PASSABLE)
+      else if(Particles.z[i] > psec->ceilingheight && psec->c_pflags & PS_PASSABLE)
       {
          const linkdata_t *ldata = R_CPLink(psec);
 
-         P_UnsetParticlePosition(particle);
-         particle->x += ldata->deltax;
-         particle->y += ldata->deltay;
-         particle->z += ldata->deltaz;
-         P_SetParticlePosition(particle);
+         Particles.x[i] += ldata->deltax;
+         Particles.y[i] += ldata->deltay;
+         Particles.z[i] += ldata->deltaz;
+         P_SetParticlePosition(i);
       }
-      
-      prev = particle;
    }
+
+   // apply accelerations
+   P_addVectors(Particles.velx, Particles.accx, count);
+   P_addVectors(Particles.vely, Particles.accy, count);
+   P_addVectors(Particles.velz, Particles.accz, count);
 }
 
 void P_RunEffects(void)
@@ -542,66 +648,66 @@ void P_RunEffects(void)
 #define PARTICLE_VELRND ((FRACUNIT / 4096)  * (M_Random() - 128))
 #define PARTICLE_ACCRND ((FRACUNIT / 16384) * (M_Random() - 128))
 
-static particle_t *JitterParticle(int ttl)
+static int JitterParticle(int ttl)
 {
-   particle_t *particle = newParticle();
+   int particle = newParticle();
    
-   if(particle) 
+   if(particle >= 0)
    {
       // Set initial velocities
-      particle->velx = PARTICLE_VELRND;
-      particle->vely = PARTICLE_VELRND;
-      particle->velz = PARTICLE_VELRND;
+      Particles.velx[particle] = PARTICLE_VELRND;
+      Particles.vely[particle] = PARTICLE_VELRND;
+      Particles.velz[particle] = PARTICLE_VELRND;
       
       // Set initial accelerations
-      particle->accx = PARTICLE_ACCRND;
-      particle->accy = PARTICLE_ACCRND;
-      particle->accz = PARTICLE_ACCRND;
+      Particles.accx[particle] = PARTICLE_ACCRND;
+      Particles.accy[particle] = PARTICLE_ACCRND;
+      Particles.accz[particle] = PARTICLE_ACCRND;
       
-      particle->trans = FRACUNIT;	// fully opaque
-      particle->ttl = ttl;
-      particle->fade = FADEFROMTTL(ttl);
+      Particles.trans[particle] = FRACUNIT;	// fully opaque
+      Particles.ttl[particle] = ttl;
+      Particles.fade[particle] = FADEFROMTTL(ttl);
    }
    return particle;
 }
 
 static void MakeFountain(Mobj *actor, byte color1, byte color2)
 {
-   particle_t *particle;
+   int particle;
    
    if(!(leveltime & 1))
       return;
    
    particle = JitterParticle(51);
    
-   if(particle)
+   if(particle >= 0)
    {
       angle_t an  = M_Random()<<(24-ANGLETOFINESHIFT);
       fixed_t out = FixedMul(actor->radius, M_Random()<<8);
       
-      particle->x = actor->x + FixedMul(out, finecosine[an]);
-      particle->y = actor->y + FixedMul(out, finesine[an]);
-      particle->z = actor->z + actor->height + FRACUNIT;
+      Particles.x[particle] = actor->x + FixedMul(out, finecosine[an]);
+      Particles.y[particle] = actor->y + FixedMul(out, finesine[an]);
+      Particles.z[particle] = actor->z + actor->height + FRACUNIT;
       P_SetParticlePosition(particle);
       
       if(out < actor->radius/8)
-         particle->velz += FRACUNIT*10/3;
+         Particles.velz[particle] += FRACUNIT*10/3;
       else
-         particle->velz += FRACUNIT*3;
+         Particles.velz[particle] += FRACUNIT*3;
       
-      particle->accz -= FRACUNIT/11;
+      Particles.accz[particle] -= FRACUNIT/11;
       if(M_Random() < 30)
       {
-         particle->size = 4;
-         particle->color = color2;
+         Particles.size[particle] = 4;
+         Particles.color[particle] = color2;
       } 
       else 
       {
-         particle->size = 6;
-         particle->color = color1;
+         Particles.size[particle] = 6;
+         Particles.color[particle] = color1;
       }
 
-      particle->styleflags = 0;
+      Particles.styleflags[particle] = 0;
    }
 }
 
@@ -635,45 +741,45 @@ static void P_RunEffect(Mobj *actor, unsigned int effects)
       
       angle_t an = (moveangle + ANG90) >> ANGLETOFINESHIFT;
 
-      particle_t *particle = JitterParticle(3 + (M_Random() & 31));
-      if(particle)
+      int particle = JitterParticle(3 + (M_Random() & 31));
+      if(particle >= 0)
       {
          fixed_t pathdist = M_Random()<<8;
-         particle->x = backx - FixedMul(actor->momx, pathdist);
-         particle->y = backy - FixedMul(actor->momy, pathdist);
-         particle->z = backz - FixedMul(actor->momz, pathdist);
+         Particles.x[particle] = backx - FixedMul(actor->momx, pathdist);
+         Particles.y[particle] = backy - FixedMul(actor->momy, pathdist);
+         Particles.z[particle] = backz - FixedMul(actor->momz, pathdist);
          P_SetParticlePosition(particle);
 
          speed = (M_Random () - 128) * (FRACUNIT/200);
-         particle->velx += FixedMul(speed, finecosine[an]);
-         particle->vely += FixedMul(speed, finesine[an]);
-         particle->velz -= FRACUNIT/36;
-         particle->accz -= FRACUNIT/20;
-         particle->color = yellow;
-         particle->size = 2;
-         particle->styleflags = PS_FULLBRIGHT;
+         Particles.velx[particle] += FixedMul(speed, finecosine[an]);
+         Particles.vely[particle] += FixedMul(speed, finesine[an]);
+         Particles.velz[particle] -= FRACUNIT/36;
+         Particles.accz[particle] -= FRACUNIT/20;
+         Particles.color[particle] = yellow;
+         Particles.size[particle] = 2;
+         Particles.styleflags[particle] = PS_FULLBRIGHT;
       }
       
       for(i = 6; i; --i)
       {
-         particle_t *iparticle = JitterParticle(3 + (M_Random() & 31));
-         if(iparticle)
+         int iparticle = JitterParticle(3 + (M_Random() & 31));
+         if(iparticle >= 0)
          {
             fixed_t pathdist = M_Random() << 8;
-            iparticle->x = backx - FixedMul(actor->momx, pathdist);
-            iparticle->y = backy - FixedMul(actor->momy, pathdist);
-            iparticle->z = backz - FixedMul(actor->momz, pathdist) + 
+            Particles.x[iparticle] = backx - FixedMul(actor->momx, pathdist);
+            Particles.y[iparticle] = backy - FixedMul(actor->momy, pathdist);
+            Particles.z[iparticle] = backz - FixedMul(actor->momz, pathdist) + 
                              (M_Random() << 10);
             P_SetParticlePosition(iparticle);
 
             speed = (M_Random() - 128) * (FRACUNIT/200);
-            iparticle->velx += FixedMul(speed, finecosine[an]);
-            iparticle->vely += FixedMul(speed, finesine[an]);
-            iparticle->velz += FRACUNIT/80;
-            iparticle->accz += FRACUNIT/40;
-            iparticle->color = (M_Random() & 7) ? grey2 : grey1;            
-            iparticle->size = 3;
-            iparticle->styleflags = 0;
+            Particles.velx[iparticle] += FixedMul(speed, finecosine[an]);
+            Particles.vely[iparticle] += FixedMul(speed, finesine[an]);
+            Particles.velz[iparticle] += FRACUNIT/80;
+            Particles.accz[iparticle] += FRACUNIT/40;
+            Particles.color[iparticle] = (M_Random() & 7) ? grey2 : grey1;            
+            Particles.size[iparticle] = 3;
+            Particles.styleflags[iparticle] = 0;
          } 
          else
             break;
@@ -736,22 +842,22 @@ void P_DrawSplash(int count, fixed_t x, fixed_t y, fixed_t z,
    for(; count; count--)
    {
       angle_t an;
-      particle_t *p = JitterParticle(10);
+      int p = JitterParticle(10);
             
-      if(!p)
+      if(p < 0)
          break;
       
-      p->size = 2;
-      p->color = M_Random() & 0x80 ? color1 : color2;
-      p->styleflags = PS_FULLBRIGHT;
-      p->velz -= M_Random() * 512;
-      p->accz -= FRACUNIT/8;
-      p->accx += (M_Random() - 128) * 8;
-      p->accy += (M_Random() - 128) * 8;
-      p->z = z - M_Random() * 1024;
+      Particles.size[p] = 2;
+      Particles.color[p] = M_Random() & 0x80 ? color1 : color2;
+      Particles.styleflags[p] = PS_FULLBRIGHT;
+      Particles.velz[p] -= M_Random() * 512;
+      Particles.accz[p] -= FRACUNIT/8;
+      Particles.accx[p] += (M_Random() - 128) * 8;
+      Particles.accy[p] += (M_Random() - 128) * 8;
+      Particles.z[p] = z - M_Random() * 1024;
       an = (angle + (M_Random() << 21)) >> ANGLETOFINESHIFT;
-      p->x = x + (M_Random() & 15)*finecosine[an];
-      p->y = y + (M_Random() & 15)*finesine[an];
+      Particles.x[p] = x + (M_Random() & 15)*finecosine[an];
+      Particles.y[p] = y + (M_Random() & 15)*finesine[an];
       P_SetParticlePosition(p);
    }
 }
@@ -769,24 +875,24 @@ static void P_BloodDrop(int count, fixed_t x, fixed_t y, fixed_t z,
 {
    for(; count; --count)
    {
-      particle_t *p = newParticle();
+      int p = newParticle();
       angle_t an;
       
-      if(!p)
+      if(p < 0)
          break;
       
-      p->ttl = 96;
-      p->fade = FADEFROMTTL(96);
-      p->trans = FRACUNIT;
-      p->size = 4;
-      p->color = M_Random() & 0x80 ? color1 : color2;
-      p->velz = 128 * -3000 + M_Random();
-      p->accz = -(LevelInfo.gravity*100/256);
-      p->styleflags = PS_FLOORCLIP | PS_FALLTOGROUND;
-      p->z = z + (M_Random() - 128) * -2400;
+      Particles.ttl[p] = 96;
+      Particles.fade[p] = FADEFROMTTL(96);
+      Particles.trans[p] = FRACUNIT;
+      Particles.size[p] = 4;
+      Particles.color[p] = M_Random() & 0x80 ? color1 : color2;
+      Particles.velz[p] = 128 * -3000 + M_Random();
+      Particles.accz[p] = -(LevelInfo.gravity*100/256);
+      Particles.styleflags[p] = PS_FLOORCLIP | PS_FALLTOGROUND;
+      Particles.z[p] = z + (M_Random() - 128) * -2400;
       an = (angle + ((M_Random() - 128) << 22)) >> ANGLETOFINESHIFT;
-      p->x = x + (M_Random() & 10) * finecosine[an];
-      p->y = y + (M_Random() & 10) * finesine[an];
+      Particles.x[p] = x + (M_Random() & 10) * finecosine[an];
+      Particles.y[p] = y + (M_Random() & 10) * finesine[an];
       P_SetParticlePosition(p);
    }
 }
@@ -801,7 +907,7 @@ static void P_BloodDrop(int count, fixed_t x, fixed_t y, fixed_t z,
 void P_SmokePuff(int count, fixed_t x, fixed_t y, fixed_t z, angle_t angle, 
                  int updown)
 {
-   particle_t *p;
+   int p;
    angle_t an;
    int ttl;
    fixed_t accz;
@@ -846,33 +952,33 @@ void P_SmokePuff(int count, fixed_t x, fixed_t y, fixed_t z, angle_t angle,
 
    for(; count; --count)
    {      
-      if(!(p = newParticle()))
+      if((p = newParticle()) < 0)
          break;
       
-      p->ttl = ttl;
-      p->fade = FADEFROMTTL(ttl);
-      p->trans = FRACUNIT;
-      p->size = 2 + M_Random() % 5;
-      p->color = M_Random() & 0x80 ? color1 : color2;      
-      p->velz = M_Random() * 512;
+      Particles.ttl[p] = ttl;
+      Particles.fade[p] = FADEFROMTTL(ttl);
+      Particles.trans[p] = FRACUNIT;
+      Particles.size[p] = 2 + M_Random() % 5;
+      Particles.color[p] = M_Random() & 0x80 ? color1 : color2;      
+      Particles.velz[p] = M_Random() * 512;
       if(updown == 1) // ceiling shot?
-         p->velz = -(p->velz / 4);
-      p->accz = accz;
-      p->styleflags = 0;
+         Particles.velz[p] = -(Particles.velz[p] / 4);
+      Particles.accz[p] = accz;
+      Particles.styleflags[p] = 0;
       
       an = (angle + ((M_Random() - 128) << 23)) >> ANGLETOFINESHIFT;
-      p->velx = (M_Random() * finecosine[an]) >> 11;
-      p->vely = (M_Random() * finesine[an]) >> 11;
-      p->accx = p->velx >> 4;
-      p->accy = p->vely >> 4;
+      Particles.velx[p] = (M_Random() * finecosine[an]) >> 11;
+      Particles.vely[p] = (M_Random() * finesine[an]) >> 11;
+      Particles.accx[p] = Particles.velx[p] >> 4;
+      Particles.accy[p] = Particles.vely[p] >> 4;
       
       if(updown == 1) // ceiling shot?
-         p->z = z - (M_Random() + 72) * 2000;
+         Particles.z[p] = z - (M_Random() + 72) * 2000;
       else
-         p->z = z + (M_Random() + 72) * 2000;
+         Particles.z[p] = z + (M_Random() + 72) * 2000;
       an = (angle + ((M_Random() - 128) << 22)) >> ANGLETOFINESHIFT;
-      p->x = x + (M_Random() & 14) * finecosine[an];
-      p->y = y + (M_Random() & 14) * finesine[an];
+      Particles.x[p] = x + (M_Random() & 14) * finecosine[an];
+      Particles.y[p] = y + (M_Random() & 14) * finesine[an];
       P_SetParticlePosition(p);
    }
 
@@ -885,26 +991,26 @@ void P_SmokePuff(int count, fixed_t x, fixed_t y, fixed_t z, angle_t angle,
          fixed_t pathdist = M_Random() << 8;
          fixed_t speed;
          
-         if(!(p = JitterParticle(3 + (M_Random() % 24))))
+         if((p = JitterParticle(3 + (M_Random() % 24))) < 0)
             break;
          
-         p->x = x - pathdist;
-         p->y = y - pathdist;
-         p->z = z - pathdist;
+         Particles.x[p] = x - pathdist;
+         Particles.y[p] = y - pathdist;
+         Particles.z[p] = z - pathdist;
          P_SetParticlePosition(p);
          
          speed = (M_Random() - 128) * (FRACUNIT / 200);
          an = angle >> ANGLETOFINESHIFT;
-         p->velx += FixedMul(speed, finecosine[an]);
-         p->vely += FixedMul(speed, finesine[an]);
+         Particles.velx[p] += FixedMul(speed, finecosine[an]);
+         Particles.vely[p] += FixedMul(speed, finesine[an]);
          if(updown) // on ceiling or wall, fall fast
-            p->velz -= FRACUNIT/36;
+            Particles.velz[p] -= FRACUNIT/36;
          else       // on floor, throw it upward a bit
-            p->velz += FRACUNIT/2;
-         p->accz -= FRACUNIT/20;
-         p->color = yellow;
-         p->size = 2;
-         p->styleflags = PS_FULLBRIGHT;
+            Particles.velz[p] += FRACUNIT/2;
+         Particles.accz[p] -= FRACUNIT/20;
+         Particles.color[p] = yellow;
+         Particles.size[p] = 2;
+         Particles.styleflags[p] = PS_FULLBRIGHT;
       }
    }
 }
@@ -932,7 +1038,7 @@ void P_BloodSpray(Mobj *mo, int count, fixed_t x, fixed_t y, fixed_t z,
                   angle_t angle)
 {
    byte color1, color2;
-   particle_t *p;
+   int p;
    angle_t an;
    int bloodcolor = mo->info->bloodcolor;
 
@@ -964,32 +1070,32 @@ void P_BloodSpray(Mobj *mo, int count, fixed_t x, fixed_t y, fixed_t z,
 
    for(; count; --count)
    {
-      if(!(p = newParticle()))
+      if((p = newParticle()) < 0)
          break;
       
-      p->ttl = 25 + M_Random() % 6;
-      p->fade = FADEFROMTTL(p->ttl);
-      p->trans = FRACUNIT;
-      p->size = 1 + M_Random() % 4;
+      Particles.ttl[p] = 25 + M_Random() % 6;
+      Particles.fade[p] = FADEFROMTTL(Particles.ttl[p]);
+      Particles.trans[p] = FRACUNIT;
+      Particles.size[p] = 1 + M_Random() % 4;
       
       // if colors are part of same ramp, use all in between
       if(color1 != color2 && abs(color2 - color1) <= 16)
-         p->color = M_RangeRandom(color1, color2);
+         Particles.color[p] = M_RangeRandom(color1, color2);
       else
-         p->color = M_Random() & 0x80 ? color1 : color2;
+         Particles.color[p] = M_Random() & 0x80 ? color1 : color2;
       
-      p->styleflags = 0;
+      Particles.styleflags[p] = 0;
       
       an      = (angle + ((M_Random() - 128) << 23)) >> ANGLETOFINESHIFT;
-      p->velx = (M_Random() * finecosine[an]) / 768;
-      p->vely = (M_Random() * finesine[an]) / 768;
+      Particles.velx[p] = (M_Random() * finecosine[an]) / 768;
+      Particles.vely[p] = (M_Random() * finesine[an]) / 768;
 
       an      = (angle + ((M_Random() - 128) << 22)) >> ANGLETOFINESHIFT;      
-      p->x    = x + (M_Random() % 15) * finecosine[an];
-      p->y    = y + (M_Random() % 15) * finesine[an];
-      p->z    = z + (M_Random() - 128) * -3500;
-      p->velz = (M_Random() < 32) ? M_Random() * 140 : M_Random() * -128;
-      p->accz = -FRACUNIT/16;
+      Particles.x[p]    = x + (M_Random() % 15) * finecosine[an];
+      Particles.y[p]    = y + (M_Random() % 15) * finesine[an];
+      Particles.z[p]    = z + (M_Random() - 128) * -3500;
+      Particles.velz[p] = (M_Random() < 32) ? M_Random() * 140 : M_Random() * -128;
+      Particles.accz[p] = -FRACUNIT/16;
       
       P_SetParticlePosition(p);
    }
@@ -1017,32 +1123,32 @@ void P_DrawSplash2(int count, fixed_t x, fixed_t y, fixed_t z,
    
    for(; count; count--)
    {
-      particle_t *p = newParticle();
+      int p = newParticle();
       angle_t an;
       
-      if(!p)
+      if(p < 0)
          break;
       
-      p->ttl = 12;
-      p->fade = FADEFROMTTL(12);
-      p->trans = FRACUNIT;
-      p->styleflags = 0;
-      p->size = 2 + M_Random() % 5;
-      p->color = M_Random() & 0x80 ? color1 : color2;
-      p->velz = M_Random() * zvel;
-      p->accz = -FRACUNIT/22;
+      Particles.ttl[p] = 12;
+      Particles.fade[p] = FADEFROMTTL(12);
+      Particles.trans[p] = FRACUNIT;
+      Particles.styleflags[p] = 0;
+      Particles.size[p] = 2 + M_Random() % 5;
+      Particles.color[p] = M_Random() & 0x80 ? color1 : color2;
+      Particles.velz[p] = M_Random() * zvel;
+      Particles.accz[p] = -FRACUNIT/22;
       if(kind)
       {
          an = (angle + ((M_Random() - 128) << 23)) >> ANGLETOFINESHIFT;
-         p->velx = (M_Random() * finecosine[an]) >> 11;
-         p->vely = (M_Random() * finesine[an]) >> 11;
-         p->accx = p->velx >> 4;
-         p->accy = p->vely >> 4;
+         Particles.velx[p] = (M_Random() * finecosine[an]) >> 11;
+         Particles.vely[p] = (M_Random() * finesine[an]) >> 11;
+         Particles.accx[p] = Particles.velx[p] >> 4;
+         Particles.accy[p] = Particles.vely[p] >> 4;
       }
-      p->z = z + (M_Random() + zadd) * zspread;
+      Particles.z[p] = z + (M_Random() + zadd) * zspread;
       an = (angle + ((M_Random() - 128) << 22)) >> ANGLETOFINESHIFT;
-      p->x = x + (M_Random() & 31) * finecosine[an];
-      p->y = y + (M_Random() & 31) * finesine[an];
+      Particles.x[p] = x + (M_Random() & 31) * finecosine[an];
+      Particles.y[p] = y + (M_Random() & 31) * finesine[an];
       P_SetParticlePosition(p);
    }
 }
@@ -1053,22 +1159,22 @@ void P_DisconnectEffect(Mobj *actor)
    
    for(i = 64; i; i--)
    {
-      particle_t *p = JitterParticle (TICRATE*2);
+      int p = JitterParticle (TICRATE*2);
       
-      if(!p)
+      if(p < 0)
          break;
       
-      p->x = actor->x + 
+      Particles.x[p] = actor->x + 
              ((M_Random()-128)<<9) * (actor->radius>>FRACBITS);
-      p->y = actor->y + 
+      Particles.y[p] = actor->y + 
              ((M_Random()-128)<<9) * (actor->radius>>FRACBITS);
-      p->z = actor->z + (M_Random()<<8) * (actor->height>>FRACBITS);
+      Particles.z[p] = actor->z + (M_Random()<<8) * (actor->height>>FRACBITS);
       P_SetParticlePosition(p);
 
-      p->accz -= FRACUNIT/4096;
-      p->color = M_Random() < 128 ? maroon1 : maroon2;
-      p->size = 4;
-      p->styleflags = PS_FULLBRIGHT;
+      Particles.accz[p] -= FRACUNIT/4096;
+      Particles.color[p] = M_Random() < 128 ? maroon1 : maroon2;
+      Particles.size[p] = 4;
+      Particles.styleflags[p] = PS_FULLBRIGHT;
    }
 }
 
@@ -1080,7 +1186,7 @@ void P_DisconnectEffect(Mobj *actor)
 static void P_FlyEffect(Mobj *actor)
 {
    int i, count;
-   particle_t *p;
+   int p;
    float angle;
    float sp, sy, cp, cy;
    vec3_t forward;
@@ -1102,7 +1208,7 @@ static void P_FlyEffect(Mobj *actor)
    
    for(i = 0; i < count; i += 2)
    {
-      if(!(p = newParticle()))
+      if((p = newParticle()) < 0)
          break;
 
       angle = ltime * avelocities[i][0];
@@ -1117,20 +1223,20 @@ static void P_FlyEffect(Mobj *actor)
       forward[2] = -sp;
 
       dist = (float)sin(ltime + i)*64;
-      p->x = actor->x + (int)((bytedirs[i][0]*dist + forward[0]*BEAMLENGTH)*FRACUNIT);
-      p->y = actor->y + (int)((bytedirs[i][1]*dist + forward[1]*BEAMLENGTH)*FRACUNIT);
-      p->z = actor->z + (int)((bytedirs[i][2]*dist + forward[2]*BEAMLENGTH)*FRACUNIT);
+      Particles.x[p] = actor->x + (int)((bytedirs[i][0]*dist + forward[0]*BEAMLENGTH)*FRACUNIT);
+      Particles.y[p] = actor->y + (int)((bytedirs[i][1]*dist + forward[1]*BEAMLENGTH)*FRACUNIT);
+      Particles.z[p] = actor->z + (int)((bytedirs[i][2]*dist + forward[2]*BEAMLENGTH)*FRACUNIT);
       P_SetParticlePosition(p);
 
-      p->velx = p->vely = p->velz = 0;
-      p->accx = p->accy = p->accz = 0;
+      Particles.velx[p] = Particles.vely[p] = Particles.velz[p] = 0;
+      Particles.accx[p] = Particles.accy[p] = Particles.accz[p] = 0;
 
-      p->color = black;
+      Particles.color[p] = black;
 
-      p->size = 4; // ???
-      p->ttl = 1;
-      p->trans = FRACUNIT;
-      p->styleflags = 0;
+      Particles.size[p] = 4; // ???
+      Particles.ttl[p] = 1;
+      Particles.trans[p] = FRACUNIT;
+      Particles.styleflags[p] = 0;
    }
 }
 
@@ -1142,7 +1248,7 @@ static void P_FlyEffect(Mobj *actor)
 static void P_BFGEffect(Mobj *actor)
 {
    int i;
-   particle_t *p;
+   int p;
    float angle;
    float sp, sy, cp, cy;
    vec3_t forward;
@@ -1152,7 +1258,7 @@ static void P_BFGEffect(Mobj *actor)
    ltime = (float)leveltime / 30.0f;
    for(i = 0; i < NUMVERTEXNORMALS; i++)
    {
-      if(!(p = newParticle()))
+      if((p = newParticle()) < 0)
          break;
 
       angle = ltime * avelocities[i][0];
@@ -1167,20 +1273,20 @@ static void P_BFGEffect(Mobj *actor)
       forward[2] = -sp;
       
       dist = (float)sin(ltime + i)*64;
-      p->x = actor->x + (int)((bytedirs[i][0]*dist + forward[0]*BEAMLENGTH)*FRACUNIT);
-      p->y = actor->y + (int)((bytedirs[i][1]*dist + forward[1]*BEAMLENGTH)*FRACUNIT);
-      p->z = actor->z + (15*FRACUNIT) + (int)((bytedirs[i][2]*dist + forward[2]*BEAMLENGTH)*FRACUNIT);
+      Particles.x[p] = actor->x + (int)((bytedirs[i][0]*dist + forward[0]*BEAMLENGTH)*FRACUNIT);
+      Particles.y[p] = actor->y + (int)((bytedirs[i][1]*dist + forward[1]*BEAMLENGTH)*FRACUNIT);
+      Particles.z[p] = actor->z + (15*FRACUNIT) + (int)((bytedirs[i][2]*dist + forward[2]*BEAMLENGTH)*FRACUNIT);
       P_SetParticlePosition(p);
 
-      p->velx = p->vely = p->velz = 0;
-      p->accx = p->accy = p->accz = 0;
+      Particles.velx[p] = Particles.vely[p] = Particles.velz[p] = 0;
+      Particles.accx[p] = Particles.accy[p] = Particles.accz[p] = 0;
 
-      p->color = green;
+      Particles.color[p] = green;
 
-      p->size = 4;
-      p->ttl = 1;
-      p->trans = 2*FRACUNIT/3;
-      p->styleflags = PS_FULLBRIGHT;
+      Particles.size[p] = 4;
+      Particles.ttl[p] = 1;
+      Particles.trans[p] = 2*FRACUNIT/3;
+      Particles.styleflags[p] = PS_FULLBRIGHT;
    }
 }
 
@@ -1200,7 +1306,7 @@ static void P_DripEffect(Mobj *actor)
 {
    bool makesplash = !!actor->args[3];
    bool fullbright = !!actor->args[4];
-   particle_t *p;
+   int p;
 
    // do not cause a division by zero crash or
    // allow a negative frequency
@@ -1210,26 +1316,26 @@ static void P_DripEffect(Mobj *actor)
    if(leveltime % actor->args[2])
       return;
 
-   if(!(p = newParticle()))
+   if((p = newParticle()) < 0)
       return;
       
-   p->ttl   = 18;
-   p->trans = 9*FRACUNIT/16;
-   p->fade  = p->trans / p->ttl;
+   Particles.ttl[p]   = 18;
+   Particles.trans[p] = 9*FRACUNIT/16;
+   Particles.fade[p]  = Particles.trans[p] / Particles.ttl[p];
    
-   p->color = (byte)(actor->args[0]);
-   p->size  = (byte)(actor->args[1]);
+   Particles.color[p] = (byte)(actor->args[0]);
+   Particles.size[p]  = (byte)(actor->args[1]);
    
-   p->velz = 128 * -3000;
-   p->accz = -LevelInfo.gravity;
-   p->styleflags = PS_FLOORCLIP | PS_FALLTOGROUND;
+   Particles.velz[p] = 128 * -3000;
+   Particles.accz[p] = -LevelInfo.gravity;
+   Particles.styleflags[p] = PS_FLOORCLIP | PS_FALLTOGROUND;
    if(makesplash)
-      p->styleflags |= PS_SPLASH;
+      Particles.styleflags[p] |= PS_SPLASH;
    if(fullbright)
-      p->styleflags |= PS_FULLBRIGHT;
-   p->x = actor->x;
-   p->y = actor->y;
-   p->z = actor->subsector->sector->ceilingheight;
+      Particles.styleflags[p] |= PS_FULLBRIGHT;
+   Particles.x[p] = actor->x;
+   Particles.y[p] = actor->y;
+   Particles.z[p] = actor->subsector->sector->ceilingheight;
    P_SetParticlePosition(p);
 }
 
@@ -1297,19 +1403,19 @@ static void P_ExplosionParticles(fixed_t x, fixed_t y, fixed_t z,
 
    for(i = 0; i < 256; i++)
    {
-      particle_t *p = newParticle();
+      int p = newParticle();
 
-      if(!p)
+      if(p < 0)
          break;
 
-      p->ttl = 26;
-      p->fade = FADEFROMTTL(26);
-      p->trans = FRACUNIT;
+      Particles.ttl[p] = 26;
+      Particles.fade[p] = FADEFROMTTL(26);
+      Particles.trans[p] = FRACUNIT;
 
       // 2^11 = 2048, 2^12 = 4096
-      p->x = x + (((M_Random() % 32) - 16)*4096);
-      p->y = y + (((M_Random() % 32) - 16)*4096);
-      p->z = z + (((M_Random() % 32) - 16)*4096);
+      Particles.x[p] = x + (((M_Random() % 32) - 16)*4096);
+      Particles.y[p] = y + (((M_Random() % 32) - 16)*4096);
+      Particles.z[p] = z + (((M_Random() % 32) - 16)*4096);
       P_SetParticlePosition(p);
 
       // note: was (rand() % 384) - 192 in Q2, but DOOM's RNG
@@ -1317,19 +1423,19 @@ static void P_ExplosionParticles(fixed_t x, fixed_t y, fixed_t z,
       // corrected to unbias it and get output from approx.
       // -192 to 191
       rnd = M_Random();
-      p->velx = (rnd - 192 + (rnd/2))*2048;
+      Particles.velx[p] = (rnd - 192 + (rnd/2))*2048;
       rnd = M_Random();
-      p->vely = (rnd - 192 + (rnd/2))*2048;
+      Particles.vely[p] = (rnd - 192 + (rnd/2))*2048;
       rnd = M_Random();
-      p->velz = (rnd - 192 + (rnd/2))*2048;
+      Particles.velz[p] = (rnd - 192 + (rnd/2))*2048;
 
-      p->accx = p->accy = p->accz = 0;
+      Particles.accx[p] = Particles.accy[p] = Particles.accz[p] = 0;
 
-      p->size = (M_Random() < 48) ? 6 : 4;
+      Particles.size[p] = (M_Random() < 48) ? 6 : 4;
 
-      p->color = (M_Random() & 0x80) ? color2 : color1;
+      Particles.color[p] = (M_Random() & 0x80) ? color2 : color1;
 
-      p->styleflags = PS_FULLBRIGHT;
+      Particles.styleflags[p] = PS_FULLBRIGHT;
    }
 }
 
@@ -1371,6 +1477,69 @@ void P_AddEventVars()
    }
 }
 
+//
+// ptcl_bench
+//
+// Particle stress benchmark: fills the particle set with a burst around the
+// console player and times the particle thinker over a number of tics. The
+// particles are left alive, so the renderer can be watched under the same
+// load afterwards.
+//
+CONSOLE_COMMAND(ptcl_bench, cf_level)
+{
+   Mobj *mo = players[consoleplayer].mo;
+   int count = Particles.max;
+   int tics  = 35;
+
+   if(!mo)
+      return;
+
+   if(Console.argc >= 1)
+      count = Console.argv[0]->toInt();
+   if(Console.argc >= 2)
+      tics = Console.argv[1]->toInt();
+   tics = eclamp(tics, 1, 255);
+
+   for(int i = 0; i < count; i++)
+   {
+      int p = newParticle();
+      if(p < 0)
+         break;
+
+      Particles.ttl[p]   = 255;
+      Particles.fade[p]  = FADEFROMTTL(255);
+      Particles.trans[p] = FRACUNIT;
+      Particles.x[p] = mo->x + (((M_Random() % 32) - 16) * 4096);
+      Particles.y[p] = mo->y + (((M_Random() % 32) - 16) * 4096);
+      Particles.z[p] = mo->z + mo->height / 2;
+      P_SetParticlePosition(p);
+
+      Particles.velx[p] = (M_Random() - 128) * 2048;
+      Particles.vely[p] = (M_Random() - 128) * 2048;
+      Particles.velz[p] = M_Random() * 1024;
+      Particles.accz[p] = -FRACUNIT/8;
+      Particles.size[p] = (M_Random() < 48) ? 6 : 4;
+      Particles.color[p] = (M_Random() & 0x80) ? red : yellow;
+      Particles.styleflags[p] = PS_FLOORCLIP;
+   }
+
+   int started  = Particles.count;
+   int relinks  = 0;
+   auto begin   = std::chrono::steady_clock::now();
+
+   for(int i = 0; i < tics; i++)
+   {
+      P_ParticleThinker();
+      relinks += ptclrelinks;
+   }
+
+   double us = std::chrono::duration<double, std::micro>(
+      std::chrono::steady_clock::now() - begin).count();
+
+   C_Printf("%d particles, %d tics: %.1f us/tic, %d relinks/tic, %d left\n",
+            started, tics, us / tics, relinks / tics, Particles.count);
+}
+
 #if 0
 //
 // Script functions
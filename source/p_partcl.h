@@ -41,28 +41,44 @@ struct subsector_t;
 #define PS_HITGROUND    0x0008
 #define PS_SPLASH       0x0010 
 
+//
+// Particle storage
+//
+// Live particles are packed at the start of a set of parallel arrays, so that
+// the per-tic motion update runs over contiguous memory. A particle is named
+// by its index, which stays valid until the next P_ParticleThinker: particles
+// that die are replaced by the last live one.
+//
+
+// haleyjd 02/20/04: particles now need sector links
+// haleyjd 08/05/05: use generalized dbl-linked list code
 struct particle_t
 {
-   // haleyjd 02/20/04: particles now need sector links
-   // haleyjd 08/05/05: use generalized dbl-linked list code
-   DLListItem<particle_t> seclinks;         // sector links
-   subsector_t *subsector;
-
-   fixed_t x, y, z;
-   fixed_t velx, vely, velz;
-   fixed_t accx, accy, accz;
-   unsigned int trans;
-   unsigned int fade;
-   byte	ttl;
-   byte	size;
-   byte color;
-   int  next;
-   int  styleflags; // haleyjd 07/03/03
+   DLListItem<particle_t> seclinks; // sector links
+};
+
+struct particleset_t
+{
+   int count;                 // number of live particles
+   int max;                   // capacity of every array
+
+   particle_t   *links;       // sector list links
+   subsector_t **subsector;
+
+   fixed_t *x, *y, *z;
+   fixed_t *velx, *vely, *velz;
+   fixed_t *accx, *accy, *accz;
+   unsigned int *trans;
+   unsigned int *fade;
+   byte *ttl;
+   byte *size;
+   byte *color;
+   int  *styleflags;          // haleyjd 07/03/03
+
+   int index(const particle_t *link) const { return int(link - links); }
 };
 
-extern int activeParticles;
-extern int inactiveParticles;
-extern particle_t *Particles;
+extern particleset_t Particles;
 extern int particle_trans;
 
 #define FX_ROCKET		0x00000001
@@ -321,6 +321,7 @@ void PushThinker::Think()
             }
          }
       }
+      thing->wake();
       thing->momx += xspeed<<(FRACBITS-PUSH_FACTOR);
       thing->momy += yspeed<<(FRACBITS-PUSH_FACTOR);
    }
@@ -0,0 +1,292 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: compressed savegame files, written in the background.
+//
+// The game is serialized into memory on the main thread, which is fast; the
+// zlib compression and the disk write, which are not, happen on a worker
+// thread. Only the worker touches the copy of the data it is given, and it
+// uses nothing but the C library and zlib, as the zone heap is not
+// thread-safe. Results are reported back on the main thread.
+//
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "z_zone.h"
+#include "../zlib/zlib.h"
+#include "c_io.h"
+#include "d_dehtbl.h"
+#include "doomstat.h"
+#include "m_swap.h"
+#include "p_savefile.h"
+#include "v_misc.h"
+
+// Follows the description in a compressed save. Uncompressed saves have the
+// version string there instead, which never matches.
+#define SAVEFILE_MAGIC   "EESAVEZ\x1a"
+#define SAVEFILE_VERSION 1
+
+// Sanity limit on the sizes in the header.
+#define SAVEFILE_MAXSIZE 0x40000000u
+
+struct savefileheader_t
+{
+   char     magic[8];    // SAVEFILE_MAGIC
+   uint32_t version;     // SAVEFILE_VERSION
+   uint32_t size;        // uncompressed size of the rest of the save
+   uint32_t packedsize;  // compressed size, which follows the header
+};
+
+struct savefilejob_t
+{
+   std::thread       thread;
+   std::atomic<bool> done;
+   std::string       filename;
+   std::vector<byte> data;
+   size_t            descsize;
+   bool              quiet;
+
+   // results, valid once done
+   const char *failure;    // message for a failed save, or nullptr
+   int         error;      // errno for a failed write, or 0
+   size_t      packedsize;
+   double      packms;     // time spent compressing, on the worker
+   double      writems;    // time spent writing, on the worker
+};
+
+static savefilejob_t *saveFileJob;
+
+//
+// P_runSaveFileJob
+//
+// Worker thread: compresses the save and writes it under a temporary name,
+// renaming it into place only once it is complete.
+//
+static void P_runSaveFileJob(savefilejob_t *job)
+{
+   auto start = std::chrono::steady_clock::now();
+
+   const byte *payload     = job->data.data() + job->descsize;
+   uLong       payloadsize = uLong(job->data.size() - job->descsize);
+
+   std::vector<byte> packed(compressBound(payloadsize));
+   uLongf packedsize = uLongf(packed.size());
+
+   int result = compress2(packed.data(), &packedsize, payload, payloadsize,
+                          Z_DEFAULT_COMPRESSION);
+
+   auto packdone = std::chrono::steady_clock::now();
+   job->packms = std::chrono::duration<double, std::milli>(packdone - start).count();
+
+   if(result != Z_OK)
+   {
+      job->failure = FC_ERROR "Could not save game: compression failed";
+   }
+   else
+   {
+      savefileheader_t hdr;
+      std::string      tmpname = job->filename + ".tmp";
+      FILE            *f;
+      bool             ok;
+
+      memcpy(hdr.magic, SAVEFILE_MAGIC, sizeof(hdr.magic));
+      hdr.version    = SwapULong(SAVEFILE_VERSION);
+      hdr.size       = SwapULong(uint32_t(payloadsize));
+      hdr.packedsize = SwapULong(uint32_t(packedsize));
+
+      ok = (f = fopen(tmpname.c_str(), "wb")) != nullptr &&
+           fwrite(job->data.data(), 1, job->descsize, f) == job->descsize &&
+           fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+           fwrite(packed.data(), 1, packedsize, f) == packedsize;
+      if(f && fclose(f))
+         ok = false;
+
+      if(ok)
+      {
+         remove(job->filename.c_str());
+         ok = !rename(tmpname.c_str(), job->filename.c_str());
+      }
+
+      if(!ok)
+      {
+         job->error   = errno;
+         job->failure = FC_ERROR "Could not save game: Error unknown";
+         remove(tmpname.c_str());
+      }
+   }
+
+   job->packedsize = packedsize;
+   job->writems = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - packdone).count();
+   job->done = true;
+}
+
+//
+// P_reportSaveFile
+//
+// Collects the finished worker and reports how the save went.
+//
+static void P_reportSaveFile()
+{
+   savefilejob_t *job = saveFileJob;
+
+   saveFileJob = nullptr;
+   if(job->thread.joinable())
+      job->thread.join();
+
+   if(job->failure)
+      doom_printf("%s", job->error ? strerror(job->error) : job->failure);
+   else
+   {
+      if(devparm)
+      {
+         // writems is about what the main thread used to wait for on top
+         // of serializing, when the save was written straight to disk
+         C_Printf("Savegame packed from %u to %u bytes in %.1f ms, "
+                  "written in %.1f ms\n", unsigned(job->data.size()),
+                  unsigned(job->packedsize), job->packms, job->writems);
+      }
+      if(!job->quiet) // sf: no 'game saved' message for hubs
+         doom_printf("%s", DEH_String("GGSAVED"));  // Ty 03/27/98 - externalized
+   }
+
+   delete job;
+}
+
+//
+// P_WriteSaveFile
+//
+void P_WriteSaveFile(const char *filename, const byte *data, size_t size,
+                     size_t descsize, bool quiet)
+{
+   // one write at a time, so that saves to the same file land in order
+   P_FinishSaveFile();
+
+   savefilejob_t *job = new savefilejob_t;
+   job->done       = false;
+   job->filename   = filename;
+   job->data.assign(data, data + size);
+   job->descsize   = descsize;
+   job->quiet      = quiet;
+   job->failure    = nullptr;
+   job->error      = 0;
+   job->packedsize = 0;
+   job->packms     = 0.0;
+   job->writems    = 0.0;
+
+   saveFileJob = job;
+
+   try
+   {
+      job->thread = std::thread(P_runSaveFileJob, job);
+   }
+   catch(...)
+   {
+      // no threads available; do it here instead
+      P_runSaveFileJob(job);
+      P_reportSaveFile();
+   }
+}
+
+//
+// P_CheckSaveFile
+//
+void P_CheckSaveFile()
+{
+   if(saveFileJob && saveFileJob->done)
+      P_reportSaveFile();
+}
+
+//
+// P_FinishSaveFile
+//
+void P_FinishSaveFile()
+{
+   if(saveFileJob)
+      P_reportSaveFile();
+}
+
+//
+// P_ReadSaveFile
+//
+int P_ReadSaveFile(const char *filename, size_t descsize, byte *&data,
+                   size_t &size)
+{
+   savefileheader_t hdr;
+   FILE *f;
+   int   result = SAVEFILE_ERROR;
+
+   data = nullptr;
+   size = 0;
+
+   if(!(f = fopen(filename, "rb")))
+      return SAVEFILE_ERROR;
+
+   byte *desc = emalloc(byte *, descsize);
+
+   if(fread(desc, 1, descsize, f) != descsize ||
+      fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+      memcmp(hdr.magic, SAVEFILE_MAGIC, sizeof(hdr.magic)))
+   {
+      result = SAVEFILE_PLAIN;
+   }
+   else if(SwapULong(hdr.version) > SAVEFILE_VERSION)
+      C_Printf(FC_ERROR "Savegame %s is from a newer version\n", filename);
+   else
+   {
+      uint32_t rawsize    = SwapULong(hdr.size);
+      uint32_t packedsize = SwapULong(hdr.packedsize);
+
+      if(rawsize <= SAVEFILE_MAXSIZE && packedsize <= SAVEFILE_MAXSIZE)
+      {
+         byte *packed = emalloc(byte *, packedsize ? packedsize : 1);
+         uLongf outsize = rawsize;
+
+         data = emalloc(byte *, descsize + rawsize);
+         memcpy(data, desc, descsize);
+
+         if(fread(packed, 1, packedsize, f) == packedsize &&
+            uncompress(data + descsize, &outsize, packed, packedsize) == Z_OK &&
+            outsize == rawsize)
+         {
+            size   = descsize + rawsize;
+            result = SAVEFILE_COMPRESSED;
+         }
+         else
+         {
+            efree(data);
+            data = nullptr;
+         }
+         efree(packed);
+      }
+   }
+
+   efree(desc);
+   fclose(f);
+
+   return result;
+}
+
+// EOF
+
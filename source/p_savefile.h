@@ -0,0 +1,55 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: compressed savegame files, written in the background.
+//
+
+#ifndef P_SAVEFILE_H__
+#define P_SAVEFILE_H__
+
+// Starts compressing and writing a serialized savegame on a worker thread.
+// The first descsize bytes (the description) stay uncompressed, so that the
+// save menu can read them directly. Success or failure is reported from the
+// main thread once the write finishes; quiet suppresses the success message.
+void P_WriteSaveFile(const char *filename, const byte *data, size_t size,
+                     size_t descsize, bool quiet);
+
+// Reports on a finished background write, if there is one. Called each tic.
+void P_CheckSaveFile();
+
+// Waits for a background write to finish, then reports on it.
+void P_FinishSaveFile();
+
+enum
+{
+   SAVEFILE_ERROR,      // unreadable or corrupt
+   SAVEFILE_PLAIN,      // uncompressed, from before compression was added
+   SAVEFILE_COMPRESSED  // decompressed into data
+};
+
+// Reads a savegame file. Compressed saves are expanded into an emalloc'd
+// image laid out exactly like an uncompressed save.
+int P_ReadSaveFile(const char *filename, size_t descsize, byte *&data,
+                   size_t &size);
+
+#endif
+
+// EOF
+
@@ -23,6 +23,8 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <chrono>
+
 #include "z_zone.h"
 #include "i_system.h"
 
@@ -50,6 +52,7 @@
 #include "p_maputl.h"
 #include "p_spec.h"
 #include "p_tick.h"
+#include "p_savefile.h"
 #include "p_saveg.h"
 #include "p_enemy.h"
 #include "p_xenemy.h"
@@ -817,6 +820,9 @@ static void P_ArchiveThinkers(SaveArchive &arc)
 
    if(arc.isSaving())
    {
+      // parked thinkers count their tics down lazily
+      Thinker::SettleThinkers();
+
       // save off the current thinkers
       for(th = thinkercap.next; th != &thinkercap; th = th->next)
       {
@@ -996,8 +1002,9 @@ static void P_ArchivePolyObj(SaveArchive &arc, polyobj_t *po)
       if((po->flags & POF_ISBAD) || po != Polyobj_GetForNum(po->id))
          return;
 
-      // rotate and translate polyobject
-      Polyobj_MoveOnLoad(po, angle, pt.x, pt.y);
+      // rotate and translate polyobject; the angle is relative, as snapshot
+      // restores find the polyobject already turned
+      Polyobj_MoveOnLoad(po, angle - po->angle, pt.x, pt.y);
    }
 }
 
@@ -1247,6 +1254,42 @@ static void P_ArchiveACS(SaveArchive &arc)
    ACS_Archive(arc);
 }
 
+//============================================================================
+//
+// Level State
+//
+
+//
+// P_ArchiveLevelState
+//
+// Saves or restores everything that changes while a level is played, in
+// savegame order. Loading expects the same level to be set up already.
+//
+void P_ArchiveLevelState(SaveArchive &arc)
+{
+   if(arc.isSaving())
+      P_NumberThinkers();    // turn ptrs to numbers
+
+   P_ArchivePlayers(arc);
+   P_ArchiveWorld(arc);
+   P_ArchiveLevelInfo(arc);
+   P_ArchivePolyObjects(arc); // haleyjd 03/27/06
+   P_ArchiveThinkers(arc);
+   P_ArchiveRNG(arc);         // killough 1/18/98: save RNG information
+   P_ArchiveMap(arc);         // killough 1/22/98: save automap information
+   if(arc.isSaving())
+      P_ArchiveSoundSequences(arc);
+   else
+      P_UnArchiveSoundSequences(arc);
+   P_ArchiveButtons(arc);
+   P_ArchiveACS(arc);         // davidph 05/30/12
+
+   if(arc.isSaving())
+      P_DeNumberThinkers();
+   else
+      P_FreeThinkerTable();
+}
+
 //============================================================================
 //
 // Saving - Main Routine
@@ -1259,16 +1302,13 @@ void P_SaveCurrentLevel(char *filename, char *description)
    int i;
    char name2[VERSIONSIZE];
    const char *fn;
-   OutBuffer savefile;
+   MemOutBuffer savefile;
    SaveArchive arc(&savefile);
 
-   if(!savefile.createFile(filename, 512*1024, OutBuffer::NENDIAN))
-   {
-      const char *str =
-         errno ? strerror(errno) : FC_ERROR "Could not save game: Error unknown";
-      doom_printf("%s", str);
-      return;
-   }
+   auto start = std::chrono::steady_clock::now();
+
+   // serialize into memory; compression and disk IO happen on a worker
+   savefile.openMemory(512*1024, OutBuffer::NENDIAN);
 
    // Enable buffered IO exceptions
    savefile.setThrowing(true);
@@ -1358,20 +1398,7 @@ void P_SaveCurrentLevel(char *filename, char *description)
       // killough 3/22/98: add Z_CheckHeap after each call to ensure consistency
       // haleyjd 07/06/09: just Z_CheckHeap after the end. This stuff works by now.
    
-      P_NumberThinkers();    // turn ptrs to numbers
-
-      P_ArchivePlayers(arc);
-      P_ArchiveWorld(arc);
-      P_ArchiveLevelInfo(arc);
-      P_ArchivePolyObjects(arc); // haleyjd 03/27/06
-      P_ArchiveThinkers(arc);
-      P_ArchiveRNG(arc);    // killough 1/18/98: save RNG information
-      P_ArchiveMap(arc);    // killough 1/22/98: save automap information
-      P_ArchiveSoundSequences(arc);
-      P_ArchiveButtons(arc);
-      P_ArchiveACS(arc);            // davidph 05/30/12
-
-      P_DeNumberThinkers();
+      P_ArchiveLevelState(arc);
 
       uint8_t cmarker = 0xE6; // consistency marker
       arc << cmarker; 
@@ -1379,25 +1406,25 @@ void P_SaveCurrentLevel(char *filename, char *description)
    catch(BufferedIOException)
    {
       // An IO error occurred while trying to save.
-      const char *str =
-         errno ? strerror(errno) : FC_ERROR "Could not save game: Error unknown";
-      doom_printf("%s", str);
-
-      // Close the file and remove it
-      savefile.setThrowing(false);
-      savefile.close();
-      remove(filename);
+      doom_printf("%s", FC_ERROR "Could not save game: Error unknown");
       return;
    }
 
-   // Close the save file
+   // Hand the data over to be written; the success message comes from there
+   P_WriteSaveFile(filename, savefile.getData(), savefile.getSize(),
+                   SAVESTRINGSIZE, !!hub_changelevel);
    savefile.close();
 
+   if(devparm)
+   {
+      C_Printf("P_SaveCurrentLevel: %u bytes serialized and handed off in %.1f ms\n",
+               unsigned(savefile.getSize()),
+               std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - start).count());
+   }
+
    // Check the heap.
    Z_CheckHeap();
-
-   if(!hub_changelevel) // sf: no 'game saved' message for hubs
-      doom_printf("%s", DEH_String("GGSAVED"));  // Ty 03/27/98 - externalized
 }
 
 //============================================================================
@@ -1410,18 +1437,35 @@ void P_LoadGame(const char *filename)
    int i;
    char vcheck[VERSIONSIZE], vread[VERSIONSIZE];
    //uint64_t checksum, rchecksum;
-   InBuffer loadfile;
-   SaveArchive arc(&loadfile);
+   InBuffer     filebuf;
+   MemInBuffer  membuf;
+   InBuffer    *loadfile = &filebuf;
+   byte        *savedata = nullptr;
+   size_t       savesize;
+
+   // the file may still be being written
+   P_FinishSaveFile();
 
-   if(!loadfile.openFile(filename, InBuffer::NENDIAN))
+   switch(P_ReadSaveFile(filename, SAVESTRINGSIZE, savedata, savesize))
    {
+   case SAVEFILE_COMPRESSED:
+      membuf.openMemory(savedata, savesize, InBuffer::NENDIAN);
+      loadfile = &membuf;
+      break;
+   case SAVEFILE_PLAIN: // saved before compression
+      if(filebuf.openFile(filename, InBuffer::NENDIAN))
+         break;
+      // fall through
+   default:
       C_Printf(FC_ERROR "Failed to load savegame %s\n", filename);
       C_SetConsole();
       return;
    }
 
+   SaveArchive arc(loadfile);
+
    // Enable buffered IO exceptions
-   loadfile.setThrowing(true);
+   loadfile->setThrowing(true);
 
    try
    {
@@ -1547,7 +1591,7 @@ void P_LoadGame(const char *filename)
 
       /* cph 2001/05/23 - Must read options before we set up the level */
       byte options[GAME_OPTION_SIZE];
-      loadfile.read(options, sizeof(options));
+      loadfile->read(options, sizeof(options));
 
       G_ReadOptions(options);
  
@@ -1585,18 +1629,7 @@ void P_LoadGame(const char *filename)
       arc << dmflags;
 
       // dearchive all the modifications
-      P_ArchivePlayers(arc);
-      P_ArchiveWorld(arc);
-      P_ArchiveLevelInfo(arc);
-      P_ArchivePolyObjects(arc);    // haleyjd 03/27/06
-      P_ArchiveThinkers(arc);
-      P_ArchiveRNG(arc);            // killough 1/18/98: load RNG information
-      P_ArchiveMap(arc);            // killough 1/22/98: load automap information
-      P_UnArchiveSoundSequences(arc);
-      P_ArchiveButtons(arc);
-      P_ArchiveACS(arc);            // davidph 05/30/12
-
-      P_FreeThinkerTable();
+      P_ArchiveLevelState(arc);
 
       uint8_t cmarker;
       arc << cmarker;
@@ -1612,7 +1645,9 @@ void P_LoadGame(const char *filename)
       I_Error("P_LoadGame: Savegame read error\n");
    }
 
-   loadfile.close();
+   loadfile->close();
+   if(savedata)
+      efree(savedata);
 
    if (setsizeneeded)
       R_ExecuteSetViewSize();
@@ -112,6 +112,8 @@ unsigned int P_NumForThinker(Thinker *th);
 Thinker *P_ThinkerForNum(unsigned int n);
 void P_SetNewTarget(Mobj **mop, Mobj *targ);
 
+void P_ArchiveLevelState(SaveArchive &arc);
+
 void P_SaveCurrentLevel(char *filename, char *description);
 void P_LoadGame(const char *filename);
 
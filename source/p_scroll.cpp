@@ -151,6 +151,7 @@ void ScrollThinker::Think()
             (!(thing->flags & MF_NOGRAVITY || thing->z > height) ||
              thing->z < waterheight))
          {
+            thing->wake();
             thing->momx += dx;
             thing->momy += dy;
          }
@@ -71,6 +71,7 @@
 #include "p_setup.h"
 #include "p_skin.h"
 #include "p_slopes.h"
+#include "p_snapshot.h"
 #include "p_spec.h"
 #include "p_tick.h"
 #include "polyobj.h"
@@ -3154,6 +3155,9 @@ static void P_PreZoneFreeLevel()
    // haleyjd 05/16/08: clear dynamic segs
    R_ClearDynaSegs();
 
+   // the BSP lookup grid refers to the nodes about to be freed
+   R_ClearNodeGrid();
+
    //==============================================
    // Playsim
 
@@ -3176,6 +3180,9 @@ static void P_InitNewLevel(int lumpnum, WadDirectory *waddir)
 
    // re-initialize thinker list
    Thinker::InitThinkers();   
+
+   // snapshots of the previous level are meaningless now
+   P_SnapshotClear();
    
    // haleyjd 02/02/04 -- clear the TID hash table
    P_InitTIDHash();     
@@ -3493,6 +3500,9 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
       CHECK_ERROR();
    }
 
+   // start point lookups near the leaves from now on
+   R_BuildNodeGrid();
+
    // ioanch 20160309: reversed P_GroupLines with P_LoadReject to fix the
    // overrun
    P_GroupLines();
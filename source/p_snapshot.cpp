@@ -0,0 +1,455 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: in-memory level snapshots, for rewinding and trying out branches.
+//
+// A snapshot is the level state as a savegame would store it, serialized into
+// memory instead of a file. Consecutive snapshots differ in few bytes, so most
+// are kept as the XOR against the one before, with unchanged runs skipped;
+// every so often one is kept whole to bound the work of a restore.
+//
+
+#include <deque>
+#include <vector>
+
+#include "z_zone.h"
+#include "autodoom/b_ape.h"
+#include "autodoom/b_botmap.h"
+#include "autodoom/b_think.h"
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "doomstat.h"
+#include "g_dmflag.h"
+#include "i_system.h"
+#include "m_buffer.h"
+#include "p_mobj.h"
+#include "p_saveg.h"
+#include "p_snapshot.h"
+#include "p_tick.h"
+#include "s_sndseq.h"
+#include "s_sound.h"
+#include "v_misc.h"
+
+// At most this many deltas are chained after a whole snapshot.
+#define SNAPSHOT_KEYINTERVAL 32
+
+// Unchanged runs shorter than this are cheaper to store as literal bytes.
+#define SNAPSHOT_MINSKIP 4
+
+int p_snapshotrate = 0;   // seconds between automatic snapshots; 0 disables
+int p_snapshotmax  = 300; // snapshots kept before the oldest are dropped
+
+struct snapshot_t
+{
+   int    leveltime;
+   bool   keyframe;       // data is the whole image rather than a delta
+   size_t size;           // size of the image
+   std::vector<byte> data;
+};
+
+static std::deque<snapshot_t> snapshots;
+static int snapshotFirst;           // number of snapshots.front()
+
+static MemOutBuffer     *snapOut;   // capture buffer, grown once and reused
+static std::vector<byte> snapImage; // image of the newest snapshot
+static std::vector<byte> snapWork;  // scratch image for restores
+
+//
+// P_archiveSnapshot
+//
+// What a snapshot holds: the savegame level state plus the few globals a
+// savegame keeps in its header or rebuilds when the level is loaded.
+//
+static void P_archiveSnapshot(SaveArchive &arc)
+{
+   int leveltics = gametic - basetic;
+
+   arc << leveltime << leveltics << dmflags
+       << totalkills << totalitems << totalsecret;
+
+   if(arc.isLoading())
+      basetic = gametic - leveltics;
+
+   P_ArchiveLevelState(arc);
+   P_ArchiveItemRespawnQueue(arc);
+}
+
+//
+// P_snapPutVarint
+//
+static void P_snapPutVarint(std::vector<byte> &out, size_t value)
+{
+   while(value >= 0x80)
+   {
+      out.push_back(byte(value | 0x80));
+      value >>= 7;
+   }
+   out.push_back(byte(value));
+}
+
+//
+// P_snapGetVarint
+//
+static size_t P_snapGetVarint(const byte *&p)
+{
+   size_t value = 0;
+   int    shift = 0;
+   byte   b;
+
+   do
+   {
+      b = *p++;
+      value |= size_t(b & 0x7f) << shift;
+      shift += 7;
+   }
+   while(b & 0x80);
+
+   return value;
+}
+
+//
+// P_encodeSnapshotDelta
+//
+// Encodes cur against prev as pairs of (unchanged count, literal count)
+// followed by the literal XORed bytes. Bytes past the end of prev are XORed
+// against zero. Returns false as soon as the delta stops being worth it.
+//
+static bool P_encodeSnapshotDelta(const byte *cur, size_t cursize,
+                                  const std::vector<byte> &prev,
+                                  std::vector<byte> &out)
+{
+   const size_t prevsize = prev.size();
+   auto diff = [&] (size_t i) -> byte {
+      return i < prevsize ? cur[i] ^ prev[i] : cur[i];
+   };
+
+   out.clear();
+
+   size_t i = 0;
+   while(i < cursize)
+   {
+      size_t start = i;
+      while(i < cursize && !diff(i))
+         ++i;
+      size_t skip = i - start;
+
+      // a literal ends at the first long enough unchanged run
+      size_t litstart = i, zeros = 0;
+      while(i < cursize && zeros < SNAPSHOT_MINSKIP)
+      {
+         zeros = diff(i) ? 0 : zeros + 1;
+         ++i;
+      }
+      i -= zeros;
+
+      P_snapPutVarint(out, skip);
+      P_snapPutVarint(out, i - litstart);
+      for(size_t j = litstart; j < i; j++)
+         out.push_back(diff(j));
+
+      if(out.size() > cursize / 2)
+         return false;
+   }
+
+   return true;
+}
+
+//
+// P_applySnapshotDelta
+//
+// Turns the image of the previous snapshot into that of snap.
+//
+static void P_applySnapshotDelta(const snapshot_t &snap, std::vector<byte> &image)
+{
+   const byte *p   = snap.data.data();
+   const byte *end = p + snap.data.size();
+   size_t      i   = 0;
+
+   image.resize(snap.size, 0);
+
+   while(p < end)
+   {
+      i += P_snapGetVarint(p);
+      size_t count = P_snapGetVarint(p);
+      if(i + count > snap.size || p + count > end)
+         I_Error("P_applySnapshotDelta: corrupt snapshot\n");
+      while(count--)
+         image[i++] ^= *p++;
+   }
+}
+
+//
+// P_trimSnapshots
+//
+// Drops the oldest snapshots beyond p_snapshotmax. The front one is always
+// whole; the snapshot after it is made whole before it goes.
+//
+static void P_trimSnapshots()
+{
+   int max = p_snapshotmax > 0 ? p_snapshotmax : 1;
+
+   while(int(snapshots.size()) > max)
+   {
+      snapshot_t &next = snapshots[1];
+
+      if(!next.keyframe)
+      {
+         snapWork = snapshots.front().data;
+         P_applySnapshotDelta(next, snapWork);
+         next.data.swap(snapWork);
+         next.keyframe = true;
+      }
+
+      snapshots.pop_front();
+      ++snapshotFirst;
+   }
+}
+
+//
+// P_SnapshotCapture
+//
+const byte *P_SnapshotCapture(size_t &size)
+{
+   if(!snapOut)
+      snapOut = new MemOutBuffer;
+
+   snapOut->openMemory(64 * 1024, OutBuffer::NENDIAN);
+   SaveArchive arc(snapOut);
+   P_archiveSnapshot(arc);
+   snapOut->close();
+
+   size = snapOut->getSize();
+   return snapOut->getData();
+}
+
+//
+// P_SnapshotSave
+//
+int P_SnapshotSave()
+{
+   if(gamestate != GS_LEVEL)
+      return -1;
+
+   size_t      cursize;
+   const byte *cur = P_SnapshotCapture(cursize);
+
+   // chain a delta unless the last whole snapshot is too far back
+   int sincekey = 0;
+   for(auto it = snapshots.rbegin(); it != snapshots.rend() && !it->keyframe; ++it)
+      ++sincekey;
+
+   snapshots.emplace_back();
+   snapshot_t &snap = snapshots.back();
+   snap.leveltime = leveltime;
+   snap.size      = cursize;
+   snap.keyframe  = snapshots.size() == 1 || sincekey + 1 >= SNAPSHOT_KEYINTERVAL ||
+                    !P_encodeSnapshotDelta(cur, cursize, snapImage, snap.data);
+
+   if(snap.keyframe)
+      snap.data.assign(cur, cur + cursize);
+   snap.data.shrink_to_fit();
+
+   snapImage.assign(cur, cur + cursize);
+
+   P_trimSnapshots();
+
+   return snapshotFirst + int(snapshots.size()) - 1;
+}
+
+//
+// P_releaseLevelThinkers
+//
+// Empties the thinker list ahead of a restore. Loading a savegame leaves the
+// removed mobjs to be freed along with the level, but a level may be restored
+// many times, so the mobjs that nothing refers to any longer are freed here.
+//
+static void P_releaseLevelThinkers()
+{
+   std::vector<Thinker *> removed;
+
+   // sounds may still be playing from the objects about to go
+   S_StopSounds(false);
+   S_SequenceGameLoad();
+
+   for(Thinker *th = thinkercap.next; th != &thinkercap; )
+   {
+      Thinker *next = th->next;
+
+      if(th->isInstanceOf(RTTI(Mobj)))
+      {
+         th->remove();
+         removed.push_back(th);
+      }
+      else
+         delete th;
+
+      th = next;
+   }
+
+   Thinker::InitThinkers();
+
+   // removing a mobj drops the references it holds on others, so whatever is
+   // still referenced is held from outside the thinkers and has to stay
+   for(Thinker *th : removed)
+   {
+      if(!th->isReferenced())
+         delete th;
+   }
+}
+
+//
+// P_SnapshotLoad
+//
+void P_SnapshotLoad(const byte *data, size_t size)
+{
+   P_releaseLevelThinkers();
+
+   MemInBuffer loadfile;
+   SaveArchive arc(&loadfile);
+
+   loadfile.openMemory(data, size, InBuffer::NENDIAN);
+   loadfile.setThrowing(true);
+
+   try
+   {
+      P_archiveSnapshot(arc);
+   }
+   catch(BufferedIOException)
+   {
+      I_Error("P_SnapshotLoad: snapshot is truncated\n");
+   }
+
+   // the bots only point into the old objects
+   if(botMap)
+   {
+      botMap->refreshMobjLists();
+      for(int i = 0; i < MAXPLAYERS; i++)
+      {
+         if(playeringame[i] && players[i].mo)
+         {
+            bots[i].mapInit();
+            gPlayerObservers[i].mapInit();
+         }
+      }
+   }
+}
+
+//
+// P_SnapshotRestore
+//
+bool P_SnapshotRestore(int id)
+{
+   int index = id - snapshotFirst;
+
+   if(gamestate != GS_LEVEL || index < 0 || index >= int(snapshots.size()))
+      return false;
+
+   int key = index;
+   while(!snapshots[key].keyframe)
+      --key;
+
+   snapWork = snapshots[key].data;
+   for(int i = key + 1; i <= index; i++)
+      P_applySnapshotDelta(snapshots[i], snapWork);
+
+   P_SnapshotLoad(snapWork.data(), snapWork.size());
+
+   // later snapshots belong to the future that was just abandoned
+   snapshots.erase(snapshots.begin() + index + 1, snapshots.end());
+   snapImage.swap(snapWork);
+
+   return true;
+}
+
+//
+// P_SnapshotForTime
+//
+int P_SnapshotForTime(int tic)
+{
+   for(int i = int(snapshots.size()) - 1; i >= 0; i--)
+   {
+      if(snapshots[i].leveltime <= tic)
+         return snapshotFirst + i;
+   }
+
+   return -1;
+}
+
+//
+// P_SnapshotClear
+//
+void P_SnapshotClear()
+{
+   snapshots.clear();
+   snapshotFirst = 0;
+   snapImage.clear();
+}
+
+//
+// P_SnapshotTicker
+//
+void P_SnapshotTicker()
+{
+   // a demo being played back cannot be rewound
+   if(p_snapshotrate <= 0 || demoplayback)
+      return;
+
+   if(!(leveltime % (p_snapshotrate * TICRATE)))
+      P_SnapshotSave();
+}
+
+//=============================================================================
+//
+// Console Commands
+//
+
+VARIABLE_INT(p_snapshotrate, NULL, 0, 60, NULL);
+CONSOLE_VARIABLE(p_snapshotrate, p_snapshotrate, 0) {}
+
+VARIABLE_INT(p_snapshotmax, NULL, 1, 3600, NULL);
+CONSOLE_VARIABLE(p_snapshotmax, p_snapshotmax, 0)
+{
+   P_trimSnapshots();
+}
+
+CONSOLE_COMMAND(rewind, cf_notnet|cf_level)
+{
+   int seconds = Console.argc ? Console.argv[0]->toInt() : 1;
+   int id;
+
+   if(demorecording || demoplayback)
+   {
+      C_Printf(FC_ERROR "Cannot rewind a demo\n");
+      return;
+   }
+
+   if((id = P_SnapshotForTime(leveltime - seconds * TICRATE)) < 0 ||
+      !P_SnapshotRestore(id))
+   {
+      C_Printf(FC_ERROR "No snapshot that old; see p_snapshotrate\n");
+      return;
+   }
+
+   C_Printf("Rewound to %d:%02d\n", leveltime / (60 * TICRATE),
+            (leveltime / TICRATE) % 60);
+}
+
+// EOF
+
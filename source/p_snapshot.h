@@ -0,0 +1,59 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: in-memory level snapshots, for rewinding and trying out branches.
+//
+
+#ifndef P_SNAPSHOT_H__
+#define P_SNAPSHOT_H__
+
+// Captures the current level state and returns its snapshot number, or -1
+// outside of a level. Snapshots are numbered in order of capture.
+int P_SnapshotSave();
+
+// Returns the level to the state captured by a snapshot and discards every
+// later snapshot. Objects are recreated, so any pointers to mobjs held outside
+// the level state are invalid afterwards; bots are reset as on a new map.
+bool P_SnapshotRestore(int id);
+
+// Serializes the current level state as a snapshot holds it, without keeping
+// it. The data stays valid until the next capture or snapshot is taken.
+const byte *P_SnapshotCapture(size_t &size);
+
+// Loads captured level state into the current level, which must be the same
+// map it was captured on. Pointers to mobjs are invalidated as for a restore.
+void P_SnapshotLoad(const byte *data, size_t size);
+
+// Number of the newest snapshot taken at or before the given leveltime, or -1.
+int P_SnapshotForTime(int tic);
+
+// Discards all snapshots. Called when a level is set up.
+void P_SnapshotClear();
+
+// Takes the automatic snapshots configured by p_snapshotrate.
+void P_SnapshotTicker();
+
+extern int p_snapshotrate;
+extern int p_snapshotmax;
+
+#endif
+
+// EOF
+
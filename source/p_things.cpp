@@ -180,6 +180,8 @@ int EV_ThingActivate(int tid)
 
    while((mobj = P_FindMobjFromTID(tid, mobj, NULL)))
    {
+      mobj->wake();
+
       if((mobj->flags & MF_COUNTKILL) || (mobj->flags3 & MF3_KILLABLE))
       {
          if(mobj->flags2 & MF2_DORMANT)
@@ -215,6 +217,8 @@ int EV_ThingDeactivate(int tid)
 
    while((mobj = P_FindMobjFromTID(tid, mobj, NULL)))
    {
+      mobj->wake();
+
       if((mobj->flags & MF_COUNTKILL) || (mobj->flags3 & MF3_KILLABLE))
       {
          if(!(mobj->flags2 & MF2_DORMANT))
@@ -296,6 +300,7 @@ int EV_ThingStop(Mobj *actor, int tid)
    int success = 0;
    while((mobj = P_FindMobjFromTID(tid, mobj, actor)))
    {
+      mobj->wake();
       mobj->momx = mobj->momy = mobj->momz = 0; // same as A_Stop
       success = 1;
    }
@@ -354,6 +359,7 @@ int EV_ThrustThingZ(Mobj *actor, int tid, int ispeed, bool upDown, bool setAdd)
    Mobj *mobj = nullptr;
    while((mobj = P_FindMobjFromTID(tid, mobj, actor)))
    {
+      mobj->wake();
       mobj->momz = (setAdd ? mobj->momz : 0) + speed * sign;
       success = 1;
    }
@@ -23,6 +23,9 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
+#include <vector>
+
 #include "z_zone.h"
 
 #include "acs_intr.h"
@@ -31,11 +34,14 @@
 #include "d_dehtbl.h"
 #include "d_main.h"
 #include "doomstat.h"
+#include "g_demosum.h"
 #include "i_system.h"
+#include "m_argv.h"
 #include "p_anim.h"
 #include "p_chase.h"
 #include "p_saveg.h"
 #include "p_sector.h"
+#include "p_snapshot.h"
 #include "p_spec.h"
 #include "p_tick.h"
 #include "p_user.h"
@@ -64,6 +70,53 @@ Thinker thinkercap;
 
 Thinker thinkerclasscap[NUMTHCLASS];
 
+//
+// Idle-thinker scheduling
+//
+// Most of the thinkers on a large map are monsters standing still in a
+// looping spawn state, and all their Think calls do until they see a player
+// is count down their state tics. Such thinkers are taken out of the run 
+// list walked by RunThinkers and parked in a timer wheel, keyed by the tic 
+// on which their state next changes. A parked thinker is also woken early 
+// by anything else that touches it (see Thinker::wake).
+//
+// A woken thinker is not simply put back at the end: it is run at exactly
+// the place in the list where it would have run, so the order of thinking 
+// (and of random number calls) is unchanged and demos stay in sync. Every 
+// thinker's place is its runorder, which increases along the thinker list.
+//
+
+// Off by default until a demo corpus has been shown to keep sync with it on
+// (compare -demosumout streams with -demosumcmp).
+bool p_thinkersched = false;
+
+#define THINKERWHEELSIZE 256
+
+static Thinker activecap;                      // head and tail of run list
+static Thinker thinkerwheel[THINKERWHEELSIZE]; // parked thinkers by wake tic
+
+// Woken thinkers to run during the walk in progress, as a heap on runorder,
+// and woken thinkers whose place the walk has already passed.
+static std::vector<Thinker *> thinkersDue;
+static std::vector<Thinker *> thinkersDueNext;
+
+static unsigned int thinkerRunOrder;    // last runorder handed out
+static unsigned int thinkerRunPos;      // runorder of the running thinker
+static int          thinkerRunTic = -1; // leveltime of the last walk begun
+static bool         thinkerWalking;     // true during RunThinkers
+static bool         thinkerSchedParm;   // false if -nothinkersched was given
+static int          numParkedThinkers;
+
+//
+// T_dueOrder
+//
+// Orders the heap of due thinkers so that the lowest runorder comes first.
+//
+static bool T_dueOrder(const Thinker *a, const Thinker *b)
+{
+   return a->getRunOrder() > b->getRunOrder();
+}
+
 // 
 // Thinker::StaticType
 //
@@ -80,6 +133,19 @@ void Thinker::InitThinkers(void)
       thinker.cprev = thinker.cnext = &thinker;
 
    thinkercap.prev = thinkercap.next  = &thinkercap;
+
+   // reset idle-thinker scheduling; anything parked belonged to the old list
+   activecap.aprev = activecap.anext = &activecap;
+   for(Thinker &slot : thinkerwheel)
+      slot.aprev = slot.anext = &slot;
+   thinkersDue.clear();
+   thinkersDueNext.clear();
+   thinkerRunOrder   = 0;
+   thinkerRunPos     = 0;
+   thinkerRunTic     = -1;
+   thinkerWalking    = false;
+   thinkerSchedParm  = !M_CheckParm("-nothinkersched");
+   numParkedThinkers = 0;
 }
 
 //
@@ -133,6 +199,14 @@ void Thinker::addThinker()
    next = &thinkercap;
    prev = thinkercap.prev;
    thinkercap.prev = this;
+
+   // new thinkers run last, as they come last in the list
+   activecap.aprev->anext = this;
+   anext = &activecap;
+   aprev = activecap.aprev;
+   activecap.aprev = this;
+   runorder   = ++thinkerRunOrder;
+   schedstate = TS_ACTIVE;
    
    references = 0;    // killough 11/98: init reference counter to 0
    
@@ -164,7 +238,10 @@ void Thinker::removeDelayed()
    if(!this->references)
    {
       Thinker *lnext = this->next;
-      (lnext->prev = currentthinker = this->prev)->next = lnext;
+      (lnext->prev = this->prev)->next = lnext;
+
+      // RunThinkers walks the run list
+      (this->anext->aprev = currentthinker = this->aprev)->anext = this->anext;
       
       // haleyjd 11/09/06: remove from threaded list now
       (this->cnext->cprev = this->cprev)->cnext = this->cnext;
@@ -188,6 +265,9 @@ void Thinker::removeDelayed()
 void Thinker::remove()
 {
    removed = true;
+
+   // must get its turn to be freed
+   wake();
    
    // killough 8/29/98: remove immediately from threaded list
    
@@ -228,18 +308,183 @@ void Thinker::remove()
 //
 void Thinker::RunThinkers(void)
 {
-   for(currentthinker = thinkercap.next; 
-       currentthinker != &thinkercap;
-       currentthinker = currentthinker->next)
+   thinkerRunTic  = leveltime;
+   thinkerRunPos  = 0;
+   thinkerWalking = true;
+
+   // wake everything parked until this tic, or everything at all if 
+   // scheduling has been turned off since the last walk
+   if(!p_thinkersched || !thinkerSchedParm)
+      WakeAllThinkers();
+   else
+   {
+      Thinker *slot = &thinkerwheel[leveltime & (THINKERWHEELSIZE - 1)];
+      Thinker *th, *anext;
+
+      for(th = slot->anext; th != slot; th = anext)
+      {
+         anext = th->anext;
+         if(th->waketic == leveltime)
+            th->unpark();
+      }
+   }
+
+   for(Thinker *th : thinkersDueNext)
+   {
+      thinkersDue.push_back(th);
+      std::push_heap(thinkersDue.begin(), thinkersDue.end(), T_dueOrder);
+   }
+   thinkersDueNext.clear();
+
+   currentthinker = &activecap;
+   for(;;)
    {
-      if(currentthinker->removed)
-         currentthinker->removeDelayed();
-      else
-         currentthinker->Think();
+      Thinker *lnext = currentthinker->anext;
+
+      // a due thinker is put back into the run list where it belongs
+      if(!thinkersDue.empty() && 
+         (lnext == &activecap || thinkersDue.front()->runorder < lnext->runorder))
+      {
+         std::pop_heap(thinkersDue.begin(), thinkersDue.end(), T_dueOrder);
+         lnext = thinkersDue.back();
+         thinkersDue.pop_back();
+
+         lnext->aprev = currentthinker;
+         lnext->anext = currentthinker->anext;
+         currentthinker->anext->aprev = lnext;
+         currentthinker->anext = lnext;
+         lnext->schedstate = TS_ACTIVE;
+      }
+      else if(lnext == &activecap)
+         break;
+
+      currentthinker = lnext;
+      currentthinker->runOne();
    }
+
+   thinkerWalking = false;
    S_MusInfoUpdate();
 }
 
+//
+// Thinker::runOne
+//
+// Runs the current thinker, or frees it if it was removed, then parks it 
+// if it has nothing to do for a while.
+//
+void Thinker::runOne()
+{
+   thinkerRunPos = runorder;
+
+   if(removed)
+      removeDelayed();
+   else
+   {
+      Think();
+      if(!removed && p_thinkersched && thinkerSchedParm && canPark())
+         park();
+   }
+}
+
+//
+// Thinker::lastRunTic
+//
+// Returns the last tic whose walk through the thinkers has already passed
+// this thinker's place in the list.
+//
+int Thinker::lastRunTic() const
+{
+   return (thinkerWalking && runorder > thinkerRunPos) ? thinkerRunTic - 1 : thinkerRunTic;
+}
+
+//
+// Thinker::park
+//
+// Takes the current thinker out of the run list until the tic on which it
+// next has to think. Called only right after its own Think.
+//
+void Thinker::park()
+{
+   Thinker *slot;
+
+   // RunThinkers continues from the predecessor
+   (anext->aprev = currentthinker = aprev)->anext = anext;
+
+   parktic = leveltime;
+   waketic = leveltime + parkTics();
+
+   slot = &thinkerwheel[waketic & (THINKERWHEELSIZE - 1)];
+   slot->aprev->anext = this;
+   anext = slot;
+   aprev = slot->aprev;
+   slot->aprev = this;
+
+   schedstate = TS_PARKED;
+   ++numParkedThinkers;
+}
+
+//
+// Thinker::unpark
+//
+// Brings a parked thinker up to date and queues it to run at its next turn,
+// which is still in the walk in progress if that has not yet reached it.
+//
+void Thinker::unpark()
+{
+   int tic = lastRunTic();
+
+   (anext->aprev = aprev)->anext = anext;
+   aprev = anext = NULL;
+
+   skipThinks(tic - parktic);
+   parktic    = tic;
+   schedstate = TS_DUE;
+   --numParkedThinkers;
+
+   if(thinkerWalking && runorder > thinkerRunPos)
+   {
+      thinkersDue.push_back(this);
+      std::push_heap(thinkersDue.begin(), thinkersDue.end(), T_dueOrder);
+   }
+   else
+      thinkersDueNext.push_back(this);
+}
+
+//
+// Thinker::SettleThinkers
+//
+// Brings every parked thinker's state up to date without waking it, for 
+// code which looks at all thinkers, such as the savegame writer.
+//
+void Thinker::SettleThinkers()
+{
+   for(Thinker &slot : thinkerwheel)
+   {
+      for(Thinker *th = slot.anext; th != &slot; th = th->anext)
+      {
+         int tic = th->lastRunTic();
+
+         th->skipThinks(tic - th->parktic);
+         th->parktic = tic;
+      }
+   }
+}
+
+//
+// Thinker::WakeAllThinkers
+//
+void Thinker::WakeAllThinkers()
+{
+   if(!numParkedThinkers)
+      return;
+
+   for(Thinker &slot : thinkerwheel)
+   {
+      while(slot.anext != &slot)
+         slot.anext->unpark();
+   }
+}
+
 //
 // Thinker::serialize
 //
@@ -307,9 +552,16 @@ void P_Ticker()
    
    leveltime++;                       // for par times
 
+   G_DemoSumTic(); // per-tic checksums for finding demo desyncs
+
+   P_SnapshotTicker(); // periodic snapshots for rewinding
+
    P_RunEffects(); // haleyjd: run particle effects
 }
 
+VARIABLE_TOGGLE(p_thinkersched, NULL, onoff);
+CONSOLE_VARIABLE(p_thinkersched, p_thinkersched, 0) {}
+
 //----------------------------------------------------------------------------
 //
 // $Log: p_tick.c,v $
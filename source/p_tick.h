@@ -38,12 +38,33 @@ class Thinker : public RTTIObject
 private:
    // Private implementation details - Methods
    void removeDelayed(); 
+   void park();
+   void unpark();
+   void runOne();
+   int  lastRunTic() const;
 
    // Data members
    // killough 11/98: count of how many other objects reference
    // this one using pointers. Used for garbage collection.
    mutable unsigned int references;
    
+   // Idle-thinker scheduling. Thinkers that are provably dormant are taken
+   // out of the run list and parked until the tic on which they next have
+   // something to do; see RunThinkers.
+   enum
+   {
+      TS_ACTIVE, // in the run list
+      TS_PARKED, // waiting in the timer wheel
+      TS_DUE     // woken, waiting to be run at its place in the list
+   };
+
+   Thinker     *aprev;     // run list, or timer wheel slot while parked
+   Thinker     *anext;
+   unsigned int runorder;  // increases along the thinker list
+   int          parktic;   // last tic whose think has been accounted for
+   int          waketic;   // tic on which a parked thinker must run again
+   int          schedstate;
+
    // Statics
    // Current position in list during RunThinkers
    static Thinker *currentthinker;
@@ -52,6 +73,13 @@ protected:
    // Virtual methods (overridables)
    virtual void Think() {}
 
+   // Idle-thinker scheduling: return true only if the next Think calls up
+   // to and excluding the one at parkTics() tics from now would do nothing 
+   // but what skipThinks does, unless the thinker is woken.
+   virtual bool canPark() const { return false; }
+   virtual int  parkTics() const { return 0; }
+   virtual void skipThinks(int count) {}
+
    // Methods
    void addToThreadedList(int tclass);
 
@@ -64,8 +92,9 @@ protected:
 public:
    // Constructor
    Thinker() 
-      : Super(), references(0), removed(false), ordinal(0), prev(NULL),
-        next(NULL), cprev(NULL), cnext(NULL)
+      : Super(), references(0), aprev(NULL), anext(NULL), runorder(0),
+        parktic(0), waketic(0), schedstate(TS_ACTIVE), removed(false),
+        ordinal(0), prev(NULL), next(NULL), cprev(NULL), cnext(NULL)
    {
    }
 
@@ -75,16 +104,24 @@ public:
    // Static functions
    static void InitThinkers();
    static void RunThinkers();
+   static void SettleThinkers();
+   static void WakeAllThinkers();
 
    // Methods
    void addThinker();
    
    // Accessors
    bool isRemoved() const { return removed; }
+   unsigned int getRunOrder() const { return runorder; }
+
+   // Idle-thinker scheduling: must be called before anything outside of
+   // the thinker's own Think changes state that canPark depends on.
+   void wake() { if(schedstate == TS_PARKED) unpark(); }
    
    // Reference counting
    void addReference() const { ++references; }
    void delReference() const { --references; }
+   bool isReferenced() const { return references != 0; }
 
    // Enumeration 
    // For thinkers needing savegame enumeration.
@@ -145,6 +182,8 @@ void P_Ticker(void);
 
 extern Thinker thinkercap;  // Both the head and tail of the thinker list
 
+extern bool p_thinkersched; // park idle thinkers until they have work to do
+
 //
 // P_NextThinker
 //
@@ -871,6 +871,7 @@ static void Polyobj_pushThing(polyobj_t *po, line_t *line, Mobj *mo)
    lineangle >>= ANGLETOFINESHIFT;
    momx = FixedMul(po->thrust, finecosine[lineangle]);
    momy = FixedMul(po->thrust, finesine[lineangle]);
+   mo->wake();
    mo->momx += momx;
    mo->momy += momy;
 
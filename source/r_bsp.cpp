@@ -2604,12 +2604,10 @@ static void R_AddDynaSegs(subsector_t *sub)
 {
    bool needbsp = (!sub->bsp || sub->bsp->dirty);
 
+   // only subsectors actually reached are rebuilt; the old tree is handed
+   // back so that its partition choices can be reused
    if(needbsp)
-   {
-      if(sub->bsp)
-         R_FreeDynaBSP(sub->bsp);
-      sub->bsp = R_BuildDynaBSP(sub);
-   }
+      sub->bsp = R_BuildDynaBSP(sub, sub->bsp);
    if(sub->bsp)
       R_RenderPolyNode(sub->bsp->root);
 }
@@ -2817,6 +2815,9 @@ static void R_Subsector(int num)
       R_AddLine(line++, false);
 }
 
+// Number of BSP nodes visited since the counter was last reset
+unsigned int r_bspnodecount;
+
 //
 // R_RenderBSPNode
 //
@@ -2831,6 +2832,8 @@ void R_RenderBSPNode(int bspnum)
    while(!(bspnum & NF_SUBSECTOR))  // Found a subsector?
    {
       node_t *bsp = &nodes[bspnum];
+
+      ++r_bspnodecount;
       
       // Decide which side the view point is on.
       int side = R_PointOnSide(viewx, viewy, bsp);
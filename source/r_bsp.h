@@ -60,6 +60,8 @@ void R_ClearDrawSegs();
 
 void R_RenderBSPNode(int bspnum);
 
+extern unsigned int r_bspnodecount; // nodes visited, for portal statistics
+
 // killough 4/13/98: fake floors/ceilings for deep water / fake ceilings:
 sector_t *R_FakeFlat(sector_t *, sector_t *, int *, int *, bool);
 bool R_PickNearestBoxLines(const fixed_t bbox[4], dlnormal_t &dl1,
@@ -33,8 +33,11 @@
 #include "d_main.h"
 #include "doomstat.h"
 #include "e_hash.h"
+#include "hal/i_timer.h"
+#include "m_collection.h"
 #include "m_compare.h"
 #include "m_swap.h"
+#include "m_workpool.h"
 #include "p_info.h"   // haleyjd
 #include "p_skin.h"
 #include "p_setup.h"
@@ -577,6 +580,8 @@ void R_PrecacheLevel(void)
    if(!r_precache)
       return;
 
+   unsigned int starttime = i_haltimer.GetTicks();
+
    // SoM: Hey, you never know, it could happen....
    numalloc = (texturecount > numsprites ? texturecount : numsprites);
    hitlist = emalloc(byte *, numalloc);
@@ -611,11 +616,13 @@ void R_PrecacheLevel(void)
    }
 
    // Precache textures.
+   PODCollection<int> texnums;
    for(i = texturecount; --i >= 0; )
    {
       if(hitlist[i])
-         R_CacheTexture(i);
+         texnums.add(i);
    }
+   R_PrecacheTextures(texnums.begin(), texnums.getLength());
 
 
    // Precache sprites.
@@ -631,6 +638,9 @@ void R_PrecacheLevel(void)
       }
    }
 
+   // Gather the sprite lumps first so archived ones can be inflated in bulk
+   PODCollection<int> spritelumps;
+
    for(i = numsprites; --i >= 0; )
    {
       if (hitlist[i])
@@ -642,12 +652,23 @@ void R_PrecacheLevel(void)
             int16_t *sflump = sprites[i].spriteframes[j].lump;
             int k = 7;
             do
-               wGlobalDir.cacheLumpNum(firstspritelump + sflump[k], PU_CACHE);
+               spritelumps.add(firstspritelump + sflump[k]);
             while(--k >= 0);
          }
       }
    }
+
+   wGlobalDir.prefetchLumps(spritelumps.begin(), spritelumps.getLength());
+   for(int lumpnum : spritelumps)
+      wGlobalDir.cacheLumpNum(lumpnum, PU_CACHE);
+
    efree(hitlist);
+
+   if(devparm)
+   {
+      C_Printf("R_PrecacheLevel: %u ms using %d thread(s)\n",
+               i_haltimer.GetTicks() - starttime, M_WorkerThreadCount() + 1);
+   }
 }
 
 //
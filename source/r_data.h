@@ -136,6 +136,9 @@ byte *R_GetLinearBuffer(int tex);
 // Returns the texture for chaining.
 texture_t *R_CacheTexture(int num);
 
+// Cache a set of textures, composing them in parallel.
+void R_PrecacheTextures(const int *texnums, size_t count);
+
 // SoM: all textures/flats are now stored in a single array (textures)
 // Walls start from wallstart to (wallstop - 1) and flats go from flatstart 
 // to (flatstop - 1)
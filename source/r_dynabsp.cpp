@@ -31,10 +31,40 @@
 
 #include "z_zone.h"
 
+#include "c_io.h"
+#include "c_runcmd.h"
 #include "i_system.h"
+#include "m_compare.h"
 #include "p_setup.h"
 #include "r_dynabsp.h"
 
+//=============================================================================
+//
+// Statistics
+//
+
+struct dynabspstats_t
+{
+   int builds;  // trees built
+   int replays; // of which reused every partition choice
+   int segs;    // dynasegs fed in
+};
+
+static dynabspstats_t dynaBSPFrame;     // frame being rendered
+static dynabspstats_t dynaBSPLastFrame; // last complete frame
+static dynabspstats_t dynaBSPTotal;
+static int            dynaBSPPeak;      // most builds in one frame
+
+//
+// R_DynaBSPBeginFrame
+//
+void R_DynaBSPBeginFrame()
+{
+   dynaBSPLastFrame = dynaBSPFrame;
+   dynaBSPPeak = emax(dynaBSPPeak, dynaBSPFrame.builds);
+   memset(&dynaBSPFrame, 0, sizeof(dynaBSPFrame));
+}
+
 //=============================================================================
 //
 // rpolynode Maintenance
@@ -220,6 +250,111 @@ prune: ; // early exit and skip past the tests above
    return best; // All finished, return best seg
 }
 
+//=============================================================================
+//
+// Partition Choice Replay
+//
+// A polyobject is reattached from scratch every time it moves, so its
+// dynasegs are new objects each time and a tree cannot be kept. When the
+// segs of a subsector have only been translated, though, they come back in
+// the same order and the same shape, and every partition selection would
+// pick the same seg again. Each tree records its choices, and a rebuild
+// from segs with the same signature plays them back instead of repeating
+// the O(n^2) selection. Any seg is a valid partition, so a bad replay can
+// only cost tree quality, never correctness; it is dropped as soon as a
+// list does not have the recorded length.
+//
+
+struct dynabspbuild_t
+{
+   rpolybsp_t *bsp;       // tree recording its choices
+   int         next;      // node being built, in build order
+   bool        replaying; // bsp->choices holds the choices to repeat
+};
+
+//
+// R_dynaSegsSignature
+//
+// Hashes the seg list by line, side and shape, with coordinates taken
+// relative to the first seg and rounded to 1/16 unit, so that a translated
+// copy gives the same value.
+//
+static uint32_t R_dynaSegsSignature(dseglist_t segs)
+{
+   uint32_t hash = 2166136261u;
+   double   ox   = (*segs)->psx;
+   double   oy   = (*segs)->psy;
+
+   auto mix = [&hash] (uint32_t value) {
+      hash = (hash ^ value) * 16777619u;
+   };
+
+   for(dseglink_t *rover = segs; rover; rover = rover->dllNext)
+   {
+      const dynaseg_t *ds = *rover;
+
+      mix(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(ds->seg.linedef)));
+      mix(ds->backside);
+      mix(static_cast<uint32_t>(lround((ds->psx - ox) * 16.0)));
+      mix(static_cast<uint32_t>(lround((ds->psy - oy) * 16.0)));
+      mix(static_cast<uint32_t>(lround((ds->pex - ox) * 16.0)));
+      mix(static_cast<uint32_t>(lround((ds->pey - oy) * 16.0)));
+   }
+
+   return hash;
+}
+
+//
+// R_choosePartition
+//
+// Replays the recorded choice for this node if there still is one, or else
+// selects a partition, and records what was used.
+//
+static dynaseg_t *R_choosePartition(dynabspbuild_t &build, dseglist_t segs)
+{
+   rpolybsp_t *bsp = build.bsp;
+   dynaseg_t  *best = NULL;
+   dseglink_t *rover;
+   int         count = 0;
+
+   for(rover = segs; rover; rover = rover->dllNext)
+      ++count;
+
+   if(build.replaying)
+   {
+      if(build.next < bsp->numchoices && bsp->choices[build.next].count == count)
+      {
+         rover = segs;
+         for(int i = 0; i < bsp->choices[build.next].index; i++)
+            rover = rover->dllNext;
+         best = *rover;
+      }
+      else
+         build.replaying = false;
+   }
+
+   if(!best)
+      best = R_selectPartition(segs);
+
+   // record it; replayed entries are overwritten with the same values
+   if(build.next >= bsp->numalloc)
+   {
+      bsp->numalloc = bsp->numalloc ? bsp->numalloc * 2 : 16;
+      bsp->choices  = erealloc(rpolychoice_t *, bsp->choices, 
+                               bsp->numalloc * sizeof(rpolychoice_t));
+   }
+
+   int index = 0;
+   for(rover = segs; *rover != best; rover = rover->dllNext)
+      ++index;
+
+   bsp->choices[build.next].index = index;
+   bsp->choices[build.next].count = count;
+   ++build.next;
+
+   return best;
+}
+
 //=============================================================================
 //
 // Tree Building
@@ -388,13 +523,13 @@ static int R_classifyDynaSeg(const dynaseg_t *part, const dynaseg_t *seg, double
 // Split the input list of segs into left and right lists using one of the segs
 // selected as a partition line for the current node.
 //
-static void R_divideSegs(rpolynode_t *rpn, const dseglist_t *ts, 
-                         dseglist_t *rs, dseglist_t *ls)
+static void R_divideSegs(dynabspbuild_t &build, rpolynode_t *rpn, 
+                         const dseglist_t *ts, dseglist_t *rs, dseglist_t *ls)
 {
    dynaseg_t *best, *add_to_rs = NULL, *add_to_ls = NULL;
    
    // select best seg to use as partition line
-   best = rpn->partition = R_selectPartition(*ts);
+   best = rpn->partition = R_choosePartition(build, *ts);
 
    best->bsplink.remove();
 
@@ -516,7 +651,7 @@ static void R_divideSegs(rpolynode_t *rpn, const dseglist_t *ts,
 // A tree of rpolynode instances is returned. NULL is returned in the terminal
 // case where there are no segs left to classify.
 //
-static rpolynode_t *R_createNode(dseglist_t *ts)
+static rpolynode_t *R_createNode(dynabspbuild_t &build, dseglist_t *ts)
 {
    dseglist_t rights = NULL;
    dseglist_t lefts  = NULL;
@@ -527,13 +662,13 @@ static rpolynode_t *R_createNode(dseglist_t *ts)
    rpolynode_t *rpn = R_GetFreePolyNode();
 
    // divide the segs into two lists
-   R_divideSegs(rpn, ts, &rights, &lefts);
+   R_divideSegs(build, rpn, ts, &rights, &lefts);
 
    // recurse into right space
-   rpn->children[0] = R_createNode(&rights);
+   rpn->children[0] = R_createNode(build, &rights);
 
    // recurse into left space
-   rpn->children[1] = R_createNode(&lefts);
+   rpn->children[1] = R_createNode(build, &lefts);
 
    return rpn;
 }
@@ -550,7 +685,8 @@ static rpolynode_t *R_createNode(dseglist_t *ts)
 // dynasegs linked by their bsplinks. The dynasegs' BSP-related fields will also
 // be initialized. The result is suitable for input to R_BuildDynaBSP.
 //
-static bool R_collapseFragmentsToDSList(const subsector_t *subsec, dseglist_t *list)
+static bool R_collapseFragmentsToDSList(const subsector_t *subsec, dseglist_t *list,
+                                        int &count)
 {
    DLListItem<rpolyobj_t> *fragment = subsec->polyList;
 
@@ -566,6 +702,7 @@ static bool R_collapseFragmentsToDSList(const subsector_t *subsec, dseglist_t *l
       {
          R_setupDSForBSP(*ds);
          ds->bsplink.insert(ds, list);
+         ++count;
 
          // NB: fragment links are not disturbed by this process.
          ds = ds->subnext;
@@ -652,20 +789,53 @@ static void R_freeTreeRecursive(rpolynode_t *root)
 //
 // R_BuildDynaBSP
 //
-// Call to build a dynamic BSP sub-tree for sorting of dynasegs.
+// Call to build a dynamic BSP sub-tree for sorting of dynasegs. prev is the
+// subsector's previous tree, or NULL; it is reused, or freed if there is
+// nothing left to sort.
 //
-rpolybsp_t *R_BuildDynaBSP(const subsector_t *subsec)
+rpolybsp_t *R_BuildDynaBSP(const subsector_t *subsec, rpolybsp_t *prev)
 {
-   rpolybsp_t *bsp = NULL;
+   rpolybsp_t *bsp = prev;
    dseglist_t segs = NULL;
+   int        count = 0;
 
-   if(R_collapseFragmentsToDSList(subsec, &segs))
+   // Freeing the old tree first restores the polyobject segs it had split.
+   if(bsp)
    {
-      bsp = estructalloctag(rpolybsp_t, 1, PU_LEVEL);
-      bsp->dirty = false;
-      bsp->root = R_createNode(&segs);
+      R_freeTreeRecursive(bsp->root);
+      bsp->root = NULL;
    }
 
+   if(!R_collapseFragmentsToDSList(subsec, &segs, count))
+   {
+      if(bsp)
+         R_FreeDynaBSP(bsp);
+      return NULL;
+   }
+
+   if(!bsp)
+      bsp = estructalloctag(rpolybsp_t, 1, PU_LEVEL);
+
+   uint32_t signature = R_dynaSegsSignature(segs);
+
+   dynabspbuild_t build;
+   build.bsp       = bsp;
+   build.next      = 0;
+   build.replaying = bsp->numchoices && bsp->signature == signature;
+
+   bsp->dirty     = false;
+   bsp->signature = signature;
+   bsp->root      = R_createNode(build, &segs);
+
+   if(build.replaying && build.next == bsp->numchoices)
+      ++dynaBSPFrame.replays, ++dynaBSPTotal.replays;
+   bsp->numchoices = build.next;
+
+   ++dynaBSPFrame.builds;
+   ++dynaBSPTotal.builds;
+   dynaBSPFrame.segs += count;
+   dynaBSPTotal.segs += count;
+
    return bsp;
 }
 
@@ -677,8 +847,26 @@ rpolybsp_t *R_BuildDynaBSP(const subsector_t *subsec)
 void R_FreeDynaBSP(rpolybsp_t *bsp)
 {
    R_freeTreeRecursive(bsp->root);
+   if(bsp->choices)
+      efree(bsp->choices);
    efree(bsp);
 }
 
+//=============================================================================
+//
+// Console Commands
+//
+
+CONSOLE_COMMAND(r_dynabspstats, 0)
+{
+   C_Printf("Polyobject BSP builds (reusing every partition choice):\n"
+            "last frame %d (%d), %d segs\n"
+            "peak frame %d\n"
+            "total %d (%d), %d segs\n",
+            dynaBSPLastFrame.builds, dynaBSPLastFrame.replays, dynaBSPLastFrame.segs,
+            emax(dynaBSPPeak, dynaBSPLastFrame.builds),
+            dynaBSPTotal.builds, dynaBSPTotal.replays, dynaBSPTotal.segs);
+}
+
 // EOF
 
@@ -36,15 +36,29 @@ struct rpolynode_t
    dseglink_t  *altered;     // polyobject-owned segs altered by partitions.
 };
 
+// Partition picked for one node, as its position in the node's seg list.
+struct rpolychoice_t
+{
+   int index; // position of the partition seg
+   int count; // length of the list it was picked from
+};
+
 struct rpolybsp_t
 {
-   bool         dirty; // needs to be rebuilt if true
-   rpolynode_t *root;  // root of tree
+   bool           dirty;      // needs to be rebuilt if true
+   rpolynode_t   *root;       // root of tree
+   uint32_t       signature;  // shape of the segs, independent of position
+   rpolychoice_t *choices;    // partitions picked, in node build order
+   int            numchoices;
+   int            numalloc;
 };
 
-rpolybsp_t *R_BuildDynaBSP(const subsector_t *subsec);
+rpolybsp_t *R_BuildDynaBSP(const subsector_t *subsec, rpolybsp_t *prev);
 void R_FreeDynaBSP(rpolybsp_t *bsp);
 
+// Call at the start of each rendered frame, for the rebuild statistics.
+void R_DynaBSPBeginFrame();
+
 
 //
 // R_PointOnDynaSegSide
@@ -41,15 +41,19 @@
 #include "hu_over.h"
 #include "i_video.h"
 #include "m_bbox.h"
+#include "m_bspgrid.h"
 #include "m_random.h"
 #include "mn_engin.h"
 #include "p_chase.h"
 #include "p_info.h"
+#include "p_maputl.h"
 #include "p_partcl.h"
+#include "p_setup.h"
 #include "p_xenemy.h"
 #include "r_bsp.h"
 #include "r_draw.h"
 #include "r_drawq.h"
+#include "r_dynabsp.h"
 #include "r_dynseg.h"
 #include "r_interpolate.h"
 #include "r_main.h"
@@ -709,6 +713,34 @@ void R_Init()
    R_InitParticles(); // haleyjd
 }
 
+// grid of BSP walk starting points, aligned with the blockmap
+static BSPGrid r_nodegrid;
+
+//
+// R_BuildNodeGrid
+//
+// Must be called once the level's nodes and blockmap have been loaded.
+//
+void R_BuildNodeGrid()
+{
+   r_nodegrid.build(bmaporgx, bmaporgy, bmapwidth, bmapheight, MAPBLOCKSHIFT,
+                    nodes, numnodes,
+                    [] (const node_t &node, int side) { return node.children[side]; },
+                    [] (fixed_t x, fixed_t y, const node_t &node) {
+      return R_PointOnSide(x, y, const_cast<node_t *>(&node));
+   });
+}
+
+//
+// R_ClearNodeGrid
+//
+// Called before the level's nodes are freed.
+//
+void R_ClearNodeGrid()
+{
+   r_nodegrid.clear();
+}
+
 //
 // R_PointInSubsector
 //
@@ -717,7 +749,7 @@ void R_Init()
 //
 subsector_t *R_PointInSubsector(fixed_t x, fixed_t y)
 {
-   int nodenum = numnodes - 1;
+   int nodenum = r_nodegrid.startNode(x, y, numnodes - 1);
    while(!(nodenum & NF_SUBSECTOR))
       nodenum = nodes[nodenum].children[R_PointOnSide(x, y, nodes+nodenum)];
    return &subsectors[(nodenum == -1 ? 0 : nodenum & ~NF_SUBSECTOR)];
@@ -1153,6 +1185,7 @@ void R_RenderPlayerView(player_t* player, camera_t *camerapoint)
    R_ClearPlanes();
    R_ClearPortals();
    R_ClearSprites();
+   R_DynaBSPBeginFrame();
 
    if(autodetect_hom)
       R_HOMdrawer();
@@ -29,13 +29,16 @@
 
 #include "z_zone.h"
 #include "i_system.h"
+#include "hal/i_timer.h"
 
 #include "c_io.h"
+#include "c_runcmd.h"
 #include "d_gi.h"
 #include "e_exdata.h"
 #include "e_things.h"
 #include "m_bbox.h"
 #include "m_collection.h"
+#include "m_compare.h"
 #include "p_setup.h"
 #include "p_spec.h"
 #include "r_bsp.h"
@@ -87,6 +90,42 @@ static PODCollection<portalentry_t> gPortals;   // defined portals
 static portal_t *portals = NULL, *last = NULL;
 static pwindow_t *unusedhead = NULL, *windowhead = NULL, *windowlast = NULL;
 
+int r_portaldepth;
+int r_portaltime;
+
+//
+// Per-frame portal statistics, reported by r_portalstats
+//
+struct portalstats_t
+{
+   int created;   // windows made by R_NewPortalWindow
+   int merged;    // line lookups served by a collinear window of the same portal
+   int culled;    // families skipped because none of their columns were open
+   int degraded;  // families drawn as tainted to stay within the budget
+   int rendered;  // families actually rendered
+   int maxdepth;  // deepest nesting level reached
+   unsigned int nodes;  // BSP nodes visited by all portal views
+};
+
+// Portal families whose node counts are kept for r_portalstats
+#define MAXSTATWINDOWS 16
+
+struct portalwindowstat_t
+{
+   const portal_t *portal;
+   int            linenum;  // -1 for sector portals
+   int            depth;
+   unsigned int   nodes;
+};
+
+static portalstats_t      portalstats, lastportalstats;
+static portalwindowstat_t windowstats[MAXSTATWINDOWS], lastwindowstats[MAXSTATWINDOWS];
+static int                numwindowstats, lastnumwindowstats;
+
+// Counts the views rendered: the player's at the start of each frame, then
+// one for every portal window. Only windows made in the same view are merged.
+static unsigned int portalpass;
+
 //
 // VALLOCATION(portals)
 //
@@ -299,6 +338,9 @@ static pwindow_t *R_NewPortalWindow(portal_t *p, line_t *l, pwindowtype_e type)
    ret->line   = l;
    ret->type   = type;
    ret->head   = ret;
+   ret->depth  = portalrender.active && portalrender.w ? 
+                 portalrender.w->depth + 1 : 1;
+   ret->pass   = portalpass;
    if(type == pw_line)
    {
 #ifdef RANGECHECK
@@ -306,6 +348,8 @@ static pwindow_t *R_NewPortalWindow(portal_t *p, line_t *l, pwindowtype_e type)
          I_Error("R_NewPortalWindow: Null line despite type == pw_line!");
 #endif
       R_calcRenderBarrier(p, l, ret->barrier);
+      ret->runv1 = l->v1;
+      ret->runv2 = l->v2;
    }
    
    R_SetPortalFunction(ret);
@@ -317,6 +361,9 @@ static pwindow_t *R_NewPortalWindow(portal_t *p, line_t *l, pwindowtype_e type)
       windowlast->next = ret;
       windowlast = ret;
    }
+
+   ++portalstats.created;
+   portalstats.maxdepth = emax(portalstats.maxdepth, ret->depth);
    
    return ret;
 }
@@ -344,6 +391,10 @@ static void R_CreateChildWindow(pwindow_t *parent)
    child->type     = parent->type;
    child->func     = parent->func;
    child->clipfunc = parent->clipfunc;
+   child->depth    = parent->depth;
+   child->pass     = parent->pass;
+   child->runv1    = parent->runv1;
+   child->runv2    = parent->runv2;
 }
 
 //
@@ -1454,19 +1505,112 @@ pwindow_t *R_GetCeilingPortalWindow(portal_t *portal, fixed_t planez)
    return window;
 }
 
+//
+// R_linesCollinear
+//
+// True if both lines lie on the same infinite line and face the same way, so
+// that they produce the same render barrier.
+//
+static bool R_linesCollinear(const line_t *a, const line_t *b)
+{
+   static const float epsilon = 1.0f / 16;
+
+   if(fabs(a->nx - b->nx) > 0.001f || fabs(a->ny - b->ny) > 0.001f)
+      return false;
+
+   float d1 = (b->v1->fx - a->v1->fx) * a->nx + (b->v1->fy - a->v1->fy) * a->ny;
+   float d2 = (b->v2->fx - a->v1->fx) * a->nx + (b->v2->fy - a->v1->fy) * a->ny;
+
+   return fabs(d1) < epsilon && fabs(d2) < epsilon;
+}
+
+//
+// R_WindowHasLine
+//
+// True if the line is one of those rendered through the window: either its
+// own line or one that was merged into it, which lies within the window's
+// run of lines.
+//
+bool R_WindowHasLine(const pwindow_t *window, const line_t *line)
+{
+   if(window->line == line)
+      return true;
+
+   if(!line || !window->line || line->portal != window->portal ||
+      line->frontsector != window->line->frontsector ||
+      !R_linesCollinear(window->line, line))
+      return false;
+
+   static const float epsilon = 1.0f / 16;
+
+   float dx  = window->runv2->fx - window->runv1->fx;
+   float dy  = window->runv2->fy - window->runv1->fy;
+   float len = dx * dx + dy * dy;
+   float t1  = (line->v1->fx - window->runv1->fx) * dx + 
+               (line->v1->fy - window->runv1->fy) * dy;
+   float t2  = (line->v2->fx - window->runv1->fx) * dx + 
+               (line->v2->fy - window->runv1->fy) * dy;
+
+   return t1 > -epsilon && t1 < len + epsilon && 
+          t2 > -epsilon && t2 < len + epsilon;
+}
+
+//
+// R_lineContinuesWindow
+//
+// True if the line continues the run of lines of a window of the same portal:
+// it must be collinear, share a vertex with one end of the run and have the
+// same front sector, which tainted windows are filled from. The window must
+// also have been made in the view being rendered now, as windows from other
+// views look through the portal from somewhere else.
+//
+static bool R_lineContinuesWindow(const pwindow_t *window, const line_t *line)
+{
+   int depth = portalrender.active && portalrender.w ? 
+               portalrender.w->depth + 1 : 1;
+
+   if(window->pass != portalpass || window->depth != depth ||
+      window->line->frontsector != line->frontsector)
+      return false;
+
+   if(line->v1 != window->runv2 && line->v2 != window->runv1)
+      return false;
+
+   return R_linesCollinear(window->line, line);
+}
+
 pwindow_t *R_GetLinePortalWindow(portal_t *portal, line_t *line)
 {
    pwindow_t *rover = windowhead;
+   pwindow_t *merged = NULL;
 
    while(rover)
    {
-      if(rover->portal == portal && rover->type == pw_line && 
-         rover->line == line)
-         return rover;
+      if(rover->portal == portal && rover->type == pw_line)
+      {
+         if(rover->line == line)
+            return rover;
+
+         // Pieces of a wall split into several linedefs see the same view
+         // through the portal; render them as one window.
+         if(!merged && R_lineContinuesWindow(rover, line))
+            merged = rover;
+      }
 
       rover = rover->next;
    }
 
+   if(merged)
+   {
+      if(line->v1 == merged->runv2)
+         merged->runv2 = line->v2;
+      else
+         merged->runv1 = line->v1;
+
+      ++portalstats.merged;
+      return merged;
+   }
+
    // not found, so make it
    return R_NewPortalWindow(portal, line, pw_line);
 }
@@ -1497,6 +1641,13 @@ void R_MovePortalOverlayToWindow(bool isceiling)
 void R_ClearPortals()
 {
    portal_t *r = portals;
+
+   lastportalstats    = portalstats;
+   lastnumwindowstats = numwindowstats;
+   memcpy(lastwindowstats, windowstats, numwindowstats * sizeof(*windowstats));
+   memset(&portalstats, 0, sizeof(portalstats));
+   numwindowstats = 0;
+   ++portalpass;
    
    while(r)
    {
@@ -1505,6 +1656,89 @@ void R_ClearPortals()
    }
 }
 
+//
+// R_windowFamilyVisible
+//
+// Windows are clipped against everything in front of them as their columns
+// are added, so a family with no open column anywhere is fully occluded and
+// its view need not be set up at all.
+//
+static bool R_windowFamilyVisible(const pwindow_t *window)
+{
+   for(; window; window = window->child)
+   {
+      for(int x = window->minx; x <= window->maxx; x++)
+      {
+         if(window->top[x] <= window->bottom[x])
+            return true;
+      }
+   }
+   return false;
+}
+
+//
+// R_overPortalBudget
+//
+// True if rendering the window would exceed the configured nesting depth or
+// the time allowed for portals this frame. Only portals that traverse the
+// BSP again are limited; plane and horizon portals are cheap.
+//
+static bool R_overPortalBudget(const pwindow_t *window, unsigned int starttime)
+{
+   const portal_t *portal = window->portal;
+
+   if(portal->type != R_SKYBOX && portal->type != R_ANCHORED &&
+      portal->type != R_TWOWAY && portal->type != R_LINKED)
+      return false;
+
+   if(r_portaldepth && window->depth > r_portaldepth)
+      return true;
+
+   return r_portaltime && i_haltimer.GetTicks() - starttime >= 
+      static_cast<unsigned int>(r_portaltime);
+}
+
+//
+// R_degradeWindowFamily
+//
+// Fills a window family that is over budget the same way as a portal that
+// recursed too far.
+//
+static void R_degradeWindowFamily(pwindow_t *window)
+{
+   ++portalstats.degraded;
+
+   if(showtainted)
+   {
+      C_Printf(FC_ERROR "Portal budget exceeded (depth=%d)\n", 
+               window->depth);
+   }
+
+   for(; window; window = window->child)
+   {
+      if(window->maxx >= window->minx)
+         R_ShowTainted(window);
+   }
+}
+
+//
+// R_addWindowStat
+//
+static void R_addWindowStat(const pwindow_t *window, unsigned int nodes)
+{
+   ++portalstats.rendered;
+   portalstats.nodes += nodes;
+
+   if(numwindowstats == MAXSTATWINDOWS)
+      return;
+
+   portalwindowstat_t &stat = windowstats[numwindowstats++];
+   stat.portal  = window->portal;
+   stat.linenum = window->line ? static_cast<int>(window->line - lines) : -1;
+   stat.depth   = window->depth;
+   stat.nodes   = nodes;
+}
+
 //
 // R_RenderPortals
 //
@@ -1513,6 +1747,7 @@ void R_ClearPortals()
 void R_RenderPortals()
 {
    pwindow_t *w;
+   unsigned int starttime = i_haltimer.GetTicks();
 
    while(windowhead)
    {
@@ -1522,7 +1757,21 @@ void R_RenderPortals()
 //      portalrender.overlay = windowhead->portal->poverlay;
 
       if(windowhead->maxx >= windowhead->minx)
-         windowhead->func(windowhead);
+      {
+         if(!R_windowFamilyVisible(windowhead))
+            ++portalstats.culled;
+         else if(R_overPortalBudget(windowhead, starttime))
+            R_degradeWindowFamily(windowhead);
+         else
+         {
+            unsigned int nodes = r_bspnodecount;
+
+            ++portalpass;
+            windowhead->func(windowhead);
+
+            R_addWindowStat(windowhead, r_bspnodecount - nodes);
+         }
+      }
 
       portalrender.active = false;
       portalrender.w = NULL;
@@ -2116,5 +2365,53 @@ bool R_IsSkyLikePortalWall(const line_t &line)
          line.portal->type == R_HORIZON || line.portal->type == R_PLANE);
 }
 
-// EOF
+//=============================================================================
+//
+// Console Commands and Variables
+//
+
+VARIABLE_INT(r_portaldepth, NULL, 0, 128, NULL);
+CONSOLE_VARIABLE(r_portaldepth, r_portaldepth, 0) {}
+
+VARIABLE_INT(r_portaltime, NULL, 0, 1000, NULL);
+CONSOLE_VARIABLE(r_portaltime, r_portaltime, 0) {}
+
+// indexed by rportaltype_e
+static const char *portaltypenames[] =
+{
+   "none", "skybox", "anchored", "horizon", "plane", "twoway", "linked"
+};
 
+CONSOLE_COMMAND(r_portalstats, 0)
+{
+   const portalstats_t &st = lastportalstats;
+
+   C_Printf(FC_HI "Portal windows (last frame):\n"
+            FC_NORMAL "created %d, merged %d, culled %d, degraded %d\n"
+            "rendered %d, max depth %d, BSP nodes %u\n",
+            st.created, st.merged, st.culled, st.degraded, st.rendered,
+            st.maxdepth, st.nodes);
+
+   for(int i = 0; i < lastnumwindowstats; i++)
+   {
+      const portalwindowstat_t &ws = lastwindowstats[i];
+      const char *name = ws.portal->type >= 0 && 
+         ws.portal->type < static_cast<int>(earrlen(portaltypenames)) ?
+         portaltypenames[ws.portal->type] : "?";
+
+      if(ws.linenum >= 0)
+      {
+         C_Printf("%2d: %-8s line %5d depth %d nodes %u\n", i, name, 
+                  ws.linenum, ws.depth, ws.nodes);
+      }
+      else
+      {
+         C_Printf("%2d: %-8s sector     depth %d nodes %u\n", i, name, 
+                  ws.depth, ws.nodes);
+      }
+   }
+   if(lastportalstats.rendered > lastnumwindowstats)
+      C_Printf("(%d more)\n", lastportalstats.rendered - lastnumwindowstats);
+}
+
+// EOF
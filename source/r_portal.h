@@ -338,6 +338,12 @@ struct pwindow_t
    // child down the chain.
    pwindow_t *head, *child;
 
+   int depth;  // portal nesting level: 1 for windows seen from the player
+   unsigned int pass;  // view the window was made in, see R_GetLinePortalWindow
+
+   // ends of the run of adjoining collinear lines drawn through the window
+   vertex_t *runv1, *runv2;
+
    planehash_t *poverlay;  // Portal overlays are now stored per window
 };
 
@@ -347,6 +353,11 @@ void R_WindowAdd(pwindow_t *window, int x, float ytop, float ybottom);
 pwindow_t *R_GetFloorPortalWindow(portal_t *portal, fixed_t planez);
 pwindow_t *R_GetCeilingPortalWindow(portal_t *portal, fixed_t planez);
 pwindow_t *R_GetLinePortalWindow(portal_t *portal, line_t *line);
+bool R_WindowHasLine(const pwindow_t *window, const line_t *line);
+
+// Portal rendering budget: 0 means unlimited
+extern int r_portaldepth; // maximum nesting level
+extern int r_portaltime;  // maximum milliseconds spent per frame
 
 
 // SoM 3/14/2004: flag if we are rendering portals.
@@ -0,0 +1,391 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: persistent on-disk cache of the parsed and composed wall textures.
+//
+// The texture definitions and composed images only change when the loaded
+// resources do, so after the first run they are written to a file keyed by
+// a hash of the wad directory. A later start with the same resources reads
+// that file instead of parsing PNAMES/TEXTUREx and composing every patch.
+//
+
+#include <vector>
+
+#include "z_zone.h"
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "d_gi.h"
+#include "doomstat.h"
+#include "hal/i_directory.h"
+#include "hal/i_process.h"
+#include "m_argv.h"
+#include "m_hash.h"
+#include "m_qstr.h"
+#include "m_utils.h"
+#include "r_data.h"
+#include "r_texcache.h"
+#include "v_misc.h"
+#include "w_wad.h"
+
+// Bump whenever the layout or the meaning of any field changes.
+#define TEXCACHE_MAGIC   "EETXC001"
+#define TEXCACHE_VERSION 1
+
+// Files larger than this are not written; offsets are 32-bit.
+#define TEXCACHE_MAXSIZE 0x7fffffffu
+
+bool r_texcache = true;
+
+//
+// R_texCacheKey
+//
+// Hashes everything the cached data is derived from.
+//
+static void R_texCacheKey(uint32_t key[5])
+{
+   HashData hash(HashData::SHA1);
+   int32_t  extra[4];
+
+   wGlobalDir.hashContents(hash);
+
+   // texture hacks depend on the game mode
+   extra[0] = GameModeInfo->type;
+   extra[1] = GameModeInfo->id;
+   extra[2] = GameModeInfo->missionInfo->id;
+   extra[3] = TEXCACHE_VERSION;
+   hash.addData(reinterpret_cast<const uint8_t *>(extra), sizeof(extra));
+   hash.wrapUp();
+
+   for(int i = 0; i < 5; i++)
+      key[i] = hash.getDigestPart(i);
+}
+
+//
+// R_texCacheEnabled
+//
+// -notexcache overrides the configured setting for one run.
+//
+static bool R_texCacheEnabled()
+{
+   return r_texcache && !M_CheckParm("-notexcache");
+}
+
+//
+// R_texCachePath
+//
+// All cache files live in <userpath>/cache, named by key so that different
+// mods do not evict each other's files.
+//
+static void R_texCachePath(const uint32_t key[5], qstring &path, bool create)
+{
+   path = userpath;
+   path.pathConcatenate("cache");
+   if(create)
+      I_CreateDirectory(path);
+
+   qstring name;
+   name.Printf(0, "textures-%08x%08x%08x%08x%08x.cache",
+               key[0], key[1], key[2], key[3], key[4]);
+   path.pathConcatenate(name.constPtr());
+}
+
+//=============================================================================
+//
+// Loading
+//
+
+//
+// TextureCacheFile::~TextureCacheFile
+//
+TextureCacheFile::~TextureCacheFile()
+{
+   if(data)
+      efree(data);
+}
+
+//
+// TextureCacheFile::validate
+//
+// Bounds-checks every offset in the file, so that a truncated or corrupt
+// cache is rejected rather than read out of range.
+//
+bool TextureCacheFile::validate() const
+{
+   auto hdr = at<texcacheheader_t>(0);
+
+   // Checks that count elements of size bytes at offset lie within the file.
+   auto inRange = [this] (uint32_t offset, uint32_t count, size_t elemsize) {
+      return offset <= size && count <= (size - offset) / elemsize;
+   };
+
+   if(hdr->fileSize != size || hdr->numwalls <= 0 ||
+      !inRange(hdr->recordsOffset, hdr->numwalls, sizeof(texcacherec_t)))
+      return false;
+
+   auto records = at<texcacherec_t>(hdr->recordsOffset);
+   for(int i = 0; i < hdr->numwalls; i++)
+   {
+      const texcacherec_t &rec = records[i];
+
+      if(rec.width <= 0 || rec.height <= 0 || rec.ccount < 0)
+         return false;
+      if(!inRange(rec.compOffset, rec.ccount, sizeof(texcachecomp_t)))
+         return false;
+
+      auto comps = at<texcachecomp_t>(rec.compOffset);
+      for(int c = 0; c < rec.ccount; c++)
+      {
+         if(comps[c].lump < -1 || comps[c].lump >= wGlobalDir.getNumLumps())
+            return false;
+      }
+
+      // textures without components are generated, not stored
+      if(!rec.ccount)
+         continue;
+
+      uint32_t imagesize = uint32_t(rec.width) * uint32_t(rec.height);
+      if(!rec.imageOffset || rec.imageSize < imagesize ||
+         !inRange(rec.imageOffset, rec.imageSize, 1))
+         return false;
+      if(!inRange(rec.runCountOffset, rec.width, sizeof(int32_t)) ||
+         !inRange(rec.runsOffset, rec.numRuns, sizeof(texcachecol_t)))
+         return false;
+
+      auto runcounts = at<int32_t>(rec.runCountOffset);
+      auto runs      = at<texcachecol_t>(rec.runsOffset);
+      uint32_t total = 0;
+      for(int x = 0; x < rec.width; x++)
+      {
+         if(runcounts[x] < 0 || (total += runcounts[x]) > rec.numRuns)
+            return false;
+      }
+      if(total != rec.numRuns)
+         return false;
+
+      for(uint32_t r = 0; r < rec.numRuns; r++)
+      {
+         if(runs[r].ptroff + runs[r].len > imagesize)
+            return false;
+      }
+   }
+
+   return true;
+}
+
+//
+// TextureCacheFile::load
+//
+// Reads the cache file matching the current resources, if one exists. The
+// header is read first so that a stale file costs only a few bytes of I/O.
+//
+bool TextureCacheFile::load()
+{
+   texcacheheader_t hdr;
+   uint32_t         key[5];
+   qstring          path;
+   FILE            *f;
+
+   if(!R_texCacheEnabled())
+      return false;
+
+   R_texCacheKey(key);
+   R_texCachePath(key, path, false);
+
+   if(!(f = fopen(path.constPtr(), "rb")))
+      return false;
+
+   bool ok = false;
+   if(fread(&hdr, sizeof(hdr), 1, f) == 1 &&
+      !memcmp(hdr.magic, TEXCACHE_MAGIC, sizeof(hdr.magic)) &&
+      !memcmp(hdr.key, key, sizeof(key)) &&
+      hdr.fileSize >= sizeof(hdr) && hdr.fileSize <= TEXCACHE_MAXSIZE)
+   {
+      size = hdr.fileSize;
+      data = emalloc(byte *, size);
+      memcpy(data, &hdr, sizeof(hdr));
+      ok = fread(data + sizeof(hdr), 1, size - sizeof(hdr), f) == size - sizeof(hdr);
+   }
+   fclose(f);
+
+   if(ok && validate())
+   {
+      header = at<texcacheheader_t>(0);
+      return true;
+   }
+
+   if(data)
+   {
+      C_Printf(FC_ERROR "Ignoring invalid texture cache %s\n", path.constPtr());
+      efree(data);
+      data = nullptr;
+      size = 0;
+   }
+   return false;
+}
+
+//=============================================================================
+//
+// Saving
+//
+
+//
+// TextureCacheWriter
+//
+// Lays out a cache file in memory. Everything is appended at 4-byte aligned
+// offsets.
+//
+class TextureCacheWriter
+{
+protected:
+   std::vector<byte> buffer;
+
+public:
+   size_t getSize() const { return buffer.size(); }
+   const byte *getData() const { return buffer.data(); }
+
+   uint32_t append(const void *src, size_t len)
+   {
+      size_t offset = (buffer.size() + 3) & ~size_t(3);
+      buffer.resize(offset + len);
+      if(len)
+         memcpy(&buffer[offset], src, len);
+      return static_cast<uint32_t>(offset);
+   }
+
+   template<typename T> T *at(uint32_t offset)
+   {
+      return reinterpret_cast<T *>(&buffer[offset]);
+   }
+};
+
+//
+// TextureCacheFile::Save
+//
+// Writes out the given wall textures, which must all be cached. The file is
+// written under a temporary name and renamed into place, so that a crash or
+// a second instance never leaves a half-written cache behind.
+//
+bool TextureCacheFile::Save(texture_t *const *walls, int numwalls)
+{
+   TextureCacheWriter writer;
+   texcacheheader_t   hdr;
+
+   if(!R_texCacheEnabled() || numwalls <= 0)
+      return false;
+
+   memset(&hdr, 0, sizeof(hdr));
+   memcpy(hdr.magic, TEXCACHE_MAGIC, sizeof(hdr.magic));
+   R_texCacheKey(hdr.key);
+   hdr.numwalls = numwalls;
+   writer.append(&hdr, sizeof(hdr));
+
+   std::vector<texcacherec_t> records(numwalls);
+
+   for(int i = 0; i < numwalls; i++)
+   {
+      const texture_t *tex = walls[i];
+      texcacherec_t   &rec = records[i];
+
+      memset(&rec, 0, sizeof(rec));
+      strncpy(rec.name, tex->name, sizeof(rec.name));
+      rec.width    = tex->width;
+      rec.height   = tex->height;
+      rec.flags    = tex->flags;
+      rec.ccount   = tex->ccount;
+      rec.flatsize = tex->flatsize;
+
+      std::vector<texcachecomp_t> comps(tex->ccount);
+      for(int c = 0; c < tex->ccount; c++)
+      {
+         comps[c].originx = tex->components[c].originx;
+         comps[c].originy = tex->components[c].originy;
+         comps[c].width   = tex->components[c].width;
+         comps[c].height  = tex->components[c].height;
+         comps[c].lump    = tex->components[c].lump;
+         comps[c].type    = tex->components[c].type;
+      }
+      rec.compOffset = writer.append(comps.data(), comps.size() * sizeof(texcachecomp_t));
+
+      if(!tex->ccount)
+         continue;
+
+      // only complete textures can be stored
+      if(!tex->buffer || !tex->columns)
+         return false;
+
+      rec.imageSize   = tex->width * tex->height + 4;
+      rec.imageOffset = writer.append(tex->buffer, rec.imageSize);
+
+      std::vector<int32_t>       runcounts(tex->width, 0);
+      std::vector<texcachecol_t> runs;
+      for(int x = 0; x < tex->width; x++)
+      {
+         for(const texcol_t *col = tex->columns[x]; col; col = col->next)
+         {
+            texcachecol_t run = { col->yoff, col->len, col->ptroff };
+            runs.push_back(run);
+            ++runcounts[x];
+         }
+      }
+      rec.numRuns        = static_cast<uint32_t>(runs.size());
+      rec.runCountOffset = writer.append(runcounts.data(), runcounts.size() * sizeof(int32_t));
+      rec.runsOffset     = writer.append(runs.data(), runs.size() * sizeof(texcachecol_t));
+
+      if(writer.getSize() > TEXCACHE_MAXSIZE)
+         return false;
+   }
+
+   uint32_t recordsOffset = writer.append(records.data(), records.size() * sizeof(texcacherec_t));
+   if(writer.getSize() > TEXCACHE_MAXSIZE)
+      return false;
+
+   auto whdr = writer.at<texcacheheader_t>(0);
+   whdr->recordsOffset = recordsOffset;
+   whdr->fileSize      = static_cast<uint32_t>(writer.getSize());
+
+   qstring path, tmppath;
+   R_texCachePath(hdr.key, path, true);
+
+   // unique per process, as other instances may be saving the same file
+   tmppath.Printf(0, "%s.%d.tmp", path.constPtr(), I_GetProcessID());
+
+   if(!M_WriteFile(tmppath.constPtr(), const_cast<byte *>(writer.getData()), writer.getSize()))
+      return false;
+
+   remove(path.constPtr());
+   if(rename(tmppath.constPtr(), path.constPtr()))
+   {
+      remove(tmppath.constPtr());
+      return false;
+   }
+
+   return true;
+}
+
+//=============================================================================
+//
+// Console Variables
+//
+
+VARIABLE_TOGGLE(r_texcache, NULL, onoff);
+CONSOLE_VARIABLE(r_texcache, r_texcache, 0) {}
+
+// EOF
+
@@ -0,0 +1,136 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: persistent on-disk cache of the parsed and composed wall textures.
+//
+
+#ifndef R_TEXCACHE_H__
+#define R_TEXCACHE_H__
+
+struct texture_t;
+
+//
+// File layout
+//
+// Every structure is 4-byte aligned and refers to others by offset from the
+// start of the file, so a loaded (or memory-mapped) file is used in place
+// without any unpacking. Values are in native byte order; a cache file is
+// only meaningful on the machine that wrote it.
+//
+
+struct texcacheheader_t
+{
+   char     magic[8];      // TEXCACHE_MAGIC
+   uint32_t key[5];        // SHA-1 of wad directory, game mode and version
+   int32_t  numwalls;      // number of wall textures stored
+   uint32_t recordsOffset; // offset of texcacherec_t[numwalls]
+   uint32_t fileSize;      // total size, for truncation checks
+};
+
+struct texcacherec_t
+{
+   char     name[8];        // texture name
+   int16_t  width, height;  // dimensions
+   uint32_t flags;          // texture_t::flags
+   int16_t  ccount;         // number of components
+   uint8_t  flatsize;       // texture_t::flatsize
+   uint8_t  pad;
+   uint32_t compOffset;     // offset of texcachecomp_t[ccount]
+   uint32_t imageOffset;    // offset of composed buffer, 0 if not stored
+   uint32_t imageSize;      // size of composed buffer
+   uint32_t runCountOffset; // offset of int32_t[width] runs per column
+   uint32_t runsOffset;     // offset of texcachecol_t[numRuns]
+   uint32_t numRuns;        // total column runs, 0 if no column lists
+};
+
+struct texcachecomp_t
+{
+   int32_t  originx, originy;
+   uint32_t width, height;
+   int32_t  lump;
+   int32_t  type;
+};
+
+struct texcachecol_t
+{
+   uint16_t yoff, len;
+   uint32_t ptroff;
+};
+
+//
+// TextureCacheFile
+//
+// A cache file read into memory and validated against the current setup.
+//
+class TextureCacheFile
+{
+protected:
+   byte   *data;                   // file contents
+   size_t  size;                   // size of data
+   const texcacheheader_t *header; // non-null once validated
+
+   template<typename T> const T *at(uint32_t offset) const
+   {
+      return reinterpret_cast<const T *>(data + offset);
+   }
+
+   bool validate() const;
+
+public:
+   TextureCacheFile() : data(nullptr), size(0), header(nullptr) {}
+   ~TextureCacheFile();
+
+   TextureCacheFile(const TextureCacheFile &) = delete;
+   TextureCacheFile &operator = (const TextureCacheFile &) = delete;
+
+   bool load();
+
+   int getNumWalls() const { return header ? header->numwalls : 0; }
+
+   const texcacherec_t &getRecord(int i) const
+   {
+      return at<texcacherec_t>(header->recordsOffset)[i];
+   }
+   const texcachecomp_t *getComponents(const texcacherec_t &rec) const
+   {
+      return at<texcachecomp_t>(rec.compOffset);
+   }
+   const byte *getImage(const texcacherec_t &rec) const
+   {
+      return rec.imageOffset ? at<byte>(rec.imageOffset) : nullptr;
+   }
+   const int32_t *getRunCounts(const texcacherec_t &rec) const
+   {
+      return at<int32_t>(rec.runCountOffset);
+   }
+   const texcachecol_t *getRuns(const texcacherec_t &rec) const
+   {
+      return at<texcachecol_t>(rec.runsOffset);
+   }
+
+   static bool Save(texture_t *const *walls, int numwalls);
+};
+
+extern bool r_texcache;
+
+#endif
+
+// EOF
+
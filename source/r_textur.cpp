@@ -23,6 +23,9 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
+#include <vector>
+
 #include "z_zone.h"
 #include "i_system.h"
 
@@ -32,14 +35,17 @@
 #include "d_io.h"
 #include "d_main.h"
 #include "e_hash.h"
+#include "m_collection.h"
 #include "m_compare.h"
 #include "m_swap.h"
+#include "m_workpool.h"
 #include "p_setup.h"
 #include "p_skin.h"
 #include "r_data.h"
 #include "r_draw.h"
 #include "r_patch.h"
 #include "r_ripple.h"
+#include "r_texcache.h"
 #include "v_misc.h"
 #include "v_patchfmt.h"
 #include "v_video.h"
@@ -615,43 +621,70 @@ static int R_ReadTextureNamespace(int texnum)
 //    x * texture->height + y
 
 
-// This struct holds the temporary structure of a masked texture while it is
-// build assembled. When a texture is complete, new col structs are allocated 
-// in a single block to ensure linearity within memory.
-struct tempmask_s
+// A texture is built in three stages so that the middle one can run on a
+// worker thread:
+//  1. R_prepareTexture (main thread) caches and locks the component graphics
+//     and allocates the texture buffer from the zone heap.
+//  2. R_composeTexture (any thread) paints the components into the buffer,
+//     marks the mask, and works out the column runs into private memory.
+//  3. R_installTexture (main thread) copies the column runs into the zone
+//     heap and unlocks the buffer.
+// R_CacheTexture runs all three back to back; R_PrecacheTextures spreads the
+// middle stage across the worker pool.
+struct texbuild_t
 {
-   // This is the buffer used for masking
-   bool       mask;       // If set to true, FinishTexture should create columns
-   int        buffermax;  // size of allocated buffer
-   byte      *buffer;     // mask buffer.
-   texture_t *tex;
+   texture_t               *tex;       // texture being built
+   bool                     mask;      // if true, build the column lists
+   std::vector<const void *> sources;  // cached graphic for each component
+   std::vector<byte>        maskbuf;   // mask buffer
+   std::vector<texcol_t>    runs;      // column runs, in column order
+   std::vector<int>         runcounts; // number of runs in each column
+   char                     error[128]; // first range error, if any
+};
    
-   texcol_t  *tempcols;
-} tempmask = { false, 0, NULL, NULL, NULL };
+#ifdef RANGECHECK
+//
+// R_textureError
+//
+// Records the first range error found while composing a texture. Workers
+// must not call I_Error, so R_installTexture raises it on the main thread.
+//
+static void R_textureError(texbuild_t &build, E_FORMAT_STRING(const char *fmt), ...)
+{
+   va_list args;
+
+   if(build.error[0])
+      return;
+
+   va_start(args, fmt);
+   pvsnprintf(build.error, sizeof(build.error), fmt, args);
+   va_end(args);
+}
+#endif
 
 //
 // AddTexColumn
 //
-// Copies from src to the tex buffer and optionally marks the temporary mask
+// Copies from src to the tex buffer and optionally marks the mask
 //
-static void AddTexColumn(texture_t *tex, const byte *src, int srcstep, 
+static void AddTexColumn(texbuild_t &build, const byte *src, int srcstep,
                          int ptroff, int len)
 {
-   byte *dest = tex->buffer + ptroff;
+   texture_t *tex  = build.tex;
+   byte      *dest = tex->buffer + ptroff;
    
 #ifdef RANGECHECK
-   if(ptroff < 0 || ptroff + len > tex->width * tex->height ||
-      ptroff + len > tempmask.buffermax)
+   if(ptroff < 0 || ptroff + len > tex->width * tex->height)
    {
-      I_Error("AddTexColumn(%s) invalid ptroff: %i / (%i, %i)\n", 
-              (const char *)(tex->name), 
-              ptroff + len, tex->width * tex->height, tempmask.buffermax);
+      R_textureError(build, "AddTexColumn(%s) invalid ptroff: %i / %i\n",
+                     (const char *)(tex->name), ptroff + len, tex->width * tex->height);
+      return;
    }
 #endif
 
-   if(tempmask.mask && tex == tempmask.tex)
+   if(build.mask)
    {
-      byte *mask = tempmask.buffer + ptroff;
+      byte *mask = &build.maskbuf[ptroff];
       
       while(len > 0)
       {
@@ -667,7 +700,7 @@ static void AddTexColumn(texture_t *tex, const byte *src, int srcstep,
       while(len > 0)
       {
          *dest = *src;
-         dest++; src++;
+         dest++; src += srcstep;
          len--;
       }
    }
@@ -678,9 +711,10 @@ static void AddTexColumn(texture_t *tex, const byte *src, int srcstep,
 // 
 // Paints the given flat-based component to the texture and marks mask info
 //
-static void AddTexFlat(texture_t *tex, tcomponent_t *component)
+static void AddTexFlat(texbuild_t &build, const tcomponent_t *component,
+                       const byte *src)
 {
-   byte      *src = (byte *)(wGlobalDir.cacheLumpNum(component->lump, PU_CACHE));
+   texture_t *tex = build.tex;
    int       destoff, srcoff, deststep, srcxstep, srcystep;
    int       xstart, ystart, xstop, ystop;
    int       width, height, wcount, hcount;
@@ -737,10 +771,13 @@ static void AddTexFlat(texture_t *tex, tcomponent_t *component)
    {
 #ifdef RANGECHECK
       if(srcoff < 0 || srcoff + (hcount - 1) * srcystep > tex->width * tex->height)
-         I_Error("AddTexFlat(%s): Invalid srcoff %i / %i\n", 
-                 (const char *)(tex->name), srcoff, tex->width * tex->height);
+      {
+         R_textureError(build, "AddTexFlat(%s): Invalid srcoff %i / %i\n",
+                        (const char *)(tex->name), srcoff, tex->width * tex->height);
+         return;
+      }
 #endif
-      AddTexColumn(tex, src + srcoff, srcystep, destoff, hcount);
+      AddTexColumn(build, src + srcoff, srcystep, destoff, hcount);
       srcoff += srcxstep;
       destoff += deststep;
       wcount--;
@@ -752,9 +789,10 @@ static void AddTexFlat(texture_t *tex, tcomponent_t *component)
 // 
 // Paints the given flat-based component to the texture and marks mask info
 //
-static void AddTexPatch(texture_t *tex, tcomponent_t *component)
+static void AddTexPatch(texbuild_t &build, const tcomponent_t *component,
+                        const patch_t *patch)
 {
-   patch_t *patch = PatchLoader::CacheNum(wGlobalDir, component->lump, PU_CACHE);
+   texture_t *tex = build.tex;
    int      destoff;
    int      xstart, ystart, xstop;
    int      colindex, colstep;
@@ -786,7 +824,7 @@ static void AddTexPatch(texture_t *tex, tcomponent_t *component)
    {
       int top, y1, y2, destbase;
       const column_t *column = 
-         (const column_t *)((byte *)patch + patch->columnofs[colindex]);
+         (const column_t *)((const byte *)patch + patch->columnofs[colindex]);
          
       destbase = x * tex->height;
       top = 0;
@@ -827,12 +865,15 @@ static void AddTexPatch(texture_t *tex, tcomponent_t *component)
 
 #ifdef RANGECHECK
       if(srcoff < 0 || srcoff + y2 - y1 > column->length)
-         I_Error("AddTexFlat(%s): Invalid srcoff %i / %i\n", 
-                 (const char *)(tex->name), srcoff, column->length);
+      {
+         R_textureError(build, "AddTexFlat(%s): Invalid srcoff %i / %i\n",
+                        (const char *)(tex->name), srcoff, column->length);
+         return;
+      }
 #endif
             
          if(y2 - y1 > 0)
-            AddTexColumn(tex, src + srcoff, 1, destoff, y2 - y1);
+            AddTexColumn(build, src + srcoff, 1, destoff, y2 - y1);
             
          column = reinterpret_cast<const column_t *>(src + column->length + 1);
       }
@@ -840,12 +881,48 @@ static void AddTexPatch(texture_t *tex, tcomponent_t *component)
 }
 
 //
-// StartTexture
+// R_lockComponent
+//
+// Caches a component graphic and keeps it from being purged until the texture
+// is finished. Blocks that were purgable are added to locked so that they can
+// be returned to PU_CACHE afterward.
+//
+static const void *R_lockComponent(const tcomponent_t *component,
+                                   PODCollection<void *> &locked)
+{
+   void *data;
+
+   if(component->type == TC_PATCH)
+      data = PatchLoader::CacheNum(wGlobalDir, component->lump, PU_CACHE);
+   else
+      data = wGlobalDir.cacheLumpNum(component->lump, PU_CACHE);
+
+   if(Z_CheckTag(data) == PU_CACHE)
+   {
+      Z_ChangeTag(data, PU_STATIC);
+      locked.add(data);
+   }
+
+   return data;
+}
+
+//
+// R_unlockComponents
+//
+static void R_unlockComponents(PODCollection<void *> &locked)
+{
+   for(void *data : locked)
+      Z_ChangeTag(data, PU_CACHE);
+   locked.clear();
+}
+
+//
+// R_prepareTexture
 //
-// Allocates the texture buffer, as well as managing the temporary structs and
-// the mask buffer.
+// Allocates the texture buffer and gathers the component graphics.
 //
-static void StartTexture(texture_t *tex, bool mask)
+static void R_prepareTexture(texbuild_t &build, texture_t *tex,
+                             PODCollection<void *> &locked)
 {
    // haleyjd 11/18/12: We *must* allocate some pad space in the texture buffer.
    // Due to intermixed use of float and fixed_t in Cardboard, it is impossible
@@ -855,80 +932,71 @@ static void StartTexture(texture_t *tex, bool mask)
 
    int bufferlen = tex->width * tex->height + 4;
    
-   // Static for now
+   // Static until R_installTexture
    tex->buffer = ecalloctag(byte *, 1, bufferlen, PU_STATIC, (void **)&tex->buffer);
    
-   if((tempmask.mask = mask))
+   build.tex      = tex;
+   build.error[0] = '\0';
+
+   // This function has two primary branches:
+   // 1. There is no buffer, and there are no columns which means the texture
+   //    has never been built before and needs a full treatment
+   // 2. There is no buffer, but there are columns which means that the buffer
+   //    (PU_CACHE) has been freed but the columns (PU_RENDERER) have not.
+   //    This case means we only have to rebuilt the buffer.
+   if((build.mask = (tex->columns == NULL)))
+      build.maskbuf.assign(bufferlen, 0);
+
+   build.sources.assign(tex->ccount, nullptr);
+   for(int i = 0; i < tex->ccount; i++)
    {
-      tempmask.tex = tex;
-      
-      // Setup the temporary mask
-      if(bufferlen > tempmask.buffermax || !tempmask.buffer)
-      {
-         tempmask.buffermax = bufferlen;
-         tempmask.buffer = (byte *)(Z_Realloc(tempmask.buffer, bufferlen, 
-                                        PU_RENDERER, (void **)&tempmask.buffer));
-      }
-      memset(tempmask.buffer, 0, bufferlen);
+      // SoM: Do NOT add lumps with a -1 lumpnum
+      if(tex->components[i].lump != -1)
+         build.sources[i] = R_lockComponent(&tex->components[i], locked);
    }
 }
 
 //
-// NextTempCol
+// R_composeTexture
 //
-// Returns either the next element in the chain or a new element which is
-// then added to the chain.
+// Paints the components and builds the column runs. Touches nothing but the
+// texture buffer and the build structure, so it is safe on a worker thread.
 //
-static texcol_t *NextTempCol(texcol_t *current)
+static void R_composeTexture(texbuild_t &build)
 {
-   if(!current)
+   texture_t *tex = build.tex;
+
+   // Add the components to the buffer/mask
+   for(int i = 0; i < tex->ccount; i++)
    {
-      if(!tempmask.tempcols)
-         return tempmask.tempcols = estructalloc(texcol_t, 1);
-      else
-         return tempmask.tempcols;
-   }
-   
-   if(!current->next)
-      return current->next = estructalloc(texcol_t, 1);
-   
-   return current->next;
-}
+      const tcomponent_t *component = tex->components + i;
 
-//
-// FinishTexture
-//
-// Called after R_CacheTexture is finished drawing a texture. This function
-// builds the columns (if needed) of a texture from the temporary mask buffer.
-//
-static void FinishTexture(texture_t *tex)
-{
-   int        x, y, i, colcount;
-   texcol_t   *col, *tcol;
-   byte       *maskp;
+      if(!build.sources[i])
+         continue;
 
-   Z_ChangeTag(tex->buffer, PU_CACHE);
+      switch(component->type)
+      {
+      case TC_FLAT:
+         AddTexFlat(build, component, static_cast<const byte *>(build.sources[i]));
+         break;
+      case TC_PATCH:
+         AddTexPatch(build, component, static_cast<const patch_t *>(build.sources[i]));
+         break;
+      default:
+         break;
+      }
+   }
    
-   if(!tempmask.mask)
+   if(!build.mask)
       return;
       
-   if(tempmask.tex != tex)
-   {
-      // SoM: ERROR?
-      return;
-   }
-   
-   // Allocate column pointers
-   tex->columns = ecalloctag(texcol_t **, sizeof(texcol_t **), tex->width, PU_RENDERER, NULL);
-   
-   // Build the columns based on mask info
-   maskp = tempmask.buffer;
+   // Build the column runs based on mask info
+   const byte *maskp = build.maskbuf.data();
 
-   for(x = 0; x < tex->width; x++)
+   build.runcounts.assign(tex->width, 0);
+   for(int x = 0; x < tex->width; x++)
    {
-      y = 0;
-      col = NULL;
-      colcount = 0;
+      int y = 0;
       
       while(y < tex->height)
       {
@@ -942,20 +1010,50 @@ static void FinishTexture(texture_t *tex)
          // Build a column
          if(y < tex->height && *maskp > 0)
          {
-            colcount++;
-            col = NextTempCol(col);
+            texcol_t col;
             
-            col->yoff = y;
-            col->ptroff = uint32_t(maskp - tempmask.buffer);
+            col.yoff   = y;
+            col.ptroff = uint32_t(maskp - build.maskbuf.data());
+            col.next   = NULL;
 
             while(y < tex->height && *maskp > 0)
             {
                maskp++; y++;
             }
             
-            col->len = y - col->yoff;
+            col.len = y - col.yoff;
+            build.runs.push_back(col);
+            ++build.runcounts[x];
          }
       }
+   }
+}
+
+//
+// R_installTexture
+//
+// Called after a texture is finished drawing. This function allocates the
+// columns (if needed) of a texture from the runs found while composing it.
+//
+static void R_installTexture(texbuild_t &build)
+{
+   texture_t *tex = build.tex;
+
+   if(build.error[0])
+      I_Error("%s", build.error);
+
+   Z_ChangeTag(tex->buffer, PU_CACHE);
+
+   if(!build.mask)
+      return;
+
+   // Allocate column pointers
+   tex->columns = ecalloctag(texcol_t **, sizeof(texcol_t **), tex->width, PU_RENDERER, NULL);
+
+   const texcol_t *run = build.runs.data();
+   for(int x = 0; x < tex->width; x++)
+   {
+      int colcount = build.runcounts[x];
       
       // No columns? No problem!
       if(!colcount)
@@ -965,16 +1063,12 @@ static void FinishTexture(texture_t *tex)
       }
          
       // Now allocate and build the actual column structs in the texture
-      tcol = tex->columns[x] = estructalloctag(texcol_t, colcount, PU_RENDERER);
+      texcol_t *tcol = tex->columns[x] = estructalloctag(texcol_t, colcount, PU_RENDERER);
            
-      col = NULL;
-      for(i = 0; i < colcount; i++)
+      for(int i = 0; i < colcount; i++, run++)
       {
-         col = NextTempCol(col);
-         memcpy(tcol, col, sizeof(texcol_t));
-         
-         tcol->next = i + 1 < colcount ? tcol + 1 : NULL;
-         tcol = tcol->next;
+         tcol[i] = *run;
+         tcol[i].next = i + 1 < colcount ? &tcol[i + 1] : NULL;
       }
    }
 }
@@ -987,7 +1081,6 @@ static void FinishTexture(texture_t *tex)
 texture_t *R_CacheTexture(int num)
 {
    texture_t  *tex;
-   int        i;
    
 #ifdef RANGECHECK
    if(num < 0 || num >= texturecount)
@@ -1005,41 +1098,76 @@ texture_t *R_CacheTexture(int num)
               (const char *)(tex->name));
    }
 
-   // This function has two primary branches:
-   // 1. There is no buffer, and there are no columns which means the texture
-   //    has never been built before and needs a full treatment
-   // 2. There is no buffer, but there are columns which means that the buffer
-   //    (PU_CACHE) has been freed but the columns (PU_RENDERER) have not. 
-   //    This case means we only have to rebuilt the buffer.
+   texbuild_t            build;
+   PODCollection<void *> locked;
 
-   // Start the texture. Check the size of the mask buffer if needed.   
-   StartTexture(tex, tex->columns == NULL);
+   R_prepareTexture(build, tex, locked);
+   R_composeTexture(build);
+   R_installTexture(build);
+   R_unlockComponents(locked);
    
-   // Add the components to the buffer/mask
-   for(i = 0; i < tex->ccount; i++)
+   return tex;
+}
+
+// Number of textures composed per parallel batch; bounds the amount of
+// component data locked in memory at once.
+#define PRECACHE_BATCH 256
+
+//
+// R_PrecacheTextures
+//
+// Caches a set of textures, composing them in parallel on the worker pool.
+// Component graphics are read on the main thread, with archived lumps
+// inflated up front in one batch.
+//
+void R_PrecacheTextures(const int *texnums, size_t count)
+{
+   PODCollection<int> pending;
+   PODCollection<int> lumps;
+
+   for(size_t i = 0; i < count; i++)
    {
-      tcomponent_t *component = tex->components + i;
-      
-      // SoM: Do NOT add lumps with a -1 lumpnum
-      if(component->lump == -1)
+      int num = texnums[i];
+      if(num < 0 || num >= texturecount)
          continue;
-         
-      switch(component->type)
+
+      texture_t *tex = textures[num];
+      if(tex->buffer || !tex->ccount)
+         continue;
+
+      pending.add(num);
+      for(int c = 0; c < tex->ccount; c++)
       {
-      case TC_FLAT:
-         AddTexFlat(tex, component);
-         break;
-      case TC_PATCH:
-         AddTexPatch(tex, component);
-         break;
-      default:
-         break;
+         if(tex->components[c].lump != -1)
+            lumps.add(tex->components[c].lump);
       }
    }
 
-   // Finish texture
-   FinishTexture(tex);
-   return tex;
+   // tolerate duplicates in the request
+   std::sort(pending.begin(), pending.end());
+   pending.resize(std::unique(pending.begin(), pending.end()) - pending.begin());
+
+   wGlobalDir.prefetchLumps(lumps.begin(), lumps.getLength());
+
+   for(size_t start = 0; start < pending.getLength(); start += PRECACHE_BATCH)
+   {
+      size_t                batchsize = emin<size_t>(PRECACHE_BATCH,
+                                                     pending.getLength() - start);
+      texbuild_t            builds[PRECACHE_BATCH];
+      PODCollection<void *> locked;
+
+      for(size_t i = 0; i < batchsize; i++)
+         R_prepareTexture(builds[i], textures[pending[start + i]], locked);
+
+      M_GetWorkerPool().parallelFor(batchsize, [&builds] (size_t i) {
+         R_composeTexture(builds[i]);
+      });
+
+      for(size_t i = 0; i < batchsize; i++)
+         R_installTexture(builds[i]);
+
+      R_unlockComponents(locked);
+   }
 }
 
 //
@@ -1364,6 +1492,82 @@ static void R_AddFlats()
    }
 }
 
+//
+// R_loadCachedWalls
+//
+// Recreates the wall textures from a texture cache file, complete with their
+// composed buffers and column lists.
+//
+static void R_loadCachedWalls(const TextureCacheFile &cache)
+{
+   for(int i = 0; i < numwalls; i++)
+   {
+      if(!(i & 127))
+         V_LoadingIncrease();
+
+      const texcacherec_t &rec = cache.getRecord(i);
+      char name[9];
+
+      memcpy(name, rec.name, 8);
+      name[8] = '\0';
+
+      texture_t *tex = textures[wallstart + i] =
+         R_AllocTexStruct(name, rec.width, rec.height, rec.ccount);
+      tex->flags    = rec.flags;
+      tex->flatsize = rec.flatsize;
+
+      // dummy and missing textures are regenerated
+      if(!rec.ccount)
+      {
+         if(!strcmp(name, "BAADF00D"))
+            badtex = wallstart + i;
+         R_checkerBoardTexture(tex);
+         continue;
+      }
+
+      tex->index = wallstart + i;
+
+      const texcachecomp_t *comps = cache.getComponents(rec);
+      for(int c = 0; c < rec.ccount; c++)
+      {
+         tex->components[c].originx = comps[c].originx;
+         tex->components[c].originy = comps[c].originy;
+         tex->components[c].width   = comps[c].width;
+         tex->components[c].height  = comps[c].height;
+         tex->components[c].lump    = comps[c].lump;
+         tex->components[c].type    = static_cast<cmptype_e>(comps[c].type);
+      }
+
+      tex->buffer = emalloctag(byte *, rec.imageSize, PU_CACHE, (void **)&tex->buffer);
+      memcpy(tex->buffer, cache.getImage(rec), rec.imageSize);
+
+      tex->columns = ecalloctag(texcol_t **, sizeof(texcol_t **), tex->width, PU_RENDERER, NULL);
+
+      const int32_t       *runcounts = cache.getRunCounts(rec);
+      const texcachecol_t *run       = cache.getRuns(rec);
+      for(int x = 0; x < tex->width; x++)
+      {
+         int colcount = runcounts[x];
+
+         if(!colcount)
+         {
+            tex->columns[x] = NULL;
+            continue;
+         }
+
+         texcol_t *tcol = tex->columns[x] = estructalloctag(texcol_t, colcount, PU_RENDERER);
+
+         for(int j = 0; j < colcount; j++, run++)
+         {
+            tcol[j].yoff   = run->yoff;
+            tcol[j].len    = run->len;
+            tcol[j].ptroff = run->ptroff;
+            tcol[j].next   = j + 1 < colcount ? &tcol[j + 1] : NULL;
+         }
+      }
+   }
+}
+
 //
 // R_InitTextures
 //
@@ -1372,36 +1576,46 @@ static void R_AddFlats()
 void R_InitTextures()
 {
    auto &tns = wGlobalDir.getNamespace(lumpinfo_t::ns_textures);
-   int *patchlookup;
+   int *patchlookup = NULL;
    int errors = 0;
    int i, texnum = 0;
+   int nummappatches = 0;
    bool needDummy = false;
    
-   texturelump_t *maptex1;
-   texturelump_t *maptex2;
+   texturelump_t *maptex1 = NULL;
+   texturelump_t *maptex2 = NULL;
 
-   // load PNAMES
-   int nummappatches;
-   patchlookup = R_LoadPNames(nummappatches);
+   // If the resources are unchanged since the last run, the wall textures
+   // come ready-made from the texture cache.
+   TextureCacheFile texcache;
+   bool cached = texcache.load();
 
-   // Load the map texture definitions from textures.lmp.
-   // The data is contained in one or two lumps,
-   //  TEXTURE1 for shareware, plus TEXTURE2 for commercial.
-   maptex1 = R_InitTextureLump("TEXTURE1");
-   maptex2 = R_InitTextureLump("TEXTURE2");
+   if(cached)
+      numwalls = texcache.getNumWalls();
+   else
+   {
+      // load PNAMES
+      patchlookup = R_LoadPNames(nummappatches);
 
-   // calculate total textures before ns_textures namespace
-   numwalls = maptex1->numtextures + maptex2->numtextures;
+      // Load the map texture definitions from textures.lmp.
+      // The data is contained in one or two lumps,
+      //  TEXTURE1 for shareware, plus TEXTURE2 for commercial.
+      maptex1 = R_InitTextureLump("TEXTURE1");
+      maptex2 = R_InitTextureLump("TEXTURE2");
 
-   // if there are no TEXTURE1/2 lookups, we need to create a dummy texture
-   if(!numwalls)
-   {
-      ++numwalls;
-      needDummy = true;
-   }
+      // calculate total textures before ns_textures namespace
+      numwalls = maptex1->numtextures + maptex2->numtextures;
 
-   // add in ns_textures namespace
-   numwalls += tns.numLumps;
+      // if there are no TEXTURE1/2 lookups, we need to create a dummy texture
+      if(!numwalls)
+      {
+         ++numwalls;
+         needDummy = true;
+      }
+
+      // add in ns_textures namespace
+      numwalls += tns.numLumps;
+   }
 
    wallstart = 0;
    wallstop  = wallstart + numwalls;
@@ -1425,44 +1639,48 @@ void R_InitTextures()
    // initialize loading dots / bar
    R_InitLoading();
 
-   // detect texture formats
-   R_DetectTextureFormat(maptex1);
-   R_DetectTextureFormat(maptex2);
-
-   // if we need a dummy texture, add it now.
-   if(needDummy)
+   if(cached)
+      R_loadCachedWalls(texcache);
+   else
    {
-      R_MakeDummyTexture();
-      ++texnum;
-   }
+      // detect texture formats
+      R_DetectTextureFormat(maptex1);
+      R_DetectTextureFormat(maptex2);
+
+      // if we need a dummy texture, add it now.
+      if(needDummy)
+      {
+         R_MakeDummyTexture();
+         ++texnum;
+      }
 
-   // read texture lumps
-   texnum = R_ReadTextureLump(maptex1, patchlookup, nummappatches, texnum, &errors);
-   texnum = R_ReadTextureLump(maptex2, patchlookup, nummappatches, texnum, &errors);
-   R_ReadTextureNamespace(texnum);
+      // read texture lumps
+      texnum = R_ReadTextureLump(maptex1, patchlookup, nummappatches, texnum, &errors);
+      texnum = R_ReadTextureLump(maptex2, patchlookup, nummappatches, texnum, &errors);
+      R_ReadTextureNamespace(texnum);
 
-   // done with patch lookup
-   if(patchlookup)
-      efree(patchlookup);
+      // done with patch lookup
+      if(patchlookup)
+         efree(patchlookup);
 
-   // done with texturelumps
-   R_FreeTextureLump(maptex1);
-   R_FreeTextureLump(maptex2);
+      // done with texturelumps
+      R_FreeTextureLump(maptex1);
+      R_FreeTextureLump(maptex2);
    
-   if(errors)
-      I_Error("\n\n%d texture errors.\n", errors);
+      if(errors)
+         I_Error("\n\n%d texture errors.\n", errors);
 
-   // SoM: This REALLY hits us when starting EE with large wads. Caching 
-   // textures on map start would probably be preferable 99.9% of the time...
-   // Precache textures
-   for(i = wallstart; i < wallstop; i++)
-   {
-      R_checkInvalidTexture(i);
-      R_CacheTexture(i);
+      // SoM: This REALLY hits us when starting EE with large wads. Caching 
+      // textures on map start would probably be preferable 99.9% of the time...
+      // Precache textures
+      for(i = wallstart; i < wallstop; i++)
+      {
+         R_checkInvalidTexture(i);
+         R_CacheTexture(i);
+      }
+
+      TextureCacheFile::Save(textures + wallstart, numwalls);
    }
-   
-   if(errors)
-      I_Error("\n\n%d texture errors.\n", errors); 
       
    // Load flats
    R_AddFlats();     
@@ -117,10 +117,8 @@ int numsprites;
 
 // haleyjd: global particle system state
 
-int        activeParticles;
-int        inactiveParticles;
-particle_t *Particles;
-int        particle_trans;
+particleset_t Particles;
+int           particle_trans;
 
 float *mfloorclip, *mceilingclip;
 
@@ -223,9 +221,6 @@ static lighttable_t **spritelights; // killough 1/25/98 made static
 static spriteframe_t sprtemp[MAX_SPRITE_FRAMES];
 static int maxframe;
 
-// Max number of particles
-static int numParticles;
-
 static vissprite_t *vissprites, **vissprite_ptrs;  // killough
 static size_t num_vissprite, num_vissprite_alloc, num_vissprite_ptrs;
 
@@ -290,7 +285,7 @@ VALLOCATION(clipbot)
 
 // Forward declarations:
 static void R_DrawParticle(vissprite_t *vis);
-static void R_ProjectParticle(particle_t *particle);
+static void R_ProjectParticles(sector_t *sec);
 
 //
 // R_SetMaskedSilhouette
@@ -932,7 +927,7 @@ static void R_ProjectSprite(Mobj *thing, v3fixed_t *delta = nullptr,
          offsetpos.y += delta->y;
       }
       const renderbarrier_t &barrier = portalrender.w->barrier;
-      if(portalrender.w->line && portalrender.w->line != portalline &&
+      if(portalrender.w->line && !R_WindowHasLine(portalrender.w, portalline) &&
          P_PointOnDivlineSide(offsetpos.x, offsetpos.y, &barrier.dln.dl) == 0)
       {
          return;
@@ -1202,13 +1197,8 @@ void R_AddSprites(sector_t* sec, int lightlevel)
 
    // haleyjd 02/20/04: Handle all particles in sector.
 
-   if(drawparticles)
-   {
-      DLListItem<particle_t> *link;
-
-      for(link = sec->ptcllist; link; link = link->dllNext)
-         R_ProjectParticle(*link);
-   }
+   if(drawparticles && sec->ptcllist)
+      R_ProjectParticles(sec);
 }
 
 //
@@ -2177,33 +2167,40 @@ void R_CheckMobjProjections(Mobj *mobj, bool checklines)
 //
 // newParticle
 //
-// Tries to find an inactive particle in the Particles list
-// Returns NULL on failure
+// Takes the next free slot in the particle arrays and clears it.
+// Returns -1 if every particle is in use.
 //
-particle_t *newParticle()
+int newParticle()
 {
-   particle_t *result = NULL;
-   if(inactiveParticles != -1)
-   {
-      result = Particles + inactiveParticles;
-      inactiveParticles = result->next;
-      result->next = activeParticles;
-      activeParticles = int(result - Particles);
-   }
-
-   return result;
+   if(Particles.count == Particles.max)
+      return -1;
+
+   int i = Particles.count++;
+
+   Particles.links[i].seclinks.dllPrev = nullptr;
+   Particles.links[i].seclinks.dllNext = nullptr;
+   Particles.subsector[i] = nullptr;
+   Particles.x[i]    = Particles.y[i]    = Particles.z[i]    = 0;
+   Particles.velx[i] = Particles.vely[i] = Particles.velz[i] = 0;
+   Particles.accx[i] = Particles.accy[i] = Particles.accz[i] = 0;
+   Particles.trans[i] = 0;
+   Particles.fade[i]  = 0;
+   Particles.ttl[i]   = 0;
+   Particles.size[i]  = 0;
+   Particles.color[i] = 0;
+   Particles.styleflags[i] = 0;
+
+   return i;
 }
 
 //
 // R_InitParticles
 //
-// Allocate the particle list and initialize it
+// Allocate the particle arrays and initialize them
 //
 void R_InitParticles()
 {
-   int i;
-
-   numParticles = 0;
+   int i, numParticles = 0;
 
    if((i = M_CheckParm("-numparticles")) && i < myargc - 1)
       numParticles = atoi(myargv[i+1]);
@@ -2212,173 +2209,221 @@ void R_InitParticles()
       numParticles = 4000;
    else if(numParticles < 100)
       numParticles = 100;
-   
-   Particles = (particle_t *)(Z_Malloc(numParticles*sizeof(particle_t), PU_STATIC, NULL));
+
+   // the motion arrays are padded to a whole number of SIMD vectors
+   int padded = (numParticles + 7) & ~7;
+
+   Particles.max        = numParticles;
+   Particles.links      = estructalloc(particle_t, numParticles);
+   Particles.subsector  = ecalloc(subsector_t **, numParticles, sizeof(subsector_t *));
+   Particles.x          = ecalloc(fixed_t *, padded, sizeof(fixed_t));
+   Particles.y          = ecalloc(fixed_t *, padded, sizeof(fixed_t));
+   Particles.z          = ecalloc(fixed_t *, padded, sizeof(fixed_t));
+   Particles.velx       = ecalloc(fixed_t *, padded, sizeof(fixed_t));
+   Particles.vely       = ecalloc(fixed_t *, padded, sizeof(fixed_t));
+   Particles.velz       = ecalloc(fixed_t *, padded, sizeof(fixed_t));
+   Particles.accx       = ecalloc(fixed_t *, padded, sizeof(fixed_t));
+   Particles.accy       = ecalloc(fixed_t *, padded, sizeof(fixed_t));
+   Particles.accz       = ecalloc(fixed_t *, padded, sizeof(fixed_t));
+   Particles.trans      = ecalloc(unsigned int *, padded, sizeof(unsigned int));
+   Particles.fade       = ecalloc(unsigned int *, padded, sizeof(unsigned int));
+   Particles.ttl        = ecalloc(byte *, padded, sizeof(byte));
+   Particles.size       = ecalloc(byte *, numParticles, sizeof(byte));
+   Particles.color      = ecalloc(byte *, numParticles, sizeof(byte));
+   Particles.styleflags = ecalloc(int *, padded, sizeof(int));
+
    R_ClearParticles();
 }
 
 //
 // R_ClearParticles
 //
-// set up the particle list
+// Empties the particle set. Called when a level is loaded, at which point
+// the sector lists the particles were linked into are gone.
 //
 void R_ClearParticles()
 {
-   int i;
-   
-   memset(Particles, 0, numParticles*sizeof(particle_t));
-   activeParticles = -1;
-   inactiveParticles = 0;
-   for(i = 0; i < numParticles - 1; i++)
-      Particles[i].next = i + 1;
-   Particles[i].next = -1;
+   Particles.count = 0;
 }
 
 //
-// R_ProjectParticle
+// R_particleColormap
 //
-static void R_ProjectParticle(particle_t *particle)
+// Light table for the particles in one sector, which is the same for all of
+// them except for the distance term.
+//
+static lighttable_t **R_particleColormap(sector_t *sector)
 {
-   fixed_t gzt;
-   int x1, x2;
-   vissprite_t *vis;
-   sector_t    *sector = NULL;
-   int heightsec = -1;
+   sector_t tmpsec;
+   int floorlightlevel, ceilinglightlevel, lightnum;
+
+   R_FakeFlat(sector, &tmpsec, &floorlightlevel, &ceilinglightlevel, false);
+
+   lightnum = (floorlightlevel + ceilinglightlevel) / 2;
+   lightnum = (lightnum >> LIGHTSEGSHIFT) + (extralight * LIGHTBRIGHT);
    
-   float tempx, tempy, ty1, tx1, tx2, tz;
-   float idist, xscale, yscale;
-   float y1, y2;
+   if(lightnum >= LIGHTLEVELS || fixedcolormap)
+      return scalelight[LIGHTLEVELS - 1];      
+   else if(lightnum < 0)
+      return scalelight[0];
+   else
+      return scalelight[lightnum];
+}
 
-   // SoM: Cardboard translate the mobj coords and just project the sprite.
-   tempx = M_FixedToFloat(particle->x) - view.x;
-   tempy = M_FixedToFloat(particle->y) - view.y;
-   ty1   = (tempy * view.cos) + (tempx * view.sin);
+// Particles transformed per batch in R_ProjectParticles
+#define PTCLBATCH 64
 
-   // lies in front of the front view plane
-   if(ty1 < 1.0f)
-      return;
+//
+// R_ProjectParticles
+//
+// Projects all the particles linked into a sector. They are taken in batches:
+// a first pass transforms each batch into view space and drops the ones
+// behind the view plane, then the survivors are turned into vissprites. All
+// of them share the sector, so its height and lighting checks are done once.
+//
+static void R_ProjectParticles(sector_t *sector)
+{
+   int   idx[PTCLBATCH];
+   float bx[PTCLBATCH], by[PTCLBATCH];
 
-   // invisible?
-   if(!particle->trans)
-      return;
+   int heightsec = sector->heightsec;
+   int phs = view.sector->heightsec;
+   bool colormapset = false;
+   lighttable_t **ltable = nullptr;
 
-   tx1 = (tempx * view.cos) - (tempy * view.sin);
+   DLListItem<particle_t> *link = sector->ptcllist;
 
-   tx2 = tx1 + 1.0f;
+   while(link)
+   {
+      int count = 0;
 
-   idist = 1.0f / ty1;
-   xscale = idist * view.xfoc;
-   yscale = idist * view.yfoc;
-   
-   // calculate edges of the shape
-   x1 = (int)(view.xcenter + (tx1 * xscale));
-   x2 = (int)(view.xcenter + (tx2 * xscale));
+      // gather a batch
+      for(; link && count < PTCLBATCH; link = link->dllNext)
+      {
+         int i = Particles.index(*link);
 
-   if(x2 < x1) x2 = x1;
-   
-   // off either side?
-   if(x1 >= viewwindow.width || x2 < 0)
-      return;
+         // invisible?
+         if(!Particles.trans[i])
+            continue;
 
-   tz = M_FixedToFloat(particle->z) - view.z;
+         idx[count] = i;
+         bx[count]  = M_FixedToFloat(Particles.x[i]) - view.x;
+         by[count]  = M_FixedToFloat(Particles.y[i]) - view.y;
+         ++count;
+      }
 
-   y1 = (view.ycenter - (tz * yscale));
-   y2 = (view.ycenter - ((tz - 1.0f) * yscale));
+      // rotate into view space; ty1 goes into by, tx1 into bx
+      for(int n = 0; n < count; n++)
+      {
+         float tempx = bx[n], tempy = by[n];
+
+         by[n] = (tempy * view.cos) + (tempx * view.sin);
+         bx[n] = (tempx * view.cos) - (tempy * view.sin);
+      }
+
+      for(int n = 0; n < count; n++)
+      {
+         int i = idx[n];
+         float ty1 = by[n], tx1 = bx[n];
+
+         // lies in front of the front view plane
+         if(ty1 < 1.0f)
+            continue;
+
+         float tx2    = tx1 + 1.0f;
+         float idist  = 1.0f / ty1;
+         float xscale = idist * view.xfoc;
+         float yscale = idist * view.yfoc;
+
+         // calculate edges of the shape
+         int x1 = (int)(view.xcenter + (tx1 * xscale));
+         int x2 = (int)(view.xcenter + (tx2 * xscale));
+
+         if(x2 < x1) x2 = x1;
    
-   if(y2 < 0.0f || y1 >= view.height)
-      return;
+         // off either side?
+         if(x1 >= viewwindow.width || x2 < 0)
+            continue;
+
+         fixed_t z  = Particles.z[i];
+         float   tz = M_FixedToFloat(z) - view.z;
+
+         float y1 = (view.ycenter - (tz * yscale));
+         float y2 = (view.ycenter - ((tz - 1.0f) * yscale));
    
-   gzt = particle->z + 1;
+         if(y2 < 0.0f || y1 >= view.height)
+            continue;
    
-   // killough 3/27/98: exclude things totally separated
-   // from the viewer, by either water or fake ceilings
-   // killough 4/11/98: improve sprite clipping for underwater/fake ceilings
+         fixed_t gzt = z + 1;
    
-   {
-      // haleyjd 02/20/04: use subsector now stored in particle
-      subsector_t *subsector = particle->subsector;
-      sector = subsector->sector;
-      heightsec = sector->heightsec;
-
-      if(particle->z < sector->floorheight || 
-	 particle->z > sector->ceilingheight)
-	 return;
-   }
+         // killough 3/27/98: exclude things totally separated
+         // from the viewer, by either water or fake ceilings
+         // killough 4/11/98: improve sprite clipping for underwater/fake ceilings
+         if(z < sector->floorheight || z > sector->ceilingheight)
+            continue;
    
-   // only clip particles which are in special sectors
-   if(heightsec != -1)
-   {
-      int phs = view.sector->heightsec;
-      
-      if(phs != -1 && 
-	 viewz < sectors[phs].floorheight ?
-	 particle->z >= sectors[heightsec].floorheight :
-         gzt < sectors[heightsec].floorheight)
-         return;
-
-      if(phs != -1 && 
-	 viewz > sectors[phs].ceilingheight ?
-	 gzt < sectors[heightsec].ceilingheight &&
-	 viewz >= sectors[heightsec].ceilingheight :
-         particle->z >= sectors[heightsec].ceilingheight)
-         return;
-   }
+         // only clip particles which are in special sectors
+         if(heightsec != -1)
+         {
+            if(phs != -1 && 
+               viewz < sectors[phs].floorheight ?
+               z >= sectors[heightsec].floorheight :
+               gzt < sectors[heightsec].floorheight)
+               continue;
+
+            if(phs != -1 && 
+               viewz > sectors[phs].ceilingheight ?
+               gzt < sectors[heightsec].ceilingheight &&
+               viewz >= sectors[heightsec].ceilingheight :
+               z >= sectors[heightsec].ceilingheight)
+               continue;
+         }
    
-   // store information in a vissprite
-   vis = R_NewVisSprite();
-   vis->heightsec = heightsec;
-   vis->gx = particle->x;
-   vis->gy = particle->y;
-   vis->gz = particle->z;
-   vis->gzt = gzt;
-   vis->texturemid = vis->gzt - viewz;
-   vis->x1 = x1 < 0 ? 0 : x1;
-   vis->x2 = x2 >= viewwindow.width ? viewwindow.width-1 : x2;
-   vis->colour = particle->color;
-   vis->patch = -1;
-   vis->translucency = static_cast<uint16_t>(particle->trans - 1);
-   vis->tranmaplump = -1;
-   // Cardboard
-   vis->dist = idist;
-   vis->xstep = 1.0f / xscale;
-   vis->ytop = y1;
-   vis->ybottom = y2;
-   vis->scale = yscale;
-   vis->sector = int(sector - sectors);
-
-   if(fixedcolormap ==
-      fullcolormap + INVERSECOLORMAP*256*sizeof(lighttable_t))
-   {
-      vis->colormap = fixedcolormap;
-   } 
-   else
-   {
-      R_SectorColormap(sector);
+         // store information in a vissprite
+         vissprite_t *vis = R_NewVisSprite();
+         vis->heightsec = heightsec;
+         vis->gx = Particles.x[i];
+         vis->gy = Particles.y[i];
+         vis->gz = z;
+         vis->gzt = gzt;
+         vis->texturemid = vis->gzt - viewz;
+         vis->x1 = x1 < 0 ? 0 : x1;
+         vis->x2 = x2 >= viewwindow.width ? viewwindow.width-1 : x2;
+         vis->colour = Particles.color[i];
+         vis->patch = -1;
+         vis->translucency = static_cast<uint16_t>(Particles.trans[i] - 1);
+         vis->tranmaplump = -1;
+         // Cardboard
+         vis->dist = idist;
+         vis->xstep = 1.0f / xscale;
+         vis->ytop = y1;
+         vis->ybottom = y2;
+         vis->scale = yscale;
+         vis->sector = int(sector - sectors);
+
+         if(fixedcolormap ==
+            fullcolormap + INVERSECOLORMAP*256*sizeof(lighttable_t))
+         {
+            vis->colormap = fixedcolormap;
+            continue;
+         }
 
-      if(LevelInfo.useFullBright && (particle->styleflags & PS_FULLBRIGHT))
-      {
-         vis->colormap = fullcolormap;
-      }
-      else
-      {
-         lighttable_t **ltable;
-         sector_t tmpsec;
-         int floorlightlevel, ceilinglightlevel, lightnum, index;
+         if(!colormapset)
+         {
+            R_SectorColormap(sector);
+            colormapset = true;
+         }
 
-         R_FakeFlat(sector, &tmpsec, &floorlightlevel, 
-                    &ceilinglightlevel, false);
+         if(LevelInfo.useFullBright && (Particles.styleflags[i] & PS_FULLBRIGHT))
+         {
+            vis->colormap = fullcolormap;
+            continue;
+         }
 
-         lightnum = (floorlightlevel + ceilinglightlevel) / 2;
-         lightnum = (lightnum >> LIGHTSEGSHIFT) + (extralight * LIGHTBRIGHT);
-         
-         if(lightnum >= LIGHTLEVELS || fixedcolormap)
-            ltable = scalelight[LIGHTLEVELS - 1];      
-         else if(lightnum < 0)
-            ltable = scalelight[0];
-         else
-            ltable = scalelight[lightnum];
+         if(!ltable)
+            ltable = R_particleColormap(sector);
          
-         index = (int)(idist * 2560.0f);
+         int index = (int)(idist * 2560.0f);
          if(index >= MAXLIGHTSCALE)
             index = MAXLIGHTSCALE - 1;
          
@@ -76,7 +76,7 @@ void R_ClearSprites(void);
 void R_DrawPostBSP(void);
 void R_ClearParticles(void);
 void R_InitParticles(void);
-particle_t *newParticle(void);
+int  newParticle(void);
 
 typedef struct cb_maskedcolumn_s
 {
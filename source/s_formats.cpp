@@ -31,6 +31,7 @@
 #include "doomtype.h"
 #include "d_gi.h"
 #include "m_binary.h"
+#include "m_collection.h"
 #include "m_compare.h"
 #include "m_swap.h"
 #include "s_sound.h"
@@ -522,5 +523,25 @@ void S_CacheDigitalSoundLump(sfxinfo_t *sfx)
    wGlobalDir.cacheLumpNum(lump, PU_CACHE);
 }
 
+//
+// S_PrefetchDigitalSoundLumps
+//
+// Invoke before caching a batch of sounds so that lumps stored compressed in
+// archives are inflated together in parallel.
+//
+void S_PrefetchDigitalSoundLumps(sfxinfo_t *const *sfxs, size_t count)
+{
+   PODCollection<int> lumps;
+
+   for(size_t i = 0; i < count; i++)
+   {
+      int lump = S_getSfxLumpNum(sfxs[i]);
+      if(lump != -1)
+         lumps.add(lump);
+   }
+
+   wGlobalDir.prefetchLumps(lumps.begin(), lumps.getLength());
+}
+
 // EOF
 
@@ -33,6 +33,7 @@ struct sfxinfo_t;
 
 bool S_LoadDigitalSoundEffect(sfxinfo_t *sfx);
 void S_CacheDigitalSoundLump(sfxinfo_t *sfx);
+void S_PrefetchDigitalSoundLumps(sfxinfo_t *const *sfxs, size_t count);
 
 #endif
 
@@ -0,0 +1,620 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: platform-independent sound mixing kernels and resampling cache.
+//
+// The kernels have SSE2 and AVX2 versions chosen at compile time, and a
+// scalar loop for other targets and for the remainder of each run. All of
+// them do the same multiply and add per sample, so the output does not
+// depend on which one was built.
+//
+// Pitched voices are resampled once, on the main thread, into a copy that
+// plays at unit step; that way every voice takes the vectorised path.
+//
+// Voice stepping and the equalizer live here too, so that every driver which
+// mixes in software produces the same output.
+//
+
+#include <math.h>
+#include <unordered_map>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define S_MIXER_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define S_MIXER_SSE2
+#endif
+
+#include "z_zone.h"
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "doomstat.h"
+#include "i_sound.h"
+#include "m_compare.h"
+#include "m_fixed.h"
+#include "s_mixer.h"
+#include "sounds.h"
+
+// Resampled copies beyond this many bytes are evicted once no voice uses them.
+#define RESAMPLE_CACHE_SIZE (16 * 1024 * 1024)
+
+// The rate s_formats converts every sound to.
+#define MIXER_SAMPLERATE 44100u
+
+//=============================================================================
+//
+// Mixing Kernels
+//
+
+//
+// S_MixMonoToStereo
+//
+void S_MixMonoToStereo(float *out, const float *src, int count,
+                       float leftvol, float rightvol)
+{
+   int i = 0;
+
+#if defined(S_MIXER_AVX2)
+   const __m256 lv = _mm256_set1_ps(leftvol);
+   const __m256 rv = _mm256_set1_ps(rightvol);
+
+   for(; i + 8 <= count; i += 8, src += 8, out += 16)
+   {
+      __m256 s  = _mm256_loadu_ps(src);
+      __m256 l  = _mm256_mul_ps(s, lv);
+      __m256 r  = _mm256_mul_ps(s, rv);
+      __m256 lo = _mm256_unpacklo_ps(l, r); // l0 r0 l1 r1 | l4 r4 l5 r5
+      __m256 hi = _mm256_unpackhi_ps(l, r); // l2 r2 l3 r3 | l6 r6 l7 r7
+
+      _mm256_storeu_ps(out, _mm256_add_ps(_mm256_loadu_ps(out),
+                                          _mm256_permute2f128_ps(lo, hi, 0x20)));
+      _mm256_storeu_ps(out + 8, _mm256_add_ps(_mm256_loadu_ps(out + 8),
+                                              _mm256_permute2f128_ps(lo, hi, 0x31)));
+   }
+#elif defined(S_MIXER_SSE2)
+   const __m128 lv = _mm_set1_ps(leftvol);
+   const __m128 rv = _mm_set1_ps(rightvol);
+
+   for(; i + 4 <= count; i += 4, src += 4, out += 8)
+   {
+      __m128 s = _mm_loadu_ps(src);
+      __m128 l = _mm_mul_ps(s, lv);
+      __m128 r = _mm_mul_ps(s, rv);
+
+      _mm_storeu_ps(out,     _mm_add_ps(_mm_loadu_ps(out),     _mm_unpacklo_ps(l, r)));
+      _mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4), _mm_unpackhi_ps(l, r)));
+   }
+#endif
+
+   for(; i < count; i++, out += 2)
+   {
+      float sample = *src++;
+      out[0] = out[0] + sample * leftvol;
+      out[1] = out[1] + sample * rightvol;
+   }
+}
+
+//
+// S_MixAdd
+//
+void S_MixAdd(float *dest, const float *src, int count)
+{
+   int i = 0;
+
+#if defined(S_MIXER_AVX2)
+   for(; i + 8 <= count; i += 8)
+   {
+      _mm256_storeu_ps(dest + i, _mm256_add_ps(_mm256_loadu_ps(dest + i),
+                                               _mm256_loadu_ps(src + i)));
+   }
+#elif defined(S_MIXER_SSE2)
+   for(; i + 4 <= count; i += 4)
+      _mm_storeu_ps(dest + i, _mm_add_ps(_mm_loadu_ps(dest + i), _mm_loadu_ps(src + i)));
+#endif
+
+   for(; i < count; i++)
+      dest[i] = dest[i] + src[i];
+}
+
+//
+// S_PitchStep
+//
+unsigned int S_PitchStep(int pitch)
+{
+   return (unsigned int)(pow(1.2, (pitch - 128) / 64.0) * FPFRACUNIT);
+}
+
+//
+// S_playedSamples
+//
+// The mixer plays the sample at index (k * step) >> 16 for its kth output,
+// and stops once that index reaches the last sample. Returns how many it
+// plays.
+//
+static uint64_t S_playedSamples(unsigned int alen, unsigned int step)
+{
+   uint64_t last  = alen - 1;
+   uint64_t count = ((last << 16) + step - 1) / step;
+
+   return count ? count : 1;
+}
+
+//
+// S_SoundLengthMS
+//
+unsigned int S_SoundLengthMS(const sfxinfo_t *sfx, unsigned int step)
+{
+   if(!sfx->data || !sfx->alen || !step)
+      return 0;
+
+   return (unsigned int)(S_playedSamples(sfx->alen, step) * 1000 / MIXER_SAMPLERATE);
+}
+
+//=============================================================================
+//
+// Voices
+//
+
+//
+// S_SetVoiceVolume
+//
+void S_SetVoiceVolume(mixvoice_t *voice, int volume, int separation)
+{
+   // Separation, that is, orientation/stereo.
+   //  range is: 1 - 256
+   separation += 1;
+
+   // SoM 7/1/02: forceFlipPan accounted for here
+   if(forceFlipPan)
+      separation = 257 - separation;
+
+   // Per left/right channel.
+   //  x^2 separation,
+   //  adjust volume properly.
+   int leftvol  = volume - ((volume*separation*separation) >> 16);
+   separation   = separation - 257;
+   int rightvol = volume - ((volume*separation*separation) >> 16);
+
+   // volume levels are softened slightly by dividing by 191 rather than ideal 127
+   voice->leftvol  = (float)(eclamp((double)leftvol  / 191.0, 0.0, 1.0));
+   voice->rightvol = (float)(eclamp((double)rightvol / 191.0, 0.0, 1.0));
+}
+
+//
+// S_mixUnitStep
+//
+// Mixes a voice which plays one sample per output sample, a run at a time.
+//
+static bool S_mixUnitStep(mixvoice_t *voice, float *out, int frames, bool canloop)
+{
+   while(frames > 0)
+   {
+      // the end is checked after each sample is played, so at least one is
+      int run = emax(int(voice->enddata - voice->data), 1);
+      run = emin(run, frames);
+
+      S_MixMonoToStereo(out, voice->data, run, voice->leftvol, voice->rightvol);
+      out         += run * 2;
+      voice->data += run;
+      frames      -= run;
+
+      if(voice->data >= voice->enddata)
+      {
+         if(!canloop || !voice->loop)
+         {
+            voice->data = nullptr;
+            return false;
+         }
+         voice->data = voice->startdata;
+         voice->stepremainder = 0;
+      }
+   }
+
+   return true;
+}
+
+//
+// S_MixVoice
+//
+bool S_MixVoice(mixvoice_t *voice, float *out, int frames, bool canloop)
+{
+   if(voice->step == 1 << 16)
+      return S_mixUnitStep(voice, out, frames, canloop);
+
+   float *end = out + frames * 2;
+
+   while(out != end)
+   {
+      float sample = *(voice->data);
+      *(out + 0) = *(out + 0) + sample * voice->leftvol;
+      *(out + 1) = *(out + 1) + sample * voice->rightvol;
+      out += 2;
+
+      // Increment index; MSB is next sample
+      voice->stepremainder += voice->step;
+      voice->data += voice->stepremainder >> 16;
+      voice->stepremainder &= 0xffff;
+
+      // Check whether we are done
+      if(voice->data >= voice->enddata)
+      {
+         if(!canloop || !voice->loop)
+         {
+            voice->data = nullptr;
+            return false;
+         }
+         // haleyjd 06/03/06: restart a looping sample if not paused
+         voice->data = voice->startdata;
+         voice->stepremainder = 0;
+      }
+   }
+
+   return true;
+}
+
+//
+// S_SeekVoice
+//
+bool S_SeekVoice(mixvoice_t *voice, unsigned int ms)
+{
+   uint64_t step   = voice->step;
+   uint64_t frames = uint64_t(ms) * MIXER_SAMPLERATE / 1000;
+   uint64_t played = S_playedSamples(unsigned(voice->enddata - voice->startdata) + 1,
+                                     voice->step);
+
+   if(frames >= played && !voice->loop)
+      return false;
+
+   uint64_t pos = (frames % played) * step;
+   voice->data          = voice->startdata + (pos >> 16);
+   voice->stepremainder = (unsigned int)(pos & 0xffff);
+   return true;
+}
+
+//
+// S_VoicesMayLoop
+//
+bool S_VoicesMayLoop()
+{
+   return !paused &&
+      ((!menuactive && !consoleactive) || demoplayback || netgame);
+}
+
+//=============================================================================
+//
+// Three-Band Equalization
+//
+
+#define SND_PI 3.14159265
+
+//
+// rational_tanh
+//
+// cschueler
+// http://www.musicdsp.org/showone.php?id=238
+//
+// Notes :
+// This is a rational function to approximate a tanh-like soft clipper. It is
+// based on the pade-approximation of the tanh function with tweaked 
+// coefficients.
+// The function is in the range x=-3..3 and outputs the range y=-1..1. Beyond
+// this range the output must be clamped to -1..1.
+// The first two derivatives of the function vanish at -3 and 3, so the 
+// transition to the hard clipped region is C2-continuous.
+//
+static double rational_tanh(double x)
+{
+   if(x < -3)
+      return -1;
+   else if(x > 3)
+      return 1;
+   else
+      return x * ( 27 + x * x ) / ( 27 + 9 * x * x );
+}
+
+//
+// SoundEqualizer::setup
+//
+// haleyjd 04/21/10
+//
+void SoundEqualizer::setup(int samplerate)
+{
+   // flush out state of equalizers
+   memset(eqstate, 0, sizeof(eqstate));
+
+   // Set Low/Mid/High gains 
+   eqstate[0].lg = eqstate[1].lg = s_lowgain;
+   eqstate[0].mg = eqstate[1].mg = s_midgain;
+   eqstate[0].hg = eqstate[1].hg = s_highgain;
+
+   // Calculate filter cutoff frequencies
+   eqstate[0].lf = eqstate[1].lf = 2 * sin(SND_PI * (s_lowfreq  / (double)samplerate));
+   eqstate[0].hf = eqstate[1].hf = 2 * sin(SND_PI * (s_highfreq / (double)samplerate));
+
+   // Calculate preamp factor
+   preampmul = s_eqpreamp;
+}
+
+//
+// SoundEqualizer::process
+//
+// EQ.C - Main Source file for 3 band EQ
+// http://www.musicdsp.org/showone.php?id=236
+//
+// (c) Neil C / Etanza Systems / 2K6
+// Shouts / Loves / Moans = etanza at lycos dot co dot uk
+//
+// This work is hereby placed in the public domain for all purposes, including
+// use in commercial applications.
+// The author assumes NO RESPONSIBILITY for any problems caused by the use of
+// this software.
+//
+// haleyjd 12/19/13: rewritten to loop over the sample buffer and do output
+// directly back to the SDL audio stream.
+//
+void SoundEqualizer::process(const float *stream, const float *end, int16_t *dest)
+{
+   int esnum = 0;
+
+   // haleyjd: This "very small addend" is supposed to take care of P4
+   // denormalization problems. Do we actually need it?
+   static const double vsa = (1.0 / 4294967295.0);
+   // Locals
+   double sample, l, m, h;    // Low / Mid / High - Sample Values
+
+   while(stream != end)
+   {
+      auto es = &eqstate[esnum];
+      esnum ^= 1; // haleyjd: toggle between equalizer channels
+
+      sample = *stream++ * preampmul;
+
+      // Filter #1 (lowpass)
+      es->f1p0  += (es->lf * (sample   - es->f1p0)) + vsa;
+      es->f1p1  += (es->lf * (es->f1p0 - es->f1p1));
+      es->f1p2  += (es->lf * (es->f1p1 - es->f1p2));
+      es->f1p3  += (es->lf * (es->f1p2 - es->f1p3));
+
+      l          = es->f1p3;
+
+      // Filter #2 (highpass)
+      es->f2p0  += (es->hf * (sample   - es->f2p0)) + vsa;
+      es->f2p1  += (es->hf * (es->f2p0 - es->f2p1));
+      es->f2p2  += (es->hf * (es->f2p1 - es->f2p2));
+      es->f2p3  += (es->hf * (es->f2p2 - es->f2p3));
+
+      h          = es->sdm3 - es->f2p3;
+
+      // Calculate midrange (signal - (low + high))
+      m          = es->sdm3 - (h + l); // haleyjd 07/05/10: which is right?
+      //m          = sample - (h + l); // the one above seems more correct to me.
+
+      // Scale, Combine and store
+      l         *= es->lg;
+      m         *= es->mg;
+      h         *= es->hg;
+
+      // Shuffle history buffer
+      es->sdm3   = es->sdm2;
+      es->sdm2   = es->sdm1;
+      es->sdm1   = sample;                
+
+      // Return result
+      // haleyjd: use rational_tanh for soft clipping
+      *dest++ = (int16_t)(rational_tanh(l + m + h) * 32767.0);
+   }
+}
+
+//=============================================================================
+//
+// Resampling Cache
+//
+
+struct resamplekey_t
+{
+   const sfxinfo_t *sfx;
+   unsigned int     step;
+
+   bool operator == (const resamplekey_t &other) const
+   {
+      return sfx == other.sfx && step == other.step;
+   }
+};
+
+struct resamplehash_t
+{
+   size_t operator () (const resamplekey_t &key) const
+   {
+      return std::hash<const void *>()(key.sfx) ^ (size_t(key.step) * 0x9E3779B1u);
+   }
+};
+
+static std::unordered_map<resamplekey_t, sndresampled_t *, resamplehash_t> resampleCache;
+
+static sndresampled_t *resampleHead; // most recently used
+static sndresampled_t *resampleTail; // least recently used
+static size_t          resampleBytes;
+
+//
+// S_unlinkResampled
+//
+static void S_unlinkResampled(sndresampled_t *rs)
+{
+   if(rs->prev)
+      rs->prev->next = rs->next;
+   else
+      resampleHead = rs->next;
+
+   if(rs->next)
+      rs->next->prev = rs->prev;
+   else
+      resampleTail = rs->prev;
+
+   rs->prev = rs->next = nullptr;
+}
+
+//
+// S_linkResampled
+//
+static void S_linkResampled(sndresampled_t *rs)
+{
+   rs->prev = nullptr;
+   rs->next = resampleHead;
+   if(resampleHead)
+      resampleHead->prev = rs;
+   else
+      resampleTail = rs;
+   resampleHead = rs;
+}
+
+//
+// S_freeResampled
+//
+static void S_freeResampled(sndresampled_t *rs)
+{
+   efree(rs->data);
+   efree(rs);
+}
+
+//
+// S_evictResampled
+//
+// Frees least recently used copies that no voice is playing until the cache
+// fits its budget again.
+//
+static void S_evictResampled()
+{
+   sndresampled_t *rs = resampleTail;
+
+   while(rs && resampleBytes > RESAMPLE_CACHE_SIZE)
+   {
+      sndresampled_t *prev = rs->prev;
+
+      if(!rs->users)
+      {
+         resamplekey_t key = { rs->sfx, rs->step };
+
+         resampleCache.erase(key);
+         S_unlinkResampled(rs);
+         resampleBytes -= rs->alen * sizeof(float);
+         S_freeResampled(rs);
+      }
+      rs = prev;
+   }
+}
+
+//
+// S_resample
+//
+// Builds the exact sequence of samples the mixer would play, plus the last
+// sample so that the copy ends the same way.
+//
+static sndresampled_t *S_resample(sfxinfo_t *sfx, unsigned int step)
+{
+   const float *src   = static_cast<const float *>(sfx->data);
+   uint64_t     last  = sfx->alen - 1;
+   uint64_t     count = S_playedSamples(sfx->alen, step);
+
+   if((count + 1) * sizeof(float) > RESAMPLE_CACHE_SIZE)
+      return nullptr;
+
+   auto rs  = estructalloc(sndresampled_t, 1);
+   rs->sfx  = sfx;
+   rs->step = step;
+   rs->alen = static_cast<unsigned int>(count + 1);
+   rs->data = emalloc(float *, rs->alen * sizeof(float));
+
+   for(uint64_t i = 0; i < count; i++)
+      rs->data[i] = src[(i * step) >> 16];
+   rs->data[count] = src[last];
+
+   return rs;
+}
+
+//
+// S_GetResampledSound
+//
+sndresampled_t *S_GetResampledSound(sfxinfo_t *sfx, unsigned int step)
+{
+   if(!sfx->data || !sfx->alen || !step)
+      return nullptr;
+
+   resamplekey_t key = { sfx, step };
+   sndresampled_t *rs;
+
+   auto itr = resampleCache.find(key);
+   if(itr != resampleCache.end())
+   {
+      rs = itr->second;
+      S_unlinkResampled(rs);
+   }
+   else
+   {
+      if(!(rs = S_resample(sfx, step)))
+         return nullptr;
+
+      resampleCache[key] = rs;
+      resampleBytes += rs->alen * sizeof(float);
+   }
+
+   S_linkResampled(rs);
+   ++rs->users;
+   S_evictResampled();
+
+   return rs;
+}
+
+//
+// S_ReleaseResampledSound
+//
+void S_ReleaseResampledSound(sndresampled_t *rs)
+{
+   if(--rs->users > 0)
+      return;
+
+   if(rs->orphaned)
+      S_freeResampled(rs);
+   else
+      S_evictResampled();
+}
+
+//
+// S_FlushResampledSounds
+//
+void S_FlushResampledSounds()
+{
+   for(auto &entry : resampleCache)
+   {
+      sndresampled_t *rs = entry.second;
+
+      if(rs->users)
+         rs->orphaned = true;
+      else
+         S_freeResampled(rs);
+   }
+
+   resampleCache.clear();
+   resampleHead = resampleTail = nullptr;
+   resampleBytes = 0;
+}
+
+// EOF
+
@@ -0,0 +1,144 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: platform-independent sound mixing kernels and resampling cache.
+//
+
+#ifndef S_MIXER_H__
+#define S_MIXER_H__
+
+struct sfxinfo_t;
+
+// Adds count mono samples from src into the interleaved stereo buffer out,
+// scaled by the left and right volumes.
+void S_MixMonoToStereo(float *out, const float *src, int count,
+                       float leftvol, float rightvol);
+
+// Adds count samples of src into dest.
+void S_MixAdd(float *dest, const float *src, int count);
+
+//
+// mixvoice_t
+//
+// Playback state of one voice mixed in software.
+//
+struct mixvoice_t
+{
+   unsigned int step;          // 16.16 step through the sample data
+   unsigned int stepremainder; // 0.16 remainder of the last step
+   float       *data;          // current position; nullptr once finished
+   float       *startdata;
+   float       *enddata;       // last sample
+   float        leftvol, rightvol;
+   int          loop;
+   bool         reverb;        // mixed into the reverb buffer
+};
+
+// Sets a voice's left and right volumes from a volume and a separation in
+// the range 0 to 255, 128 being centred.
+void S_SetVoiceVolume(mixvoice_t *voice, int volume, int separation);
+
+// Adds frames stereo frames of a voice into out. A looping voice restarts if
+// canloop is set; otherwise data is cleared and false returned at its end.
+bool S_MixVoice(mixvoice_t *voice, float *out, int frames, bool canloop);
+
+// Moves a voice that has just started ms milliseconds into its data. Returns
+// false if a voice that does not loop would have finished by then.
+bool S_SeekVoice(mixvoice_t *voice, unsigned int ms);
+
+// True if looping sounds should keep going rather than end, which they do
+// while the game is paused or behind a menu.
+bool S_VoicesMayLoop();
+
+//
+// SoundEqualizer
+//
+// Three-band equalizer and soft clipper for the final stereo mix, configured
+// from the s_* equalizer variables.
+//
+class SoundEqualizer
+{
+protected:
+   struct eqstate_t
+   {
+      // Filter #1 (Low band)
+      double lf;                     // Frequency
+      double f1p0, f1p1, f1p2, f1p3; // Poles ...
+
+      // Filter #2 (High band)
+      double hf;                     // Frequency
+      double f2p0, f2p1, f2p2, f2p3; // Poles ...
+
+      // Sample history buffer
+      double sdm1, sdm2, sdm3;       // Sample data minus 1, 2, 3
+
+      // Gain Controls
+      double lg, mg, hg;             // low, mid, high gain
+   };
+
+   eqstate_t eqstate[2]; // one per stereo channel
+   double    preampmul;
+
+public:
+   // Clears the filter state and reads the current settings.
+   void setup(int samplerate);
+
+   // Equalizes the interleaved stereo samples from stream to end into dest.
+   void process(const float *stream, const float *end, int16_t *dest);
+};
+
+// 16.16 step through sample data for a pitch, 128 being unpitched.
+unsigned int S_PitchStep(int pitch);
+
+// Milliseconds a loaded sound plays for at the given step.
+unsigned int S_SoundLengthMS(const sfxinfo_t *sfx, unsigned int step);
+
+//
+// sndresampled_t
+//
+// A sound effect as the mixer would play it at a given 16.16 step. Playing
+// it at unit step gives the same samples, in the same number, as stepping
+// through the original.
+//
+struct sndresampled_t
+{
+   sfxinfo_t      *sfx;
+   unsigned int    step;
+   float          *data;
+   unsigned int    alen;     // includes one trailing sample, as in sfxinfo_t
+   int             users;    // voices holding this copy
+   bool            orphaned; // flushed while in use; freed on last release
+   sndresampled_t *prev;     // LRU order, most recent first
+   sndresampled_t *next;
+};
+
+// Returns a cached copy of a loaded sound resampled at step, creating it if
+// needed, or nullptr if it cannot be cached. The caller holds a reference
+// until S_ReleaseResampledSound. Main thread only.
+sndresampled_t *S_GetResampledSound(sfxinfo_t *sfx, unsigned int step);
+void S_ReleaseResampledSound(sndresampled_t *rs);
+
+// Drops every cached copy, for when sound data is reloaded.
+void S_FlushResampledSounds();
+
+#endif
+
+// EOF
+
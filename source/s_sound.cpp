@@ -37,6 +37,7 @@
 #include "doomstat.h"
 #include "e_reverbs.h"
 #include "e_sound.h"
+#include "hal/i_timer.h"
 #include "i_sound.h"
 #include "i_system.h"
 #include "m_compare.h"
@@ -51,6 +52,8 @@
 #include "r_defs.h"
 #include "r_main.h"
 #include "r_state.h"
+#include "s_formats.h"
+#include "s_mixer.h"
 #include "s_reverb.h"
 #include "s_sound.h"
 #include "v_misc.h"
@@ -94,6 +97,10 @@ struct channel_t
   int singularity;         // haleyjd 09/27/06: stored singularity value
   int idnum;               // haleyjd 09/30/06: unique id num for sound event
   bool looping;            // haleyjd 10/06/06: is this channel looping?
+  bool reverb;             // whether the sound goes through the reverb
+  bool isvirtual;          // tracked without a hardware channel
+  unsigned int starttime;  // ms timestamp at which the sound started
+  unsigned int length;     // ms the sound plays for, if not looping
 };
 
 // the set of channels available
@@ -121,6 +128,15 @@ static musicinfo_t *mus_playing;
 int numChannels;
 int default_numChannels;  // killough 9/98
 
+// Extra channels for sounds that lost out on priority. They are kept
+// without being mixed and take over the next hardware channel to free up,
+// resuming where they would have been by then.
+int numVirtualChannels;
+int default_numVirtualChannels;
+
+// hardware channels followed by virtual ones
+static int numSoundSlots;
+
 //jff 3/17/98 to keep track of last IDMUS specified music num
 int idmusnum;
 
@@ -146,7 +162,7 @@ bool s_hidefmusic;
 static void S_StopChannel(int cnum)
 {
 #ifdef RANGECHECK
-   if(cnum < 0 || cnum >= numChannels)
+   if(cnum < 0 || cnum >= numSoundSlots)
       I_Error("S_StopChannel: handle %d out of range\n", cnum);
 #endif
 
@@ -154,7 +170,8 @@ static void S_StopChannel(int cnum)
 
    if(c->sfxinfo)
    {
-      I_StopSound(c->handle, c->idnum); // stop the sound playing
+      if(!c->isvirtual)
+         I_StopSound(c->handle, c->idnum); // stop the sound playing
       
       // haleyjd 09/27/06: clear the entire channel
       memset(c, 0, sizeof(channel_t));
@@ -313,6 +330,49 @@ static int S_AdjustSoundParams(camera_t *listener, const PointThinker *source,
    return *vol > 0;
 }
 
+//
+// S_countChannels
+//
+// haleyjd 04/28/10: gets a count of the currently active sound channels.
+// Virtual channels are not heard, so they do not count.
+//
+static int S_countChannels()
+{
+   int numchannels = 0;
+
+   for(int cnum = 0; cnum < numSoundSlots; cnum++)
+      if(channels[cnum].sfxinfo && !channels[cnum].isvirtual)
+         ++numchannels;
+
+   return numchannels;
+}
+
+//
+// S_soundLength
+//
+// Milliseconds a loaded sound plays for at the given pitch.
+//
+static unsigned int S_soundLength(const sfxinfo_t *sfx, int pitch)
+{
+   return S_SoundLengthMS(sfx, pitched_sounds ? S_PitchStep(pitch) : 1 << 16);
+}
+
+//
+// S_virtualizeChannel
+//
+// Takes the hardware channel away from a playing sound, which carries on as
+// a virtual one.
+//
+static void S_virtualizeChannel(int cnum)
+{
+   channel_t *c = &channels[cnum];
+
+   I_StopSound(c->handle, c->idnum);
+   c->handle    = -1;
+   c->idnum     = 0;
+   c->isvirtual = true;
+}
+
 //
 // S_getChannel
 //
@@ -320,9 +380,14 @@ static int S_AdjustSoundParams(camera_t *listener, const PointThinker *source,
 //   haleyjd 09/27/06: fixed priority/singularity bugs
 //   Note that a higher priority number means lower priority!
 //
+//   With virtual channels, isvirtual is set if the sound should be tracked
+//   without playing because every hardware channel holds something more
+//   important. Otherwise, the least important sound playing is made virtual
+//   if needed to free a hardware channel.
+//
 static int S_getChannel(const PointThinker *origin, sfxinfo_t *sfxinfo,
                         int priority, int singularity, int schan,
-                        bool nocutoff)
+                        bool nocutoff, bool &isvirtual)
 {
    // channel number to use
    int cnum;
@@ -336,12 +401,12 @@ static int S_getChannel(const PointThinker *origin, sfxinfo_t *sfxinfo,
 
    // kill old sound?
    if(nocutoff)
-      cnum = numChannels;
+      cnum = numSoundSlots;
    else
    {
       // killough 12/98: replace is_pickup hack with singularity flag
       // haleyjd 06/12/08: only if subchannel matches
-      for(cnum = 0; cnum < numChannels; cnum++)
+      for(cnum = 0; cnum < numSoundSlots; cnum++)
       {
          // haleyjd 04/09/11: Allow different sounds played on NULL
          // channel to not cut each other off
@@ -362,13 +427,13 @@ static int S_getChannel(const PointThinker *origin, sfxinfo_t *sfxinfo,
    }
    
    // Find an open channel
-   if(cnum == numChannels)
+   if(cnum == numSoundSlots)
    {
       // haleyjd 09/28/06: it isn't necessary to look for playing sounds in
       // the same singularity class again, as we just did that above. Here
       // we are looking for an open channel. We will also keep track of the
       // channel found with the lowest sound priority while doing this.
-      for(cnum = 0; cnum < numChannels && channels[cnum].sfxinfo; cnum++)
+      for(cnum = 0; cnum < numSoundSlots && channels[cnum].sfxinfo; cnum++)
       {
          if(channels[cnum].priority > lowestpriority)
          {
@@ -379,7 +444,7 @@ static int S_getChannel(const PointThinker *origin, sfxinfo_t *sfxinfo,
    }
 
    // None available?
-   if(cnum == numChannels)
+   if(cnum == numSoundSlots)
    {
       // Look for lower priority
       // haleyjd: we have stored the channel found with the lowest priority
@@ -394,27 +459,35 @@ static int S_getChannel(const PointThinker *origin, sfxinfo_t *sfxinfo,
    }
 
 #ifdef RANGECHECK
-   if(cnum >= numChannels)
+   if(cnum >= numSoundSlots)
       I_Error("S_getChannel: handle %d out of range\n", cnum);
 #endif
-   
-   return cnum;
-}
 
-//
-// S_countChannels
-//
-// haleyjd 04/28/10: gets a count of the currently active sound channels.
-//
-static int S_countChannels()
-{
-   int numchannels = 0;
+   isvirtual = false;
 
-   for(int cnum = 0; cnum < numChannels; cnum++)
-      if(channels[cnum].sfxinfo)
-         ++numchannels;
+   if(numVirtualChannels && S_countChannels() >= numChannels)
+   {
+      lowestpriority = D_MININT;
+      lpcnum = -1;
 
-   return numchannels;
+      for(int i = 0; i < numSoundSlots; i++)
+      {
+         const channel_t &c = channels[i];
+
+         if(c.sfxinfo && !c.isvirtual && c.priority > lowestpriority)
+         {
+            lowestpriority = c.priority;
+            lpcnum = i;
+         }
+      }
+
+      if(lpcnum >= 0 && priority <= lowestpriority)
+         S_virtualizeChannel(lpcnum);
+      else
+         isvirtual = true;
+   }
+   
+   return cnum;
 }
 
 //
@@ -429,6 +502,7 @@ static int S_countChannels()
 void S_StartSfxInfo(const soundparams_t &params)
 {
    int  sep = 0, pitch, singularity, cnum, handle, o_priority, priority, chancount;
+   bool isvirtual;
    int  volume         = snd_SfxVolume;
    int  volumeScale    = params.volumeScale;
    int  subchannel     = params.subchannel;
@@ -623,11 +697,12 @@ void S_StartSfxInfo(const soundparams_t &params)
       subchannel = sfx->subchannel;
 
    // try to find a channel
-   if((cnum = S_getChannel(origin, sfx, priority, singularity, subchannel, nocutoff)) < 0)
+   if((cnum = S_getChannel(origin, sfx, priority, singularity, subchannel, nocutoff,
+                           isvirtual)) < 0)
       return;
 
 #ifdef RANGECHECK
-   if(cnum < 0 || cnum >= numChannels)
+   if(cnum < 0 || cnum >= numSoundSlots)
       I_Error("S_StartSfxInfo: handle %d out of range\n", cnum);
 #endif
 
@@ -639,10 +714,13 @@ void S_StartSfxInfo(const soundparams_t &params)
       sfx = sfx->link;     // sf: skip thru link(s)
 
    // Assigns the handle to one of the channels in the mix/output buffer.
-   handle = I_StartSound(sfx, cnum, volume, sep, pitch, priority, params.loop, params.reverb);
+   if(isvirtual)
+      handle = -1;
+   else
+      handle = I_StartSound(sfx, cnum, volume, sep, pitch, priority, params.loop, params.reverb);
 
    // haleyjd: check to see if the sound was started
-   if(handle >= 0)
+   if(handle >= 0 || (isvirtual && S_LoadDigitalSoundEffect(sfx)))
    {
       channels[cnum].handle = handle;
       
@@ -658,7 +736,11 @@ void S_StartSfxInfo(const soundparams_t &params)
       channels[cnum].singularity = singularity;
       channels[cnum].looping     = params.loop;
       channels[cnum].subchannel  = subchannel;
-      channels[cnum].idnum       = I_SoundID(handle); // unique instance id
+      channels[cnum].reverb      = params.reverb;
+      channels[cnum].isvirtual   = isvirtual;
+      channels[cnum].starttime   = i_haltimer.GetTicks();
+      channels[cnum].length      = S_soundLength(sfx, pitch);
+      channels[cnum].idnum       = isvirtual ? 0 : I_SoundID(handle); // unique instance id
    }
    else // haleyjd: the sound didn't start, so clear the channel info
    {
@@ -817,10 +899,11 @@ void S_StopSound(const PointThinker *origin, int subchannel)
    if(!snd_card || nosfxparm)
       return;
 
-   for(cnum = 0; cnum < numChannels; cnum++)
+   for(cnum = 0; cnum < numSoundSlots; cnum++)
    {
       if(channels[cnum].sfxinfo && channels[cnum].origin == origin &&
-         channels[cnum].idnum == I_SoundID(channels[cnum].handle) &&
+         (channels[cnum].isvirtual ||
+          channels[cnum].idnum == I_SoundID(channels[cnum].handle)) &&
          (subchannel == CHAN_ALL || channels[cnum].subchannel == subchannel))
       {
          S_StopChannel(cnum);
@@ -880,6 +963,102 @@ static void S_updateEnvironment(sector_t *earsec)
    }
 }
 
+//
+// S_channelParams
+//
+// Works out the volume, separation and priority a channel would play with
+// now, as S_StartSfxInfo does. Returns false if it is no longer audible.
+//
+static bool S_channelParams(const channel_t *c, const Mobj *listener,
+                            camera_t *playercam, int &volume, int &sep, int &pri)
+{
+   int pitch = c->pitch;
+
+   volume = snd_SfxVolume;
+   sep    = NORM_SEP;
+   pri    = c->o_priority;
+
+   if(!c->origin || static_cast<const PointThinker *>(listener) == c->origin)
+   {
+      volume = eclamp((volume * c->volume) / 15, 0, 127);
+      return volume > 0;
+   }
+
+   return !!S_AdjustSoundParams(listener ? playercam : NULL, c->origin,
+                                c->volume, c->attenuation, &volume, &sep,
+                                &pitch, &pri, c->sfxinfo);
+}
+
+//
+// S_updateVirtualChannels
+//
+// Ends virtual sounds that have run out or become inaudible, then gives any
+// free hardware channels to the most important of the rest. These resume
+// from wherever they would have got to by now.
+//
+static void S_updateVirtualChannels(const Mobj *listener, camera_t *playercam,
+                                    const sector_t *earsec)
+{
+   unsigned int now = i_haltimer.GetTicks();
+   int volume, sep, pri;
+
+   for(int cnum = 0; cnum < numSoundSlots; cnum++)
+   {
+      channel_t *c = &channels[cnum];
+
+      if(!c->sfxinfo || !c->isvirtual)
+         continue;
+
+      if((!c->looping && now - c->starttime >= c->length) ||
+         (listener && S_CheckSectorKill(earsec, c->origin)) ||
+         !S_channelParams(c, listener, playercam, volume, sep, pri))
+      {
+         S_StopChannel(cnum);
+         continue;
+      }
+
+      c->priority = pri;
+   }
+
+   for(int voices = S_countChannels(); voices < numChannels; voices++)
+   {
+      int best = -1;
+
+      for(int cnum = 0; cnum < numSoundSlots; cnum++)
+      {
+         const channel_t &c = channels[cnum];
+
+         if(c.sfxinfo && c.isvirtual &&
+            (best < 0 || c.priority < channels[best].priority))
+            best = cnum;
+      }
+
+      if(best < 0)
+         break;
+
+      channel_t *c   = &channels[best];
+      sfxinfo_t *sfx = c->sfxinfo;
+
+      while(sfx->link)
+         sfx = sfx->link;
+
+      S_channelParams(c, listener, playercam, volume, sep, pri);
+
+      int handle = I_StartSound(sfx, best, volume, sep, c->pitch, c->priority,
+                                c->looping, c->reverb);
+      if(handle < 0)
+      {
+         S_StopChannel(best);
+         continue;
+      }
+
+      c->handle    = handle;
+      c->idnum     = I_SoundID(handle);
+      c->isvirtual = false;
+      I_SeekSound(handle, c->idnum, now - c->starttime);
+   }
+}
+
 //
 // S_UpdateSounds
 //
@@ -917,12 +1096,13 @@ void S_UpdateSounds(const Mobj *listener)
    S_updateEnvironment(earsec);
 
    // now update each individual channel
-   for(int cnum = 0; cnum < numChannels; cnum++)
+   for(int cnum = 0; cnum < numSoundSlots; cnum++)
    {
       channel_t *c = &channels[cnum];
       sfxinfo_t *sfx = c->sfxinfo;
 
-      if(!sfx)
+      // virtual channels are handled below
+      if(!sfx || c->isvirtual)
          continue;
 
       // haleyjd: has this software channel lost its hardware channel?
@@ -976,6 +1156,9 @@ void S_UpdateSounds(const Mobj *listener)
       else   // if channel is allocated but sound has stopped, free it
          S_StopChannel(cnum);
    }
+
+   if(numVirtualChannels)
+      S_updateVirtualChannels(listener, &playercam, earsec);
 }
 
 //
@@ -989,11 +1172,11 @@ bool S_CheckSoundPlaying(const PointThinker *mo, sfxinfo_t *aliasinfo)
 
    if(mo && aliasinfo)
    {
-      for(cnum = 0; cnum < numChannels; cnum++)
+      for(cnum = 0; cnum < numSoundSlots; cnum++)
       {
          if(channels[cnum].origin == mo && channels[cnum].aliasinfo == aliasinfo)
          {
-            if(I_SoundIsPlaying(channels[cnum].handle))
+            if(channels[cnum].isvirtual || I_SoundIsPlaying(channels[cnum].handle))
                return true;
          }
       }
@@ -1018,7 +1201,7 @@ void S_StopSounds(bool killall)
    // jff 1/22/98 skip sound init if sound not enabled
    // haleyjd 08/29/07: kill only sourced sounds.
    if(snd_card && !nosfxparm)
-      for(cnum = 0; cnum < numChannels; ++cnum)
+      for(cnum = 0; cnum < numSoundSlots; ++cnum)
          if(channels[cnum].sfxinfo && (killall || channels[cnum].origin))
             S_StopChannel(cnum);
 }
@@ -1034,7 +1217,7 @@ void S_StopLoopedSounds()
    int cnum;
 
    if(snd_card && !nosfxparm)
-      for(cnum = 0; cnum < numChannels; ++cnum)
+      for(cnum = 0; cnum < numSoundSlots; ++cnum)
          if(channels[cnum].sfxinfo && channels[cnum].looping)
             S_StopChannel(cnum);
 }
@@ -1437,7 +1620,9 @@ void S_Init(int sfxVolume, int musicVolume)
 
       // killough 10/98:
       numChannels = default_numChannels;
-      channels = ecalloc(channel_t *, numChannels, sizeof(channel_t));
+      numVirtualChannels = default_numVirtualChannels;
+      numSoundSlots = numChannels + numVirtualChannels;
+      channels = ecalloc(channel_t *, numSoundSlots, sizeof(channel_t));
    }
 
    if(s_precache)        // sf: option to precache sounds
@@ -1560,7 +1745,8 @@ musicinfo_t *S_MusicForName(const char *name)
 
 VARIABLE_BOOLEAN(s_precache,      NULL, onoff);
 VARIABLE_BOOLEAN(pitched_sounds,  NULL, onoff);
-VARIABLE_INT(default_numChannels, NULL, 1, 32,  NULL);
+VARIABLE_INT(default_numChannels, NULL, 1, 128, NULL);
+VARIABLE_INT(default_numVirtualChannels, NULL, 0, 256, NULL);
 VARIABLE_INT(snd_SfxVolume,       NULL, 0, 15,  NULL);
 VARIABLE_INT(snd_MusicVolume,     NULL, 0, 15,  NULL);
 VARIABLE_BOOLEAN(forceFlipPan,    NULL, onoff);
@@ -1569,6 +1755,7 @@ VARIABLE_TOGGLE(s_hidefmusic,     NULL, onoff);
 CONSOLE_VARIABLE(s_precache, s_precache, 0) {}
 CONSOLE_VARIABLE(s_pitched, pitched_sounds, 0) {}
 CONSOLE_VARIABLE(snd_channels, default_numChannels, 0) {}
+CONSOLE_VARIABLE(snd_virtualchannels, default_numVirtualChannels, 0) {}
 
 CONSOLE_VARIABLE(sfx_volume, snd_SfxVolume, 0)
 {
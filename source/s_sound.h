@@ -152,6 +152,8 @@ extern int s_precache;
 // machine-independent sound params
 extern int numChannels;
 extern int default_numChannels;  // killough 10/98
+extern int numVirtualChannels;
+extern int default_numVirtualChannels;
 
 //jff 3/17/98 holds last IDMUS number, or -1
 extern int idmusnum;
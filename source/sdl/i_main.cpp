@@ -28,6 +28,7 @@
 #include "../hal/i_platform.h"
 #include "../m_argv.h"
 #include "../d_main.h"
+#include "../d_startprof.h"
 #include "../i_system.h"
 
 // main Tweaks for Windows Platforms
@@ -76,12 +77,16 @@ int main(int argc, char **argv)
 
    // MaxW: 2017/09/16: Now prints the error on failure
    // haleyjd 04/15/02: added check for failure
-   // ioanch: avoid loading SDL_VIDEO if -nodraw and -nosound are combined.
+   // ioanch: avoid loading SDL_VIDEO if -nodraw and -nosound are combined,
+   // or for the map analyzer, which implies both.
    // FIXME: code duplication; the global booleans aren't assigned yet.
-   Uint32 initflags = (M_CheckParm("-nodraw") &&
-                       (M_CheckParm("-nosound") || (M_CheckParm("-nosfx") &&
-                                                    M_CheckParm("-nomusic")))) ?
+   Uint32 initflags = (M_CheckParm("-mapreport") ||
+                       (M_CheckParm("-nodraw") &&
+                        (M_CheckParm("-nosound") || (M_CheckParm("-nosfx") &&
+                                                     (M_CheckParm("-nomusic") ||
+                                                      M_CheckParm("-faststart")))))) ?
    SDL_INIT_JOYSTICK : SDL_INIT_VIDEO | SDL_INIT_JOYSTICK;
+   D_StartupPhase("SDL_Init");
    if(SDL_Init(initflags) == -1)
    {
       printf("Failed to initialize SDL library: %s\n", SDL_GetError());
@@ -475,6 +475,9 @@ i_sounddriver_t i_pcsound_driver =
    I_PCSSoundIsPlaying,    // SoundIsPlaying
    I_PCSUpdateSoundParams, // UpdateSoundParams
    NULL,                   // UpdateEQParams
+   NULL,                   // SeekSound
+   NULL,                   // TicSound
+   NULL,                   // WaitSoundCommands
 };
 
 // EOF
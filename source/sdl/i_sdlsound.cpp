@@ -24,6 +24,8 @@
 #include "SDL_thread.h"
 #include "SDL_mixer.h"
 
+#include <atomic>
+
 #include "../z_zone.h"
 
 #include "../c_io.h"
@@ -33,13 +35,16 @@
 #include "../d_io.h"
 #include "../doomstat.h"
 #include "../g_game.h"     //jff 1/21/98 added to use dprintf in I_RegisterSong
+#include "../hal/i_timer.h"
 #include "../i_sound.h"
 #include "../i_system.h"
 #include "../m_argv.h"
+#include "../m_collection.h"
 #include "../m_compare.h"
 #include "../mn_engin.h"
 #include "../s_reverb.h"
 #include "../s_formats.h"
+#include "../s_mixer.h"
 #include "../s_sound.h"
 #include "../v_misc.h"
 #include "../w_wad.h"
@@ -47,7 +52,7 @@
 extern bool snd_init;
 
 // Needed for calling the actual sound output.
-#define MAX_CHANNELS 32
+#define MAX_CHANNELS 128
 
 int audio_buffers;
 
@@ -61,36 +66,42 @@ static float *mixbuffer[2];
 // haleyjd 10/28/05: updated for Julian's music code, need full quality now
 static const int snd_samplerate = 44100;
 
-typedef struct channel_info_s
+//
+// channel_info_t
+//
+// A voice as the mixing thread sees it. Only the mixing thread touches these;
+// the main thread changes them through the command queue.
+//
+struct channel_info_t : mixvoice_t
+{
+  // unique instance id
+  unsigned int idnum;
+};
+
+static channel_info_t channelinfo[MAX_CHANNELS];
+
+//
+// sndhandle_t
+//
+// The main thread's record of what it last did with a channel.
+//
+struct sndhandle_t
 {
   // SFX id of the playing sound effect.
   // Used to catch duplicates (like chainsaw).
   sfxinfo_t *id;
-  // The channel step amount...
-  unsigned int step;
-  // ... and a 0.16 bit remainder of last step.
-  unsigned int stepremainder;
-  unsigned int samplerate;
-  // The channel data pointers, start and end.
-  float *data;
-  float *startdata; // haleyjd
-  float *enddata;
-  // Hardware left and right channel volume lookup.
-  float  leftvol, rightvol;
-  // haleyjd 06/03/06: looping
-  int loop;
   // unique instance id
   unsigned int idnum;
-  // if true, channel is affected by reverb
-  bool reverb;
-
-  // haleyjd 10/02/08: SDL semaphore to protect channel
-  SDL_sem *semaphore;
-  bool shouldstop; // haleyjd 05/16/11
+  // started and not stopped; it may have finished since
+  bool active;
+  // pitched copy being played, if any; its step is always 1.0
+  sndresampled_t *resampled;
+};
 
-} channel_info_t;
+static sndhandle_t sndhandles[MAX_CHANNELS];
 
-static channel_info_t channelinfo[MAX_CHANNELS+1];
+// Id of the last voice on each channel to end, set by the mixing thread.
+static std::atomic<unsigned int> channeldone[MAX_CHANNELS];
 
 // Pitch to stepping lookup, unused.
 static int steptable[256];
@@ -98,6 +109,198 @@ static int steptable[256];
 // Volume lookups.
 //static int vol_lookup[128*256];
 
+//=============================================================================
+//
+// Command Queue
+//
+// Single-producer, single-consumer ring from the main thread to the mixing
+// thread. The main thread writes a command and then publishes it by moving
+// the head; the mixing thread runs everything published at the start of
+// each buffer and then moves the tail. Neither side ever waits.
+//
+// Room for a stop on every channel is kept free of starts and seeks. A stop
+// needs a start before it, so however far the mixing thread falls behind, a
+// stop always fits and no sound is left playing.
+//
+
+// Must be a power of two.
+#define SNDCMD_QUEUESIZE 1024
+#define SNDCMD_STOPROOM  MAX_CHANNELS
+
+// Milliseconds without a mixed buffer after which the device is taken to be
+// stopped, see I_SDLWaitSoundCommands
+#define SNDCMD_WAITLIMIT 1000
+
+enum sndcmdtype_e
+{
+   SNDCMD_START,  // begin a voice
+   SNDCMD_STOP,   // end a voice
+   SNDCMD_SEEK,   // move a voice just started
+};
+
+struct sndcommand_t
+{
+   int          type;
+   int          handle;
+   unsigned int id;
+   float       *data;     // SNDCMD_START
+   unsigned int alen;     // SNDCMD_START
+   int          loop;     // SNDCMD_START
+   bool         reverb;   // SNDCMD_START
+   float        leftvol;  // SNDCMD_START
+   float        rightvol; // SNDCMD_START
+   unsigned int step;     // SNDCMD_START
+   unsigned int ms;       // SNDCMD_SEEK
+};
+
+static sndcommand_t          sndcommands[SNDCMD_QUEUESIZE];
+static std::atomic<uint32_t> sndcmdhead; // next to write; main thread
+static std::atomic<uint32_t> sndcmdtail; // next to read; mixing thread
+
+// Statistics, for snd_mixstats.
+static uint32_t              sndcmdpeak;    // deepest the queue has been
+static uint32_t              sndcmddropped; // starts and seeks refused
+static std::atomic<uint32_t> sndbuffers;    // buffers mixed
+
+//
+// I_sdlQueueCommand
+//
+// Main thread only. Returns false, and drops the command, if the mixing
+// thread has fallen so far behind that only the room kept for stops is left.
+// Stops are never dropped.
+//
+static bool I_sdlQueueCommand(const sndcommand_t &cmd)
+{
+   uint32_t head  = sndcmdhead.load(std::memory_order_relaxed);
+   uint32_t depth = head - sndcmdtail.load(std::memory_order_acquire);
+   uint32_t limit = SNDCMD_QUEUESIZE;
+
+   if(cmd.type != SNDCMD_STOP)
+      limit -= SNDCMD_STOPROOM;
+
+   if(depth >= limit)
+   {
+      ++sndcmddropped;
+      return false;
+   }
+
+   sndcommands[head & (SNDCMD_QUEUESIZE - 1)] = cmd;
+   sndcmdhead.store(head + 1, std::memory_order_release);
+
+   sndcmdpeak = emax(sndcmdpeak, depth + 1);
+   return true;
+}
+
+//=============================================================================
+//
+// Parameter Slots
+//
+// Volume and step change for every moving sound on every tic, and only the
+// latest change counts, so they don't go through the queue. Each channel
+// has one slot the main thread overwrites, and the mixing thread applies
+// whatever is there after running the queue. The sequence count is odd
+// while the main thread is writing; a slot caught mid-write is left for the
+// next buffer.
+//
+
+struct sndparams_t
+{
+   std::atomic<uint32_t>     seq;
+   std::atomic<unsigned int> id;
+   std::atomic<float>        leftvol;
+   std::atomic<float>        rightvol;
+   std::atomic<unsigned int> step;
+};
+
+static sndparams_t sndparams[MAX_CHANNELS];
+
+// Set by the main thread when the equalizer settings change.
+static std::atomic<bool> sndeqchanged;
+
+//
+// I_sdlSetParams
+//
+// Main thread only.
+//
+static void I_sdlSetParams(int handle, unsigned int id, float leftvol,
+                           float rightvol, unsigned int step)
+{
+   sndparams_t &p   = sndparams[handle];
+   uint32_t     seq = p.seq.load(std::memory_order_relaxed);
+
+   p.seq.store(seq + 1, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+
+   p.id.store(id, std::memory_order_relaxed);
+   p.leftvol.store(leftvol, std::memory_order_relaxed);
+   p.rightvol.store(rightvol, std::memory_order_relaxed);
+   p.step.store(step, std::memory_order_relaxed);
+
+   p.seq.store(seq + 2, std::memory_order_release);
+}
+
+//=============================================================================
+//
+// Resampled Copy Retirement
+//
+// A copy the main thread has finished with may still be read by the mixing
+// thread until it has run the commands queued so far. Copies wait here for
+// that, and are released by the main thread.
+//
+
+struct sndretired_t
+{
+   sndresampled_t *rs;
+   uint32_t        head; // queue head when retired
+};
+
+static PODCollection<sndretired_t> sndretired;
+
+//
+// I_sdlRetireResampled
+//
+static void I_sdlRetireResampled(sndhandle_t *hs)
+{
+   if(!hs->resampled)
+      return;
+
+   sndretired_t &r = sndretired.addNew();
+   r.rs   = hs->resampled;
+   r.head = sndcmdhead.load(std::memory_order_relaxed);
+   hs->resampled = nullptr;
+}
+
+//
+// I_sdlReleaseRetired
+//
+// Releases every retired copy the mixing thread can no longer be reading.
+//
+static void I_sdlReleaseRetired()
+{
+   uint32_t tail = sndcmdtail.load(std::memory_order_acquire);
+   size_t   keep = 0;
+
+   for(size_t i = 0; i < sndretired.getLength(); i++)
+   {
+      if(int32_t(tail - sndretired[i].head) >= 0)
+         S_ReleaseResampledSound(sndretired[i].rs);
+      else
+         sndretired[keep++] = sndretired[i];
+   }
+   sndretired.resize(keep);
+}
+
+//
+// I_sdlHandleIsPlaying
+//
+static bool I_sdlHandleIsPlaying(int handle)
+{
+   const sndhandle_t &hs = sndhandles[handle];
+
+   return hs.active &&
+      channeldone[handle].load(std::memory_order_acquire) != hs.idnum;
+}
+
 //
 // addsfx
 //
@@ -110,7 +313,8 @@ static int steptable[256];
 // haleyjd: needs to take a sfxinfo_t ptr, not a sound id num
 // haleyjd 06/03/06: changed to return boolean for failure or success
 //
-static bool addsfx(sfxinfo_t *sfx, int channel, int loop, unsigned int id, bool reverb)
+static bool addsfx(sfxinfo_t *sfx, int channel, int loop, unsigned int id, bool reverb,
+                   unsigned int step, int volume, int separation)
 {
 #ifdef RANGECHECK
    if(channel < 0 || channel >= MAX_CHANNELS)
@@ -125,40 +329,59 @@ static bool addsfx(sfxinfo_t *sfx, int channel, int loop, unsigned int id, bool
    if(!S_LoadDigitalSoundEffect(sfx))
       return false;
 
-   // haleyjd 10/02/08: critical section
-   if(SDL_SemWait(channelinfo[channel].semaphore) == 0)
+   // pitched sounds play from a copy resampled here, which lets the mixer
+   // treat every voice as unpitched
+   sndresampled_t *rs = nullptr;
+   if(step != 1 << 16)
+      rs = S_GetResampledSound(sfx, step);
+
+   sndcommand_t cmd = {};
+   mixvoice_t   vol;
+
+   S_SetVoiceVolume(&vol, volume, separation);
+
+   cmd.type     = SNDCMD_START;
+   cmd.handle   = channel;
+   cmd.id       = id;
+   cmd.data     = rs ? rs->data : (float *)sfx->data;
+   cmd.alen     = rs ? rs->alen : sfx->alen;
+   cmd.loop     = loop;
+   cmd.reverb   = reverb;
+   cmd.leftvol  = vol.leftvol;
+   cmd.rightvol = vol.rightvol;
+   cmd.step     = rs ? 1 << 16 : step;
+
+   if(!I_sdlQueueCommand(cmd))
    {
-      channelinfo[channel].data = (float *)sfx->data;
-      
-      // Set pointer to end of raw data.
-      channelinfo[channel].enddata = (float *)sfx->data + sfx->alen - 1;
-      
-      // haleyjd 06/03/06: keep track of start of sound
-      channelinfo[channel].startdata = channelinfo[channel].data;
-      
-      channelinfo[channel].stepremainder = 0;
-      
-      // Preserve sound SFX id
-      channelinfo[channel].id = sfx;
-      
-      // Set looping
-      channelinfo[channel].loop = loop;
-
-      // Set reverb
-      channelinfo[channel].reverb = reverb;
-      
-      // Set instance ID
-      channelinfo[channel].idnum = id;
-
-      // Shouldn't be stopped - haleyjd 05/16/11
-      channelinfo[channel].shouldstop = false;
-
-      SDL_SemPost(channelinfo[channel].semaphore);
-
-      return true;
+      if(rs)
+         S_ReleaseResampledSound(rs);
+      return false;
    }
-   else
-      return false; // acquisition failed
+
+   sndhandle_t &hs = sndhandles[channel];
+
+   // the previous copy is replaced once the mixer runs this command
+   I_sdlRetireResampled(&hs);
+   hs.resampled = rs;
+   hs.id        = sfx;
+   hs.idnum     = id;
+   hs.active    = true;
+
+   return true;
+}
+
+//
+// soundStep
+//
+// 16.16 step through the sample data for a pitch.
+//
+static unsigned int soundStep(int pitch)
+{
+   // MWM 2000-12-24: Calculates proportion of channel samplerate
+   // to global samplerate for mixing purposes.
+   // Patched to shift left *then* divide, to minimize roundoff errors
+   // as well as to use SAMPLERATE as defined above, not to assume 11025 Hz
+   return pitched_sounds ? steptable[pitch] : 1 << 16;
 }
 
 //
@@ -169,11 +392,6 @@ static bool addsfx(sfxinfo_t *sfx, int channel, int loop, unsigned int id, bool
 //
 static void updateSoundParams(int handle, int volume, int separation, int pitch)
 {
-   int slot = handle;
-   int rightvol;
-   int leftvol;
-   int step = steptable[pitch];
-   
    if(!snd_init)
       return;
 
@@ -181,195 +399,134 @@ static void updateSoundParams(int handle, int volume, int separation, int pitch)
    if(handle < 0 || handle >= MAX_CHANNELS)
       I_Error("I_UpdateSoundParams: handle out of range\n");
 #endif
-   
-   // Separation, that is, orientation/stereo.
-   //  range is: 1 - 256
-   separation += 1;
 
-   // SoM 7/1/02: forceFlipPan accounted for here
-   if(forceFlipPan)
-      separation = 257 - separation;
-   
-   // Per left/right channel.
-   //  x^2 separation,
-   //  adjust volume properly.
+   const sndhandle_t &hs = sndhandles[handle];
+   if(!hs.active)
+      return;
 
-   leftvol    = volume - ((volume*separation*separation) >> 16);
-   separation = separation - 257;
-   rightvol   = volume - ((volume*separation*separation) >> 16);  
+   mixvoice_t vol;
 
-   // volume levels are softened slightly by dividing by 191 rather than ideal 127
-   channelinfo[slot].leftvol  = (float)(eclamp((double)leftvol  / 191.0, 0.0, 1.0));
-   channelinfo[slot].rightvol = (float)(eclamp((double)rightvol / 191.0, 0.0, 1.0));
+   S_SetVoiceVolume(&vol, volume, separation);
 
-   // haleyjd 06/07/09: critical section is not needed here because this data
-   // can be out of sync without affecting the sound update loop. This may cause
-   // momentary out-of-sync volume between the left and right sound channels, but
-   // the impact would be practically unnoticeable.
+   // Set stepping; a resampled copy already has the pitch applied, which
+   // stays as it was when the sound started
+   unsigned int step = hs.resampled ? 1 << 16 : soundStep(pitch);
 
-   // Set stepping
-   // MWM 2000-12-24: Calculates proportion of channel samplerate
-   // to global samplerate for mixing purposes.
-   // Patched to shift left *then* divide, to minimize roundoff errors
-   // as well as to use SAMPLERATE as defined above, not to assume 11025 Hz
-   if(pitched_sounds)
-      channelinfo[slot].step = step;
-   else
-      channelinfo[slot].step = 1 << 16;   
+   I_sdlSetParams(handle, hs.idnum, vol.leftvol, vol.rightvol, step);
 }
 
-//=============================================================================
+// haleyjd 04/21/10: equalizer for the final mix
+static SoundEqualizer equalizer;
+
+//============================================================================
 //
-// Three-Band Equalization
+// MAIN ROUTINE - AUDIOSPEC CALLBACK ROUTINE
 //
 
-static double preampmul;
-
-struct EQSTATE
-{
-  // Filter #1 (Low band)
-
-  double  lf;       // Frequency
-  double  f1p0;     // Poles ...
-  double  f1p1;    
-  double  f1p2;
-  double  f1p3;
-
-  // Filter #2 (High band)
-
-  double  hf;       // Frequency
-  double  f2p0;     // Poles ...
-  double  f2p1;
-  double  f2p2;
-  double  f2p3;
-
-  // Sample history buffer
-
-  double  sdm1;     // Sample data minus 1
-  double  sdm2;     //                   2
-  double  sdm3;     //                   3
-
-  // Gain Controls
-
-  double  lg;       // low  gain
-  double  mg;       // mid  gain
-  double  hg;       // high gain
-  
-};  
+// size of a single sample
+#define SAMPLESIZE sizeof(Sint16) 
 
-// haleyjd 04/21/10: equalizers for each stereo channel
-static EQSTATE eqstate[2];
+// step to next stereo sample pair (2 samples)
+#define STEP 2
 
 //
-// rational_tanh
-//
-// cschueler
-// http://www.musicdsp.org/showone.php?id=238
+// I_SDLEndChannel
 //
-// Notes :
-// This is a rational function to approximate a tanh-like soft clipper. It is
-// based on the pade-approximation of the tanh function with tweaked 
-// coefficients.
-// The function is in the range x=-3..3 and outputs the range y=-1..1. Beyond
-// this range the output must be clamped to -1..1.
-// The first two derivatives of the function vanish at -3 and 3, so the 
-// transition to the hard clipped region is C2-continuous.
+// Mixing thread only. Lets the main thread know the voice has ended.
 //
-static double rational_tanh(double x)
+static void I_SDLEndChannel(int handle)
 {
-   if(x < -3)
-      return -1;
-   else if(x > 3)
-      return 1;
-   else
-      return x * ( 27 + x * x ) / ( 27 + 9 * x * x );
+   channelinfo[handle].data = nullptr;
+   channeldone[handle].store(channelinfo[handle].idnum, std::memory_order_release);
 }
 
 //
-// do_3band
-//
-// EQ.C - Main Source file for 3 band EQ
-// http://www.musicdsp.org/showone.php?id=236
-//
-// (c) Neil C / Etanza Systems / 2K6
-// Shouts / Loves / Moans = etanza at lycos dot co dot uk
+// I_SDLRunCommands
 //
-// This work is hereby placed in the public domain for all purposes, including
-// use in commercial applications.
-// The author assumes NO RESPONSIBILITY for any problems caused by the use of
-// this software.
+// Mixing thread only. Applies everything the main thread has queued.
 //
-// haleyjd 12/19/13: rewritten to loop over the sample buffer and do output
-// directly back to the SDL audio stream.
-//
-static void do_3band(float *stream, float *end, Sint16 *dest)
+static void I_SDLRunCommands()
 {
-   int esnum = 0;
-
-   // haleyjd: This "very small addend" is supposed to take care of P4
-   // denormalization problems. Do we actually need it?
-   static double vsa = (1.0 / 4294967295.0);
-   // Locals
-   double sample, l, m, h;    // Low / Mid / High - Sample Values
+   uint32_t tail = sndcmdtail.load(std::memory_order_relaxed);
+   uint32_t head = sndcmdhead.load(std::memory_order_acquire);
 
-   while(stream != end)
+   for(; tail != head; tail++)
    {
-      auto es = &eqstate[esnum];
-      esnum ^= 1; // haleyjd: toggle between equalizer channels
-
-      sample = *stream++ * preampmul;
-
-      // Filter #1 (lowpass)
-      es->f1p0  += (es->lf * (sample   - es->f1p0)) + vsa;
-      es->f1p1  += (es->lf * (es->f1p0 - es->f1p1));
-      es->f1p2  += (es->lf * (es->f1p1 - es->f1p2));
-      es->f1p3  += (es->lf * (es->f1p2 - es->f1p3));
+      const sndcommand_t &cmd  = sndcommands[tail & (SNDCMD_QUEUESIZE - 1)];
+      channel_info_t     *chan = &channelinfo[cmd.handle];
 
-      l          = es->f1p3;
-
-      // Filter #2 (highpass)
-      es->f2p0  += (es->hf * (sample   - es->f2p0)) + vsa;
-      es->f2p1  += (es->hf * (es->f2p0 - es->f2p1));
-      es->f2p2  += (es->hf * (es->f2p1 - es->f2p2));
-      es->f2p3  += (es->hf * (es->f2p2 - es->f2p3));
-
-      h          = es->sdm3 - es->f2p3;
+      if(cmd.type == SNDCMD_START)
+      {
+         chan->data          = cmd.data;
+         chan->startdata     = cmd.data;
+         chan->enddata       = cmd.data + cmd.alen - 1;
+         chan->stepremainder = 0;
+         chan->step          = cmd.step;
+         chan->leftvol       = cmd.leftvol;
+         chan->rightvol      = cmd.rightvol;
+         chan->loop          = cmd.loop;
+         chan->reverb        = cmd.reverb;
+         chan->idnum         = cmd.id;
+         continue;
+      }
 
-      // Calculate midrange (signal - (low + high))
-      m          = es->sdm3 - (h + l); // haleyjd 07/05/10: which is right?
-      //m          = sample - (h + l); // the one above seems more correct to me.
+      // the rest apply only to the voice they were meant for
+      if(!chan->data || chan->idnum != cmd.id)
+         continue;
 
-      // Scale, Combine and store
-      l         *= es->lg;
-      m         *= es->mg;
-      h         *= es->hg;
+      switch(cmd.type)
+      {
+      case SNDCMD_STOP:
+         I_SDLEndChannel(cmd.handle);
+         break;
+      case SNDCMD_SEEK:
+         if(!S_SeekVoice(chan, cmd.ms))
+            I_SDLEndChannel(cmd.handle);
+         break;
+      default:
+         break;
+      }
+   }
 
-      // Shuffle history buffer
-      es->sdm3   = es->sdm2;
-      es->sdm2   = es->sdm1;
-      es->sdm1   = sample;                
+   sndcmdtail.store(tail, std::memory_order_release);
 
-      // Return result
-      // haleyjd: use rational_tanh for soft clipping
-      *dest++ = (Sint16)(rational_tanh(l + m + h) * 32767.0);
-   }
+   if(sndeqchanged.exchange(false, std::memory_order_acquire))
+      equalizer.setup(snd_samplerate);
 }
 
 //
-// End Equalizer Code
-//
-//============================================================================
-
-//============================================================================
+// I_SDLRunParams
 //
-// MAIN ROUTINE - AUDIOSPEC CALLBACK ROUTINE
+// Mixing thread only. Applies the latest parameters of each voice.
 //
+static void I_SDLRunParams()
+{
+   for(int i = 0; i < MAX_CHANNELS; i++)
+   {
+      sndparams_t &p   = sndparams[i];
+      uint32_t     seq = p.seq.load(std::memory_order_acquire);
 
-// size of a single sample
-#define SAMPLESIZE sizeof(Sint16) 
+      if(!seq || seq & 1)
+         continue;
 
-// step to next stereo sample pair (2 samples)
-#define STEP 2
+      unsigned int id       = p.id.load(std::memory_order_relaxed);
+      float        leftvol  = p.leftvol.load(std::memory_order_relaxed);
+      float        rightvol = p.rightvol.load(std::memory_order_relaxed);
+      unsigned int step     = p.step.load(std::memory_order_relaxed);
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if(p.seq.load(std::memory_order_relaxed) != seq)
+         continue; // rewritten meanwhile
+
+      channel_info_t *chan = &channelinfo[i];
+      if(!chan->data || chan->idnum != id)
+         continue;
+
+      chan->leftvol  = leftvol;
+      chan->rightvol = rightvol;
+      chan->step     = step;
+   }
+}
 
 //
 // I_SDLConvertSoundBuffer
@@ -409,104 +566,41 @@ static void inline I_SDLConvertSoundBuffer(Uint8 *stream, int len)
 //
 static inline void I_SDLMixBuffers()
 {
-   float *bptr = mixbuffer[0];
-   float *end  = bptr + mixbuffer_size;
-   while(bptr != end)
-   {
-      *bptr = *bptr + *(bptr + mixbuffer_size);
-      ++bptr;
-   }
+   S_MixAdd(mixbuffer[0], mixbuffer[1], mixbuffer_size);
 }
 
 //
 // I_SDLUpdateSoundCB
 //
 // SDL_mixer postmix callback routine. Possibly dispatched asynchronously.
-// We do our own mixing on up to 32 digital sound channels.
+// We do our own mixing on up to MAX_CHANNELS digital sound channels.
 //
 static void I_SDLUpdateSoundCB(void *userdata, Uint8 *stream, int len)
 {
    // convert input samples to floating point
    I_SDLConvertSoundBuffer(stream, len);
 
-   float *leftout;
    // Pointer to end of mixbuffer
    float *leftend0 = mixbuffer[0] + (len/SAMPLESIZE);
-   float *leftend1 = mixbuffer[1] + (len/SAMPLESIZE);
-   float *leftend;
+   int    frames   = len / (SAMPLESIZE * STEP);
 
-   // Mix audio channels
-   for(channel_info_t *chan = channelinfo; chan != &channelinfo[numChannels]; chan++)
-   {
-      // fast rejection before semaphore lock
-      if(chan->shouldstop || !chan->data)
-         continue;
-         
-      // try to acquire semaphore, but do not block; if the main thread is using
-      // this channel we'll just skip it for now - safer and faster.
-      if(SDL_SemTryWait(chan->semaphore) != 0)
-         continue;
+   // haleyjd 06/03/06: looping samples restart only if not paused
+   const bool canloop = S_VoicesMayLoop();
 
-      // Left and right channel are in audio stream, alternating.
-      if(chan->reverb)
-      {
-         leftout  = mixbuffer[1];
-         leftend  = leftend1;
-      }
-      else
-      {
-         leftout = mixbuffer[0];
-         leftend = leftend0;
-      }
+   I_SDLRunCommands();
+   I_SDLRunParams();
 
-      // Lost before semaphore acquired? (very unlikely, but must check for 
-      // safety). BTW, don't move this up or you'll chew major CPU whenever this
-      // does happen.
-      if(chan->shouldstop || !chan->data)
-      {
-         SDL_SemPost(chan->semaphore);
-         continue;
-      }
+   // Mix audio channels; all of them, in case snd_channels has just shrunk
+   for(int i = 0; i < MAX_CHANNELS; i++)
+   {
+      channel_info_t *chan = &channelinfo[i];
 
-      while(leftout != leftend)
-      {
-         float sample  = *(chan->data);         
-         *(leftout + 0) = *(leftout + 0) + sample * chan->leftvol;
-         *(leftout + 1) = *(leftout + 1) + sample * chan->rightvol;
-         
-         // Increment current pointers in stream
-         leftout += STEP;
-         
-         // Increment index
-         chan->stepremainder += chan->step;
-         
-         // MSB is next sample
-         chan->data += chan->stepremainder >> 16;
-         
-         // Limit to LSB
-         chan->stepremainder &= 0xffff;
-         
-         // Check whether we are done
-         if(chan->data >= chan->enddata)
-         {
-            if(chan->loop && !paused && 
-               ((!menuactive && !consoleactive) || demoplayback || netgame))
-            {
-               // haleyjd 06/03/06: restart a looping sample if not paused
-               chan->data = chan->startdata;
-               chan->stepremainder = 0;
-            }
-            else
-            {
-               // flag the channel to be stopped by the main thread ASAP
-               chan->data = NULL;
-               break;
-            }
-         }
-      }
+      if(!chan->data)
+         continue;
 
-      // release semaphore and move on to the next channel
-      SDL_SemPost(chan->semaphore);
+      // Left and right channel are in audio stream, alternating.
+      if(!S_MixVoice(chan, mixbuffer[chan->reverb ? 1 : 0], frames, canloop))
+         I_SDLEndChannel(i);
    }
 
    // do reverberation if an effect is active
@@ -517,7 +611,9 @@ static void I_SDLUpdateSoundCB(void *userdata, Uint8 *stream, int len)
    I_SDLMixBuffers();
 
    // haleyjd 04/21/10: equalization output pass
-   do_3band(mixbuffer[0], leftend0, (Sint16 *)stream);
+   equalizer.process(mixbuffer[0], leftend0, (Sint16 *)stream);
+
+   sndbuffers.fetch_add(1, std::memory_order_relaxed);
 }
 
 //
@@ -525,8 +621,6 @@ static void I_SDLUpdateSoundCB(void *userdata, Uint8 *stream, int len)
 //
 //============================================================================
 
-#define SND_PI 3.14159265
-
 //
 // I_SetChannels
 //
@@ -538,43 +632,25 @@ static void I_SetChannels()
 {
    int i;
    
-   int *steptablemid = steptable + 128;
-   
    // Okay, reset internal mixing channels to zero.
    for(i = 0; i < MAX_CHANNELS; i++)
+   {
       memset(&channelinfo[i], 0, sizeof(channel_info_t));
+      memset(&sndhandles[i], 0, sizeof(sndhandle_t));
+      channeldone[i].store(0);
+   }
    
    // This table provides step widths for pitch parameters.
-   for(i = -128; i < 128; i++)
-      steptablemid[i] = (int)(pow(1.2, ((double)i/(64.0)))*FPFRACUNIT);
+   for(i = 0; i < 256; i++)
+      steptable[i] = S_PitchStep(i);
    
    // allocate mixing buffers
    auto buf = ecalloc(float *, 2*mixbuffer_size, sizeof(float));
    mixbuffer[0] = buf;
    mixbuffer[1] = buf + mixbuffer_size;
 
-   // haleyjd 10/02/08: create semaphores
-   for(i = 0; i < MAX_CHANNELS; i++)
-   {
-      channelinfo[i].semaphore = SDL_CreateSemaphore(1);
-
-      if(!channelinfo[i].semaphore)
-         I_Error("I_SetChannels: failed to create semaphore for channel %d\n", i);
-   }
-
    // haleyjd 04/21/10: initialize equalizers
-
-   // Set Low/Mid/High gains 
-   eqstate[0].lg = eqstate[1].lg = s_lowgain;
-   eqstate[0].mg = eqstate[1].mg = s_midgain;
-   eqstate[0].hg = eqstate[1].hg = s_highgain;
-
-   // Calculate filter cutoff frequencies
-   eqstate[0].lf = eqstate[1].lf = 2 * sin(SND_PI * (s_lowfreq  / (double)snd_samplerate));
-   eqstate[0].hf = eqstate[1].hf = 2 * sin(SND_PI * (s_highfreq / (double)snd_samplerate));
-
-   // Calculate preamplification factor
-   preampmul = s_eqpreamp;
+   equalizer.setup(snd_samplerate);
 }
 
 //=============================================================================
@@ -589,20 +665,7 @@ static void I_SetChannels()
 //
 static void I_SDLUpdateEQParams()
 {
-   // flush out state of equalizers
-   memset(eqstate, 0, sizeof(eqstate));
-
-   // Set Low/Mid/High gains 
-   eqstate[0].lg = eqstate[1].lg = s_lowgain;
-   eqstate[0].mg = eqstate[1].mg = s_midgain;
-   eqstate[0].hg = eqstate[1].hg = s_highgain;
-
-   // Calculate filter cutoff frequencies
-   eqstate[0].lf = eqstate[1].lf = 2 * sin(SND_PI * (s_lowfreq  / (double)snd_samplerate));
-   eqstate[0].hf = eqstate[1].hf = 2 * sin(SND_PI * (s_highfreq / (double)snd_samplerate));
-
-   // Calculate preamp factor
-   preampmul = s_eqpreamp;
+   sndeqchanged.store(true, std::memory_order_release);
 }
 
 //
@@ -628,7 +691,7 @@ static int I_SDLStartSound(sfxinfo_t *sound, int cnum, int vol, int sep,
    // haleyjd 06/03/06: look for an unused hardware channel
    for(handle = 0; handle < numChannels; handle++)
    {
-      if(channelinfo[handle].data == NULL || channelinfo[handle].shouldstop)
+      if(!I_sdlHandleIsPlaying(handle))
          break;
    }
 
@@ -636,12 +699,11 @@ static int I_SDLStartSound(sfxinfo_t *sound, int cnum, int vol, int sep,
    // than to cut off one already playing, which sounds weird.
    if(handle == numChannels)
       return -1;
+
+   I_sdlReleaseRetired();
  
-   if(addsfx(sound, handle, loop, id, reverb))
-   {
-      updateSoundParams(handle, vol, sep, pitch);
+   if(addsfx(sound, handle, loop, id, reverb, soundStep(pitch), vol, sep))
       ++id; // increment id to keep each sound instance unique
-   }
    else
       handle = -1;
    
@@ -660,9 +722,77 @@ static void I_SDLStopSound(int handle, int id)
    if(handle < 0 || handle >= MAX_CHANNELS)
       I_Error("I_SDLStopSound: handle out of range\n");
 #endif
+
+   sndhandle_t &hs = sndhandles[handle];
    
-   if(channelinfo[handle].idnum == (unsigned int)id)
-      channelinfo[handle].shouldstop = true;
+   if(!hs.active || hs.idnum != (unsigned int)id)
+      return;
+
+   sndcommand_t cmd = {};
+
+   cmd.type   = SNDCMD_STOP;
+   cmd.handle = handle;
+   cmd.id     = hs.idnum;
+   I_sdlQueueCommand(cmd);
+
+   hs.active = false;
+   I_sdlRetireResampled(&hs);
+}
+
+//
+// I_SDLSeekSound
+//
+// Moves a sound that has just been started ms milliseconds into its data,
+// stopping it if a non-looping sound would have ended by then.
+//
+static void I_SDLSeekSound(int handle, int id, unsigned int ms)
+{
+#ifdef RANGECHECK
+   if(handle < 0 || handle >= MAX_CHANNELS)
+      I_Error("I_SDLSeekSound: handle out of range\n");
+#endif
+
+   const sndhandle_t &hs = sndhandles[handle];
+
+   if(!hs.active || hs.idnum != (unsigned int)id)
+      return;
+
+   sndcommand_t cmd = {};
+
+   cmd.type   = SNDCMD_SEEK;
+   cmd.handle = handle;
+   cmd.id     = hs.idnum;
+   cmd.ms     = ms;
+   I_sdlQueueCommand(cmd);
+}
+
+//
+// I_SDLWaitSoundCommands
+//
+// Waits for the mixing thread to run everything queued so far. A voice it has
+// stopped no longer reads its sample data, so that may then be freed. If the
+// device has stopped calling back, nothing is mixing; it runs the queue
+// before touching any voice once it resumes.
+//
+static void I_SDLWaitSoundCommands()
+{
+   uint32_t     head    = sndcmdhead.load(std::memory_order_relaxed);
+   uint32_t     buffers = sndbuffers.load(std::memory_order_relaxed);
+   unsigned int start   = i_haltimer.GetTicks();
+
+   while(sndcmdtail.load(std::memory_order_acquire) != head)
+   {
+      uint32_t now = sndbuffers.load(std::memory_order_relaxed);
+      if(now != buffers)
+      {
+         buffers = now;
+         start   = i_haltimer.GetTicks();
+      }
+      else if(i_haltimer.GetTicks() - start >= SNDCMD_WAITLIMIT)
+         break;
+
+      i_haltimer.Sleep(1);
+   }
 }
 
 //
@@ -677,7 +807,7 @@ static int I_SDLSoundIsPlaying(int handle)
       I_Error("I_SDLSoundIsPlaying: handle out of range\n");
 #endif
  
-   return !channelinfo[handle].shouldstop && channelinfo[handle].data;
+   return I_sdlHandleIsPlaying(handle);
 }
 
 //
@@ -695,22 +825,19 @@ static int I_SDLSoundID(int handle)
       I_Error("I_SDLSoundID: handle out of range\n");
 #endif
 
-   return channelinfo[handle].idnum;
+   return sndhandles[handle].idnum;
 }
 
 //
 // I_SDLUpdateSound
 //
-// haleyjd 10/02/08: This function is now responsible for stopping channels
-// that have expired. The I_SDLUpdateSound function does sound updating, but
-// cannot be allowed to modify the zone heap due to being dispatched from a
-// separate thread.
+// Releases resampled copies the mixing thread is done with. Channel state
+// itself belongs to the mixing thread, which ends voices on its own.
 // 
 static void I_SDLUpdateSound()
 {
-   // 10/30/10: Moved channel stopping logic to I_StartSound to avoid problems
-   // with thread contention when running with d_fastrefresh enabled. Calling
-   // this from the main loop too often caused the sound to stutter.
+   if(sndretired.getLength())
+      I_sdlReleaseRetired();
 }
 
 //
@@ -830,7 +957,36 @@ i_sounddriver_t i_sdlsound_driver =
    I_SDLSoundIsPlaying,    // SoundIsPlaying
    I_SDLUpdateSoundParams, // UpdateSoundParams
    I_SDLUpdateEQParams,    // UpdateEQParams
+   I_SDLSeekSound,         // SeekSound
+   NULL,                   // TicSound
+   I_SDLWaitSoundCommands, // WaitSoundCommands
 };
 
+//
+// snd_mixstats
+//
+// Prints the command queue counters. Starts and seeks are refused only if
+// the mixing thread stops taking them, as when the audio device is lost.
+// The mixing thread never waits on the main thread, so it never skips a
+// buffer and there is no skipped count to show.
+//
+CONSOLE_COMMAND(snd_mixstats, 0)
+{
+   if(!snd_init || !mixbuffer_size)
+   {
+      C_Printf("The SDL sound driver is not in use\n");
+      return;
+   }
+
+   uint32_t depth = sndcmdhead.load() - sndcmdtail.load();
+
+   C_Printf("Buffers mixed: %u\n"
+            "Command queue: %u of %d, peak %u, refused %u\n"
+            "Resampled copies awaiting the mixer: %u\n",
+            sndbuffers.load(std::memory_order_relaxed), depth,
+            SNDCMD_QUEUESIZE, sndcmdpeak, sndcmddropped,
+            static_cast<unsigned int>(sndretired.getLength()));
+}
+
 // EOF
 
@@ -116,6 +116,38 @@ void I_StopSound(int handle, int id)
       i_sounddriver->StopSound(handle, id);
 }
 
+//
+// I_SeekSound
+//
+// Used to resume a sound that has been playing without a channel. Drivers
+// that cannot seek just play it from the start.
+//
+void I_SeekSound(int handle, int id, unsigned int ms)
+{
+   if(snd_init && i_sounddriver->SeekSound)
+      i_sounddriver->SeekSound(handle, id, ms);
+}
+
+//
+// I_SoundTic
+//
+void I_SoundTic()
+{
+   if(snd_init && i_sounddriver->TicSound)
+      i_sounddriver->TicSound();
+}
+
+//
+// I_WaitSoundCommands
+//
+// Drivers that mix on the calling thread need not wait for anything.
+//
+void I_WaitSoundCommands()
+{
+   if(snd_init && i_sounddriver->WaitSoundCommands)
+      i_sounddriver->WaitSoundCommands();
+}
+
 //
 // I_SoundIsPlaying
 //
@@ -205,6 +237,7 @@ void I_CacheSound(sfxinfo_t *sound)
 extern i_sounddriver_t i_sdlsound_driver;
 extern i_sounddriver_t i_pcsound_driver;
 #endif
+extern i_sounddriver_t i_wavsound_driver;
 
 //
 // I_InitSound
@@ -215,8 +248,11 @@ void I_InitSound(void)
    {
       printf("I_InitSound: ");
 
+      // -wavout renders to a file instead of any device
+      int card = M_CheckParm("-wavout") ? 2 : snd_card;
+
       // FIXME/TODO: initialize sound driver
-      switch(snd_card)
+      switch(card)
       {
 #ifdef _SDL_VER
       case -1:
@@ -237,6 +273,14 @@ void I_InitSound(void)
          }
          break;
 #endif
+      case 2:
+         i_sounddriver = &i_wavsound_driver;
+         if(i_sounddriver->InitSound())
+         {
+            atexit(I_ShutdownSound);
+            snd_init = true;
+         }
+         break;
       default:
          printf("Sound is disabled.\n");
          i_sounddriver = NULL;
@@ -35,6 +35,7 @@
 #include "../c_runcmd.h"
 #include "../d_event.h"
 #include "../d_gi.h"
+#include "../d_main.h"
 #include "../i_system.h"
 #include "../i_sound.h"
 #include "../i_video.h"
@@ -43,6 +44,7 @@
 #include "../m_syscfg.h"
 #include "../g_demolog.h"
 #include "../g_game.h"
+#include "../p_savefile.h"
 #include "../w_wad.h"
 #include "../v_video.h"
 #include "../m_argv.h"
@@ -135,6 +137,9 @@ void I_Quit(void)
    // haleyjd 06/05/10: not in fatal error situations; causes heap calls
    if(error_exitcode < I_ERRORLEVEL_FATAL && demorecording)
       G_CheckDemoStatus();
+
+   // don't lose a savegame still being written
+   IFNOTFATAL(P_FinishSaveFile());
    
    // sf : rearrange this so the errmsg doesn't get messed up
    if(error_exitcode >= I_ERRORLEVEL_MESSAGE)
@@ -320,6 +325,10 @@ void I_EndDoom()
    // allow ENDOOM disable in configuration.
    if(!GameModeInfo || !showendoom)
       return;
+
+   // the virtual clock used by -maxspeed would never end the wait below
+   if(d_maxspeed)
+      return;
    
    if((lumpnum = wGlobalDir.checkNumForName(GameModeInfo->endTextName)) < 0)
       return;
@@ -0,0 +1,406 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: offline sound driver writing the mix to a WAV file.
+//
+// Sound effects are mixed on the main thread, one tic's worth of samples for
+// each game tic run, with the same voice stepping, reverb and equalizer as
+// the SDL driver. Nothing depends on an audio device or the wall clock, so
+// a capture made faster than real time sounds the same as one made live.
+//
+
+#include "../z_zone.h"
+#include "../doomdef.h"
+#include "../doomstat.h"
+#include "../i_sound.h"
+#include "../m_argv.h"
+#include "../m_swap.h"
+#include "../s_formats.h"
+#include "../s_mixer.h"
+#include "../s_reverb.h"
+#include "../s_sound.h"
+#include "../sounds.h"
+
+#define WAV_MAXCHANNELS 128
+
+// The rate s_formats converts every sound to.
+#define WAV_SAMPLERATE 44100
+
+// Stereo frames mixed per game tic.
+#define WAV_TICFRAMES (WAV_SAMPLERATE / TICRATE)
+
+// Sizes written when the output cannot be rewound to fill them in, as on a
+// pipe; most readers take them to mean "until the end of the stream".
+#define WAV_STREAMSIZE 0xffffffffu
+
+//
+// wavchannel_t
+//
+struct wavchannel_t : mixvoice_t
+{
+   sfxinfo_t      *id;
+   unsigned int    idnum;
+   sndresampled_t *resampled; // pitched copy being played, if any
+};
+
+static wavchannel_t wavchannels[WAV_MAXCHANNELS];
+
+// Pitch to stepping lookup.
+static unsigned int wavsteptable[256];
+
+// Dry and reverberated mix of one tic, and its final 16-bit form.
+static float   wavmix[2][WAV_TICFRAMES * 2];
+static int16_t wavpcm[WAV_TICFRAMES * 2];
+
+static SoundEqualizer wavequalizer;
+
+static FILE    *wavfile;
+static uint64_t wavdatabytes; // PCM bytes written so far
+
+//
+// I_wavWriteHeader
+//
+// Writes the canonical 44-byte RIFF header for 16-bit stereo PCM.
+//
+static bool I_wavWriteHeader(uint32_t databytes)
+{
+   uint32_t riffbytes = databytes == WAV_STREAMSIZE ? databytes : databytes + 36;
+   byte     header[44];
+   byte    *p = header;
+
+   auto putTag = [&p] (const char *tag) {
+      memcpy(p, tag, 4);
+      p += 4;
+   };
+   auto putLong = [&p] (uint32_t x) {
+      *p++ = byte(x);
+      *p++ = byte(x >> 8);
+      *p++ = byte(x >> 16);
+      *p++ = byte(x >> 24);
+   };
+   auto putShort = [&p] (uint16_t x) {
+      *p++ = byte(x);
+      *p++ = byte(x >> 8);
+   };
+
+   putTag("RIFF");
+   putLong(riffbytes);
+   putTag("WAVE");
+   putTag("fmt ");
+   putLong(16);                 // format chunk size
+   putShort(1);                 // PCM
+   putShort(2);                 // channels
+   putLong(WAV_SAMPLERATE);
+   putLong(WAV_SAMPLERATE * 4); // bytes per second
+   putShort(4);                 // bytes per frame
+   putShort(16);                // bits per sample
+   putTag("data");
+   putLong(databytes);
+
+   return fwrite(header, sizeof(header), 1, wavfile) == 1;
+}
+
+//
+// I_wavStopChannel
+//
+static void I_wavStopChannel(wavchannel_t *chan)
+{
+   chan->data = nullptr;
+   if(chan->resampled)
+   {
+      S_ReleaseResampledSound(chan->resampled);
+      chan->resampled = nullptr;
+   }
+}
+
+//
+// I_WAVInitSound
+//
+static int I_WAVInitSound()
+{
+   int p = M_CheckParm("-wavout");
+
+   if(!p || p >= myargc - 1)
+   {
+      printf("No file given to -wavout.\n");
+      return 0;
+   }
+
+   if(!(wavfile = fopen(myargv[p + 1], "wb")))
+   {
+      printf("Couldn't open %s for sound output.\n", myargv[p + 1]);
+      return 0;
+   }
+
+   // a tic is about 5 KB; write in larger blocks
+   setvbuf(wavfile, nullptr, _IOFBF, 64 * 1024);
+
+   // the real sizes are filled in at shutdown where the output allows
+   if(!I_wavWriteHeader(WAV_STREAMSIZE))
+   {
+      printf("Couldn't write to %s.\n", myargv[p + 1]);
+      fclose(wavfile);
+      wavfile = nullptr;
+      return 0;
+   }
+   wavdatabytes = 0;
+
+   memset(wavchannels, 0, sizeof(wavchannels));
+   for(int i = 0; i < 256; i++)
+      wavsteptable[i] = S_PitchStep(i);
+
+   wavequalizer.setup(WAV_SAMPLERATE);
+
+   printf("Writing sound to %s.\n", myargv[p + 1]);
+   return 1;
+}
+
+//
+// I_WAVCacheSound
+//
+static void I_WAVCacheSound(sfxinfo_t *sound)
+{
+   S_CacheDigitalSoundLump(sound);
+}
+
+//
+// I_WAVUpdateSound
+//
+// Mixing happens per tic, in I_WAVTicSound.
+//
+static void I_WAVUpdateSound()
+{
+}
+
+//
+// I_WAVSubmitSound
+//
+static void I_WAVSubmitSound()
+{
+}
+
+//
+// I_WAVShutdownSound
+//
+// atexit handler. Fills in the header sizes if the output can be rewound.
+//
+static void I_WAVShutdownSound()
+{
+   if(!wavfile)
+      return;
+
+   for(wavchannel_t &chan : wavchannels)
+      I_wavStopChannel(&chan);
+
+   // beyond 4 GB the streaming sizes are as good as any
+   if(wavdatabytes <= WAV_STREAMSIZE - 36 && !fseek(wavfile, 0, SEEK_SET))
+      I_wavWriteHeader(uint32_t(wavdatabytes));
+
+   fclose(wavfile);
+   wavfile = nullptr;
+}
+
+//
+// I_WAVUpdateSoundParams
+//
+static void I_WAVUpdateSoundParams(int handle, int vol, int sep, int pitch)
+{
+#ifdef RANGECHECK
+   if(handle < 0 || handle >= WAV_MAXCHANNELS)
+      I_Error("I_WAVUpdateSoundParams: handle out of range\n");
+#endif
+
+   wavchannel_t *chan = &wavchannels[handle];
+
+   S_SetVoiceVolume(chan, vol, sep);
+
+   // a resampled copy already has the pitch applied
+   if(chan->resampled || !pitched_sounds)
+      chan->step = 1 << 16;
+   else
+      chan->step = wavsteptable[pitch];
+}
+
+//
+// I_WAVStartSound
+//
+static int I_WAVStartSound(sfxinfo_t *sound, int cnum, int vol, int sep,
+                           int pitch, int pri, int loop, bool reverb)
+{
+   static unsigned int id = 1;
+   int handle;
+
+   // as with SDL, a sound is missed rather than one cut off
+   for(handle = 0; handle < numChannels && handle < WAV_MAXCHANNELS; handle++)
+   {
+      if(!wavchannels[handle].data)
+         break;
+   }
+   if(handle == numChannels || handle == WAV_MAXCHANNELS)
+      return -1;
+
+   if(!sound || !S_LoadDigitalSoundEffect(sound))
+      return -1;
+
+   wavchannel_t *chan = &wavchannels[handle];
+
+   I_wavStopChannel(chan);
+   if(pitched_sounds && wavsteptable[pitch] != 1 << 16)
+      chan->resampled = S_GetResampledSound(sound, wavsteptable[pitch]);
+
+   float       *data = chan->resampled ? chan->resampled->data : (float *)sound->data;
+   unsigned int alen = chan->resampled ? chan->resampled->alen : sound->alen;
+
+   chan->data          = data;
+   chan->startdata     = data;
+   chan->enddata       = data + alen - 1;
+   chan->stepremainder = 0;
+   chan->loop          = loop;
+   chan->reverb        = reverb;
+   chan->id            = sound;
+   chan->idnum         = id++;
+
+   I_WAVUpdateSoundParams(handle, vol, sep, pitch);
+
+   return handle;
+}
+
+//
+// I_WAVSoundID
+//
+static int I_WAVSoundID(int handle)
+{
+#ifdef RANGECHECK
+   if(handle < 0 || handle >= WAV_MAXCHANNELS)
+      I_Error("I_WAVSoundID: handle out of range\n");
+#endif
+
+   return wavchannels[handle].idnum;
+}
+
+//
+// I_WAVStopSound
+//
+static void I_WAVStopSound(int handle, int id)
+{
+#ifdef RANGECHECK
+   if(handle < 0 || handle >= WAV_MAXCHANNELS)
+      I_Error("I_WAVStopSound: handle out of range\n");
+#endif
+
+   if(wavchannels[handle].idnum == (unsigned int)id)
+      I_wavStopChannel(&wavchannels[handle]);
+}
+
+//
+// I_WAVSoundIsPlaying
+//
+static int I_WAVSoundIsPlaying(int handle)
+{
+#ifdef RANGECHECK
+   if(handle < 0 || handle >= WAV_MAXCHANNELS)
+      I_Error("I_WAVSoundIsPlaying: handle out of range\n");
+#endif
+
+   return wavchannels[handle].data != nullptr;
+}
+
+//
+// I_WAVUpdateEQParams
+//
+static void I_WAVUpdateEQParams()
+{
+   wavequalizer.setup(WAV_SAMPLERATE);
+}
+
+//
+// I_WAVSeekSound
+//
+static void I_WAVSeekSound(int handle, int id, unsigned int ms)
+{
+#ifdef RANGECHECK
+   if(handle < 0 || handle >= WAV_MAXCHANNELS)
+      I_Error("I_WAVSeekSound: handle out of range\n");
+#endif
+
+   wavchannel_t *chan = &wavchannels[handle];
+
+   if(chan->idnum == (unsigned int)id && chan->data && !S_SeekVoice(chan, ms))
+      I_wavStopChannel(chan);
+}
+
+//
+// I_WAVTicSound
+//
+// Mixes and writes out one tic of sound. Everything runs on the main thread,
+// so channels are used directly, without any locking.
+//
+static void I_WAVTicSound()
+{
+   const bool canloop = S_VoicesMayLoop();
+
+   memset(wavmix, 0, sizeof(wavmix));
+
+   for(int i = 0; i < numChannels && i < WAV_MAXCHANNELS; i++)
+   {
+      wavchannel_t *chan = &wavchannels[i];
+
+      if(chan->data &&
+         !S_MixVoice(chan, wavmix[chan->reverb ? 1 : 0], WAV_TICFRAMES, canloop))
+         I_wavStopChannel(chan);
+   }
+
+   if(s_reverbactive)
+      S_ProcessReverb(wavmix[1], WAV_TICFRAMES);
+   S_MixAdd(wavmix[0], wavmix[1], WAV_TICFRAMES * 2);
+
+   wavequalizer.process(wavmix[0], wavmix[0] + WAV_TICFRAMES * 2, wavpcm);
+
+   // WAV data is little-endian
+   for(int16_t &sample : wavpcm)
+      sample = SwapShort(sample);
+
+   if(fwrite(wavpcm, sizeof(wavpcm), 1, wavfile) == 1)
+      wavdatabytes += sizeof(wavpcm);
+}
+
+//
+// WAV Sound Driver Object
+//
+i_sounddriver_t i_wavsound_driver =
+{
+   I_WAVInitSound,         // InitSound
+   I_WAVCacheSound,        // CacheSound
+   I_WAVUpdateSound,       // UpdateSound
+   I_WAVSubmitSound,       // SubmitSound
+   I_WAVShutdownSound,     // ShutdownSound
+   I_WAVStartSound,        // StartSound
+   I_WAVSoundID,           // SoundID
+   I_WAVStopSound,         // StopSound
+   I_WAVSoundIsPlaying,    // SoundIsPlaying
+   I_WAVUpdateSoundParams, // UpdateSoundParams
+   I_WAVUpdateEQParams,    // UpdateEQParams
+   I_WAVSeekSound,         // SeekSound
+   I_WAVTicSound,          // TicSound
+   NULL,                   // WaitSoundCommands
+};
+
+// EOF
+
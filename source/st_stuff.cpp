@@ -1417,6 +1417,19 @@ static void ST_DoomInit()
    ST_loadData();
 }
 
+//
+// ST_InitPalette
+//
+// Finds the palette lump, which the status bar code needs even when its
+// graphics are not loaded.
+//
+void ST_InitPalette()
+{
+   // haleyjd: moved palette initialization here, because all
+   // game modes will need it.
+   lu_palette = W_GetNumForName("PLAYPAL");
+}
+
 //
 // ST_Init
 //
@@ -1426,9 +1439,7 @@ static void ST_DoomInit()
 //
 void ST_Init()
 {
-   // haleyjd: moved palette initialization here, because all
-   // game modes will need it.
-   lu_palette = W_GetNumForName("PLAYPAL");
+   ST_InitPalette();
 
    GameModeInfo->StatusBar->Init();
 }
@@ -58,6 +58,7 @@ void ST_Drawer(bool fullscreen);
 void ST_Start(void);
 
 // Called by startup code.
+void ST_InitPalette();
 void ST_Init(void);
 
 void ST_CacheFaces(patch_t **faces, const char *facename);
@@ -1425,6 +1425,56 @@ const char *WadDirectory::getLumpFileName(int lump) const
    return WadDirectoryPimpl::FileNameForSource(lumpinfo[lumpIdx]->source);
 }
 
+//
+// WadDirectory::hashContents
+//
+// Feeds a summary of the directory into a hash: the name, size and namespace
+// of every lump, in order, plus the path, size and modification time of each
+// file that contributed lumps. Equal hashes mean the same resources were
+// loaded in the same order, without any lump data having to be read. Used to
+// key on-disk caches of data derived from the directory.
+//
+void WadDirectory::hashContents(HashData &hash) const
+{
+   int lastsource = -1;
+
+   for(int i = 0; i < numlumps; i++)
+   {
+      const lumpinfo_t *lump = lumpinfo[i];
+
+      if(lump->source != lastsource)
+      {
+         const char *filename = WadDirectoryPimpl::FileNameForSource(lump->source);
+         struct stat sbuf;
+
+         lastsource = lump->source;
+         if(filename)
+         {
+            hash.addData(reinterpret_cast<const uint8_t *>(filename), 
+                         static_cast<uint32_t>(strlen(filename)));
+            if(!stat(filename, &sbuf))
+            {
+               int64_t filesize = static_cast<int64_t>(sbuf.st_size);
+               int64_t filetime = static_cast<int64_t>(sbuf.st_mtime);
+               hash.addData(reinterpret_cast<const uint8_t *>(&filesize), sizeof(filesize));
+               hash.addData(reinterpret_cast<const uint8_t *>(&filetime), sizeof(filetime));
+            }
+         }
+      }
+
+      uint32_t lumpsize = static_cast<uint32_t>(lump->size);
+      int32_t  namespc  = lump->li_namespace;
+      hash.addData(reinterpret_cast<const uint8_t *>(lump->name), 8);
+      hash.addData(reinterpret_cast<const uint8_t *>(&lumpsize), sizeof(lumpsize));
+      hash.addData(reinterpret_cast<const uint8_t *>(&namespc), sizeof(namespc));
+      if(lump->lfn)
+      {
+         hash.addData(reinterpret_cast<const uint8_t *>(lump->lfn), 
+                      static_cast<uint32_t>(strlen(lump->lfn)));
+      }
+   }
+}
+
 //
 // W_InitLumpHash
 //
@@ -1684,6 +1734,32 @@ void *WadDirectory::cacheLumpName(const char *name, int tag,
    return cacheLumpNum(getNumForName(name), tag, lfmt);
 }
 
+//
+// WadDirectory::prefetchLumps
+//
+// Hint that a batch of lumps is about to be cached. Lumps inside ZIP/PK3
+// archives that aren't already in the zone cache are inflated ahead of time
+// in parallel; other lump types are unaffected.
+//
+void WadDirectory::prefetchLumps(const int *lumpnums, size_t count) const
+{
+   PODCollection<ZipLump *> zipLumps;
+
+   for(size_t i = 0; i < count; i++)
+   {
+      int lumpnum = lumpnums[i];
+      if(lumpnum < 0 || lumpnum >= numlumps)
+         continue;
+
+      const lumpinfo_t *lump = lumpinfo[lumpnum];
+      if(lump->type == lumpinfo_t::lump_zip && !lump->cache[lumpinfo_t::fmt_default])
+         zipLumps.add(lump->zip.zipLump);
+   }
+
+   if(!zipLumps.isEmpty())
+      ZipFile::PrefetchLumps(zipLumps.begin(), zipLumps.getLength());
+}
+
 //
 // WadDirectory::cacheLumpAuto
 //
@@ -23,6 +23,7 @@
 
 #include "z_zone.h"
 
+class  HashData;
 class  ZAutoBuffer;
 class  ZipFile;
 struct ZipLump;
@@ -324,6 +325,7 @@ public:
                       const WadLumpLoader *lfmt = nullptr) const;
    void *cacheLumpName(const char *name, int tag,
                        const WadLumpLoader *lfmt = nullptr) const;
+   void  prefetchLumps(const int *lumpnums, size_t count) const;
    void  cacheLumpAuto(int lumpnum, ZAutoBuffer &buffer) const;
    void  cacheLumpAuto(const char *name, ZAutoBuffer &buffer) const;
    bool  writeLump(const char *lumpname, const char *destpath) const;
@@ -331,6 +333,8 @@ public:
 
    lumpinfo_t *getLumpNameChain(const char *name) const;
 
+   void  hashContents(HashData &hash) const;
+
    const char *getLumpName(int lumpnum) const;
    const char *getLumpFileName(int lump) const;
 
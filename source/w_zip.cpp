@@ -26,14 +26,23 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
 #include "z_auto.h"
 
+#include "c_io.h"
+#include "c_runcmd.h"
 #include "i_system.h"
 #include "m_buffer.h"
+#include "m_collection.h"
 #include "m_compare.h"
 #include "m_qstr.h"
 #include "m_structio.h"
 #include "m_swap.h"
+#include "m_workpool.h"
 #include "w_wad.h"
 #include "w_zip.h"
 
@@ -247,6 +256,133 @@ static bool ZIP_FindEndOfCentralDir(InBuffer &fin, long &position)
    return true;
 }
 
+//=============================================================================
+//
+// Decompressed Lump Cache
+//
+// Deflated lumps are otherwise re-inflated from scratch every time they are
+// re-cached after a PU_CACHE purge. Inflated copies are kept here, bounded
+// by w_zipcachesize, with least-recently-used eviction. The cache is only
+// ever touched from the main thread; ZipFile::PrefetchLumps inflates on the
+// worker pool into private buffers and inserts them afterward.
+//
+
+int w_zipcachesize = 32;
+
+class ZipLumpCache
+{
+protected:
+   struct entry_t
+   {
+      const ZipLump          *lump; // owning lump
+      std::unique_ptr<byte[]> data; // inflated contents
+      size_t                  size; // size of data
+   };
+   typedef std::list<entry_t> lrulist_t;
+
+   lrulist_t lru;   // most recently used first
+   std::unordered_map<const ZipLump *, lrulist_t::iterator> index;
+   size_t totalSize;
+
+public:
+   unsigned int hits, misses, evictions, prefetched;
+
+   ZipLumpCache() 
+      : lru(), index(), totalSize(0), hits(0), misses(0), evictions(0), 
+        prefetched(0)
+   {
+   }
+
+   static size_t Budget() 
+   { 
+      return static_cast<size_t>(emax(w_zipcachesize, 0)) << 20; 
+   }
+
+   bool contains(const ZipLump *lump) const { return index.count(lump) > 0; }
+   size_t getTotalSize() const { return totalSize; }
+   size_t getNumEntries() const { return index.size(); }
+
+   //
+   // Copy a cached lump into buffer if present, and mark it most recent.
+   //
+   bool lookup(const ZipLump *lump, void *buffer)
+   {
+      auto itr = index.find(lump);
+      if(itr == index.end())
+      {
+         ++misses;
+         return false;
+      }
+      lru.splice(lru.begin(), lru, itr->second);
+      memcpy(buffer, itr->second->data.get(), itr->second->size);
+      ++hits;
+      return true;
+   }
+
+   //
+   // Drop least recently used entries until at most budget bytes remain.
+   //
+   void evictTo(size_t budget)
+   {
+      while(totalSize > budget && !lru.empty())
+      {
+         entry_t &last = lru.back();
+         totalSize -= last.size;
+         index.erase(last.lump);
+         lru.pop_back();
+         ++evictions;
+      }
+   }
+
+   //
+   // Take ownership of an inflated buffer for lump.
+   //
+   void insert(const ZipLump *lump, std::unique_ptr<byte[]> data, size_t size)
+   {
+      size_t budget = Budget();
+      if(!size || size > budget || contains(lump))
+         return;
+
+      evictTo(budget - size);
+      lru.push_front(entry_t { lump, std::move(data), size });
+      index[lump] = lru.begin();
+      totalSize += size;
+   }
+
+   //
+   // Copy buffer into the cache for lump.
+   //
+   void insertCopy(const ZipLump *lump, const void *buffer, size_t size)
+   {
+      if(!size || size > Budget() || contains(lump))
+         return;
+
+      std::unique_ptr<byte[]> data(new byte[size]);
+      memcpy(data.get(), buffer, size);
+      insert(lump, std::move(data), size);
+   }
+
+   //
+   // Forget all entries belonging to a zip file that is being destroyed.
+   //
+   void purgeFile(const ZipFile *file)
+   {
+      for(auto itr = lru.begin(); itr != lru.end(); )
+      {
+         if(itr->lump->file == file)
+         {
+            totalSize -= itr->size;
+            index.erase(itr->lump);
+            itr = lru.erase(itr);
+         }
+         else
+            ++itr;
+      }
+   }
+};
+
+static ZipLumpCache zipLumpCache;
+
 //=============================================================================
 //
 // ZipFile Class
@@ -257,6 +393,9 @@ static bool ZIP_FindEndOfCentralDir(InBuffer &fin, long &position)
 //
 ZipFile::~ZipFile()
 {
+   // drop any inflated lumps still cached for this file
+   zipLumpCache.purgeFile(this);
+
    // free the directory
    if(lumps && numLumps)
    {
@@ -664,6 +803,34 @@ public:
    }
 };
 
+//
+// ZIP_InflateBuffer
+//
+// Inflate a complete raw deflate stream already in memory. Unlike the
+// ZIPDeflateReader, this never calls I_Error and allocates nothing from the
+// zone heap, so it is safe to call from a worker thread.
+//
+static bool ZIP_InflateBuffer(const byte *src, size_t srclen, byte *dest, 
+                              size_t destlen)
+{
+   z_stream zlStream = z_stream();
+   int      code;
+
+   if(inflateInit2(&zlStream, -MAX_WBITS) != Z_OK)
+      return false;
+
+   zlStream.next_in   = const_cast<Bytef *>(src);
+   zlStream.avail_in  = static_cast<uInt>(srclen);
+   zlStream.next_out  = dest;
+   zlStream.avail_out = static_cast<uInt>(destlen);
+
+   code = inflate(&zlStream, Z_FINISH);
+   inflateEnd(&zlStream);
+
+   return (code == Z_STREAM_END || code == Z_OK || code == Z_BUF_ERROR) && 
+          zlStream.avail_out == 0;
+}
+
 //
 // ZIP_ReadDeflated
 //
@@ -722,6 +889,10 @@ void ZipLump::read(void *buffer)
 {
    InBuffer reader;
 
+   // Deflated lumps may already be inflated in the decompressed lump cache
+   if(method == ZipFile::METHOD_DEFLATE && zipLumpCache.lookup(this, buffer))
+      return;
+
    reader.openExisting(file->getFile(), InBuffer::LENDIAN);
 
    // Calculate an offset beyond the lump's local file header, if such hasn't
@@ -743,6 +914,7 @@ void ZipLump::read(void *buffer)
       break;
    case ZipFile::METHOD_DEFLATE:
       ZIP_ReadDeflated(reader, buffer, size);
+      zipLumpCache.insertCopy(this, buffer, size);
       break;
    default:
       // shouldn't happen; files with other methods are removed from the directory
@@ -752,6 +924,26 @@ void ZipLump::read(void *buffer)
    }
 }
 
+//
+// ZipLump::readRaw
+//
+// Read a lump's data exactly as stored in the archive, without inflating it.
+// buffer must hold at least "compressed" bytes. Returns false on IO error.
+//
+bool ZipLump::readRaw(void *buffer)
+{
+   InBuffer reader;
+
+   reader.openExisting(file->getFile(), InBuffer::LENDIAN);
+
+   if(flags & ZipFile::LF_CALCOFFSET)
+      setAddress(reader);
+   else if(reader.seek(offset, SEEK_SET))
+      return false;
+
+   return reader.read(buffer, compressed) == compressed;
+}
+
 //
 // ZipLump::read(ZAutoBuffer &, bool)
 //
@@ -769,5 +961,113 @@ void ZipLump::read(ZAutoBuffer &buf, bool asString)
    }
 }
 
+//=============================================================================
+//
+// Prefetching
+//
+
+//
+// ZipFile::PrefetchLumps
+//
+// Fill the decompressed lump cache with a batch of lumps that are about to be
+// used, such as all sprites or sounds being precached. Compressed data is read
+// on the main thread in file order, then inflated in parallel on the worker
+// pool. Lumps that are stored, already cached, or that would not fit in the
+// cache budget are skipped; any that fail to inflate here are simply read the
+// ordinary way later, which will report the error.
+//
+void ZipFile::PrefetchLumps(ZipLump *const *lumps, size_t numlumps)
+{
+   struct prefetch_t
+   {
+      ZipLump                *lump;
+      std::unique_ptr<byte[]> raw;
+      std::unique_ptr<byte[]> data;
+      bool                    ok;
+   };
+
+   size_t budget = ZipLumpCache::Budget();
+   size_t total  = 0;
+   PODCollection<ZipLump *> wanted;
+
+   for(size_t i = 0; i < numlumps; i++)
+   {
+      ZipLump *lump = lumps[i];
+      if(!lump || lump->method != METHOD_DEFLATE || !lump->size || 
+         zipLumpCache.contains(lump))
+         continue;
+      // don't prefetch more than the cache can hold, or we evict ourselves
+      if(total + lump->size > budget)
+         break;
+      total += lump->size;
+      wanted.add(lump);
+   }
+
+   if(wanted.isEmpty())
+      return;
+
+   // sort by archive and position so the raw reads are sequential
+   std::sort(wanted.begin(), wanted.end(), [] (const ZipLump *a, const ZipLump *b) {
+      return a->file != b->file ? a->file < b->file : a->offset < b->offset;
+   });
+   wanted.resize(std::unique(wanted.begin(), wanted.end()) - wanted.begin());
+
+   std::unique_ptr<prefetch_t[]> jobs(new prefetch_t[wanted.getLength()]);
+   size_t numjobs = 0;
+   for(ZipLump *lump : wanted)
+   {
+      prefetch_t &job = jobs[numjobs];
+      job.lump = lump;
+      job.raw.reset(new byte[lump->compressed ? lump->compressed : 1]);
+      job.ok   = false;
+      if(lump->readRaw(job.raw.get()))
+         ++numjobs;
+      else
+         job.raw.reset();
+   }
+
+   M_GetWorkerPool().parallelFor(numjobs, [&jobs] (size_t i) {
+      prefetch_t &job = jobs[i];
+      job.data.reset(new byte[job.lump->size]);
+      job.ok = ZIP_InflateBuffer(job.raw.get(), job.lump->compressed, 
+                                 job.data.get(), job.lump->size);
+      job.raw.reset();
+   });
+
+   for(size_t i = 0; i < numjobs; i++)
+   {
+      if(jobs[i].ok)
+      {
+         zipLumpCache.insert(jobs[i].lump, std::move(jobs[i].data), 
+                             jobs[i].lump->size);
+         ++zipLumpCache.prefetched;
+      }
+   }
+}
+
+//
+// ZipFile::PrintCacheStats
+//
+void ZipFile::PrintCacheStats()
+{
+   C_Printf("Decompressed lump cache: %u lumps, %u KB of %d MB\n"
+            "hits %u, misses %u, evictions %u, prefetched %u\n",
+            static_cast<unsigned int>(zipLumpCache.getNumEntries()),
+            static_cast<unsigned int>(zipLumpCache.getTotalSize() >> 10),
+            w_zipcachesize, zipLumpCache.hits, zipLumpCache.misses, 
+            zipLumpCache.evictions, zipLumpCache.prefetched);
+}
+
+VARIABLE_INT(w_zipcachesize, NULL, 0, 1024, NULL);
+CONSOLE_VARIABLE(w_zipcachesize, w_zipcachesize, 0)
+{
+   zipLumpCache.evictTo(ZipLumpCache::Budget());
+}
+
+CONSOLE_COMMAND(w_zipcachestats, 0)
+{
+   ZipFile::PrintCacheStats();
+}
+
 // EOF
 
@@ -52,6 +52,7 @@ struct ZipLump
    void setAddress(InBuffer &fin);
    void read(void *buffer);
    void read(ZAutoBuffer &buf, bool asString);
+   bool readRaw(void *buffer);
 };
 
 struct ZipWad
@@ -114,8 +115,14 @@ public:
    int      findLump(const char *name) const;
    int      getNumLumps() const { return numLumps; }   
    FILE    *getFile()     const { return file;     }
+
+   // Decompressed lump cache
+   static void PrefetchLumps(ZipLump *const *lumps, size_t numlumps);
+   static void PrintCacheStats();
 };
 
+extern int w_zipcachesize; // decompressed lump cache budget in MB
+
 #endif
 
 // EOF